@@ -32,8 +32,11 @@
 #include <picoos-u.h>
 #include <picoos-net.h>
 #include <sys/socket.h>
+#include <netdb.h>
 #include <string.h>
+#include <errno.h>
 #include <net/ip/uiplib.h>
+#include <lib/memb.h>
 
 #if NETCFG_BSD_SOCKETS == 1
 
@@ -45,6 +48,14 @@
 #define SOCKADDR2PORT(sa) (((struct sockaddr_in*)sa)->sin_port)
 #endif
 
+#if NETSTACK_CONF_WITH_IPV6
+#define SOCKADDR_LEN sizeof(struct sockaddr_in6)
+#define SOCKADDR_FAMILY AF_INET6
+#else
+#define SOCKADDR_LEN sizeof(struct sockaddr_in)
+#define SOCKADDR_FAMILY AF_INET
+#endif
+
 int net_socket(int domain, int type, int protocol)
 {
   UosFile* sock;
@@ -96,8 +107,7 @@ int net_bind(int s, const struct sockaddr *name, socklen_t namelen)
 
 int net_listen(int s, int backlog)
 {
-  netSockListen(uosSlot2File(s));
-  return 0;
+  return netSockListenBacklog(uosSlot2File(s), backlog);
 }
 
 int net_getsockopt (int s, int level, int optname, void *optval, socklen_t *optlen)
@@ -121,6 +131,39 @@ int net_setsockopt (int s, int level, int optname, const void *optval, socklen_t
     return 0;
   }
 
+#if NETCFG_TCP_KEEPALIVE == 1
+  if ((level == SOL_SOCKET && optname == SO_KEEPALIVE) || level == IPPROTO_TCP) {
+
+    if (optval == NULL || optlen < sizeof(int)) {
+
+      errno = EINVAL;
+      return -1;
+    }
+  }
+
+  if (level == SOL_SOCKET && optname == SO_KEEPALIVE)
+    return netSockKeepalive(file, *(const int*)optval != 0);
+
+  if (level == IPPROTO_TCP) {
+
+    int v = *(const int*)optval;
+
+    if (v <= 0)
+      return -1;
+
+    switch (optname) {
+    case TCP_KEEPIDLE:
+      return netSockKeepaliveParams(file, v, 0, 0);
+
+    case TCP_KEEPINTVL:
+      return netSockKeepaliveParams(file, 0, v, 0);
+
+    case TCP_KEEPCNT:
+      return netSockKeepaliveParams(file, 0, 0, v);
+    }
+  }
+#endif
+
   return -1;
 }
 
@@ -139,6 +182,173 @@ int net_recv(int s, void *dataptr, size_t size, int flags)
   return len;
 }
 
+#if UIP_CONF_UDP == 1
+
+static void sockaddrSet(struct sockaddr* sa, socklen_t* salen, const uip_ipaddr_t* addr, uint16_t port)
+{
+  if (sa == NULL)
+    return;
+
+  sa->sa_len = SOCKADDR_LEN;
+  sa->sa_family = SOCKADDR_FAMILY;
+  uip_ipaddr_copy(SOCKADDR2UIP(sa), addr);
+  SOCKADDR2PORT(sa) = uip_htons(port);
+  if (salen != NULL)
+    *salen = SOCKADDR_LEN;
+}
+
+int net_recvfrom(int s, void *mem, size_t len, int flags, struct sockaddr *from, socklen_t *fromlen)
+{
+  UosFile* file = uosSlot2File(s);
+  NetSock* sock = (NetSock*)file->fsPriv;
+  uip_ipaddr_t addr;
+  uint16_t port;
+  int rlen;
+
+  rlen = netSockRecvFrom(file, mem, len > 0xffff ? 0xffff : len, &addr, &port, sock->timeout);
+  if (rlen == NET_SOCK_EOF)
+    return 0;
+
+  if (rlen < 0)
+    return -1;
+
+  sockaddrSet(from, fromlen, &addr, port);
+  return rlen;
+}
+
+/*
+ * Receive multiple datagrams. Blocks (according to SO_RCVTIMEO)
+ * for first one only, rest are taken from socket queue.
+ * Datagrams are passed to netSockRecvBatch in groups
+ * of NETCFG_MMSG_BATCH.
+ */
+int net_recvmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+  UosFile* file = uosSlot2File(s);
+  NetSock* sock = (NetSock*)file->fsPriv;
+  NetSockDgram msgs[NETCFG_MMSG_BATCH];
+  struct msghdr* m;
+  unsigned int n = 0;
+  int count;
+  int i;
+  int result;
+
+  while (n < vlen) {
+
+    count = vlen - n > NETCFG_MMSG_BATCH ? NETCFG_MMSG_BATCH : vlen - n;
+    for (i = 0; i < count; i++) {
+
+      m = &msgvec[n + i].msg_hdr;
+      msgs[i].data = m->msg_iov[0].iov_base;
+      msgs[i].max = m->msg_iov[0].iov_len > 65535 ? 65535 : m->msg_iov[0].iov_len;
+    }
+
+    result = netSockRecvBatch(file, msgs, count, n == 0 ? sock->timeout : 0);
+    if (result <= 0)
+      break;
+
+    for (i = 0; i < result; i++) {
+
+      m = &msgvec[n + i].msg_hdr;
+      msgvec[n + i].msg_len = msgs[i].len;
+      m->msg_flags = 0;
+      sockaddrSet(m->msg_name, &m->msg_namelen, &msgs[i].addr, msgs[i].port);
+    }
+
+    n += result;
+    if (result < count)
+      break;
+  }
+
+  return n > 0 ? (int)n : -1;
+}
+
+int net_sendto(int s, const void *dataptr, size_t size, int flags, const struct sockaddr *to, socklen_t tolen)
+{
+  if (to == NULL)
+    return net_send(s, dataptr, size, flags);
+
+  if (size > NET_SOCK_MAX_DGRAM) {
+
+    errno = EMSGSIZE;
+    return -1;
+  }
+
+  if (netSockSendTo(uosSlot2File(s), dataptr, size, SOCKADDR2UIP(to), uip_ntohs(SOCKADDR2PORT(to))) < (int)size)
+    return -1;
+
+  return size;
+}
+
+/*
+ * Send multiple datagrams. Datagrams are passed to
+ * netSockSendBatch in groups of NETCFG_MMSG_BATCH.
+ * Datagram without msg_name goes to connected peer.
+ * Sending stops at datagram longer than NET_SOCK_MAX_DGRAM.
+ */
+int net_sendmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+  UosFile* file = uosSlot2File(s);
+  NetSockDgram msgs[NETCFG_MMSG_BATCH];
+  struct msghdr* m;
+  unsigned int sent = 0;
+  bool tooLong = false;
+  int count;
+  int i;
+  int result;
+
+  while (sent < vlen && !tooLong) {
+
+    count = vlen - sent > NETCFG_MMSG_BATCH ? NETCFG_MMSG_BATCH : vlen - sent;
+    for (i = 0; i < count; i++) {
+
+      m = &msgvec[sent + i].msg_hdr;
+      if (m->msg_iov[0].iov_len > NET_SOCK_MAX_DGRAM) {
+
+        tooLong = true;
+        break;
+      }
+
+      msgs[i].data = m->msg_iov[0].iov_base;
+      msgs[i].len = m->msg_iov[0].iov_len;
+      if (m->msg_name == NULL) {
+
+        memset(&msgs[i].addr, 0, sizeof(msgs[i].addr));
+        msgs[i].port = 0;
+      }
+      else {
+
+        uip_ipaddr_copy(&msgs[i].addr, SOCKADDR2UIP(m->msg_name));
+        msgs[i].port = uip_ntohs(SOCKADDR2PORT(m->msg_name));
+      }
+    }
+
+    count = i;
+    if (count == 0) {
+
+      if (sent == 0)
+        errno = EMSGSIZE;
+
+      break;
+    }
+
+    result = netSockSendBatch(file, msgs, count);
+    if (result <= 0)
+      break;
+
+    for (i = 0; i < result; i++)
+      msgvec[sent + i].msg_len = msgs[i].len;
+
+    sent += result;
+    if (result < count)
+      break;
+  }
+
+  return sent > 0 ? (int)sent : -1;
+}
+
+#endif
+
 int net_send(int s, const void *dataptr, size_t size, int flags)
 {
   UosFile* sock = uosSlot2File(s);
@@ -159,6 +369,105 @@ int net_write(int s, const void *dataptr, size_t size)
   return net_send(s, dataptr, size, 0);
 }
 
+#if NETCFG_DNS == 1
+
+struct addrinfoStorage {
+  struct addrinfo ai;
+  struct sockaddr_storage sa;
+};
+
+MEMB(addrinfoPool, struct addrinfoStorage, NETCFG_ADDRINFO_COUNT);
+
+int net_getaddrinfo(const char *nodename, const char *servname,
+                    const struct addrinfo *hints, struct addrinfo **res)
+{
+  struct addrinfoStorage* ai;
+  uip_ipaddr_t addr;
+  const char* p;
+  long port = 0;
+
+  *res = NULL;
+  if (hints != NULL && hints->ai_family != AF_UNSPEC &&
+#if NETSTACK_CONF_WITH_IPV6
+      hints->ai_family != AF_INET6)
+#else
+      hints->ai_family != AF_INET)
+#endif
+    return EAI_FAMILY;
+
+  if (servname != NULL) {
+
+    for (p = servname; *p != '\0'; p++) {
+
+      if (*p < '0' || *p > '9' || port > 65535)
+        return EAI_SERVICE;
+
+      port = port * 10 + *p - '0';
+    }
+
+    if (p == servname || port > 65535)
+      return EAI_SERVICE;
+  }
+
+  if (nodename == NULL)
+    memset(&addr, 0, sizeof(addr));
+  else if (hints != NULL && (hints->ai_flags & AI_NUMERICHOST)) {
+
+    if (!uiplib_ipaddrconv(nodename, &addr))
+      return EAI_NONAME;
+  }
+  else if (netResolve(nodename, &addr, INFINITE) == -1)
+    return EAI_NONAME;
+
+  posTaskSchedLock();
+  ai = memb_alloc(&addrinfoPool);
+  posTaskSchedUnlock();
+
+  if (ai == NULL)
+    return EAI_MEMORY;
+
+  memset(ai, 0, sizeof(*ai));
+  if (hints != NULL) {
+
+    ai->ai.ai_socktype = hints->ai_socktype;
+    ai->ai.ai_protocol = hints->ai_protocol;
+  }
+
+  ai->ai.ai_addr = (struct sockaddr*)&ai->sa;
+#if NETSTACK_CONF_WITH_IPV6
+  ai->ai.ai_family = AF_INET6;
+  ai->ai.ai_addrlen = sizeof(struct sockaddr_in6);
+#else
+  ai->ai.ai_family = AF_INET;
+  ai->ai.ai_addrlen = sizeof(struct sockaddr_in);
+#endif
+
+  ai->ai.ai_addr->sa_len = ai->ai.ai_addrlen;
+  ai->ai.ai_addr->sa_family = ai->ai.ai_family;
+  uip_ipaddr_copy(SOCKADDR2UIP(ai->ai.ai_addr), &addr);
+  SOCKADDR2PORT(ai->ai.ai_addr) = uip_htons(port);
+
+  *res = &ai->ai;
+  return 0;
+}
+
+void net_freeaddrinfo(struct addrinfo *ai)
+{
+  struct addrinfo* next;
+
+  posTaskSchedLock();
+  while (ai != NULL) {
+
+    next = ai->ai_next;
+    memb_free(&addrinfoPool, ai);
+    ai = next;
+  }
+
+  posTaskSchedUnlock();
+}
+
+#endif
+
 #if !NETSTACK_CONF_WITH_IPV6
 int inet_aton(const char *cp, struct in_addr *pin)
 {
@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Packet capture ring. Ethernet layer passes every frame
+ * here, frames that pass the filter are copied (truncated to
+ * snap length) into a preallocated ring, overwriting oldest
+ * ones. Ring contents can be written out in pcap format.
+ */
+
+#include <picoos.h>
+#include <picoos-u.h>
+#include <picoos-net.h>
+#include <string.h>
+
+#if NETCFG_CAPTURE == 1
+
+#if NETCFG_CAPTURE_HOSTFILE == 1
+#include <stdio.h>
+#endif
+
+#ifndef NETCFG_CAPTURE_COUNT
+#define NETCFG_CAPTURE_COUNT 16
+#endif
+
+#ifndef NETCFG_CAPTURE_SNAPLEN
+#define NETCFG_CAPTURE_SNAPLEN 96
+#endif
+
+#define PCAP_MAGIC      0xa1b2c3d4
+#define PCAP_LINK_ETHER 1
+
+#define ETH_HDR_LEN     14
+#define ETH_TYPE_IP     0x0800
+#define ETH_TYPE_IPV6   0x86dd
+
+typedef struct {
+
+  JIF_t    time;
+  uint16_t origLen;
+  uint16_t capLen;
+  uint8_t  data[NETCFG_CAPTURE_SNAPLEN];
+} CaptureRec;
+
+struct pcapFileHdr {
+
+  uint32_t magic;
+  uint16_t versionMajor;
+  uint16_t versionMinor;
+  int32_t  thisZone;
+  uint32_t sigFigs;
+  uint32_t snapLen;
+  uint32_t linkType;
+};
+
+struct pcapRecHdr {
+
+  uint32_t tsSec;
+  uint32_t tsUsec;
+  uint32_t inclLen;
+  uint32_t origLen;
+};
+
+static CaptureRec ring[NETCFG_CAPTURE_COUNT];
+static uint16_t ringHead;
+static uint16_t ringCount;
+static volatile bool enabled;
+static NetCaptureFilter filter;
+
+static uint16_t get16(const uint8_t* p)
+{
+  return (p[0] << 8) | p[1];
+}
+
+static bool filterMatch(const uint8_t* frame, uint16_t len)
+{
+  uint16_t type;
+  uint8_t  proto;
+  const uint8_t* l4;
+
+  if (len < ETH_HDR_LEN)
+    return false;
+
+  type = get16(frame + 12);
+  if (filter.ethType != 0 && filter.ethType != type)
+    return false;
+
+  if (filter.proto == 0 && filter.port == 0)
+    return true;
+
+  if (type == ETH_TYPE_IP && len >= ETH_HDR_LEN + 20) {
+
+    proto = frame[ETH_HDR_LEN + 9];
+    l4 = frame + ETH_HDR_LEN + (frame[ETH_HDR_LEN] & 0x0f) * 4;
+  }
+  else if (type == ETH_TYPE_IPV6 && len >= ETH_HDR_LEN + 40) {
+
+    proto = frame[ETH_HDR_LEN + 6];
+    l4 = frame + ETH_HDR_LEN + 40;
+  }
+  else
+    return false;
+
+  if (filter.proto != 0 && filter.proto != proto)
+    return false;
+
+  if (filter.port == 0)
+    return true;
+
+  if ((proto != UIP_PROTO_TCP && proto != UIP_PROTO_UDP) || l4 + 4 > frame + len)
+    return false;
+
+  return get16(l4) == filter.port || get16(l4 + 2) == filter.port;
+}
+
+void netCapturePacket(void)
+{
+  CaptureRec* rec;
+  uint16_t cap;
+#if UIP_XMITV
+  uint16_t hdr;
+#endif
+
+  if (!enabled)
+    return;
+
+  cap = uip_len > NETCFG_CAPTURE_SNAPLEN ? NETCFG_CAPTURE_SNAPLEN : uip_len;
+
+  // Exporting task reads the ring when capture is
+  // disabled, keep record update atomic against it.
+  // Capture might have been stopped (or restarted with
+  // another filter) before lock was taken, check again.
+  posTaskSchedLock();
+
+  if (!enabled || !filterMatch(uip_buf, uip_len)) {
+
+    posTaskSchedUnlock();
+    return;
+  }
+
+  rec = &ring[ringHead];
+  rec->time = jiffies;
+  rec->origLen = uip_len;
+  rec->capLen = cap;
+#if UIP_XMITV
+  hdr = uip_len - uip_xmitv_len;
+  if (uip_xmitv_data != NULL && cap > hdr) {
+
+    // Payload is not in uip_buf.
+    memcpy(rec->data, uip_buf, hdr);
+    memcpy(rec->data + hdr, uip_xmitv_data, cap - hdr);
+  }
+  else
+#endif
+    memcpy(rec->data, uip_buf, cap);
+
+  ringHead = (ringHead + 1) % NETCFG_CAPTURE_COUNT;
+  if (ringCount < NETCFG_CAPTURE_COUNT)
+    ++ringCount;
+
+  posTaskSchedUnlock();
+}
+
+void netCaptureStart(const NetCaptureFilter* f)
+{
+  posTaskSchedLock();
+
+  if (f != NULL)
+    filter = *f;
+  else
+    memset(&filter, 0, sizeof(filter));
+
+  ringHead = 0;
+  ringCount = 0;
+  enabled = true;
+
+  posTaskSchedUnlock();
+}
+
+void netCaptureStop(void)
+{
+  enabled = false;
+}
+
+/*
+ * Write ring contents in pcap format using
+ * given output function. Capture is stopped
+ * while doing this.
+ */
+typedef int (*CaptureWrite)(void* arg, const void* data, int len);
+
+static int captureExport(CaptureWrite out, void* arg)
+{
+  struct pcapFileHdr fh;
+  struct {
+    struct pcapRecHdr hdr;
+    uint8_t data[NETCFG_CAPTURE_SNAPLEN];
+  } rec;
+  CaptureRec* r;
+  uint16_t i;
+  uint16_t idx;
+  uint16_t count;
+
+  posTaskSchedLock();
+  enabled = false;
+  count = ringCount;
+  idx = (ringHead + NETCFG_CAPTURE_COUNT - count) % NETCFG_CAPTURE_COUNT;
+  posTaskSchedUnlock();
+
+  fh.magic = PCAP_MAGIC;
+  fh.versionMajor = 2;
+  fh.versionMinor = 4;
+  fh.thisZone = 0;
+  fh.sigFigs = 0;
+  fh.snapLen = NETCFG_CAPTURE_SNAPLEN;
+  fh.linkType = PCAP_LINK_ETHER;
+
+  if (out(arg, &fh, sizeof(fh)) != sizeof(fh))
+    return -1;
+
+  for (i = 0; i < count; i++) {
+
+    r = &ring[idx];
+    rec.hdr.tsSec = r->time / HZ;
+    rec.hdr.tsUsec = (r->time % HZ) * (1000000 / HZ);
+    rec.hdr.inclLen = r->capLen;
+    rec.hdr.origLen = r->origLen;
+    memcpy(rec.data, r->data, r->capLen);
+
+    if (out(arg, &rec, sizeof(rec.hdr) + r->capLen) != (int)(sizeof(rec.hdr) + r->capLen))
+      return -1;
+
+    idx = (idx + 1) % NETCFG_CAPTURE_COUNT;
+  }
+
+  return 0;
+}
+
+static int fileWrite(void* arg, const void* data, int len)
+{
+  return uosFileWrite((UosFile*)arg, data, len);
+}
+
+int netCaptureExport(UosFile* file)
+{
+  return captureExport(fileWrite, file);
+}
+
+#if NETCFG_CAPTURE_HOSTFILE == 1
+
+static int stdioWrite(void* arg, const void* data, int len)
+{
+  return fwrite(data, 1, len, (FILE*)arg);
+}
+
+int netCaptureSave(const char* fileName)
+{
+  FILE* fp;
+  int   result;
+
+  fp = fopen(fileName, "wb");
+  if (fp == NULL)
+    return -1;
+
+  result = captureExport(stdioWrite, fp);
+  if (fclose(fp) != 0)
+    result = -1;
+
+  return result;
+}
+
+#endif
+
+#endif
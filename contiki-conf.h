@@ -64,6 +64,137 @@ typedef JIF_t clock_time_t;
 #endif
 #endif
 
+#ifndef NETCFG_DNS
+#define NETCFG_DNS 0
+#endif
+
+#ifndef NETCFG_DNS_CACHE_SIZE
+#define NETCFG_DNS_CACHE_SIZE 4
+#endif
+
+#ifndef NETCFG_DNS_NAME_MAX
+#define NETCFG_DNS_NAME_MAX 48
+#endif
+
+#ifndef NETCFG_DNS_RETRIES
+#define NETCFG_DNS_RETRIES 4
+#endif
+
+#ifndef NETCFG_DNS_RETRY_TIME
+#define NETCFG_DNS_RETRY_TIME MS(1000)
+#endif
+
+#ifndef NETCFG_DNS_MAX_TTL
+#define NETCFG_DNS_MAX_TTL 3600
+#endif
+
+#ifndef NETCFG_DNS_TASK_PRIO
+#define NETCFG_DNS_TASK_PRIO 1
+#endif
+
+#ifndef NETCFG_DNS_STACK_SIZE
+#define NETCFG_DNS_STACK_SIZE 1000
+#endif
+
+#ifndef NETCFG_ADDRINFO_COUNT
+#define NETCFG_ADDRINFO_COUNT 2
+#endif
+
+#ifndef NETCFG_STATS
+#define NETCFG_STATS 0
+#endif
+
+#ifndef NETCFG_CAPTURE
+#define NETCFG_CAPTURE 0
+#endif
+
+#ifndef NETCFG_LEGACY_INTERFACE
+#define NETCFG_LEGACY_INTERFACE 1
+#endif
+
+#ifndef NETCFG_CAPTURE_HOSTFILE
+#define NETCFG_CAPTURE_HOSTFILE 0
+#endif
+
+#ifndef NETCFG_TELNET_INBUF
+#define NETCFG_TELNET_INBUF 80
+#endif
+
+#ifndef NETCFG_TELNET_OUTBUF
+#define NETCFG_TELNET_OUTBUF 256
+#endif
+
+#ifndef NETCFG_LISTEN_BACKLOG
+#define NETCFG_LISTEN_BACKLOG 4
+#endif
+
+#ifndef NETCFG_UDP_RXQUEUE
+#define NETCFG_UDP_RXQUEUE 4
+#endif
+
+#ifndef NETCFG_UDP_RXSIZE
+#define NETCFG_UDP_RXSIZE 128
+#endif
+
+#ifndef NETCFG_MMSG_BATCH
+#define NETCFG_MMSG_BATCH 8
+#endif
+
+#ifndef NETCFG_TCP_KEEPALIVE
+#define NETCFG_TCP_KEEPALIVE 0
+#endif
+
+#ifndef NETCFG_TCP_KEEPIDLE
+#define NETCFG_TCP_KEEPIDLE 120
+#endif
+
+#ifndef NETCFG_TCP_KEEPINTVL
+#define NETCFG_TCP_KEEPINTVL 10
+#endif
+
+#ifndef NETCFG_TCP_KEEPCNT
+#define NETCFG_TCP_KEEPCNT 5
+#endif
+
+#ifndef NETCFG_TCP_IDLE_TIMEOUT
+#define NETCFG_TCP_IDLE_TIMEOUT 0
+#endif
+
+/*
+ * Main loop runs uip_periodic this many times
+ * per second. Keepalive times are counted in these.
+ */
+#define NET_PERIODIC_HZ 2
+
+#if NETCFG_TCP_KEEPALIVE == 1 || NETCFG_TCP_IDLE_TIMEOUT > 0
+#define UIP_CONF_TCP_KEEPALIVE 1
+#define UIP_CONF_TCP_IDLE_TIMEOUT (NETCFG_TCP_IDLE_TIMEOUT * NET_PERIODIC_HZ)
+#endif
+
+#ifndef NETCFG_XMITV
+#define NETCFG_XMITV 0
+#endif
+
+#if NETCFG_XMITV == 1
+#define UIP_CONF_XMITV 1
+#endif
+
+/*
+ * TCP MSS is limited by mtu of the interface
+ * that connection is routed to (see ethernet.c).
+ */
+struct uip_conn;
+#define UIP_CONF_TCP_CONN_MSS netInterfaceTcpMss
+uint16_t netInterfaceTcpMss(const struct uip_conn* conn);
+
+#ifndef NETCFG_HDLC_VJCOMP
+#define NETCFG_HDLC_VJCOMP 0
+#endif
+
+#ifndef NETCFG_HDLC_VJ_SLOTS
+#define NETCFG_HDLC_VJ_SLOTS 4
+#endif
+
 #ifndef UIP_CONF_BYTE_ORDER
 #define UIP_CONF_BYTE_ORDER       LITTLE_ENDIAN
 #endif
@@ -79,6 +210,8 @@ typedef enum {
   NET_SOCK_READING,
   NET_SOCK_READING_LINE,
   NET_SOCK_READ_OK,
+  NET_SOCK_BORROWING,
+  NET_SOCK_LENT,
   NET_SOCK_WRITING,
   NET_SOCK_WRITE_OK,
   NET_SOCK_CONNECT,
@@ -96,10 +229,42 @@ typedef enum {
 
 } NetSockState;
 
+typedef enum {
+
+  NET_SOCK_CMD_NONE,
+  NET_SOCK_CMD_CONNECT,
+  NET_SOCK_CMD_UDP_NEW,
+  NET_SOCK_CMD_LISTEN,
+  NET_SOCK_CMD_UNLISTEN,
+  NET_SOCK_CMD_KEEPALIVE
+
+} NetSockCmd;
+
 #define NET_SOCK_EOF	 0
 #define NET_SOCK_ABORT	 -1
 #define	NET_SOCK_TIMEOUT -2
 
+#if NETCFG_STATS == 1
+
+typedef struct {
+
+  uint32_t rxBytes;
+  uint32_t txBytes;
+  uint32_t rxSegs;
+  uint32_t txSegs;
+} NetSockStats;
+
+#endif
+
+/*
+ * Established connection waiting for accept.
+ */
+typedef struct {
+
+  UosFile* file;
+  struct uip_conn* conn;
+} NetSockPending;
+
 struct netSock {
 
   POSFLAG_t sockChange;
@@ -107,12 +272,35 @@ struct netSock {
   POSMUTEX_t mutex;
 
   NetSockState state;
+  bool udp;
+  bool pendingAccept;  // connection stopped until accepted
+
+  // command submitted to main thread
+  struct netSock* cmdNext;
+  UosFile* cmdFile;
+  const void* cmdAddr;
+  uint16_t cmdPort;
+  NetSockCmd cmd;
+  int cmdResult;
+
+#if NETCFG_STATS == 1
+  NetSockStats stats;
+#endif
+
+  // bound local port, kept out of union below so that
+  // socket options set before connect or listen don't
+  // overwrite it
+  int port;
 
   union {
     struct {
       // for sockets that are listening
-      int port;
-      struct uip_conn* newConnection;
+      uint8_t backlog;
+      uint8_t pendingHead;
+      uint8_t pendingCount;
+      uint8_t acceptWaiters;
+      POSSEMA_t acceptSema;
+      NetSockPending pending[NETCFG_LISTEN_BACKLOG];
     };
     struct {
       // for sockets that are connected
@@ -120,8 +308,31 @@ struct netSock {
       uint16_t len;
       uint16_t max;
       char* buf;
+      // amount consumed from lent data (tcp)
+      uint16_t lentUsed;
+      // sender of datagram read (udp)
+      void* fromAddr;
+      uint16_t* fromPort;
+      // datagrams being sent with destinations (udp)
+      const struct netSockDgram* txMsgs;
+      uint16_t txNext;
+      uint16_t txCount;
     };
   };
+
+#if UIP_CONF_UDP == 1
+  // datagrams waiting for reader
+  struct netUdpDgram* rxHead;
+  struct netUdpDgram* rxTail;
+#endif
+
+#if NETCFG_TCP_KEEPALIVE == 1
+  // keepalive settings in periodic ticks
+  uint16_t kaIdle;
+  uint16_t kaIntvl;
+  uint8_t kaCnt;
+  bool kaOn;
+#endif
 };
 
 typedef struct netSock NetSock;
@@ -135,14 +346,27 @@ typedef struct netSockState uip_tcp_appstate_t;
 typedef struct netSockState uip_udp_appstate_t;
 typedef int (*NetSockAcceptHook)(UosFile* sock, int port);
 
-#define UIP_APPCALL netTcpAppcall
 void netTcpAppcall(void);
 
+#if NETCFG_DRIVER_PCAP_REPLAY > 0 && defined(NETCFG_CYCLE_COUNTER)
+// Replay driver times application part separately.
+#define UIP_APPCALL pcapReplayTcpAppcall
+void pcapReplayTcpAppcall(void);
+#else
+#define UIP_APPCALL netTcpAppcall
+#endif
+
 #if UIP_CONF_UDP == 1
 
-#define UIP_UDP_APPCALL netUdpAppcall
 void netUdpAppcall(void);
 
+#if NETCFG_DRIVER_PCAP_REPLAY > 0 && defined(NETCFG_CYCLE_COUNTER)
+#define UIP_UDP_APPCALL pcapReplayUdpAppcall
+void pcapReplayUdpAppcall(void);
+#else
+#define UIP_UDP_APPCALL netUdpAppcall
+#endif
+
 #endif
 #endif
 
@@ -0,0 +1,685 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Stub DNS resolver for socket layer. Queries are sent by
+ * a resolver task to nameservers known by uip-nameserver module.
+ * Answers are cached until their TTL expires, and concurrent
+ * lookups for the same name share a single query.
+ */
+
+#include <picoos.h>
+#include <picoos-u.h>
+#include <picoos-net.h>
+#include <string.h>
+#include <net/ip/uiplib.h>
+#include <net/ip/uip-nameserver.h>
+#include <lib/random.h>
+
+#if NETCFG_DNS == 1
+
+#if UIP_CONF_UDP == 0
+#error UIP_CONF_UDP must be set to 1 for DNS resolver.
+#endif
+
+#define DNS_PORT        53
+#define DNS_MSG_MAX     512
+#define DNS_HDR_LEN     12
+
+#define DNS_FLAG_QR     0x8000
+#define DNS_FLAG_RD     0x0100
+#define DNS_RCODE_MASK  0x000f
+
+#define DNS_CLASS_IN    1
+#if NETSTACK_CONF_WITH_IPV6
+#define DNS_TYPE_ADDR   28 // AAAA
+#else
+#define DNS_TYPE_ADDR   1  // A
+#endif
+
+/*
+ * Poll interval of resolver task while queries are
+ * outstanding. New requests that arrive during this
+ * time are sent when read returns.
+ */
+#define DNS_POLL        MS(100)
+
+typedef enum {
+
+  DNS_FREE,
+  DNS_NEW,
+  DNS_PENDING,
+  DNS_OK
+} DnsState;
+
+typedef struct {
+
+  char name[NETCFG_DNS_NAME_MAX];
+  uip_ipaddr_t addr;
+  JIF_t timer;
+  uint16_t id;
+  uint8_t state;
+  uint8_t retries;
+  NetResolveReq* waiters;
+} DnsEntry;
+
+typedef struct {
+
+  NetResolveReq req;
+  POSSEMA_t done;
+  uip_ipaddr_t* addr;
+  int status;
+} DnsWait;
+
+static DnsEntry dnsCache[NETCFG_DNS_CACHE_SIZE];
+static POSMUTEX_t dnsMutex;
+static POSSEMA_t dnsWake;
+static uint8_t dnsServer;
+static UosFile* dnsSock;
+static uint8_t dnsBuf[DNS_MSG_MAX];
+
+static char lower(char c)
+{
+  return (c >= 'A' && c <= 'Z') ? c + 'a' - 'A' : c;
+}
+
+static bool nameEqual(const char* a, const char* b)
+{
+  char ca, cb;
+
+  do {
+
+    ca = lower(*a++);
+    cb = lower(*b++);
+    if (ca != cb)
+      return false;
+
+  } while (ca != '\0');
+
+  return true;
+}
+
+static DnsEntry* dnsLookup(const char* name)
+{
+  DnsEntry* e;
+
+  for (e = dnsCache; e < dnsCache + NETCFG_DNS_CACHE_SIZE; e++) {
+
+    if (e->state == DNS_FREE)
+      continue;
+
+    if (e->state == DNS_OK && POS_TIMEAFTER(jiffies, e->timer)) {
+
+      e->state = DNS_FREE;
+      continue;
+    }
+
+    if (nameEqual(e->name, name))
+      return e;
+  }
+
+  return NULL;
+}
+
+/*
+ * Find a slot for new query. Free slots are used first,
+ * after that the cached answer that expires first is replaced.
+ * Entries that have queries in flight are never replaced.
+ */
+static DnsEntry* dnsNew(const char* name)
+{
+  DnsEntry* e;
+  DnsEntry* victim = NULL;
+
+  for (e = dnsCache; e < dnsCache + NETCFG_DNS_CACHE_SIZE; e++) {
+
+    if (e->state == DNS_FREE) {
+
+      victim = e;
+      break;
+    }
+
+    if (e->state == DNS_OK &&
+        (victim == NULL || POS_TIMEAFTER(victim->timer, e->timer)))
+      victim = e;
+  }
+
+  if (victim == NULL)
+    return NULL;
+
+  strcpy(victim->name, name);
+  victim->state = DNS_NEW;
+  victim->retries = 0;
+  victim->waiters = NULL;
+  return victim;
+}
+
+/*
+ * Complete entry and call callbacks of all waiters.
+ * Called with dnsMutex locked, returns with it unlocked.
+ */
+static void dnsComplete(DnsEntry* e, uint32_t ttl)
+{
+  NetResolveReq* req;
+  NetResolveReq* next;
+  char name[NETCFG_DNS_NAME_MAX];
+  uip_ipaddr_t addr;
+  bool ok = (ttl > 0);
+
+  req = e->waiters;
+  e->waiters = NULL;
+  strcpy(name, e->name);
+  uip_ipaddr_copy(&addr, &e->addr);
+
+  if (ok) {
+
+    if (ttl > NETCFG_DNS_MAX_TTL)
+      ttl = NETCFG_DNS_MAX_TTL;
+
+    e->state = DNS_OK;
+    e->timer = jiffies + ttl * HZ;
+  }
+  else
+    e->state = DNS_FREE;
+
+  posMutexUnlock(dnsMutex);
+
+  while (req != NULL) {
+
+    next = req->next;
+    req->callback(req->arg, name, ok ? &addr : NULL);
+    req = next;
+  }
+}
+
+static uint8_t* dnsEncodeName(uint8_t* p, const char* name)
+{
+  uint8_t* label;
+  uint8_t  len;
+
+  while (*name != '\0') {
+
+    label = p++;
+    len = 0;
+    while (*name != '\0' && *name != '.') {
+
+      *p++ = *name++;
+      ++len;
+    }
+
+    if (len == 0 || len > 63)
+      return NULL;
+
+    *label = len;
+    if (*name == '.')
+      ++name;
+  }
+
+  *p++ = 0;
+  return p;
+}
+
+static bool dnsSend(DnsEntry* e)
+{
+  uint8_t* p = dnsBuf;
+
+  memset(p, 0, DNS_HDR_LEN);
+  p[0] = e->id >> 8;
+  p[1] = e->id & 0xff;
+  p[2] = DNS_FLAG_RD >> 8;
+  p[5] = 1;  // qdcount
+
+  p = dnsEncodeName(p + DNS_HDR_LEN, e->name);
+  if (p == NULL)
+    return false;
+
+  *p++ = 0;
+  *p++ = DNS_TYPE_ADDR;
+  *p++ = 0;
+  *p++ = DNS_CLASS_IN;
+
+  return uosFileWrite(dnsSock, dnsBuf, p - dnsBuf) > 0;
+}
+
+static const uint8_t* dnsSkipName(const uint8_t* p, const uint8_t* end)
+{
+  while (p < end) {
+
+    if (*p == 0)
+      return p + 1;
+
+    if ((*p & 0xc0) == 0xc0)
+      return p + 2;
+
+    p += *p + 1;
+  }
+
+  return NULL;
+}
+
+static uint16_t get16(const uint8_t* p)
+{
+  return (p[0] << 8) | p[1];
+}
+
+/*
+ * Check that question in answer is for the name we asked.
+ * Question name is never compressed, as it is the first name
+ * in message. Returns pointer past question or NULL.
+ */
+static const uint8_t* dnsCheckQuestion(const uint8_t* p, const uint8_t* end, const char* name)
+{
+  uint8_t len;
+
+  while (p < end && *p != 0) {
+
+    len = *p++;
+    if ((len & 0xc0) || p + len > end)
+      return NULL;
+
+    while (len-- > 0)
+      if (*name == '\0' || lower(*p++) != lower(*name++))
+        return NULL;
+
+    if (*name == '.')
+      ++name;
+    else if (*name != '\0')
+      return NULL;
+  }
+
+  if (p + 5 > end || *name != '\0')
+    return NULL;
+
+  ++p;
+  if (get16(p) != DNS_TYPE_ADDR || get16(p + 2) != DNS_CLASS_IN)
+    return NULL;
+
+  return p + 4;
+}
+
+/*
+ * Parse answer received into dnsBuf.
+ */
+static void dnsParse(int len)
+{
+  const uint8_t* p = dnsBuf;
+  const uint8_t* end = dnsBuf + len;
+  DnsEntry* e;
+  uint16_t id, flags, qdcount, ancount;
+  uint16_t type, class, rdlen;
+  uint32_t ttl;
+
+  if (len < DNS_HDR_LEN)
+    return;
+
+  id = get16(p);
+  flags = get16(p + 2);
+  qdcount = get16(p + 4);
+  ancount = get16(p + 6);
+
+  if (!(flags & DNS_FLAG_QR))
+    return;
+
+  posMutexLock(dnsMutex);
+
+  for (e = dnsCache; e < dnsCache + NETCFG_DNS_CACHE_SIZE; e++)
+    if (e->state == DNS_PENDING && e->id == id)
+      break;
+
+  if (e == dnsCache + NETCFG_DNS_CACHE_SIZE) {
+
+    posMutexUnlock(dnsMutex);
+    return;
+  }
+
+  // Answer to some other question with matching id
+  // is ignored, query is retransmitted later.
+  p = NULL;
+  if (qdcount == 1)
+    p = dnsCheckQuestion(dnsBuf + DNS_HDR_LEN, end, e->name);
+
+  if (p == NULL) {
+
+    posMutexUnlock(dnsMutex);
+    return;
+  }
+
+  if ((flags & DNS_RCODE_MASK) != 0) {
+
+    dnsComplete(e, 0);
+    return;
+  }
+
+  while (ancount-- > 0 && p != NULL) {
+
+    p = dnsSkipName(p, end);
+    if (p == NULL || p + 10 > end)
+      break;
+
+    type  = get16(p);
+    class = get16(p + 2);
+    ttl   = ((uint32_t)get16(p + 4) << 16) | get16(p + 6);
+    rdlen = get16(p + 8);
+    p += 10;
+
+    if (p + rdlen > end)
+      break;
+
+    // CNAME records are skipped, answer section contains
+    // the address of canonical name too.
+    if (type == DNS_TYPE_ADDR && class == DNS_CLASS_IN &&
+        rdlen == sizeof(uip_ipaddr_t)) {
+
+      memcpy(&e->addr, p, sizeof(uip_ipaddr_t));
+      dnsComplete(e, ttl > 0 ? ttl : 1);
+      return;
+    }
+
+    p += rdlen;
+  }
+
+  dnsComplete(e, 0);
+}
+
+/*
+ * Open socket to current nameserver.
+ */
+static bool dnsOpen(void)
+{
+  uip_ipaddr_t server;
+  uip_ipaddr_t* ns;
+  uint16_t count;
+
+  posTaskSchedLock();
+
+  count = uip_nameserver_count();
+  if (count > 0) {
+
+    if (dnsServer >= count)
+      dnsServer = 0;
+
+    ns = uip_nameserver_get(dnsServer);
+    if (ns != NULL)
+      uip_ipaddr_copy(&server, ns);
+    else
+      count = 0;
+  }
+
+  posTaskSchedUnlock();
+
+  if (count == 0)
+    return false;
+
+  dnsSock = netSockCreateUDP(&server, DNS_PORT);
+  return dnsSock != NULL;
+}
+
+static void dnsClose(void)
+{
+  if (dnsSock != NULL) {
+
+    uosFileClose(dnsSock);
+    dnsSock = NULL;
+  }
+}
+
+/*
+ * Send new queries and retransmit old ones.
+ * If some query has timed out, switch to next
+ * nameserver before retransmitting.
+ * Returns true if there are queries in flight.
+ */
+static bool dnsSendQueries(void)
+{
+  DnsEntry* e;
+  bool pending = false;
+  bool rotate = false;
+
+  posMutexLock(dnsMutex);
+
+  for (e = dnsCache; e < dnsCache + NETCFG_DNS_CACHE_SIZE; e++) {
+
+    if (e->state != DNS_PENDING || !POS_TIMEAFTER(jiffies, e->timer))
+      continue;
+
+    if (e->retries >= NETCFG_DNS_RETRIES) {
+
+      dnsComplete(e, 0);
+      posMutexLock(dnsMutex);
+      continue;
+    }
+
+    e->state = DNS_NEW;
+    rotate = true;
+  }
+
+  if (dnsSock == NULL) {
+
+    // Socket was closed because of an error,
+    // queries in flight must be sent again.
+    for (e = dnsCache; e < dnsCache + NETCFG_DNS_CACHE_SIZE; e++)
+      if (e->state == DNS_PENDING)
+        e->state = DNS_NEW;
+  }
+
+  if (rotate) {
+
+    dnsClose();
+    ++dnsServer;
+  }
+
+  for (e = dnsCache; e < dnsCache + NETCFG_DNS_CACHE_SIZE; e++) {
+
+    if (e->state == DNS_NEW) {
+
+      if (dnsSock == NULL && !dnsOpen()) {
+
+        dnsComplete(e, 0);
+        posMutexLock(dnsMutex);
+        continue;
+      }
+
+      // Each query gets a random id to make
+      // spoofing answers harder.
+      e->state = DNS_PENDING;
+      e->id = random_rand();
+      e->timer = jiffies + (NETCFG_DNS_RETRY_TIME << e->retries);
+      ++e->retries;
+      if (!dnsSend(e)) {
+
+        dnsComplete(e, 0);
+        posMutexLock(dnsMutex);
+        continue;
+      }
+    }
+
+    if (e->state == DNS_PENDING)
+      pending = true;
+  }
+
+  posMutexUnlock(dnsMutex);
+  return pending;
+}
+
+static void dnsTask(void* arg)
+{
+  int len;
+
+  while (1) {
+
+    posSemaWait(dnsWake, INFINITE);
+
+    while (dnsSendQueries()) {
+
+      len = netSockRead(dnsSock, dnsBuf, sizeof(dnsBuf), DNS_POLL);
+      if (len > 0)
+        dnsParse(len);
+      else if (len < 0 && len != NET_SOCK_TIMEOUT)
+        dnsClose();
+
+      // Zero-length datagram is just ignored.
+    }
+
+    dnsClose();
+  }
+}
+
+void netResolveInit()
+{
+  POSTASK_t t;
+
+  dnsMutex = posMutexCreate();
+  dnsWake  = posSemaCreate(0);
+  P_ASSERT("netResolveInit", dnsMutex != NULL && dnsWake != NULL);
+
+  POS_SETEVENTNAME(dnsMutex, "dns:mutex");
+  POS_SETEVENTNAME(dnsWake, "dns:wake");
+
+  t = posTaskCreate(dnsTask, NULL, NETCFG_DNS_TASK_PRIO, NETCFG_DNS_STACK_SIZE);
+  P_ASSERT("netResolveInit2", t != NULL);
+  POS_SETTASKNAME(t, "uip:dns");
+}
+
+int netResolveAsync(NetResolveReq* req, const char* name, NetResolveCallback cb, void* arg)
+{
+  DnsEntry* e;
+  uip_ipaddr_t addr;
+
+  req->callback = cb;
+  req->arg = arg;
+
+  if (uiplib_ipaddrconv(name, &addr)) {
+
+    cb(arg, name, &addr);
+    return 0;
+  }
+
+  if (strlen(name) >= NETCFG_DNS_NAME_MAX)
+    return -1;
+
+  posMutexLock(dnsMutex);
+
+  e = dnsLookup(name);
+  if (e != NULL && e->state == DNS_OK) {
+
+    uip_ipaddr_copy(&addr, &e->addr);
+    posMutexUnlock(dnsMutex);
+
+    cb(arg, name, &addr);
+    return 0;
+  }
+
+  if (e == NULL) {
+
+    e = dnsNew(name);
+    if (e == NULL) {
+
+      posMutexUnlock(dnsMutex);
+      return -1;
+    }
+
+    posSemaSignal(dnsWake);
+  }
+
+  req->next = e->waiters;
+  e->waiters = req;
+
+  posMutexUnlock(dnsMutex);
+  return 0;
+}
+
+/*
+ * Remove request from waiter list. Returns false
+ * if request was not found, which means that
+ * resolver task is just about to call the callback.
+ */
+static bool dnsCancel(NetResolveReq* req)
+{
+  DnsEntry* e;
+  NetResolveReq** r;
+
+  posMutexLock(dnsMutex);
+
+  for (e = dnsCache; e < dnsCache + NETCFG_DNS_CACHE_SIZE; e++) {
+
+    for (r = &e->waiters; *r != NULL; r = &(*r)->next) {
+
+      if (*r == req) {
+
+        *r = req->next;
+        posMutexUnlock(dnsMutex);
+        return true;
+      }
+    }
+  }
+
+  posMutexUnlock(dnsMutex);
+  return false;
+}
+
+static void dnsWaitDone(void* arg, const char* name, const uip_ipaddr_t* addr)
+{
+  DnsWait* w = (DnsWait*)arg;
+
+  if (addr != NULL) {
+
+    uip_ipaddr_copy(w->addr, addr);
+    w->status = 0;
+  }
+
+  posSemaSignal(w->done);
+}
+
+int netResolve(const char* name, uip_ipaddr_t* addr, UINT_t timeout)
+{
+  DnsWait w;
+
+  w.addr = addr;
+  w.status = -1;
+  w.done = posSemaCreate(0);
+  if (w.done == NULL)
+    return -1;
+
+  POS_SETEVENTNAME(w.done, "dns:wait");
+
+  if (netResolveAsync(&w.req, name, dnsWaitDone, &w) == -1) {
+
+    posSemaDestroy(w.done);
+    return -1;
+  }
+
+  if (posSemaWait(w.done, timeout) != 0 && !dnsCancel(&w.req))
+    posSemaWait(w.done, INFINITE);
+
+  posSemaDestroy(w.done);
+  return w.status;
+}
+
+#endif
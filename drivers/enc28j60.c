@@ -53,6 +53,11 @@ static uint8_t ENC28J60_CurrentBank[ENC28J60_NUM_INTERFACES];
 /** The Next Packet Pointer for each ENC28J60 interface */
 static int16_t ENC28J60_NextPacketPointer[ENC28J60_NUM_INTERFACES];
 
+#if ENC28J60_BATCHED_IO
+/** Set when transmission has been started but not seen completed. */
+static uint8_t ENC28J60_TxPending[ENC28J60_NUM_INTERFACES];
+#endif
+
 /** Upper two bytes of the receive status vector, set after a frame
  * is successfully received. */
 uint16_t ENC28J60_RecvStatus[ENC28J60_NUM_INTERFACES];
@@ -153,7 +158,7 @@ void enc28j60_Buffer_Read(uint8_t *buffer, uint16_t len) {
  * @param buffer the unsigned 8-bit array of data to write to the ENC28J60
  * @param len the number of bytes to write.
  */
-void enc28j60_Buffer_Write(uint8_t *buffer, uint16_t len) {
+void enc28j60_Buffer_Write(const uint8_t *buffer, uint16_t len) {
 	enc28j60_spi_select();
 
 	/* See 4.2.4 and figure 4-6 of the ENC28J60 datasheet */
@@ -394,6 +399,10 @@ void enc28j60_Init(void) {
 	
 	/* On reset, ECON1 is initialized to 0x00, so the current bank is 0. */
 	ENC28J60_CurrentBank[ENC28J60_Index] = 0x00;
+#if ENC28J60_BATCHED_IO
+	/* Reset aborts any transmission. */
+	ENC28J60_TxPending[ENC28J60_Index] = 0;
+#endif
 
 	/* --- 6.1 Initialize the Receive Buffer --- */
 
@@ -535,6 +544,22 @@ void enc28j60_Init(void) {
 	enc28j60_Bitfield_Set(ECON1, ECON1_RXEN);
 }
 
+#if ENC28J60_BATCHED_IO
+/**
+ * Waits until previously started transmission is complete,
+ * so that transmit buffer can be reused.
+ */
+static void enc28j60_Tx_Wait(void) {
+	if (!ENC28J60_TxPending[ENC28J60_Index])
+		return;
+
+	while (enc28j60_Register_Read(ECON1) & ECON1_TXRTS)
+		;
+
+	ENC28J60_TxPending[ENC28J60_Index] = 0;
+}
+#endif
+
 /**
  * Sends a frame.
  * CRC is calculated by the ENC28J60, so it need not be included in the frame
@@ -545,12 +570,35 @@ void enc28j60_Init(void) {
  *  the maximum frame length supported.
  */
 int enc28j60_Frame_Send(uint8_t *frame, uint32_t len) {
+	return enc28j60_Frame_Sendv(frame, len, NULL, 0);
+}
+
+/**
+ * Sends a frame that is in two parts, header and payload. Both are
+ * written to transmit buffer directly, so they need not to be
+ * copied together first.
+ * @param hdr unsigned 8-bit array of the frame header.
+ * @param hdrLen length of the header.
+ * @param data unsigned 8-bit array of the frame payload.
+ * @param dataLen length of the payload.
+ * @return number of bytes sent, 0 if the frame was larger than
+ *  the maximum frame length supported.
+ */
+int enc28j60_Frame_Sendv(const uint8_t *hdr, uint32_t hdrLen,
+			 const uint8_t *data, uint32_t dataLen) {
+	uint32_t len = hdrLen + dataLen;
+
 	/* See sections 3.2.2 and 7.1 of the ENC28J60 datasheet */
 
 	/* Exit if the frame is too big for us */
 	if (len > MAX_FRAME_LEN)
 		return 0; 
 
+#if ENC28J60_BATCHED_IO
+	/* Previous frame may still be going out from the buffer. */
+	enc28j60_Tx_Wait();
+#endif
+
 	/* Set the Buffer Write Pointer to the beginning of the transmit 
  	 * buffer */
 	enc28j60_Register_Write(EWRPTL, (uint8_t)(TX_BUFFER_START));
@@ -564,16 +612,24 @@ int enc28j60_Frame_Send(uint8_t *frame, uint32_t len) {
  	 * of the ENC28J60 datasheet */
 	enc28j60_Command_Write(ENC28J60_WRITE_BUF_MEM, 0, PER_PACKET_CONTROL);
 
-	/* Next write all bytes of the frame */
-	enc28j60_Buffer_Write(frame, len);
+	/* Next write all bytes of the frame. Buffer write pointer
+	 * auto-increments, so payload continues where header ended. */
+	enc28j60_Buffer_Write(hdr, hdrLen);
+	if (dataLen > 0)
+		enc28j60_Buffer_Write(data, dataLen);
 
 	/* Start the transmission by setting the TXRTS bit of ECON1 */
 	enc28j60_Bitfield_Set(ECON1, ECON1_TXRTS);
 
+#if ENC28J60_BATCHED_IO
+	/* Don't wait for completion, next send checks it. */
+	ENC28J60_TxPending[ENC28J60_Index] = 1;
+#else
 	/* Wait until the TXRTS bit of ECON1 clears, meaning transmission is
  	 * complete */
 	while (enc28j60_Register_Read(ECON1) & ECON1_TXRTS)
 		;
+#endif
 
 	return len;
 }
@@ -587,6 +643,9 @@ int enc28j60_Frame_Send(uint8_t *frame, uint32_t len) {
 unsigned int enc28j60_Frame_Recv(unsigned char *frame, unsigned int len) {
 	unsigned int frameLen;
 	int rxError = 0;
+#if ENC28J60_BATCHED_IO
+	uint8_t header[6];
+#endif
 
 	/* See section 3.2.1 and 7.2.3 of the ENC28J60 datasheet */
 	
@@ -622,6 +681,14 @@ unsigned int enc28j60_Frame_Recv(unsigned char *frame, unsigned int len) {
 	/* Set the Buffer Read Pointer to the location of the next packet */
 	enc28j60_Register_Write(ERDPTL, (uint8_t)(ENC28J60_NextPacketPointer[ENC28J60_Index]));
 	enc28j60_Register_Write(ERDPTH, (uint8_t)(ENC28J60_NextPacketPointer[ENC28J60_Index]>>8));
+#if ENC28J60_BATCHED_IO
+	/* Read Next Packet Pointer and Receive Status Vector
+	 * in one transaction. */
+	enc28j60_Buffer_Read(header, sizeof(header));
+	ENC28J60_NextPacketPointer[ENC28J60_Index] = header[0] | (header[1]<<8);
+	frameLen = header[2] | (header[3]<<8);
+	ENC28J60_RecvStatus[ENC28J60_Index] = header[4] | (header[5]<<8);
+#else
 	/* The first two bytes of the packet buffer are the Next Packet Pointer,
  	 * read them into our Next Packet Pointer variable */
 	ENC28J60_NextPacketPointer[ENC28J60_Index] = enc28j60_Buffer_ReadByte();
@@ -634,6 +701,7 @@ unsigned int enc28j60_Frame_Recv(unsigned char *frame, unsigned int len) {
 	 * statistics. */
 	ENC28J60_RecvStatus[ENC28J60_Index] = enc28j60_Buffer_ReadByte();
 	ENC28J60_RecvStatus[ENC28J60_Index] |= enc28j60_Buffer_ReadByte()<<8;
+#endif
 
 	/* Subtract 4 from the frame length so we can ignore the last 4 CRC 
  	 * bytes of the frame */
@@ -669,7 +737,7 @@ unsigned int enc28j60_Frame_Recv(unsigned char *frame, unsigned int len) {
 	/* Update the Receive Buffer Read Pointer to the Next Packet Pointer so
  	 * we can free the memory we read this frame from */
 	enc28j60_Register_Write(ERXRDPTL, (uint8_t)(ENC28J60_NextPacketPointer[ENC28J60_Index]));
-	enc28j60_Register_Write(ERXRDPTL, (uint8_t)(ENC28J60_NextPacketPointer[ENC28J60_Index]>>8));
+	enc28j60_Register_Write(ERXRDPTH, (uint8_t)(ENC28J60_NextPacketPointer[ENC28J60_Index]>>8));
 
 	/* Decrement the EPKTCNT to indicate that the packet has been received 
  	 * and to clear the PKTIF flag */
@@ -69,6 +69,14 @@
  */
 #define PER_PACKET_CONTROL	0x00
 
+/** Read the receive header (next packet pointer and status vector)
+ * with one buffer memory read and return from frame send without
+ * waiting for transmission to complete, so that it overlaps with
+ * receiving the next frame. Set to 0 to wait for every transmission. */
+#ifndef ENC28J60_BATCHED_IO
+#define ENC28J60_BATCHED_IO 1
+#endif
+
 /** Compiles the interrupts initialization code. */
 //#define ENC28J60_USE_INTERRUPTS
 
@@ -185,7 +193,7 @@ void enc28j60_Buffer_Read(uint8_t *buffer, uint16_t len);
  * @param buffer the unsigned 8-bit array of data to write to the ENC28J60
  * @param len the number of bytes to write.
  */
-void enc28j60_Buffer_Write(uint8_t *buffer, uint16_t len);
+void enc28j60_Buffer_Write(const uint8_t *buffer, uint16_t len);
 
 /**
  * Reads and returns a single byte from the ENC28J60 buffer memory.
@@ -300,6 +308,17 @@ void enc28j60_Init(void);
  */
 int enc28j60_Frame_Send(uint8_t *frame, uint32_t len);
 
+/**
+ * Sends a frame given as header and payload parts.
+ * @param hdr unsigned 8-bit array of the frame header.
+ * @param hdrLen length of the header.
+ * @param data unsigned 8-bit array of the frame payload.
+ * @param dataLen length of the payload.
+ * @return number of bytes sent, 0 if the frame was too large.
+ */
+int enc28j60_Frame_Sendv(const uint8_t *hdr, uint32_t hdrLen,
+			 const uint8_t *data, uint32_t dataLen);
+
 /**
  * Receives a frame.
  * @param frame unsigned 8-bit data buffer to copy the received frame into.
@@ -0,0 +1,481 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Behavioral ENC28J60 model for host builds. Implements
+ * enc28j60_spi_* hooks that enc28j60.c uses, so driver can be
+ * run without hardware. Model has control registers, 8 KiB
+ * buffer memory with auto-incrementing pointers, circular
+ * receive buffer, PHY registers and transmit logic.
+ *
+ * Transmission takes as long as sending the frame
+ * (with preamble, CRC and interframe gap) on 10 Mbit/s wire
+ * takes. That is counted in SPI bytes, as SPI clock in
+ * enc28j60.h is 10 MHz, so driver polling for completion
+ * sees realistic number of transactions.
+ */
+
+#include <picoos.h>
+#include <picoos-net.h>
+#include <string.h>
+
+#if NETCFG_DRIVER_ENC28J60 > 0 && NETCFG_ENC28J60_SIM == 1
+
+#include "enc28j60.h"
+#include "enc28j60_sim.h"
+
+#define MEM_SIZE     0x2000
+#define MEM_MASK     (MEM_SIZE - 1)
+
+// Wire overhead: preamble + SFD, CRC, interframe gap.
+#define TX_OVERHEAD  (8 + 4 + 12)
+
+// Common registers at end of each bank.
+#define COMMON_START 0x1B
+
+typedef enum {
+
+  SPI_IDLE,
+  SPI_OPCODE,
+  SPI_READ_REG,
+  SPI_READ_BUF,
+  SPI_WRITE_REG,
+  SPI_WRITE_BUF,
+  SPI_BIT_SET,
+  SPI_BIT_CLR,
+  SPI_DONE
+} SpiState;
+
+typedef struct {
+
+  uint8_t  regs[4][32];
+  uint16_t phy[32];
+  uint8_t  mem[MEM_SIZE];
+  SpiState state;
+  uint8_t  reg;
+  uint8_t  dummy;
+  uint16_t rxWrPtr;
+  int      txBusy;        // SPI bytes until transmission completes
+  Enc28j60SimStats stats;
+} SimChip;
+
+static SimChip chips[ENC28J60_NUM_INTERFACES];
+static Enc28j60SimOutput output;
+
+static uint8_t* reg(SimChip* c, uint8_t addr)
+{
+  if (addr >= COMMON_START)
+    return &c->regs[0][addr];
+
+  return &c->regs[c->regs[0][ECON1] & (ECON1_BSEL1 | ECON1_BSEL0)][addr];
+}
+
+static uint16_t get16(SimChip* c, uint8_t lowAddr)
+{
+  uint8_t bank = (lowAddr & BANK_MASK) >> 5;
+  uint8_t addr = lowAddr & ADDR_MASK;
+
+  return c->regs[bank][addr] | (c->regs[bank][addr + 1] << 8);
+}
+
+static void set16(SimChip* c, uint8_t lowAddr, uint16_t value)
+{
+  uint8_t bank = (lowAddr & BANK_MASK) >> 5;
+  uint8_t addr = lowAddr & ADDR_MASK;
+
+  c->regs[bank][addr] = value;
+  c->regs[bank][addr + 1] = value >> 8;
+}
+
+/*
+ * MAC and MII registers shift out a dummy byte first.
+ */
+static bool isMacMii(SimChip* c, uint8_t addr)
+{
+  uint8_t bank = c->regs[0][ECON1] & (ECON1_BSEL1 | ECON1_BSEL0);
+
+  if (addr >= COMMON_START)
+    return false;
+
+  if (bank == 2)
+    return true;
+
+  return bank == 3 && (addr <= (MAADR4 & ADDR_MASK) || addr == (MISTAT & ADDR_MASK));
+}
+
+static void chipReset(SimChip* c)
+{
+  memset(c->regs, '\0', sizeof(c->regs));
+  memset(c->phy, '\0', sizeof(c->phy));
+
+  set16(c, ERDPTL, 0x05FA);
+  set16(c, ERXRDPTL, 0x05FA);
+  set16(c, ERXNDL, 0x1FFF);
+  set16(c, ETXSTL, 0);
+  c->regs[0][ECON2] = ECON2_AUTOINC;
+  c->regs[0][ESTAT] = ESTAT_CLKRDY;
+  c->phy[PHSTAT1] = PHSTAT1_PFDPX | PHSTAT1_PHDPX | PHSTAT1_LLSTAT;
+  c->rxWrPtr = 0;
+  c->txBusy = 0;
+}
+
+static void txComplete(SimChip* c)
+{
+  c->regs[0][ECON1] &= ~ECON1_TXRTS;
+  c->regs[0][EIR] |= EIR_TXIF;
+}
+
+/*
+ * Start transmission. Frame is between ETXST and ETXND
+ * (inclusive), first byte is per-packet control byte.
+ */
+static void txStart(SimChip* c)
+{
+  uint16_t st = get16(c, ETXSTL);
+  uint16_t nd = get16(c, ETXNDL);
+  uint8_t frame[MAX_FRAME_LEN];
+  int len = 0;
+  uint16_t p;
+
+  for (p = (st + 1) & MEM_MASK; p != ((nd + 1) & MEM_MASK) && len < MAX_FRAME_LEN; p = (p + 1) & MEM_MASK)
+    frame[len++] = c->mem[p];
+
+  c->txBusy = len + TX_OVERHEAD;
+  ++c->stats.txFrames;
+
+  if (output != NULL)
+    output(frame, len);
+}
+
+static void regWritten(SimChip* c, uint8_t addr, uint8_t old)
+{
+  uint8_t* r = reg(c, addr);
+  uint8_t bank = c->regs[0][ECON1] & (ECON1_BSEL1 | ECON1_BSEL0);
+
+  if (addr == ECON1) {
+
+    if (*r & ECON1_TXRST)
+      c->txBusy = 0;
+
+    if ((*r & ECON1_TXRTS) && !(old & ECON1_TXRTS))
+      txStart(c);
+    else if (!(*r & ECON1_TXRTS))
+      c->txBusy = 0;
+
+    if ((*r & ECON1_RXEN) && !(old & ECON1_RXEN))
+      c->rxWrPtr = get16(c, ERXSTL);
+
+    return;
+  }
+
+  if (addr == ECON2) {
+
+    if ((*r & ECON2_PKTDEC) && c->regs[1][EPKTCNT & ADDR_MASK] > 0)
+      --c->regs[1][EPKTCNT & ADDR_MASK];
+
+    *r &= ~ECON2_PKTDEC;
+    if (c->regs[1][EPKTCNT & ADDR_MASK] == 0)
+      c->regs[0][EIR] &= ~EIR_PKTIF;
+
+    return;
+  }
+
+  if (bank == 2) {
+
+    if (addr == (MICMD & ADDR_MASK) && (*r & MICMD_MIIRD)) {
+
+      uint16_t v = c->phy[c->regs[2][MIREGADR & ADDR_MASK] & 0x1F];
+
+      c->regs[2][MIRDL & ADDR_MASK] = v;
+      c->regs[2][MIRDH & ADDR_MASK] = v >> 8;
+    }
+    else if (addr == (MIWRH & ADDR_MASK))
+      c->phy[c->regs[2][MIREGADR & ADDR_MASK] & 0x1F] = get16(c, MIWRL);
+  }
+}
+
+static uint8_t regRead(SimChip* c, uint8_t addr)
+{
+  if (addr == ERXWRPTL && (c->regs[0][ECON1] & (ECON1_BSEL1 | ECON1_BSEL0)) == 0)
+    return c->rxWrPtr;
+
+  if (addr == ERXWRPTH && (c->regs[0][ECON1] & (ECON1_BSEL1 | ECON1_BSEL0)) == 0)
+    return c->rxWrPtr >> 8;
+
+  return *reg(c, addr);
+}
+
+static uint8_t bufRead(SimChip* c)
+{
+  uint16_t ptr = get16(c, ERDPTL);
+  uint8_t data = c->mem[ptr];
+
+  if (c->regs[0][ECON2] & ECON2_AUTOINC) {
+
+    // Read pointer wraps inside receive buffer.
+    if (ptr == get16(c, ERXNDL))
+      ptr = get16(c, ERXSTL);
+    else
+      ptr = (ptr + 1) & MEM_MASK;
+
+    set16(c, ERDPTL, ptr);
+  }
+
+  return data;
+}
+
+static void bufWrite(SimChip* c, uint8_t data)
+{
+  uint16_t ptr = get16(c, EWRPTL);
+
+  c->mem[ptr] = data;
+  if (c->regs[0][ECON2] & ECON2_AUTOINC)
+    set16(c, EWRPTL, (ptr + 1) & MEM_MASK);
+}
+
+/*
+ * Count one SPI byte. Transmission progresses
+ * at the same rate.
+ */
+static void spiClock(SimChip* c)
+{
+  ++c->stats.bytes;
+  if (c->txBusy > 0 && --c->txBusy == 0)
+    txComplete(c);
+}
+
+void enc28j60_InterruptPin_Enable(void)
+{
+}
+
+void enc28j60_InterruptPin_Disable(void)
+{
+}
+
+void enc28j60_spi_init(void)
+{
+  int i;
+
+  for (i = 0; i < ENC28J60_NUM_INTERFACES; i++) {
+
+    chipReset(&chips[i]);
+    chips[i].state = SPI_IDLE;
+    memset(&chips[i].stats, '\0', sizeof(chips[i].stats));
+  }
+}
+
+void enc28j60_spi_select(void)
+{
+  SimChip* c = &chips[ENC28J60_Index];
+
+  c->state = SPI_OPCODE;
+  ++c->stats.transactions;
+}
+
+void enc28j60_spi_deselect(void)
+{
+  chips[ENC28J60_Index].state = SPI_IDLE;
+}
+
+void enc28j60_spi_write(uint8_t data)
+{
+  SimChip* c = &chips[ENC28J60_Index];
+  uint8_t* r;
+  uint8_t old;
+
+  spiClock(c);
+  switch (c->state) {
+  case SPI_OPCODE:
+    if (data == ENC28J60_SOFT_RESET) {
+
+      chipReset(c);
+      c->state = SPI_DONE;
+      break;
+    }
+
+    c->reg = data & ADDR_MASK;
+    switch (data & ~ADDR_MASK) {
+    case ENC28J60_READ_CTRL_REG:
+      c->state = SPI_READ_REG;
+      c->dummy = isMacMii(c, c->reg);
+      break;
+
+    case ENC28J60_WRITE_CTRL_REG:
+      c->state = SPI_WRITE_REG;
+      break;
+
+    case ENC28J60_BIT_FIELD_SET:
+      c->state = SPI_BIT_SET;
+      break;
+
+    case ENC28J60_BIT_FIELD_CLR:
+      c->state = SPI_BIT_CLR;
+      break;
+
+    default:
+      if (data == ENC28J60_READ_BUF_MEM)
+        c->state = SPI_READ_BUF;
+      else if (data == ENC28J60_WRITE_BUF_MEM)
+        c->state = SPI_WRITE_BUF;
+      else
+        c->state = SPI_DONE;
+    }
+    break;
+
+  case SPI_WRITE_REG:
+  case SPI_BIT_SET:
+  case SPI_BIT_CLR:
+    r = reg(c, c->reg);
+    old = *r;
+    if (c->state == SPI_WRITE_REG)
+      *r = data;
+    else if (c->state == SPI_BIT_SET)
+      *r |= data;
+    else
+      *r &= ~data;
+
+    regWritten(c, c->reg, old);
+    c->state = SPI_DONE;
+    break;
+
+  case SPI_WRITE_BUF:
+    bufWrite(c, data);
+    break;
+
+  default:
+    break;
+  }
+}
+
+uint8_t enc28j60_spi_read(void)
+{
+  SimChip* c = &chips[ENC28J60_Index];
+
+  spiClock(c);
+  switch (c->state) {
+  case SPI_READ_REG:
+    if (c->dummy) {
+
+      c->dummy = 0;
+      return 0;
+    }
+
+    return regRead(c, c->reg);
+
+  case SPI_READ_BUF:
+    return bufRead(c);
+
+  default:
+    return 0xFF;
+  }
+}
+
+static void rxPut(SimChip* c, uint8_t data)
+{
+  c->mem[c->rxWrPtr] = data;
+  if (c->rxWrPtr == get16(c, ERXNDL))
+    c->rxWrPtr = get16(c, ERXSTL);
+  else
+    c->rxWrPtr = (c->rxWrPtr + 1) & MEM_MASK;
+}
+
+int enc28j60SimInput(uint8_t index, const uint8_t* frame, int len)
+{
+  SimChip* c = &chips[index];
+  uint16_t st = get16(c, ERXSTL);
+  uint16_t nd = get16(c, ERXNDL);
+  uint16_t rd = get16(c, ERXRDPTL);
+  int size = nd - st + 1;
+  int used;
+  int need;
+  int crcLen;
+  uint16_t next;
+  int i;
+
+  if (!(c->regs[0][ECON1] & ECON1_RXEN) || len > MAX_FRAME_LEN - 4)
+    return 0;
+
+  // Header, frame, CRC and padding to even address.
+  crcLen = len + 4;
+  need = 6 + crcLen + (crcLen & 1);
+
+  used = c->rxWrPtr - rd;
+  if (used < 0)
+    used += size;
+
+  if (used + need >= size || c->regs[1][EPKTCNT & ADDR_MASK] == 0xFF) {
+
+    c->regs[0][EIR] |= EIR_RXERIF;
+    ++c->stats.rxOverflows;
+    return 0;
+  }
+
+  next = c->rxWrPtr + need;
+  if (next > nd)
+    next -= size;
+
+  rxPut(c, next);
+  rxPut(c, next >> 8);
+  rxPut(c, crcLen);
+  rxPut(c, crcLen >> 8);
+  rxPut(c, 0x80);                // Received ok
+  rxPut(c, 0x00);
+
+  for (i = 0; i < len; i++)
+    rxPut(c, frame[i]);
+
+  // CRC is not checked by driver.
+  for (i = 0; i < 4; i++)
+    rxPut(c, 0);
+
+  c->rxWrPtr = next;
+
+  ++c->regs[1][EPKTCNT & ADDR_MASK];
+  c->regs[0][EIR] |= EIR_PKTIF;
+  ++c->stats.rxFrames;
+  return len;
+}
+
+void enc28j60SimSetOutput(Enc28j60SimOutput out)
+{
+  output = out;
+}
+
+void enc28j60SimGetStats(uint8_t index, Enc28j60SimStats* st)
+{
+  *st = chips[index].stats;
+}
+
+void enc28j60SimResetStats(uint8_t index)
+{
+  memset(&chips[index].stats, '\0', sizeof(chips[index].stats));
+}
+
+#endif
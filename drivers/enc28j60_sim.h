@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+typedef struct {
+
+  uint32_t transactions;   // SPI transactions (chip selects)
+  uint32_t bytes;          // SPI bytes clocked
+  uint32_t txFrames;
+  uint32_t rxFrames;
+  uint32_t rxOverflows;    // frames dropped, receive buffer full
+} Enc28j60SimStats;
+
+typedef void (*Enc28j60SimOutput)(const uint8_t* frame, int len);
+
+/**
+ * Place a frame into receive buffer of simulated chip, as if
+ * it was received from wire. Returns frame length or 0 if
+ * frame was dropped.
+ */
+int enc28j60SimInput(uint8_t index, const uint8_t* frame, int len);
+
+/**
+ * Set function that gets frames transmitted by simulated chip.
+ */
+void enc28j60SimSetOutput(Enc28j60SimOutput out);
+
+void enc28j60SimGetStats(uint8_t index, Enc28j60SimStats* st);
+void enc28j60SimResetStats(uint8_t index);
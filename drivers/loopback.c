@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Loopback driver. Frames sent to interface are queued
+ * and fed back to stack from main loop, so a program
+ * can talk to itself without any network hardware.
+ * Useful for tests and benchmarks on host builds.
+ *
+ * Interface should have an IPv4 address of its own (for
+ * example 127.0.0.1/8), stack resolves it with ARP
+ * like any other neighbor. IPv6 neighbor discovery
+ * doesn't resolve own addresses, so driver is usable
+ * with IPv4 stack only.
+ */
+
+#include <picoos.h>
+#include <picoos-net.h>
+
+#if NETCFG_DRIVER_LOOPBACK > 0
+
+#include <string.h>
+
+#include "loopback.h"
+
+#ifndef NETCFG_LOOPBACK_QUEUE
+#define NETCFG_LOOPBACK_QUEUE 4
+#endif
+
+typedef struct {
+
+  uint16_t len;
+  uint8_t  data[UIP_BUFSIZE];
+} LoopbackFrame;
+
+static LoopbackFrame queue[NETCFG_LOOPBACK_QUEUE];
+static uint8_t head;
+static uint8_t count;
+
+void loopbackInit()
+{
+  head = 0;
+  count = 0;
+}
+
+/*
+ * Called by main thread only, like loopbackSend,
+ * so queue needs no locking.
+ */
+int loopbackPoll()
+{
+  LoopbackFrame* f;
+
+  if (count == 0)
+    return 0;
+
+  f = &queue[head];
+  memcpy(uip_buf, f->data, f->len);
+
+  head = (head + 1) % NETCFG_LOOPBACK_QUEUE;
+  --count;
+
+  return f->len;
+}
+
+/*
+ * Queue frame in uip_buf. If queue is full frame is
+ * dropped, like a real interface would do.
+ */
+void loopbackSend()
+{
+  LoopbackFrame* f;
+
+  if (count == NETCFG_LOOPBACK_QUEUE)
+    return;
+
+  f = &queue[(head + count) % NETCFG_LOOPBACK_QUEUE];
+  f->len = uip_len;
+  memcpy(f->data, uip_buf, uip_len);
+  ++count;
+
+  // Get main loop to poll interfaces again.
+  netInterrupt();
+}
+
+#endif
@@ -0,0 +1,548 @@
+/*
+ * Copyright (c) 2012-2013, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Replay driver for benchmarking. Feeds frames from pcap image
+ * to ethernet layer as fast as main loop can process them
+ * and discards transmitted frames, counting both.
+ * Frames in image should be addressed to the MAC and IP
+ * address configured for stack, otherwise they are just dropped.
+ * Frames sent by stack in capture (source MAC is stack MAC)
+ * are skipped.
+ *
+ * To replay a captured TCP connection, driver tracks the
+ * latest connection opened by peer. Acknowledgement numbers
+ * of peer segments are shifted from initial sequence number
+ * stack used in capture to the one it uses now, and a peer
+ * segment is held back until stack has sent everything
+ * it acknowledges. This keeps replay in step with data sent
+ * by stack application.
+ *
+ * If port provides a free-running cycle counter via
+ * NETCFG_CYCLE_COUNTER() macro, processing cycles for each
+ * frame class are recorded. Time spent in application
+ * callback (socket layer, including waking up the task
+ * that reads the socket) is recorded separately, so
+ * stack figure covers only tcpip_input/uip_process
+ * and ethernet layer.
+ */
+
+#include <picoos.h>
+#include <picoos-net.h>
+
+#if NETCFG_DRIVER_PCAP_REPLAY > 0
+
+#include <string.h>
+#if NETCFG_PCAP_REPLAY_HOSTFILE == 1
+#include <stdio.h>
+#include <stdlib.h>
+#endif
+
+#include "pcap_replay.h"
+
+#ifdef NETCFG_CYCLE_COUNTER
+#define CYCLES() NETCFG_CYCLE_COUNTER()
+#else
+#define CYCLES() 0
+#endif
+
+#define PCAP_MAGIC         0xa1b2c3d4
+#define PCAP_MAGIC_SWAPPED 0xd4c3b2a1
+#define PCAP_FILE_HDR_LEN  24
+#define PCAP_REC_HDR_LEN   16
+
+#define ETH_HDR_LEN        14
+
+#define TCP_FIN            0x01
+#define TCP_SYN            0x02
+#define TCP_ACK            0x10
+
+static const uint8_t* image;
+static uint32_t imageLen;
+static uint32_t pos;
+static uint32_t loopsLeft;
+static bool     swapped;
+static JIF_t    startTime;
+static PcapReplayResult result;
+static uint32_t appCycles;    // in application callback during current frame
+
+/*
+ * State of replayed TCP connection.
+ */
+static bool     captureIssKnown;
+static bool     liveIssKnown;
+static uint32_t captureIss;   // stack sequence number in capture
+static uint32_t liveIss;      // stack sequence number now
+static uint32_t sndMax;       // highest sequence number sent by stack
+
+static uint32_t get32(const uint8_t* p)
+{
+  uint32_t v;
+
+  memcpy(&v, p, sizeof(v));
+  if (swapped)
+    v = (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+
+  return v;
+}
+
+static int classify(void)
+{
+  const uint8_t* p = uip_buf;
+  uint16_t type;
+  uint8_t  proto;
+
+  type = (p[12] << 8) | p[13];
+  if (type == UIP_ETHTYPE_ARP)
+    return PCAP_REPLAY_ARP;
+
+  if (type == UIP_ETHTYPE_IP)
+    proto = p[ETH_HDR_LEN + 9];
+  else if (type == UIP_ETHTYPE_IPV6)
+    proto = p[ETH_HDR_LEN + 6];
+  else
+    return PCAP_REPLAY_OTHER;
+
+  switch (proto) {
+  case UIP_PROTO_ICMP:
+  case UIP_PROTO_ICMP6:
+    return PCAP_REPLAY_ICMP;
+
+  case UIP_PROTO_TCP:
+    return PCAP_REPLAY_TCP;
+
+  case UIP_PROTO_UDP:
+    return PCAP_REPLAY_UDP;
+  }
+
+  return PCAP_REPLAY_OTHER;
+}
+
+static uint32_t getBe32(const uint8_t* p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void putBe32(uint8_t* p, uint32_t v)
+{
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+/*
+ * Locate TCP header in ethernet frame. Returns NULL
+ * if frame is not a TCP segment. Segment payload
+ * length is stored into *dataLen.
+ */
+static const uint8_t* tcpHeader(const uint8_t* p, uint32_t len, uint16_t* dataLen)
+{
+  uint16_t type;
+  uint16_t ipLen;
+  uint16_t hdrLen;
+  const uint8_t* tcp;
+
+  type = (p[12] << 8) | p[13];
+  if (type == UIP_ETHTYPE_IP) {
+
+    if (p[ETH_HDR_LEN + 9] != UIP_PROTO_TCP)
+      return NULL;
+
+    hdrLen = (p[ETH_HDR_LEN] & 0x0f) * 4;
+    ipLen = (p[ETH_HDR_LEN + 2] << 8) | p[ETH_HDR_LEN + 3];
+  }
+  else if (type == UIP_ETHTYPE_IPV6) {
+
+    if (p[ETH_HDR_LEN + 6] != UIP_PROTO_TCP)
+      return NULL;
+
+    hdrLen = 40;
+    ipLen = 40 + ((p[ETH_HDR_LEN + 4] << 8) | p[ETH_HDR_LEN + 5]);
+  }
+  else
+    return NULL;
+
+  if (ETH_HDR_LEN + hdrLen + 20 > len)
+    return NULL;
+
+  tcp = p + ETH_HDR_LEN + hdrLen;
+  hdrLen += (tcp[12] >> 4) * 4;
+  *dataLen = ipLen > hdrLen ? ipLen - hdrLen : 0;
+  return tcp;
+}
+
+/*
+ * Adjust TCP checksum for changed 32-bit field (RFC 1624).
+ */
+static void adjustChecksum(uint8_t* sum, uint32_t oldValue, uint32_t newValue)
+{
+  uint32_t s;
+
+  s = (uint16_t)~((sum[0] << 8) | sum[1]);
+  s += (uint16_t)~(oldValue >> 16) + (uint16_t)~(oldValue & 0xffff);
+  s += (newValue >> 16) + (newValue & 0xffff);
+  while (s >> 16)
+    s = (s & 0xffff) + (s >> 16);
+
+  s = ~s & 0xffff;
+  sum[0] = s >> 8;
+  sum[1] = s;
+}
+
+/*
+ * Track stack side of TCP connection in frame
+ * that was sent by stack, either in capture or now.
+ */
+static void trackStackSegment(const uint8_t* frame, uint32_t len, bool live)
+{
+  const uint8_t* tcp;
+  uint16_t dataLen;
+  uint32_t seq;
+  uint32_t end;
+
+  tcp = tcpHeader(frame, len, &dataLen);
+  if (tcp == NULL)
+    return;
+
+  seq = getBe32(tcp + 4);
+  if ((tcp[13] & (TCP_SYN | TCP_ACK)) == (TCP_SYN | TCP_ACK)) {
+
+    if (live) {
+
+      liveIss = seq;
+      liveIssKnown = true;
+      sndMax = seq;
+    }
+    else {
+
+      captureIss = seq;
+      captureIssKnown = true;
+    }
+  }
+
+  if (!live || !liveIssKnown)
+    return;
+
+  end = seq + dataLen;
+  if (tcp[13] & (TCP_SYN | TCP_FIN))
+    ++end;
+
+  if ((int32_t)(end - sndMax) > 0)
+    sndMax = end;
+}
+
+/*
+ * Prepare segment sent by peer for replay. Returns false
+ * if stack hasn't yet sent all data peer acknowledges.
+ */
+static bool preparePeerSegment(const uint8_t* frame, uint32_t len)
+{
+  const uint8_t* tcp;
+  uint16_t dataLen;
+  uint32_t ack;
+  uint32_t liveAck;
+
+  tcp = tcpHeader(frame, len, &dataLen);
+  if (tcp == NULL)
+    return true;
+
+  if ((tcp[13] & (TCP_SYN | TCP_ACK)) == TCP_SYN) {
+
+    // New connection from peer.
+    captureIssKnown = false;
+    liveIssKnown = false;
+    return true;
+  }
+
+  if (!(tcp[13] & TCP_ACK) || !captureIssKnown || !liveIssKnown)
+    return true;
+
+  ack = getBe32(tcp + 8);
+  liveAck = ack - captureIss + liveIss;
+  return (int32_t)(liveAck - sndMax) <= 0;
+}
+
+/*
+ * Shift acknowledgement number of peer segment
+ * in uip_buf to match stack sequence numbers.
+ */
+static void rewritePeerSegment(void)
+{
+  uint8_t* tcp;
+  uint16_t dataLen;
+  uint32_t ack;
+  uint32_t liveAck;
+
+  tcp = (uint8_t*)tcpHeader(uip_buf, uip_len, &dataLen);
+  if (tcp == NULL || !(tcp[13] & TCP_ACK) || !captureIssKnown || !liveIssKnown)
+    return;
+
+  ack = getBe32(tcp + 8);
+  liveAck = ack - captureIss + liveIss;
+  if (liveAck == ack)
+    return;
+
+  putBe32(tcp + 8, liveAck);
+  adjustChecksum(tcp + 16, ack, liveAck);
+}
+
+void pcapReplayInit()
+{
+  image = NULL;
+  imageLen = 0;
+  loopsLeft = 0;
+  netEnableDevicePolling(MS(10));
+}
+
+int pcapReplayLoad(const void* data, uint32_t len, uint32_t loops)
+{
+  uint32_t magic;
+
+  if (len < PCAP_FILE_HDR_LEN)
+    return -1;
+
+  memcpy(&magic, data, sizeof(magic));
+  if (magic == PCAP_MAGIC)
+    swapped = false;
+  else if (magic == PCAP_MAGIC_SWAPPED)
+    swapped = true;
+  else
+    return -1;
+
+  posTaskSchedLock();
+
+  image = data;
+  imageLen = len;
+  pos = PCAP_FILE_HDR_LEN;
+  loopsLeft = loops;
+  memset(&result, 0, sizeof(result));
+  startTime = jiffies;
+  captureIssKnown = false;
+  liveIssKnown = false;
+
+  posTaskSchedUnlock();
+
+  netInterrupt();
+  return 0;
+}
+
+#if NETCFG_PCAP_REPLAY_HOSTFILE == 1
+
+int pcapReplayLoadFile(const char* fileName, uint32_t loops)
+{
+  static void* fileData = NULL;
+  FILE* fp;
+  long  len;
+
+  fp = fopen(fileName, "rb");
+  if (fp == NULL)
+    return -1;
+
+  fseek(fp, 0, SEEK_END);
+  len = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  if (len <= 0) {
+
+    fclose(fp);
+    return -1;
+  }
+
+  // Previous image is no longer replayed after this.
+  posTaskSchedLock();
+  loopsLeft = 0;
+  posTaskSchedUnlock();
+
+  free(fileData);
+  fileData = malloc(len);
+  if (fileData == NULL || fread(fileData, 1, len, fp) != (size_t)len) {
+
+    fclose(fp);
+    return -1;
+  }
+
+  fclose(fp);
+  return pcapReplayLoad(fileData, len, loops);
+}
+
+#endif
+
+bool pcapReplayPoll()
+{
+  const uint8_t* frame;
+  uint32_t capLen;
+  uint32_t cycles;
+  int      cls;
+
+  if (loopsLeft == 0)
+    return false;
+
+  if (pos + PCAP_REC_HDR_LEN > imageLen) {
+
+    if (--loopsLeft == 0) {
+
+      result.ticks = jiffies - startTime;
+      return false;
+    }
+
+    pos = PCAP_FILE_HDR_LEN;
+  }
+
+  capLen = get32(image + pos + 8);
+  pos += PCAP_REC_HDR_LEN;
+
+  if (pos + capLen > imageLen) {
+
+    // Truncated image, stop replay.
+    loopsLeft = 0;
+    result.ticks = jiffies - startTime;
+    return false;
+  }
+
+  if (capLen < ETH_HDR_LEN + 20 || capLen > UIP_BUFSIZE) {
+
+    pos += capLen;
+    return true;
+  }
+
+  frame = image + pos;
+  if (!memcmp(frame + 6, &uip_lladdr, sizeof(uip_lladdr))) {
+
+    trackStackSegment(frame, capLen, false);
+    pos += capLen;
+    return true;
+  }
+
+  if (!preparePeerSegment(frame, capLen)) {
+
+    // Wait for stack, try again on next poll.
+    pos -= PCAP_REC_HDR_LEN;
+    return false;
+  }
+
+  memcpy(uip_buf, frame, capLen);
+  pos += capLen;
+
+  uip_len = capLen;
+  rewritePeerSegment();
+  cls = classify();
+
+  ++result.frames;
+  result.bytes += capLen;
+  ++result.cls[cls].frames;
+
+  appCycles = 0;
+  cycles = CYCLES();
+  netEthernetInput();
+  cycles = CYCLES() - cycles;
+  result.cls[cls].cycles += cycles - appCycles;
+  result.cls[cls].appCycles += appCycles;
+
+  return true;
+}
+
+#if NETCFG_SOCKETS == 1 && defined(NETCFG_CYCLE_COUNTER)
+
+/*
+ * Application callbacks, see contiki-conf.h.
+ * Also called for connections that are not replayed
+ * and by periodic processing, but only time spent
+ * while replayed frame is processed is used.
+ */
+void pcapReplayTcpAppcall()
+{
+  uint32_t cycles = CYCLES();
+
+  netTcpAppcall();
+  appCycles += CYCLES() - cycles;
+}
+
+#if UIP_CONF_UDP == 1
+
+void pcapReplayUdpAppcall()
+{
+  uint32_t cycles = CYCLES();
+
+  netUdpAppcall();
+  appCycles += CYCLES() - cycles;
+}
+
+#endif
+#endif
+
+void pcapReplaySend()
+{
+  ++result.xmits;
+  trackStackSegment(uip_buf, uip_len, true);
+}
+
+bool pcapReplayDone()
+{
+  return loopsLeft == 0;
+}
+
+void pcapReplayGetResult(PcapReplayResult* r)
+{
+  posTaskSchedLock();
+  *r = result;
+  if (loopsLeft != 0)
+    r->ticks = jiffies - startTime;
+
+  posTaskSchedUnlock();
+}
+
+void pcapReplayPrint()
+{
+  static const char* const names[PCAP_REPLAY_CLASSES] = { "arp", "icmp", "tcp", "udp", "other" };
+  PcapReplayResult r;
+  JIF_t ticks;
+  int i;
+
+  pcapReplayGetResult(&r);
+  ticks = r.ticks ? r.ticks : 1;
+
+  nosPrintf("replay: %lu frames, %lu xmits, %lu bytes in %lu ticks, %lu frames/s\n",
+            (unsigned long)r.frames, (unsigned long)r.xmits, (unsigned long)r.bytes,
+            (unsigned long)r.ticks, (unsigned long)((uint64_t)r.frames * HZ / ticks));
+
+  for (i = 0; i < PCAP_REPLAY_CLASSES; i++) {
+
+    if (r.cls[i].frames == 0)
+      continue;
+
+    nosPrintf("  %s: %lu frames, %lu cycles/frame, %lu in application\n", names[i],
+              (unsigned long)r.cls[i].frames,
+              (unsigned long)(r.cls[i].cycles / r.cls[i].frames),
+              (unsigned long)(r.cls[i].appCycles / r.cls[i].frames));
+  }
+}
+
+#endif
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2012-2013, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Frame classes used in replay statistics.
+ */
+#define PCAP_REPLAY_ARP    0
+#define PCAP_REPLAY_ICMP   1
+#define PCAP_REPLAY_TCP    2
+#define PCAP_REPLAY_UDP    3
+#define PCAP_REPLAY_OTHER  4
+#define PCAP_REPLAY_CLASSES 5
+
+typedef struct {
+
+  uint32_t frames;
+  uint64_t cycles;     // stack processing
+  uint64_t appCycles;  // socket layer and task wakeup
+} PcapReplayClass;
+
+typedef struct {
+
+  uint32_t frames;     // frames fed to stack
+  uint32_t xmits;      // frames sent by stack
+  uint32_t bytes;
+  JIF_t    ticks;      // time from first to last frame
+  PcapReplayClass cls[PCAP_REPLAY_CLASSES];
+} PcapReplayResult;
+
+void pcapReplayInit(void);
+bool pcapReplayPoll(void);
+void pcapReplaySend(void);
+
+int  pcapReplayLoad(const void* image, uint32_t len, uint32_t loops);
+#if NETCFG_PCAP_REPLAY_HOSTFILE == 1
+int  pcapReplayLoadFile(const char* fileName, uint32_t loops);
+#endif
+bool pcapReplayDone(void);
+void pcapReplayGetResult(PcapReplayResult* result);
+void pcapReplayPrint(void);
@@ -54,6 +54,9 @@ typedef struct pppContext PPPContext;
 
 void pppOutputBegin(PPPContext* state, uint16_t protocol);
 void pppOutputAppend(PPPContext* state, uint8_t ch);
+void pppOutputAppendBuf(PPPContext* state, const uint8_t* data, int len);
 void pppOutputEnd(PPPContext* state);
 void pppInputBegin(PPPContext* state);
 void pppInputAppend(PPPContext* state, uint8_t ch);
+void pppInputAppendBuf(PPPContext* state, const uint8_t* data, int len);
+uint16_t pppFcs(uint16_t fcs, const uint8_t* data, int len);
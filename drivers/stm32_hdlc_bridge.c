@@ -43,14 +43,23 @@
 #include "stm32_hdlc_bridge.h"
 #include "ppp_defs.h"
 #include "ppp_frame.h"
+#if NETCFG_HDLC_VJCOMP == 1
+#include "vjcomp.h"
+#endif
 
 static volatile int packetInLen;
+static volatile int packetInProto;
 static uint8_t packetIn[UIP_BUFSIZE];
 static volatile uint8_t* packetInBegin;
 static PPPContext outCtx;
 static PPPContext inCtx;
 static uint8_t packetOut[2*UIP_BUFSIZE];
 
+#if NETCFG_HDLC_VJCOMP == 1
+static VJContext vj;
+static int packetInBadCRC;
+#endif
+
 static void packetInReady(int proto, uint8_t* data, int len);
 
 void hdlcInit()
@@ -74,6 +83,11 @@ void hdlcInit()
   // Initialize frame encoder/decoder.
 
   packetInLen = 0;
+#if NETCFG_HDLC_VJCOMP == 1
+  vjInit(&vj);
+  packetInBadCRC = 0;
+#endif
+
   inCtx.buf = packetIn;
   inCtx.max = sizeof(packetIn);
   inCtx.inputHook = packetInReady;
@@ -93,10 +107,24 @@ int hdlcPoll()
 
   if (len > 0) {
 
+#if NETCFG_HDLC_VJCOMP == 1
+
+    if (inCtx.stat.badCRC != packetInBadCRC) {
+
+      packetInBadCRC = inCtx.stat.badCRC;
+      vjRxError(&vj);
+    }
+
+    len = vjUncompress(&vj, packetInProto, (uint8_t*)packetInBegin, len, uip_buf, UIP_BUFSIZE);
+
+#else
+
     if (len > UIP_BUFSIZE)
       len = UIP_BUFSIZE;
       
     memcpy(uip_buf, (void*)packetInBegin, len);
+
+#endif
     packetInLen = 0;
   }
 
@@ -110,9 +138,23 @@ void hdlcSend()
 
   outCtx.buf = packetOut;
   outCtx.max = sizeof(packetOut);
+
+#if NETCFG_HDLC_VJCOMP == 1
+
+  uint8_t vjHdr[VJ_HDR_BUF];
+  int vjLen;
+  int skip;
+
+  pppOutputBegin(&outCtx, vjCompress(&vj, uip_buf, uip_len, vjHdr, &vjLen, &skip));
+  pppOutputAppendBuf(&outCtx, vjHdr, vjLen);
+  pppOutputAppendBuf(&outCtx, uip_buf + skip, uip_len - skip);
+
+#else
+
   pppOutputBegin(&outCtx, PPP_ETHERNET);
-  for (i = 0; i < uip_len; i++)
-    pppOutputAppend(&outCtx, uip_buf[i]);
+  pppOutputAppendBuf(&outCtx, uip_buf, uip_len);
+
+#endif
 
   pppOutputEnd(&outCtx);
 
@@ -127,10 +169,15 @@ void hdlcSend()
 
 void packetInReady(int proto, uint8_t* data, int len)
 {
-  if (proto == PPP_ETHERNET) {
+  if (proto == PPP_ETHERNET
+#if NETCFG_HDLC_VJCOMP == 1
+      || proto == PPP_VJC_COMP || proto == PPP_VJC_UNCOMP
+#endif
+     ) {
 
     packetInBegin = data;
     packetInLen = len;
+    packetInProto = proto;
     netInterrupt();
   }
 }
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Host test for ENC28J60 driver, run against simulated chip.
+ * Checks that received frames and echoed frames come through
+ * intact and prints number of SPI transactions per frame for
+ * receive only and echo (receive, send back and idle poll)
+ * traffic. Test is built twice, with and without
+ * ENC28J60_BATCHED_IO, so the counts can be compared.
+ *
+ * make test
+ */
+
+#include <picoos.h>
+#include <picoos-net.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../enc28j60.h"
+#include "../enc28j60_sim.h"
+
+#define ROUNDS      1000
+
+static int failed;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      ++failed; \
+    } \
+  } while (0)
+
+static uint32_t randState = 1;
+
+static uint32_t nextRandom(void)
+{
+  uint32_t x = randState;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  randState = x;
+  return x;
+}
+
+uip_lladdr_t uip_lladdr = { { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 } };
+
+static uint8_t frame[MAX_FRAME_LEN];
+static uint8_t buf[MAX_FRAME_LEN];
+
+/*
+ * At most one frame is being transmitted while next one is
+ * queued, so two slots are enough to check transmitted frames.
+ */
+static uint8_t queued[2][MAX_FRAME_LEN];
+static int queuedLen[2];
+static int queuedCount;
+static int sentCount;
+
+static void output(const uint8_t* f, int len)
+{
+  int slot = sentCount % 2;
+
+  CHECK(sentCount < queuedCount);
+  CHECK(len == queuedLen[slot] && !memcmp(f, queued[slot], len));
+  ++sentCount;
+}
+
+static void makeFrame(int len)
+{
+  int i;
+
+  for (i = 0; i < len; i++)
+    frame[i] = nextRandom();
+}
+
+static uint32_t transactions(void)
+{
+  Enc28j60SimStats st;
+
+  enc28j60SimGetStats(0, &st);
+  return st.transactions;
+}
+
+/*
+ * Receive frames one at a time, return SPI
+ * transactions per frame.
+ */
+static uint32_t receiveOnly(int len)
+{
+  int i;
+
+  enc28j60SimResetStats(0);
+  for (i = 0; i < ROUNDS; i++) {
+
+    makeFrame(len);
+    CHECK(enc28j60SimInput(0, frame, len) == len);
+    CHECK(enc28j60_Frame_Recv(buf, sizeof(buf)) == (unsigned int)len);
+    CHECK(!memcmp(buf, frame, len));
+  }
+
+  return transactions() / ROUNDS;
+}
+
+/*
+ * Receive frame, send it back and poll once more
+ * for frames like main loop would. Return SPI
+ * transactions per frame.
+ */
+static uint32_t echo(int len)
+{
+  unsigned int n;
+  int i;
+
+  enc28j60SimResetStats(0);
+  for (i = 0; i < ROUNDS; i++) {
+
+    makeFrame(len);
+    CHECK(enc28j60SimInput(0, frame, len) == len);
+    n = enc28j60_Frame_Recv(buf, sizeof(buf));
+    CHECK(n == (unsigned int)len);
+    memcpy(queued[queuedCount % 2], buf, n);
+    queuedLen[queuedCount % 2] = n;
+    ++queuedCount;
+    CHECK(enc28j60_Frame_Send(buf, n) == len);
+    CHECK(enc28j60_Frame_Recv(buf, sizeof(buf)) == 0);
+  }
+
+  CHECK(sentCount >= queuedCount - 1);
+  return transactions() / ROUNDS;
+}
+
+int main(int argc, char** argv)
+{
+  static const int sizes[] = { 64, 590, 1500 };
+  unsigned int i;
+
+  enc28j60SimSetOutput(output);
+  ENC28J60_Index = 0;
+  enc28j60_spi_init();
+  enc28j60_Init();
+
+  printf("batched io %d\n", ENC28J60_BATCHED_IO);
+  printf("receive only, 590 bytes: %u transactions\n", receiveOnly(590));
+
+  for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    printf("echo, %d bytes: %u transactions\n", sizes[i], echo(sizes[i]));
+
+  if (failed) {
+
+    printf("%d checks failed\n", failed);
+    return 1;
+  }
+
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,429 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Host test and benchmark for PPP framing. Checks that
+ * FCS slicing tables agree with bytewise FCS and that
+ * bulk encode/decode functions produce same results as
+ * bytewise ones, then measures their speed.
+ *
+ * make && ./ppp_frame_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Include source directly to reach static tables.
+#include "../ppp_frame.c"
+
+#define MAX_PAYLOAD 1500
+#define FRAME_MAX   (2 * MAX_PAYLOAD + 16)
+#define ROUNDS      20000
+#define BENCH_BYTES (64 * 1024 * 1024L)
+
+static int failed;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      ++failed; \
+    } \
+  } while (0)
+
+static uint32_t randState = 1;
+
+static uint32_t nextRandom(void)
+{
+  uint32_t x = randState;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  randState = x;
+  return x;
+}
+
+/*
+ * Fill buffer with random bytes. Some buffers are
+ * made mostly of flags and escapes to exercise
+ * escaping code.
+ */
+static void randomFill(uint8_t* buf, int len)
+{
+  int special = nextRandom() % 4 == 0;
+  int i;
+
+  for (i = 0; i < len; i++) {
+
+    if (special && nextRandom() % 2)
+      buf[i] = nextRandom() % 2 ? PPP_FLAG : PPP_ESCAPE;
+    else
+      buf[i] = nextRandom();
+  }
+}
+
+static uint16_t bytewiseFcs(uint16_t fcs, const uint8_t* data, int len)
+{
+  while (len-- > 0)
+    fcs = PPP_FCS(fcs, *data++);
+
+  return fcs;
+}
+
+static uint64_t nanos(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void report(const char* what, long bytes, uint64_t ns)
+{
+  printf("%-28s %8.1f MB/s\n", what, bytes / 1048576.0 / (ns / 1e9));
+}
+
+/*
+ * fcstab4[k][i] must be fcstab[i] advanced over
+ * k + 1 zero bytes.
+ */
+static void testTables(void)
+{
+#if PPP_FCS_SLICING
+  uint16_t fcs;
+  int i;
+  int k;
+
+  for (k = 0; k < 3; k++) {
+
+    for (i = 0; i < 256; i++) {
+
+      fcs = fcstab[i];
+      fcs = bytewiseFcs(fcs, (const uint8_t*)"\0\0\0", k + 1);
+      CHECK(fcstab4[k][i] == fcs);
+    }
+  }
+#endif
+}
+
+/*
+ * pppFcs must match bytewise calculation for all
+ * lengths, alignments and initial values.
+ */
+static void testFcs(void)
+{
+  static uint8_t buf[MAX_PAYLOAD + 8];
+  uint16_t init;
+  int len;
+  int off;
+
+  for (len = 0; len <= 64; len++) {
+
+    for (off = 0; off < 4; off++) {
+
+      randomFill(buf + off, len);
+      init = nextRandom();
+      CHECK(pppFcs(init, buf + off, len) == bytewiseFcs(init, buf + off, len));
+    }
+  }
+
+  for (len = 0; len < ROUNDS; len++) {
+
+    off = nextRandom() % MAX_PAYLOAD;
+    randomFill(buf, off);
+    CHECK(pppFcs(PPP_INITFCS, buf, off) == bytewiseFcs(PPP_INITFCS, buf, off));
+  }
+}
+
+static uint8_t  rxPacket[FRAME_MAX];
+static int      rxLen;
+static int      rxProto;
+static int      rxCount;
+
+static void inputHook(int proto, uint8_t* pkt, int len)
+{
+  memcpy(rxPacket, pkt, len);
+  rxLen = len;
+  rxProto = proto;
+  ++rxCount;
+}
+
+static int encodeBuf(uint8_t* frame, int max, uint16_t proto, const uint8_t* data, int len)
+{
+  PPPContext ctx;
+
+  ctx.buf = frame;
+  ctx.max = max;
+  pppOutputBegin(&ctx, proto);
+  pppOutputAppendBuf(&ctx, data, len);
+  pppOutputEnd(&ctx);
+  return ctx.ptr - ctx.buf;
+}
+
+static int encodeBytewise(uint8_t* frame, int max, uint16_t proto, const uint8_t* data, int len)
+{
+  PPPContext ctx;
+  int i;
+
+  ctx.buf = frame;
+  ctx.max = max;
+  pppOutputBegin(&ctx, proto);
+  for (i = 0; i < len; i++)
+    pppOutputAppend(&ctx, data[i]);
+
+  pppOutputEnd(&ctx);
+  return ctx.ptr - ctx.buf;
+}
+
+/*
+ * Encode random packets with both output functions and
+ * decode them with pppInputAppendBuf, feeding frame in
+ * random sized pieces.
+ */
+static void testRoundTrip(void)
+{
+  static uint8_t data[MAX_PAYLOAD];
+  static uint8_t frame1[FRAME_MAX];
+  static uint8_t frame2[FRAME_MAX];
+  static uint8_t inBuf[FRAME_MAX];
+  PPPContext in;
+  uint16_t proto;
+  int len, len1, len2;
+  int pos, piece;
+  int r;
+
+  in.buf = inBuf;
+  in.max = sizeof(inBuf);
+  in.inputHook = inputHook;
+  pppInputBegin(&in);
+
+  for (r = 0; r < ROUNDS; r++) {
+
+    len = nextRandom() % (MAX_PAYLOAD + 1);
+    randomFill(data, len);
+    proto = nextRandom() % 2 ? PPP_ETHERNET : 0x0021;
+
+    len1 = encodeBuf(frame1, sizeof(frame1), proto, data, len);
+    len2 = encodeBytewise(frame2, sizeof(frame2), proto, data, len);
+    CHECK(len1 == len2 && !memcmp(frame1, frame2, len1));
+
+    rxCount = 0;
+    pos = 0;
+    while (pos < len1) {
+
+      piece = 1 + nextRandom() % 64;
+      if (piece > len1 - pos)
+        piece = len1 - pos;
+
+      pppInputAppendBuf(&in, frame1 + pos, piece);
+      pos += piece;
+    }
+
+    CHECK(rxCount == 1);
+    CHECK(rxProto == proto);
+    CHECK(rxLen == len && !memcmp(rxPacket, data, len));
+  }
+
+  CHECK(in.stat.badCRC == 0);
+}
+
+/*
+ * Feed random garbage with frames mixed in to bulk
+ * and bytewise input functions, using a small buffer
+ * so that overflows happen. Both must deliver same
+ * packets and statistics.
+ */
+static uint8_t  hookLog[2][64 * FRAME_MAX];
+static int      hookLogLen[2];
+static int      hookLogIdx;
+
+static void logHook(int proto, uint8_t* pkt, int len)
+{
+  uint8_t* p = hookLog[hookLogIdx] + hookLogLen[hookLogIdx];
+
+  if (hookLogLen[hookLogIdx] + len + 4 > (int)sizeof(hookLog[0]))
+    return;
+
+  p[0] = proto >> 8;
+  p[1] = proto;
+  p[2] = len >> 8;
+  p[3] = len;
+  memcpy(p + 4, pkt, len);
+  hookLogLen[hookLogIdx] += len + 4;
+}
+
+static void testInputEquivalence(void)
+{
+  static uint8_t stream[32 * FRAME_MAX];
+  static uint8_t data[MAX_PAYLOAD];
+  static uint8_t buf1[256];
+  static uint8_t buf2[256];
+  PPPContext in1, in2;
+  int streamLen;
+  int len;
+  int pos, piece;
+  int i, r;
+
+  for (r = 0; r < 200; r++) {
+
+    streamLen = 0;
+    for (i = 0; i < 16; i++) {
+
+      len = nextRandom() % 400;
+      if (nextRandom() % 4 == 0) {
+
+        randomFill(stream + streamLen, len);
+        streamLen += len;
+      }
+      else {
+
+        randomFill(data, len);
+        streamLen += encodeBuf(stream + streamLen, FRAME_MAX, 0x0021, data, len);
+      }
+
+      // Corrupt some frames.
+      if (nextRandom() % 8 == 0 && streamLen > 0)
+        stream[nextRandom() % streamLen] ^= 1 << (nextRandom() % 8);
+    }
+
+    in1.buf = buf1;
+    in1.max = sizeof(buf1);
+    in1.inputHook = logHook;
+    pppInputBegin(&in1);
+
+    in2 = in1;
+    in2.buf = buf2;
+    pppInputBegin(&in2);
+
+    hookLogLen[0] = hookLogLen[1] = 0;
+
+    hookLogIdx = 0;
+    pos = 0;
+    while (pos < streamLen) {
+
+      piece = 1 + nextRandom() % 100;
+      if (piece > streamLen - pos)
+        piece = streamLen - pos;
+
+      pppInputAppendBuf(&in1, stream + pos, piece);
+      pos += piece;
+    }
+
+    hookLogIdx = 1;
+    for (pos = 0; pos < streamLen; pos++)
+      pppInputAppend(&in2, stream[pos]);
+
+    CHECK(hookLogLen[0] == hookLogLen[1] && !memcmp(hookLog[0], hookLog[1], hookLogLen[0]));
+    CHECK(in1.stat.badCRC == in2.stat.badCRC);
+    CHECK(in1.stat.tooShort == in2.stat.tooShort);
+    CHECK(in1.mode == in2.mode && in1.fcs == in2.fcs);
+  }
+}
+
+static void benchmark(void)
+{
+  static uint8_t data[MAX_PAYLOAD];
+  static uint8_t frame[FRAME_MAX];
+  static uint8_t inBuf[FRAME_MAX];
+  PPPContext in;
+  volatile uint16_t sink = 0;
+  uint64_t start;
+  long done;
+  int len;
+  int i;
+
+  // Random data has about 1 % of bytes to escape.
+  for (i = 0; i < MAX_PAYLOAD; i++)
+    data[i] = nextRandom();
+
+  start = nanos();
+  for (done = 0; done < BENCH_BYTES; done += MAX_PAYLOAD)
+    sink ^= bytewiseFcs(PPP_INITFCS, data, MAX_PAYLOAD);
+
+  report("fcs bytewise", done, nanos() - start);
+
+  start = nanos();
+  for (done = 0; done < BENCH_BYTES; done += MAX_PAYLOAD)
+    sink ^= pppFcs(PPP_INITFCS, data, MAX_PAYLOAD);
+
+  report("pppFcs", done, nanos() - start);
+
+  start = nanos();
+  for (done = 0; done < BENCH_BYTES; done += MAX_PAYLOAD)
+    sink ^= encodeBytewise(frame, sizeof(frame), 0x0021, data, MAX_PAYLOAD);
+
+  report("encode pppOutputAppend", done, nanos() - start);
+
+  start = nanos();
+  for (done = 0; done < BENCH_BYTES; done += MAX_PAYLOAD)
+    sink ^= encodeBuf(frame, sizeof(frame), 0x0021, data, MAX_PAYLOAD);
+
+  report("encode pppOutputAppendBuf", done, nanos() - start);
+
+  len = encodeBuf(frame, sizeof(frame), 0x0021, data, MAX_PAYLOAD);
+  in.buf = inBuf;
+  in.max = sizeof(inBuf);
+  in.inputHook = inputHook;
+  pppInputBegin(&in);
+
+  rxCount = 0;
+  start = nanos();
+  for (done = 0; done < BENCH_BYTES; done += MAX_PAYLOAD)
+    for (i = 0; i < len; i++)
+      pppInputAppend(&in, frame[i]);
+
+  report("decode pppInputAppend", done, nanos() - start);
+  CHECK(rxCount == done / MAX_PAYLOAD);
+
+  rxCount = 0;
+  start = nanos();
+  for (done = 0; done < BENCH_BYTES; done += MAX_PAYLOAD)
+    pppInputAppendBuf(&in, frame, len);
+
+  report("decode pppInputAppendBuf", done, nanos() - start);
+  CHECK(rxCount == done / MAX_PAYLOAD);
+  (void)sink;
+}
+
+int main(int argc, char** argv)
+{
+  testTables();
+  testFcs();
+  testRoundTrip();
+  testInputEquivalence();
+
+  if (argc < 2 || strcmp(argv[1], "-n"))
+    benchmark();
+
+  printf("%s\n", failed ? "FAILED" : "ok");
+  return failed ? 1 : 0;
+}
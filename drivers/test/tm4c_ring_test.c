@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Host test for TM4C129 EMAC descriptor rings, run against
+ * simulated DMA engine. Checks that a burst filling the whole
+ * receive ring is delivered in order, that sends queue without
+ * waiting until transmit ring is full, and that frame order is
+ * kept over 100000 send/receive cycles with frames looped from
+ * transmit DMA back to receive DMA.
+ *
+ * make test
+ */
+
+#include <picoos.h>
+#include <picoos-net.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../tm4c_emac_ring.h"
+
+#define FRAME_LEN   60
+#define CYCLES      100000
+
+static int failed;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      ++failed; \
+    } \
+  } while (0)
+
+static uint32_t randState = 1;
+
+static uint32_t nextRandom(void)
+{
+  uint32_t x = randState;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  randState = x;
+  return x;
+}
+
+/*
+ * Frames carry sequence number in first four bytes,
+ * rest of frame is derived from it.
+ */
+static int makeFrame(uint8_t* f, uint32_t seq)
+{
+  int len = FRAME_LEN + seq % 64;
+  int i;
+
+  memcpy(f, &seq, sizeof(seq));
+  for (i = sizeof(seq); i < len; i++)
+    f[i] = seq + i;
+
+  return len;
+}
+
+static bool frameOk(const uint8_t* f, int len, uint32_t seq)
+{
+  uint8_t expect[EMAC_BUFFER_SIZE];
+
+  return len == makeFrame(expect, seq) && !memcmp(f, expect, len);
+}
+
+static uint32_t txOutSeq;
+static int txOutBad;
+static bool loop;
+
+/*
+ * Frames sent by transmit DMA. Either checked here
+ * or looped back to receive DMA.
+ */
+static void output(const uint8_t* frame, int len)
+{
+  if (loop) {
+
+    emacSimReceive(frame, len);
+    return;
+  }
+
+  if (!frameOk(frame, len, txOutSeq))
+    ++txOutBad;
+
+  ++txOutSeq;
+}
+
+static void start(void)
+{
+  emacRingInit();
+  emacSimStart();
+  emacSimSetOutput(output);
+  txOutSeq = 0;
+  txOutBad = 0;
+  loop = false;
+}
+
+static void testRxBurst(void)
+{
+  uint8_t frame[EMAC_BUFFER_SIZE];
+  EmacSimStats sim;
+  EmacRingStats ring;
+  uint32_t seq;
+  int len;
+
+  start();
+
+  // DMA owns all receive descriptors, so a burst
+  // filling the ring is stored before any polling.
+  for (seq = 0; seq < NETCFG_TM4C_RX_DESCRIPTORS; seq++) {
+
+    len = makeFrame(frame, seq);
+    CHECK(emacSimReceive(frame, len) == len);
+  }
+
+  len = makeFrame(frame, seq);
+  CHECK(emacSimReceive(frame, len) == 0);
+
+  for (seq = 0; seq < NETCFG_TM4C_RX_DESCRIPTORS; seq++) {
+
+    len = emacRingRecv(frame, sizeof(frame));
+    CHECK(frameOk(frame, len, seq));
+  }
+
+  CHECK(emacRingRecv(frame, sizeof(frame)) == 0);
+
+  emacSimGetStats(&sim);
+  emacRingGetStats(&ring);
+  CHECK(sim.rxFrames == NETCFG_TM4C_RX_DESCRIPTORS);
+  CHECK(sim.rxOverflows == 1);
+  CHECK(ring.rxFrames == NETCFG_TM4C_RX_DESCRIPTORS);
+
+  // Descriptors were given back to DMA.
+  len = makeFrame(frame, 0);
+  CHECK(emacSimReceive(frame, len) == len);
+  CHECK(frameOk(frame, emacRingRecv(frame, sizeof(frame)), 0));
+  printf("rx burst: %d frames\n", NETCFG_TM4C_RX_DESCRIPTORS);
+}
+
+static void testTxQueue(void)
+{
+  uint8_t frame[EMAC_BUFFER_SIZE];
+  EmacRingStats ring;
+  uint32_t seq;
+  int len;
+
+  start();
+
+  // Sends return at once until transmit ring is full.
+  for (seq = 0; seq < NETCFG_TM4C_TX_DESCRIPTORS; seq++) {
+
+    len = makeFrame(frame, seq);
+    CHECK(emacRingSendv(frame, 14, frame + 14, len - 14));
+  }
+
+  len = makeFrame(frame, seq);
+  CHECK(!emacRingSendv(frame, 14, frame + 14, len - 14));
+
+  CHECK(emacSimTransmit(NETCFG_TM4C_TX_DESCRIPTORS + 1) == NETCFG_TM4C_TX_DESCRIPTORS);
+  CHECK(txOutSeq == NETCFG_TM4C_TX_DESCRIPTORS);
+  CHECK(txOutBad == 0);
+
+  // Transmit interrupt reclaimed descriptors.
+  CHECK(emacRingSendv(frame, 14, frame + 14, len - 14));
+  CHECK(emacSimTransmit(1) == 1);
+  CHECK(txOutBad == 0);
+
+  emacRingGetStats(&ring);
+  CHECK(ring.txFrames == NETCFG_TM4C_TX_DESCRIPTORS + 1);
+  CHECK(ring.txRingFull == 1);
+  printf("tx queue: %d frames\n", NETCFG_TM4C_TX_DESCRIPTORS);
+}
+
+/*
+ * Random number of sends and partial DMA
+ * progress in each cycle, frames looped back.
+ */
+static void testCycles(void)
+{
+  uint8_t frame[EMAC_BUFFER_SIZE];
+  EmacRingStats ring;
+  uint32_t txSeq = 0;
+  uint32_t rxSeq = 0;
+  int bad = 0;
+  int len;
+  int hdr;
+  int i;
+  int n;
+
+  start();
+  loop = true;
+
+  for (i = 0; i < CYCLES; i++) {
+
+    n = 1 + nextRandom() % NETCFG_TM4C_TX_DESCRIPTORS;
+    while (n-- > 0) {
+
+      len = makeFrame(frame, txSeq);
+      hdr = nextRandom() % len;
+      if (!emacRingSendv(frame, hdr, frame + hdr, len - hdr))
+        break;
+
+      ++txSeq;
+    }
+
+    emacSimTransmit(1 + nextRandom() % NETCFG_TM4C_TX_DESCRIPTORS);
+
+    while ((len = emacRingRecv(frame, sizeof(frame))) > 0) {
+
+      if (!frameOk(frame, len, rxSeq))
+        ++bad;
+
+      ++rxSeq;
+    }
+  }
+
+  // Drain transmit ring.
+  emacSimTransmit(NETCFG_TM4C_TX_DESCRIPTORS);
+  while ((len = emacRingRecv(frame, sizeof(frame))) > 0) {
+
+    if (!frameOk(frame, len, rxSeq))
+      ++bad;
+
+    ++rxSeq;
+  }
+
+  emacRingGetStats(&ring);
+  CHECK(bad == 0);
+  CHECK(rxSeq == txSeq);
+  CHECK(ring.txFrames == txSeq);
+  CHECK(ring.rxFrames == rxSeq);
+  printf("cycles: %d, %lu frames\n", CYCLES, (unsigned long)rxSeq);
+}
+
+int main(int argc, char** argv)
+{
+  testRxBurst();
+  testTxQueue();
+  testCycles();
+
+  if (failed) {
+
+    printf("%d checks failed\n", failed);
+    return 1;
+  }
+
+  printf("ok\n");
+  return 0;
+}
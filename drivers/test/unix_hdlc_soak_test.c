@@ -0,0 +1,367 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Soak test for Unix HDLC bridge driver over a pseudo
+ * terminal pair. Driver opens slave side, test acts as
+ * peer on master side using PPP framing code directly.
+ *
+ * Peer writes bursts of frames, so that both receive buffers
+ * of driver fill up and decoding pauses. Every frame must still
+ * be received once and in order, corrupted frames must be
+ * counted and dropped. Frames sent by driver, both whole and
+ * with separate payload, must come out unchanged.
+ *
+ * make test
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <picoos.h>
+#include <picoos-net.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <time.h>
+#include <pty.h>
+
+#include "../ppp_defs.h"
+#include "../ppp_frame.h"
+#include "../unix_hdlc_bridge.h"
+
+#define ROUNDS      2000
+#define BURST       8
+#define QUEUE       64
+#define MIN_LEN     14
+#define ETH_TYPE    0x88B5    // local experimental, not compressed
+#define TIMEOUT     5         // seconds
+
+static int failed;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      ++failed; \
+    } \
+  } while (0)
+
+static uint32_t randState = 1;
+
+static uint32_t nextRandom(void)
+{
+  uint32_t x = randState;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  randState = x;
+  return x;
+}
+
+char hdlcTestDevice[64];
+
+uip_buf_t uip_aligned_buf;
+uint16_t uip_len;
+
+void netInterrupt()
+{
+}
+
+static int master;
+
+/*
+ * Frames written by peer but not yet seen by driver.
+ */
+static uint8_t queue[QUEUE][UIP_BUFSIZE];
+static int queueLen[QUEUE];
+static int queueHead;
+static int queueTail;
+
+static uint8_t wire[2 * (UIP_BUFSIZE + 6) + 2];
+static uint8_t peerFrame[UIP_BUFSIZE + 6];
+static PPPContext outCtx;
+static PPPContext inCtx;
+
+static int gotProto;
+static uint8_t* gotPkt;
+static int gotLen;
+
+static int toDriver;
+static int fromDriver;
+static int corrupted;
+
+static void makeFrame(uint8_t* f, int len)
+{
+  int i;
+
+  for (i = 0; i < len; i++)
+    f[i] = nextRandom();
+
+  f[12] = ETH_TYPE >> 8;
+  f[13] = ETH_TYPE & 0xFF;
+}
+
+static int randomLen(void)
+{
+  return MIN_LEN + nextRandom() % (UIP_BUFSIZE - MIN_LEN + 1);
+}
+
+static bool expired(time_t start)
+{
+  return time(NULL) - start > TIMEOUT;
+}
+
+/*
+ * Poll driver once and check frame against
+ * oldest queued one.
+ */
+static void driverPoll(void)
+{
+  int len;
+
+  len = unixHdlcPoll();
+  if (len == 0)
+    return;
+
+  CHECK(queueHead != queueTail);
+  if (queueHead == queueTail)
+    return;
+
+  CHECK(len == queueLen[queueHead]);
+  CHECK(!memcmp(uip_buf, queue[queueHead], len));
+  queueHead = (queueHead + 1) % QUEUE;
+  ++toDriver;
+}
+
+/*
+ * Write data to master side. If pty is full,
+ * let driver consume frames.
+ */
+static void peerWrite(const uint8_t* buf, int len)
+{
+  time_t start = time(NULL);
+  int n;
+
+  while (len > 0 && !expired(start)) {
+
+    n = write(master, buf, len);
+    if (n == -1 && errno == EAGAIN) {
+
+      driverPoll();
+      uosSpinUSecs(100);
+      continue;
+    }
+
+    CHECK(n > 0);
+    if (n <= 0)
+      return;
+
+    buf += n;
+    len -= n;
+  }
+
+  CHECK(len == 0);
+}
+
+static void peerSend(void)
+{
+  uint8_t* f = queue[queueTail];
+  int len = randomLen();
+  int wireLen;
+  int pos;
+
+  makeFrame(f, len);
+
+  outCtx.buf = wire;
+  outCtx.max = sizeof(wire);
+  pppOutputBegin(&outCtx, PPP_ETHERNET);
+  pppOutputAppendBuf(&outCtx, f, len);
+  pppOutputEnd(&outCtx);
+  wireLen = outCtx.ptr - outCtx.buf;
+
+// Corrupt some frames. Flag and escape bytes are
+// left alone, so frame boundaries stay where they were.
+
+  if (nextRandom() % 50 == 0) {
+
+    pos = 1 + nextRandom() % (wireLen - 2);
+    while (pos < wireLen - 1 &&
+           (wire[pos] == PPP_FLAG || wire[pos] == PPP_ESCAPE ||
+           (wire[pos] ^ 0x01) == PPP_FLAG || (wire[pos] ^ 0x01) == PPP_ESCAPE))
+      ++pos;
+
+    CHECK(pos < wireLen - 1);
+    wire[pos] ^= 0x01;
+    ++corrupted;
+  }
+  else {
+
+    queueLen[queueTail] = len;
+    queueTail = (queueTail + 1) % QUEUE;
+    CHECK(queueTail != queueHead);
+  }
+
+  peerWrite(wire, wireLen);
+}
+
+static void peerInput(int proto, uint8_t* pkt, int len)
+{
+  gotProto = proto;
+  gotPkt = pkt;
+  gotLen = len;
+}
+
+/*
+ * Send frame from driver, read it from master side.
+ */
+static void driverSend(void)
+{
+  static uint8_t sent[UIP_BUFSIZE];
+  time_t start = time(NULL);
+  uint8_t buf[256];
+  int len = randomLen();
+  int dataLen;
+  int n;
+  int i;
+
+  makeFrame(uip_buf, len);
+  memcpy(sent, uip_buf, len);
+  uip_len = len;
+
+  dataLen = len - MIN_LEN;
+  if (dataLen > 0 && nextRandom() % 2) {
+
+    // Payload from separate buffer, like sockets do.
+    dataLen = nextRandom() % (dataLen + 1);
+    unixHdlcSendv(sent + len - dataLen, dataLen);
+  }
+  else
+    unixHdlcSend();
+
+  gotLen = 0;
+  while (gotLen == 0 && !expired(start)) {
+
+    n = read(master, buf, sizeof(buf));
+    if (n == -1 && errno == EAGAIN) {
+
+      uosSpinUSecs(100);
+      continue;
+    }
+
+    CHECK(n > 0);
+    if (n <= 0)
+      return;
+
+    for (i = 0; i < n; i++) {
+
+      pppInputAppend(&inCtx, buf[i]);
+      if (gotLen > 0) {
+
+        CHECK(i == n - 1);
+        break;
+      }
+    }
+  }
+
+  CHECK(gotProto == PPP_ETHERNET);
+  CHECK(gotLen == len && !memcmp(gotPkt, sent, len));
+  ++fromDriver;
+}
+
+int main(int argc, char** argv)
+{
+  struct termios tio;
+  UnixHdlcStats st;
+  time_t start;
+  int slave;
+  int round;
+  int burst;
+  int i;
+
+  CHECK(openpty(&master, &slave, hdlcTestDevice, NULL, NULL) == 0);
+  if (failed)
+    return 1;
+
+  tcgetattr(master, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(master, TCSANOW, &tio);
+  fcntl(master, F_SETFL, fcntl(master, F_GETFL, 0) | O_NONBLOCK);
+
+  unixHdlcInit();
+  close(slave);
+
+  inCtx.buf = peerFrame;
+  inCtx.max = sizeof(peerFrame);
+  inCtx.inputHook = peerInput;
+  pppInputBegin(&inCtx);
+
+  for (round = 0; round < ROUNDS && !failed; round++) {
+
+    burst = 1 + nextRandom() % BURST;
+    for (i = 0; i < burst; i++)
+      peerSend();
+
+    start = time(NULL);
+    while (queueHead != queueTail && !expired(start)) {
+
+      driverPoll();
+      uosSpinUSecs(100);
+    }
+
+    CHECK(queueHead == queueTail);
+
+    burst = 1 + nextRandom() % BURST;
+    for (i = 0; i < burst; i++)
+      driverSend();
+  }
+
+  unixHdlcGetStats(&st);
+  printf("frames: %d to driver, %d from driver, %d corrupted, %u stalls\n",
+         toDriver, fromDriver, corrupted, st.rxStalls);
+
+  CHECK(st.rxFrames == (uint32_t)toDriver);
+  CHECK(st.txFrames == (uint32_t)fromDriver);
+  CHECK(st.badCRC == corrupted);
+  CHECK(st.tooShort == 0);
+  CHECK(st.rxStalls > 0);
+
+  if (failed) {
+
+    printf("%d checks failed\n", failed);
+    return 1;
+  }
+
+  printf("ok\n");
+  return 0;
+}
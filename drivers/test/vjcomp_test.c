@@ -0,0 +1,518 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Host test for VJ header compression. Frames go through
+ * vjCompress, PPP framing and vjUncompress and must come
+ * out unchanged. Covers mixed traffic over more connections
+ * than there are slots, the SPECIAL_I and SPECIAL_D encodings
+ * and tossing of compressed packets after a frame was lost
+ * because of bad FCS. Also prints the size of a 1-byte
+ * interactive segment on the wire with and without compression.
+ *
+ * make test
+ */
+
+#include <picoos.h>
+#include <picoos-net.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../ppp_defs.h"
+#include "../ppp_frame.h"
+#include "../vjcomp.h"
+
+#define FRAME_MAX   1514
+#define WIRE_MAX    (2 * FRAME_MAX + 16)
+#define CONNS       (NETCFG_HDLC_VJ_SLOTS + 2)
+#define ROUNDS      20000
+
+#define TH_FIN      0x01
+#define TH_SYN      0x02
+#define TH_PUSH     0x08
+#define TH_ACK      0x10
+#define TH_URG      0x20
+
+static int failed;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      ++failed; \
+    } \
+  } while (0)
+
+static uint32_t randState = 1;
+
+static uint32_t nextRandom(void)
+{
+  uint32_t x = randState;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  randState = x;
+  return x;
+}
+
+/*
+ * State of one simulated TCP connection.
+ */
+typedef struct {
+
+  uint8_t  addr;
+  uint16_t port;
+  uint32_t seq;
+  uint32_t ack;
+  uint16_t win;
+  uint16_t ipid;
+  uint16_t urg;
+  uint8_t  flags;
+  uint8_t  opts;     // bytes of TCP options (NOPs)
+} Conn;
+
+static Conn conns[CONNS];
+
+static void put16(uint8_t* p, uint16_t v)
+{
+  p[0] = v >> 8;
+  p[1] = v;
+}
+
+static void put32(uint8_t* p, uint32_t v)
+{
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+static uint16_t chksum(const uint8_t* p, int len)
+{
+  uint32_t sum = 0;
+
+  for (; len > 1; p += 2, len -= 2)
+    sum += (p[0] << 8) | p[1];
+
+  while (sum >> 16)
+    sum = (sum & 0xffff) + (sum >> 16);
+
+  return ~sum;
+}
+
+/*
+ * Build ethernet frame carrying TCP segment of connection.
+ * IP checksum must be valid, as decompressor recalculates
+ * it. TCP checksum is just some value that is carried
+ * over the link.
+ */
+static int makeTcp(uint8_t* f, const Conn* c, int dataLen)
+{
+  uint8_t* ip = f + 14;
+  uint8_t* th = ip + 20;
+  int hlen = 20 + 20 + c->opts;
+  int i;
+
+  memset(f, 0, 14 + hlen);
+  memcpy(f, "\x02\x00\x00\x00\x00\x01\x02\x00\x00\x00\x00\x02\x08\x00", 14);
+
+  ip[0] = 0x45;
+  put16(ip + 2, hlen + dataLen);
+  put16(ip + 4, c->ipid);
+  ip[8] = 64;
+  ip[9] = UIP_PROTO_TCP;
+  memcpy(ip + 12, "\xc0\xa8\x01\x01", 4);
+  memcpy(ip + 16, "\xc0\xa8\x01\x02", 4);
+  ip[19] = c->addr;
+  put16(ip + 10, chksum(ip, 20));
+
+  put16(th, c->port);
+  put16(th + 2, 23);
+  put32(th + 4, c->seq);
+  put32(th + 8, c->ack);
+  th[12] = ((20 + c->opts) / 4) << 4;
+  th[13] = c->flags;
+  put16(th + 14, c->win);
+  put16(th + 16, 0x5a5a);
+  put16(th + 18, c->urg);
+  memset(th + 20, 1, c->opts);
+
+  for (i = 0; i < dataLen; i++)
+    f[14 + hlen + i] = 'a' + i % 26;
+
+  return 14 + hlen + dataLen;
+}
+
+static int makeUdp(uint8_t* f, int dataLen)
+{
+  uint8_t* ip = f + 14;
+
+  memset(f, 0, 14 + 28 + dataLen);
+  memcpy(f, "\x02\x00\x00\x00\x00\x01\x02\x00\x00\x00\x00\x02\x08\x00", 14);
+  ip[0] = 0x45;
+  put16(ip + 2, 28 + dataLen);
+  ip[8] = 64;
+  ip[9] = UIP_PROTO_UDP;
+  put16(ip + 10, chksum(ip, 20));
+  return 14 + 28 + dataLen;
+}
+
+/*
+ * Link between compressor and decompressor. Packets
+ * are PPP framed like in HDLC bridge drivers, so a
+ * corrupted frame is caught by FCS check.
+ */
+static VJContext txVJ;
+static VJContext rxVJ;
+static PPPContext outCtx;
+static PPPContext inCtx;
+static uint8_t wire[WIRE_MAX];
+static uint8_t inBuf[WIRE_MAX];
+static uint8_t rxFrame[FRAME_MAX];
+static int rxLen;
+static int rxBadCRC;
+static bool corruptNext;
+
+static int wireLen;     // Bytes on wire for last packet
+static int lastProto;   // PPP protocol of last packet
+static uint8_t lastChanges;
+
+static void inputHook(int proto, uint8_t* pkt, int len)
+{
+  rxLen = vjUncompress(&rxVJ, proto, pkt, len, rxFrame, sizeof(rxFrame));
+}
+
+static void linkReset(void)
+{
+  vjInit(&txVJ);
+  vjInit(&rxVJ);
+
+  outCtx.buf = wire;
+  outCtx.max = sizeof(wire);
+
+  inCtx.buf = inBuf;
+  inCtx.max = sizeof(inBuf);
+  inCtx.inputHook = inputHook;
+  pppInputBegin(&inCtx);
+  pppInputAppend(&inCtx, PPP_FLAG);
+  rxBadCRC = 0;
+}
+
+/*
+ * Send frame over link. Returns length of received frame,
+ * zero if it was dropped.
+ */
+static int linkSend(const uint8_t* frame, int len)
+{
+  uint8_t hdr[VJ_HDR_BUF];
+  int hdrLen;
+  int skip;
+
+  lastProto = vjCompress(&txVJ, frame, len, hdr, &hdrLen, &skip);
+  lastChanges = hdrLen > 0 ? hdr[0] : 0;
+
+  pppOutputBegin(&outCtx, lastProto);
+  pppOutputAppendBuf(&outCtx, hdr, hdrLen);
+  pppOutputAppendBuf(&outCtx, frame + skip, len - skip);
+  pppOutputEnd(&outCtx);
+
+  // Frames share flags, so count only one.
+  wireLen = outCtx.ptr - outCtx.buf - 1;
+
+  if (corruptNext) {
+
+    wire[wireLen / 2] ^= 0x01;
+    corruptNext = false;
+  }
+
+  rxLen = 0;
+  pppInputAppendBuf(&inCtx, wire + 1, wireLen);
+
+  // Like HDLC bridge drivers: frame lost because
+  // of bad FCS invalidates compression state.
+  if (inCtx.stat.badCRC != rxBadCRC) {
+
+    rxBadCRC = inCtx.stat.badCRC;
+    vjRxError(&rxVJ);
+  }
+
+  return rxLen;
+}
+
+static bool roundTrip(const uint8_t* frame, int len)
+{
+  return linkSend(frame, len) == len && !memcmp(rxFrame, frame, len);
+}
+
+/*
+ * Random mix of bulk data, acks, interactive traffic,
+ * retransmits, window and urgent pointer changes, option
+ * changes, SYN/FIN and non-TCP frames over more connections
+ * than there are slots. Every frame must be reproduced
+ * exactly.
+ */
+static void testMixed(void)
+{
+  static uint8_t frame[FRAME_MAX];
+  Conn* c;
+  int len;
+  int i;
+  int r;
+  int mismatch = 0;
+
+  linkReset();
+  for (i = 0; i < CONNS; i++) {
+
+    c = &conns[i];
+    memset(c, 0, sizeof(*c));
+    c->addr = 10 + i;
+    c->port = 1024 + i;
+    c->seq = nextRandom();
+    c->ack = nextRandom();
+    c->win = 1460;
+    c->ipid = nextRandom();
+    c->flags = TH_ACK;
+  }
+
+  for (i = 0; i < ROUNDS; i++) {
+
+    // Most traffic goes to few connections.
+    c = &conns[nextRandom() % 4 ? nextRandom() % 2 : nextRandom() % CONNS];
+    c->flags = TH_ACK;
+    c->urg = 0;
+    len = 0;
+
+    r = nextRandom() % 100;
+    if (r < 30) {
+
+      len = 1 + nextRandom() % 1400;
+      if (nextRandom() % 2)
+        c->flags |= TH_PUSH;
+    }
+    else if (r < 45)
+      c->ack += nextRandom() % 3000;
+    else if (r < 55) {
+
+      len = 1;
+      c->ack += 1;
+    }
+    else if (r < 60)
+      c->win = nextRandom();
+    else if (r < 63) {
+
+      len = 1;
+      c->flags |= TH_URG;
+      c->urg = nextRandom() % 4;
+    }
+    else if (r < 65)
+      c->seq += 70000;
+    else if (r < 67)
+      c->ipid += nextRandom();
+    else if (r < 69)
+      c->opts = c->opts ? 0 : 4;
+    else if (r < 71)
+      c->flags = nextRandom() % 2 ? TH_SYN : TH_FIN | TH_ACK;
+    else if (r < 73) {
+
+      len = makeUdp(frame, nextRandom() % 200);
+      mismatch += !roundTrip(frame, len);
+      continue;
+    }
+    // else retransmit or window probe, nothing changes
+
+    len = makeTcp(frame, c, len);
+    mismatch += !roundTrip(frame, len);
+
+    c->seq += len - 14 - 40 - c->opts;
+    ++c->ipid;
+  }
+
+  CHECK(mismatch == 0);
+  CHECK(txVJ.stat.compressed == rxVJ.stat.compressed);
+  CHECK(txVJ.stat.uncompressed == rxVJ.stat.uncompressed);
+  CHECK(txVJ.stat.compressed > ROUNDS / 2);
+  CHECK(rxVJ.stat.tossed == 0);
+  printf("mixed: %d frames, %d compressed, %d uncompressed\n",
+         ROUNDS, txVJ.stat.compressed, txVJ.stat.uncompressed);
+}
+
+/*
+ * Echoed interactive traffic uses SPECIAL_I, one-way data
+ * SPECIAL_D. Real changes that look like special cases must
+ * be sent uncompressed. Measure size of 1-byte segment.
+ */
+static void testSpecials(void)
+{
+  static uint8_t frame[FRAME_MAX];
+  Conn* c = &conns[0];
+  int len;
+  int plain;
+
+  linkReset();
+  memset(c, 0, sizeof(*c));
+  c->addr = 1;
+  c->port = 2000;
+  c->seq = 1000;
+  c->ack = 5000;
+  c->win = 1024;
+  c->ipid = 100;
+  c->flags = TH_ACK | TH_PUSH;
+
+  // First packet sets up slot.
+  len = makeTcp(frame, c, 1);
+  CHECK(roundTrip(frame, len));
+  CHECK(lastProto == PPP_VJC_UNCOMP);
+  plain = wireLen;
+
+  // Echo: both seq and ack advance by one byte.
+  c->seq += 1;
+  c->ack += 1;
+  ++c->ipid;
+  len = makeTcp(frame, c, 1);
+  CHECK(roundTrip(frame, len));
+  CHECK(lastProto == PPP_VJC_COMP);
+  CHECK((lastChanges & 0x0f) == (0x08 | 0x02 | 0x01));
+
+  printf("interactive: 1-byte segment %d bytes on wire, %d compressed\n", plain, wireLen);
+  CHECK(plain == 59);
+  CHECK(wireLen == 8);
+
+  // Unidirectional data: only seq advances by previous length.
+  c->seq += 1;
+  ++c->ipid;
+  len = makeTcp(frame, c, 512);
+  CHECK(roundTrip(frame, len));
+  CHECK(lastProto == PPP_VJC_COMP);
+  CHECK((lastChanges & 0x0f) == (0x08 | 0x04 | 0x02 | 0x01));
+
+  c->seq += 512;
+  ++c->ipid;
+  len = makeTcp(frame, c, 512);
+  CHECK(roundTrip(frame, len));
+  CHECK((lastChanges & 0x0f) == (0x08 | 0x04 | 0x02 | 0x01));
+
+  // Seq, window and urgent change: same bits as SPECIAL_I,
+  // must go uncompressed.
+  c->seq += 512;
+  c->win += 100;
+  c->urg = 1;
+  c->flags |= TH_URG;
+  ++c->ipid;
+  len = makeTcp(frame, c, 1);
+  CHECK(roundTrip(frame, len));
+  CHECK(lastProto == PPP_VJC_UNCOMP);
+
+  // Seq, ack, window and urgent change: same bits
+  // as SPECIAL_D, must go uncompressed.
+  c->seq += 1;
+  c->ack += 300;
+  c->win += 100;
+  ++c->ipid;
+  len = makeTcp(frame, c, 1);
+  CHECK(roundTrip(frame, len));
+  CHECK(lastProto == PPP_VJC_UNCOMP);
+}
+
+/*
+ * After frame is lost because of bad FCS, compressed
+ * packets without connection number are tossed until
+ * an uncompressed one (here retransmit) arrives.
+ */
+static void testToss(void)
+{
+  static uint8_t frame[FRAME_MAX];
+  Conn* c = &conns[0];
+  int len;
+  int i;
+
+  linkReset();
+  memset(c, 0, sizeof(*c));
+  c->addr = 1;
+  c->port = 3000;
+  c->seq = 1;
+  c->ack = 1;
+  c->win = 1024;
+  c->flags = TH_ACK;
+
+  for (i = 0; i < 3; i++) {
+
+    len = makeTcp(frame, c, 100);
+    CHECK(roundTrip(frame, len));
+    c->seq += 100;
+    ++c->ipid;
+  }
+
+  corruptNext = true;
+  len = makeTcp(frame, c, 100);
+  CHECK(linkSend(frame, len) == 0);
+  CHECK(lastProto == PPP_VJC_COMP);
+  CHECK(inCtx.stat.badCRC == 1);
+
+  for (i = 0; i < 2; i++) {
+
+    c->seq += 100;
+    ++c->ipid;
+    len = makeTcp(frame, c, 100);
+    CHECK(linkSend(frame, len) == 0);
+    CHECK(lastProto == PPP_VJC_COMP);
+  }
+
+  CHECK(rxVJ.stat.tossed == 2);
+
+  // Retransmit of last segment goes uncompressed
+  // and resynchronizes decompressor.
+  ++c->ipid;
+  len = makeTcp(frame, c, 100);
+  CHECK(roundTrip(frame, len));
+  CHECK(lastProto == PPP_VJC_UNCOMP);
+
+  c->seq += 100;
+  ++c->ipid;
+  len = makeTcp(frame, c, 100);
+  CHECK(roundTrip(frame, len));
+  CHECK(lastProto == PPP_VJC_COMP);
+}
+
+int main(int argc, char** argv)
+{
+  testMixed();
+  testSpecials();
+  testToss();
+
+  if (failed) {
+
+    printf("%d checks failed\n", failed);
+    return 1;
+  }
+
+  printf("ok\n");
+  return 0;
+}
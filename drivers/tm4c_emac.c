@@ -67,33 +67,10 @@
 #include "driverlib/sysctl.h"
 
 #include "tm4c_emac.h"
+#include "tm4c_emac_ring.h"
 
 static void initDescriptors(void);
 
-/*
- * Ethernet DMA descriptors. Although uIP uses a single buffer,
- * the MAC hardware needs a minimum of 3 receive descriptors to operate.
- */
-
-#define NUM_TX_DESCRIPTORS 3
-#define NUM_RX_DESCRIPTORS 3
-
-tEMACDMADescriptor rxDescriptor[NUM_TX_DESCRIPTORS];
-tEMACDMADescriptor txDescriptor[NUM_RX_DESCRIPTORS];
-
-uint32_t rxDescIndex;
-uint32_t txDescIndex;
-
-/*
- * Transmit and receive buffers.
- */
-
-#define RX_BUFFER_SIZE 1536
-#define TX_BUFFER_SIZE 1536
-uint8_t rxBuffer[RX_BUFFER_SIZE];
-uint8_t txBuffer[TX_BUFFER_SIZE];
-
-
 void tivaEmacInit()
 {
   struct uip_eth_addr ethAddr;
@@ -218,70 +195,22 @@ void tivaEmacInit()
 
 
   /*
-   * Enable the Ethernet RX Packet interrupt source.
-   */
-  EMACIntEnable(EMAC0_BASE, EMAC_INT_RECEIVE);
-
-  /*
-   * Mark the first receive descriptor as available to the DMA to start
-   * the receive processing.
+   * Enable the Ethernet RX Packet and TX interrupt sources.
+   * Transmit interrupt reclaims sent descriptors.
    */
-  rxDescriptor[rxDescIndex].ui32CtrlStatus |= DES0_RX_CTRL_OWN;
+  EMACIntEnable(EMAC0_BASE, EMAC_INT_RECEIVE | EMAC_INT_TRANSMIT);
 }
 
 /*
- * Initialize the transmit and receive DMA descriptors.  We apparently need
- * a minimum of 3 descriptors in each chain.  This is overkill since uIP uses
- * a single, common transmit and receive buffer so we tag each descriptor
- * with the same buffer and will make sure we only hand the DMA one descriptor
- * at a time.
-*/
+ * Initialize the transmit and receive DMA descriptor rings
+ * and give them to hardware.
+ */
 static void initDescriptors()
 {
-  uint32_t loop;
+  emacRingInit();
 
-  /*
-   * Initialize each of the transmit descriptors.  Note that we leave the OWN
-   * bit clear here since we have not set up any transmissions yet.
-   */
-  for (loop = 0; loop < NUM_TX_DESCRIPTORS; loop++) {
-
-    txDescriptor[loop].ui32Count = (DES1_TX_CTRL_SADDR_INSERT | (TX_BUFFER_SIZE << DES1_TX_CTRL_BUFF1_SIZE_S));
-    txDescriptor[loop].pvBuffer1 = txBuffer;
-    txDescriptor[loop].DES3.pLink =
-        (loop == (NUM_TX_DESCRIPTORS - 1)) ? txDescriptor : &txDescriptor[loop + 1];
-    txDescriptor[loop].ui32CtrlStatus = (DES0_TX_CTRL_LAST_SEG | DES0_TX_CTRL_FIRST_SEG | DES0_TX_CTRL_INTERRUPT
-        | DES0_TX_CTRL_CHAINED | DES0_TX_CTRL_IP_ALL_CKHSUMS);
-  }
-
-  /*
-   * Initialize each of the receive descriptors.  We clear the OWN bit here
-   * to make sure that the receiver doesn't start writing anything
-   * immediately.
-   */
-  for (loop = 0; loop < NUM_RX_DESCRIPTORS; loop++) {
-
-    rxDescriptor[loop].ui32CtrlStatus = 0;
-    rxDescriptor[loop].ui32Count = (DES1_RX_CTRL_CHAINED | (RX_BUFFER_SIZE << DES1_RX_CTRL_BUFF1_SIZE_S));
-    rxDescriptor[loop].pvBuffer1 = rxBuffer;
-    rxDescriptor[loop].DES3.pLink =
-        (loop == (NUM_RX_DESCRIPTORS - 1)) ? rxDescriptor : &rxDescriptor[loop + 1];
-  }
-
-  /*
-   * Set the descriptor pointers in the hardware.
-   */
-  EMACRxDMADescriptorListSet(EMAC0_BASE, rxDescriptor);
-  EMACTxDMADescriptorListSet(EMAC0_BASE, txDescriptor);
-
-  /*
-   * Start from the beginning of both descriptor chains.  We actually set
-   * the transmit descriptor index to the last descriptor in the chain
-   * since it will be incremented before use and this means the first
-   * transmission we perform will use the correct descriptor.
-   */
-  rxDescIndex = 0;
-  txDescIndex = NUM_TX_DESCRIPTORS - 1;
+  EMACRxDMADescriptorListSet(EMAC0_BASE, emacRxDesc);
+  EMACTxDMADescriptorListSet(EMAC0_BASE, emacTxDesc);
 }
 
 /*
@@ -307,76 +236,29 @@ void ENET_Handler(void)
     netInterrupt();
   }
 
+  /*
+   * Check for transmit completion.
+   */
+  if (status & EMAC_INT_TRANSMIT)
+    emacRingTxReclaim();
+
   c_pos_intExitQuick();
 }
 
 /*
- * Read a packet from the DMA receive buffer into the uIP packet buffer.
+ * Read a packet from the DMA receive ring into the uIP packet buffer.
  */
 int32_t tivaEmacPoll(uint8_t *buf, int32_t bufSize)
 {
   int32_t frameLen;
 
-  /*
-   * By default, we assume we got a bad frame.
-   */
-  frameLen = 0;
+  frameLen = emacRingRecv(buf, bufSize);
 
   /*
-   * Make sure that we own the receive descriptor.
+   * In case DMA had run out of receive descriptors,
+   * make it check again.
    */
-  if (!(rxDescriptor[rxDescIndex].ui32CtrlStatus & DES0_RX_CTRL_OWN)) {
-
-    /*
-     * We own the receive descriptor so check to see if it contains a valid
-     * frame.  Look for a descriptor error, indicating that the incoming
-     * packet was truncated or, if this is the last frame in a packet,
-     * the receive error bit.
-     */
-    if (!(rxDescriptor[rxDescIndex].ui32CtrlStatus & DES0_RX_STAT_ERR)) {
-
-      /*
-       * We have a valid frame so copy the content to the supplied
-       * buffer. First check that the "last descriptor" flag is set.  We
-       * sized the receive buffer such that it can always hold a valid
-       * frame so this flag should never be clear at this point but...
-       */
-      if (rxDescriptor[rxDescIndex].ui32CtrlStatus & DES0_RX_STAT_LAST_DESC) {
-
-        frameLen = ((rxDescriptor[rxDescIndex].ui32CtrlStatus & DES0_RX_STAT_FRAME_LENGTH_M)
-            >> DES0_RX_STAT_FRAME_LENGTH_S);
-
-        /*
-         * Sanity check.  This shouldn't be required since we sized the
-         * uIP buffer such that it's the same size as the DMA receive
-         * buffer but, just in case...
-         */
-
-        if (frameLen > bufSize)
-          frameLen = bufSize;
-
-        /*
-         * Copy the data from the DMA receive buffer into the provided
-         * frame buffer.
-         */
-        memcpy(buf, rxBuffer, frameLen);
-      }
-    }
-
-    /*
-     * Move on to the next descriptor in the chain.
-     */
-    rxDescIndex++;
-    if (rxDescIndex == NUM_RX_DESCRIPTORS)
-      rxDescIndex = 0;
-
-    /*
-     * Mark the next descriptor in the ring as available for the receiver
-     * to write into.
-     */
-    rxDescriptor[rxDescIndex].ui32CtrlStatus = DES0_RX_CTRL_OWN;
-  }
-
+  EMACRxDMAPollDemand(EMAC0_BASE);
   return frameLen;
 }
 
@@ -384,44 +266,28 @@ int32_t tivaEmacPoll(uint8_t *buf, int32_t bufSize)
  * Transmit a packet from the supplied buffer.
  */
 void tivaEmacSend(uint8_t *buf, int32_t len)
+{
+  tivaEmacSendv(buf, len, NULL, 0);
+}
+
+/*
+ * Transmit a packet that consists of header and
+ * payload in separate buffers. Both are copied directly
+ * into DMA transmit buffer.
+ */
+void tivaEmacSendv(const uint8_t *hdr, int32_t hdrLen, const uint8_t *data, int32_t dataLen)
 {
   /*
-   * Wait for the previous packet to be transmitted.
+   * Wait only if all descriptors are in use, transmit
+   * interrupt frees them.
    */
-  while (txDescriptor[txDescIndex].ui32CtrlStatus & DES0_TX_CTRL_OWN) {
+  while (!emacRingSendv(hdr, hdrLen, data, dataLen)) {
 
     /*
      * Spin and waste time.
      */
   }
 
-  /*
-   * Check that we're not going to overflow the transmit buffer.  This
-   * shouldn't be necessary since the uIP buffer is smaller than our DMA
-   * transmit buffer but, just in case...
-   */
-  if (len > TX_BUFFER_SIZE)
-    len = TX_BUFFER_SIZE;
-
-  /*
-   * Copy the packet data into the transmit buffer.
-   */
-  memcpy(txBuffer, buf, len);
-
-  /*
-   * Move to the next descriptor.
-   */
-  txDescIndex++;
-  if (txDescIndex == NUM_TX_DESCRIPTORS)
-    txDescIndex = 0;
-
-  /*
-   * Fill in the packet size and tell the transmitter to start work.
-   */
-  txDescriptor[txDescIndex].ui32Count = (uint32_t) len;
-  txDescriptor[txDescIndex].ui32CtrlStatus = (DES0_TX_CTRL_LAST_SEG | DES0_TX_CTRL_FIRST_SEG
-      | DES0_TX_CTRL_INTERRUPT | DES0_TX_CTRL_CHAINED | DES0_TX_CTRL_OWN);
-
   /*
    * Tell the DMA to reacquire the descriptor now that we've filled it in.
    */
@@ -29,5 +29,6 @@
  */
 
 void tivaEmacSend(uint8_t *pui8Buf, int32_t i32BufLen);
+void tivaEmacSendv(const uint8_t *hdr, int32_t hdrLen, const uint8_t *data, int32_t dataLen);
 int32_t tivaEmacPoll(uint8_t* buf, int32_t bufsize);
 void tivaEmacInit(void);
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Descriptor ring management for TM4C129 ethernet DMA.
+ * Each descriptor has its own buffer. All receive descriptors
+ * are given to DMA, so frames arriving in bursts are buffered
+ * until network task drains them. Transmit descriptors are
+ * filled by network task and reclaimed by ethernet interrupt
+ * handler when DMA has sent them, so sending doesn't need
+ * to wait for previous frame.
+ */
+
+#include <picoos.h>
+#include <picoos-net.h>
+#include <string.h>
+
+#if NETCFG_DRIVER_TM4C1294 > 0 || NETCFG_TM4C_EMAC_SIM == 1
+
+#include "tm4c_emac_ring.h"
+
+#if (NETCFG_TM4C_RX_DESCRIPTORS & (NETCFG_TM4C_RX_DESCRIPTORS - 1)) != 0 || \
+    (NETCFG_TM4C_TX_DESCRIPTORS & (NETCFG_TM4C_TX_DESCRIPTORS - 1)) != 0
+#error Number of EMAC descriptors must be power of two.
+#endif
+
+#define RX_MASK (NETCFG_TM4C_RX_DESCRIPTORS - 1)
+#define TX_MASK (NETCFG_TM4C_TX_DESCRIPTORS - 1)
+
+tEMACDMADescriptor emacRxDesc[NETCFG_TM4C_RX_DESCRIPTORS];
+tEMACDMADescriptor emacTxDesc[NETCFG_TM4C_TX_DESCRIPTORS];
+
+static uint8_t rxBuffers[NETCFG_TM4C_RX_DESCRIPTORS][EMAC_BUFFER_SIZE];
+static uint8_t txBuffers[NETCFG_TM4C_TX_DESCRIPTORS][EMAC_BUFFER_SIZE];
+
+static uint32_t rxIndex;
+
+/*
+ * Free-running transmit counters. Head is advanced only
+ * by sender and tail only by interrupt handler.
+ */
+static volatile uint32_t txHead;
+static volatile uint32_t txTail;
+
+static EmacRingStats stats;
+
+void emacRingInit()
+{
+  uint32_t loop;
+
+  /*
+   * Transmit descriptors are not owned by DMA
+   * until there is something to send.
+   */
+  for (loop = 0; loop < NETCFG_TM4C_TX_DESCRIPTORS; loop++) {
+
+    emacTxDesc[loop].ui32Count = (DES1_TX_CTRL_SADDR_INSERT | (EMAC_BUFFER_SIZE << DES1_TX_CTRL_BUFF1_SIZE_S));
+    emacTxDesc[loop].pvBuffer1 = txBuffers[loop];
+    emacTxDesc[loop].DES3.pLink = &emacTxDesc[(loop + 1) & TX_MASK];
+    emacTxDesc[loop].ui32CtrlStatus = (DES0_TX_CTRL_LAST_SEG | DES0_TX_CTRL_FIRST_SEG | DES0_TX_CTRL_INTERRUPT
+        | DES0_TX_CTRL_CHAINED | DES0_TX_CTRL_IP_ALL_CKHSUMS);
+  }
+
+  /*
+   * All receive descriptors are given to DMA. It doesn't
+   * start writing into them before receiver is enabled.
+   */
+  for (loop = 0; loop < NETCFG_TM4C_RX_DESCRIPTORS; loop++) {
+
+    emacRxDesc[loop].ui32Count = (DES1_RX_CTRL_CHAINED | (EMAC_BUFFER_SIZE << DES1_RX_CTRL_BUFF1_SIZE_S));
+    emacRxDesc[loop].pvBuffer1 = rxBuffers[loop];
+    emacRxDesc[loop].DES3.pLink = &emacRxDesc[(loop + 1) & RX_MASK];
+    emacRxDesc[loop].ui32CtrlStatus = DES0_RX_CTRL_OWN;
+  }
+
+  rxIndex = 0;
+  txHead = 0;
+  txTail = 0;
+  memset(&stats, '\0', sizeof(stats));
+}
+
+/*
+ * Copy next good frame from receive ring into buffer.
+ * Descriptors are given back to DMA as soon as they have been
+ * processed. Returns 0 if there are no more frames.
+ */
+int32_t emacRingRecv(uint8_t* buf, int32_t bufSize)
+{
+  tEMACDMADescriptor* desc;
+  uint32_t status;
+  int32_t frameLen;
+
+  while (true) {
+
+    desc = &emacRxDesc[rxIndex];
+    status = desc->ui32CtrlStatus;
+    if (status & DES0_RX_CTRL_OWN)
+      return 0;
+
+    /*
+     * Buffer is sized to hold a complete frame, so
+     * "last descriptor" should always be set.
+     */
+    frameLen = 0;
+    if ((status & DES0_RX_STAT_ERR) || !(status & DES0_RX_STAT_LAST_DESC))
+      ++stats.rxErrors;
+    else {
+
+      frameLen = (status & DES0_RX_STAT_FRAME_LENGTH_M) >> DES0_RX_STAT_FRAME_LENGTH_S;
+      if (frameLen > bufSize)
+        frameLen = bufSize;
+
+      memcpy(buf, desc->pvBuffer1, frameLen);
+      ++stats.rxFrames;
+    }
+
+    desc->ui32CtrlStatus = DES0_RX_CTRL_OWN;
+    rxIndex = (rxIndex + 1) & RX_MASK;
+
+    if (frameLen > 0)
+      return frameLen;
+  }
+}
+
+/*
+ * Copy frame into next free transmit descriptor and
+ * give it to DMA. Returns false if all descriptors are in use.
+ */
+bool emacRingSendv(const uint8_t* hdr, int32_t hdrLen, const uint8_t* data, int32_t dataLen)
+{
+  tEMACDMADescriptor* desc;
+  int32_t len = hdrLen + dataLen;
+
+  if (txHead - txTail >= NETCFG_TM4C_TX_DESCRIPTORS) {
+
+    ++stats.txRingFull;
+    return false;
+  }
+
+  desc = &emacTxDesc[txHead & TX_MASK];
+
+  /*
+   * uIP buffer is smaller than DMA buffer,
+   * but just in case...
+   */
+  if (len > EMAC_BUFFER_SIZE) {
+
+    len = EMAC_BUFFER_SIZE;
+    if (hdrLen > len)
+      hdrLen = len;
+
+    dataLen = len - hdrLen;
+  }
+
+  memcpy(desc->pvBuffer1, hdr, hdrLen);
+  if (dataLen > 0)
+    memcpy((uint8_t*)desc->pvBuffer1 + hdrLen, data, dataLen);
+
+  desc->ui32Count = (uint32_t) len;
+  desc->ui32CtrlStatus = (DES0_TX_CTRL_LAST_SEG | DES0_TX_CTRL_FIRST_SEG
+      | DES0_TX_CTRL_INTERRUPT | DES0_TX_CTRL_CHAINED | DES0_TX_CTRL_OWN);
+
+  ++txHead;
+  return true;
+}
+
+/*
+ * Reclaim transmit descriptors that DMA has finished with.
+ * Called from interrupt handler. Returns number
+ * of descriptors reclaimed.
+ */
+int emacRingTxReclaim()
+{
+  tEMACDMADescriptor* desc;
+  int count = 0;
+
+  while (txTail != txHead) {
+
+    desc = &emacTxDesc[txTail & TX_MASK];
+    if (desc->ui32CtrlStatus & DES0_TX_CTRL_OWN)
+      break;
+
+    if (desc->ui32CtrlStatus & DES0_TX_STAT_ERR)
+      ++stats.txErrors;
+    else
+      ++stats.txFrames;
+
+    ++txTail;
+    ++count;
+  }
+
+  return count;
+}
+
+void emacRingGetStats(EmacRingStats* st)
+{
+  *st = stats;
+}
+
+#endif
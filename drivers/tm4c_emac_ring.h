@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Descriptor ring management for TM4C129 ethernet DMA.
+ * This doesn't touch any hardware registers, so it can be
+ * used with simulated DMA engine on host (NETCFG_TM4C_EMAC_SIM).
+ */
+
+#if NETCFG_TM4C_EMAC_SIM == 1
+#include "tm4c_emac_sim.h"
+#else
+#include "driverlib/emac.h"
+#endif
+
+/*
+ * Number of descriptors (and buffers) in rings.
+ * Must be powers of two.
+ */
+#ifndef NETCFG_TM4C_RX_DESCRIPTORS
+#define NETCFG_TM4C_RX_DESCRIPTORS 8
+#endif
+
+#ifndef NETCFG_TM4C_TX_DESCRIPTORS
+#define NETCFG_TM4C_TX_DESCRIPTORS 4
+#endif
+
+#define EMAC_BUFFER_SIZE 1536
+
+typedef struct {
+
+  uint32_t rxFrames;
+  uint32_t rxErrors;
+  uint32_t txFrames;
+  uint32_t txErrors;
+  uint32_t txRingFull;   // send found all descriptors in use
+} EmacRingStats;
+
+extern tEMACDMADescriptor emacRxDesc[NETCFG_TM4C_RX_DESCRIPTORS];
+extern tEMACDMADescriptor emacTxDesc[NETCFG_TM4C_TX_DESCRIPTORS];
+
+void emacRingInit(void);
+int32_t emacRingRecv(uint8_t* buf, int32_t bufSize);
+bool emacRingSendv(const uint8_t* hdr, int32_t hdrLen, const uint8_t* data, int32_t dataLen);
+int emacRingTxReclaim(void);
+void emacRingGetStats(EmacRingStats* st);
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Simulated TM4C129 ethernet DMA engine for host builds.
+ * It walks the same descriptor chains as hardware does, so
+ * descriptor ring code can be tested and benchmarked on host.
+ */
+
+#include <picoos.h>
+#include <picoos-net.h>
+#include <string.h>
+
+#if NETCFG_TM4C_EMAC_SIM == 1
+
+#include "tm4c_emac_ring.h"
+
+static tEMACDMADescriptor* rxDma;
+static tEMACDMADescriptor* txDma;
+static EmacSimOutput output;
+static EmacSimStats stats;
+
+void emacSimStart()
+{
+  rxDma = emacRxDesc;
+  txDma = emacTxDesc;
+  memset(&stats, '\0', sizeof(stats));
+}
+
+int emacSimReceive(const uint8_t* frame, int len)
+{
+  int size;
+
+  if (!(rxDma->ui32CtrlStatus & DES0_RX_CTRL_OWN)) {
+
+    ++stats.rxOverflows;
+    return 0;
+  }
+
+  size = (rxDma->ui32Count & DES1_RX_CTRL_BUFF1_SIZE_M) >> DES1_RX_CTRL_BUFF1_SIZE_S;
+  if (len > size)
+    len = size;
+
+  memcpy(rxDma->pvBuffer1, frame, len);
+  rxDma->ui32CtrlStatus = DES0_RX_STAT_FIRST_DESC | DES0_RX_STAT_LAST_DESC |
+                          (len << DES0_RX_STAT_FRAME_LENGTH_S);
+
+  rxDma = rxDma->DES3.pLink;
+  ++stats.rxFrames;
+  return len;
+}
+
+int emacSimTransmit(int max)
+{
+  int count = 0;
+
+  while (count < max && (txDma->ui32CtrlStatus & DES0_TX_CTRL_OWN)) {
+
+    if (output != NULL)
+      output(txDma->pvBuffer1, (txDma->ui32Count & DES1_TX_CTRL_BUFF1_SIZE_M) >> DES1_TX_CTRL_BUFF1_SIZE_S);
+
+    txDma->ui32CtrlStatus &= ~DES0_TX_CTRL_OWN;
+    txDma = txDma->DES3.pLink;
+    ++stats.txFrames;
+    ++count;
+  }
+
+  // Transmit interrupt.
+  if (count > 0)
+    emacRingTxReclaim();
+
+  return count;
+}
+
+void emacSimSetOutput(EmacSimOutput out)
+{
+  output = out;
+}
+
+void emacSimGetStats(EmacSimStats* st)
+{
+  *st = stats;
+}
+
+#endif
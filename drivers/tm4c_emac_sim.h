@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Host replacement for TivaWare DMA descriptor definitions,
+ * used with simulated DMA engine. Bit values are the same
+ * as in driverlib/emac.h.
+ */
+
+typedef struct tEMACDMADescriptor {
+
+  volatile uint32_t ui32CtrlStatus;
+  volatile uint32_t ui32Count;
+  void *pvBuffer1;
+  union {
+
+    void *pvBuffer2;
+    struct tEMACDMADescriptor *pLink;
+  } DES3;
+} tEMACDMADescriptor;
+
+#define DES0_TX_CTRL_OWN               0x80000000
+#define DES0_TX_CTRL_INTERRUPT         0x40000000
+#define DES0_TX_CTRL_LAST_SEG          0x20000000
+#define DES0_TX_CTRL_FIRST_SEG         0x10000000
+#define DES0_TX_CTRL_IP_ALL_CKHSUMS    0x00C00000
+#define DES0_TX_CTRL_CHAINED           0x00100000
+#define DES0_TX_STAT_ERR               0x00008000
+
+#define DES1_TX_CTRL_SADDR_INSERT      0x20000000
+#define DES1_TX_CTRL_BUFF1_SIZE_M      0x00001FFF
+#define DES1_TX_CTRL_BUFF1_SIZE_S      0
+
+#define DES0_RX_CTRL_OWN               0x80000000
+#define DES0_RX_STAT_FRAME_LENGTH_M    0x3FFF0000
+#define DES0_RX_STAT_FRAME_LENGTH_S    16
+#define DES0_RX_STAT_ERR               0x00008000
+#define DES0_RX_STAT_FIRST_DESC        0x00000200
+#define DES0_RX_STAT_LAST_DESC         0x00000100
+
+#define DES1_RX_CTRL_CHAINED           0x00004000
+#define DES1_RX_CTRL_BUFF1_SIZE_M      0x00001FFF
+#define DES1_RX_CTRL_BUFF1_SIZE_S      0
+
+typedef struct {
+
+  uint32_t rxFrames;
+  uint32_t rxOverflows;   // no free receive descriptor
+  uint32_t txFrames;
+} EmacSimStats;
+
+typedef void (*EmacSimOutput)(const uint8_t* frame, int len);
+
+/**
+ * Start simulated DMA at beginning of descriptor rings,
+ * like EMACRxDMADescriptorListSet and EMACTxDMADescriptorListSet do.
+ */
+void emacSimStart(void);
+
+/**
+ * Let DMA receive a frame into next descriptor. Returns
+ * frame length or 0 if there was no free descriptor.
+ */
+int emacSimReceive(const uint8_t* frame, int len);
+
+/**
+ * Let DMA send at most max frames from transmit ring
+ * and run transmit interrupt if something was sent.
+ * Returns number of frames sent.
+ */
+int emacSimTransmit(int max);
+
+void emacSimSetOutput(EmacSimOutput out);
+void emacSimGetStats(EmacSimStats* st);
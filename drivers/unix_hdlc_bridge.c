@@ -0,0 +1,373 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * HDLC bridge driver for Unix hosts. Ethernet frames are
+ * carried in PPP/HDLC-like framing (same as STM32 HDLC bridge)
+ * over a serial port or pseudo terminal, for example one end of
+ * a pty pair created with
+ *
+ *   socat pty,raw,echo=0,link=/tmp/hdlc0 pty,raw,echo=0,link=/tmp/hdlc1
+ *
+ * Received data is decoded in SIGIO context into two
+ * frame buffers, so next frame can be received while stack
+ * is still processing previous one. If both buffers are full,
+ * decoding pauses and rest of data is left in input buffers
+ * until poll function frees a buffer. Transmitted frames are
+ * encoded into a buffer and written with one system call.
+ * With NETCFG_HDLC_VJCOMP TCP/IP headers are compressed
+ * (see vjcomp.c), decompression is done in poll function.
+ */
+
+#ifdef _XOPEN_SOURCE
+#undef _XOPEN_SOURCE // This driver needs BSD stuff.
+#endif
+
+#include <picoos.h>
+#include <picoos-net.h>
+
+#if NETCFG_DRIVER_UNIX_HDLC_BRIDGE > 0
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <sys/select.h>
+#include <signal.h>
+#include <errno.h>
+
+#include "ppp_defs.h"
+#include "ppp_frame.h"
+#include "unix_hdlc_bridge.h"
+#if NETCFG_HDLC_VJCOMP == 1
+#include "vjcomp.h"
+#endif
+
+#ifndef NETCFG_UNIX_HDLC_DEVICE
+#define NETCFG_UNIX_HDLC_DEVICE "/tmp/hdlc0"
+#endif
+
+#ifndef NETCFG_UNIX_HDLC_SPEED
+#define NETCFG_UNIX_HDLC_SPEED B115200
+#endif
+
+// Room for address, control, protocol and FCS.
+#define RX_FRAME_SIZE (UIP_BUFSIZE + 6)
+#define TX_FRAME_SIZE (2 * (UIP_BUFSIZE + 6) + 2)
+
+static void ioReadyContext(void);
+static void ioReady(int sig, siginfo_t *info, void *ucontext);
+static void packetInReady(int proto, uint8_t* data, int len);
+
+static int fd;
+static ucontext_t sigContext;
+
+#if PORTCFG_IRQ_STACK_SIZE >= PORTCFG_MIN_STACK_SIZE
+static char sigStack[PORTCFG_IRQ_STACK_SIZE];
+#else
+static char sigStack[PORTCFG_MIN_STACK_SIZE];
+#endif
+
+static PPPContext inCtx;
+static PPPContext outCtx;
+
+static uint8_t rxFrame[2][RX_FRAME_SIZE];
+static uint8_t* volatile rxReadyPtr[2];
+static volatile int rxReadyLen[2];
+static volatile int rxReadyProto[2];
+static int rxDecode;   // buffer being decoded into
+static int rxNext;     // oldest buffer with complete frame
+
+static uint8_t rxRaw[256];
+static int rxRawPos;
+static int rxRawLen;
+
+static uint8_t txFrame[TX_FRAME_SIZE];
+static UnixHdlcStats stats;
+
+#if NETCFG_HDLC_VJCOMP == 1
+static VJContext vj;
+static int rxBadCRC;
+#endif
+
+/*
+ * Decode received data until input is exhausted or
+ * both frame buffers are full. Input is fed to decoder
+ * up to next flag at a time, so at most one frame
+ * is completed by each call to decoder.
+ */
+static void rxProcess(void)
+{
+  const uint8_t* flag;
+  int seg;
+
+  while (rxReadyLen[rxDecode] == 0) {
+
+    if (rxRawLen == 0) {
+
+      rxRawLen = read(fd, rxRaw, sizeof(rxRaw));
+      if (rxRawLen <= 0) {
+
+        rxRawLen = 0;
+        return;
+      }
+
+      rxRawPos = 0;
+    }
+
+    flag = memchr(rxRaw + rxRawPos, PPP_FLAG, rxRawLen);
+    seg = flag != NULL ? flag - (rxRaw + rxRawPos) + 1 : rxRawLen;
+
+    pppInputAppendBuf(&inCtx, rxRaw + rxRawPos, seg);
+    rxRawPos += seg;
+    rxRawLen -= seg;
+  }
+
+  ++stats.rxStalls;
+}
+
+static void packetInReady(int proto, uint8_t* data, int len)
+{
+  if (proto != PPP_ETHERNET
+#if NETCFG_HDLC_VJCOMP == 1
+      && proto != PPP_VJC_COMP && proto != PPP_VJC_UNCOMP
+#endif
+     )
+    return;
+
+  rxReadyPtr[rxDecode] = data;
+  rxReadyLen[rxDecode] = len;
+  rxReadyProto[rxDecode] = proto;
+  ++stats.rxFrames;
+
+  // Continue with other buffer. Decoder resets
+  // its pointer to buffer start after this.
+  rxDecode ^= 1;
+  inCtx.buf = rxFrame[rxDecode];
+}
+
+static void ioReadyContext()
+{
+  c_pos_intEnter();
+  rxProcess();
+  if (rxReadyLen[rxNext] > 0)
+    netInterrupt();
+
+  c_pos_intExit();
+  setcontext(&posCurrentTask_g->ucontext);
+  assert(0);
+}
+
+static void ioReady(int sig, siginfo_t *info, void *ucontext)
+{
+  getcontext(&sigContext);
+  sigContext.uc_stack.ss_sp = sigStack;
+  sigContext.uc_stack.ss_size = sizeof(sigStack);
+  sigContext.uc_stack.ss_flags = 0;
+  sigContext.uc_link = 0;
+  sigfillset(&sigContext.uc_sigmask);
+
+  makecontext(&sigContext, ioReadyContext, 0);
+  swapcontext(&posCurrentTask_g->ucontext, &sigContext);
+}
+
+void unixHdlcInit()
+{
+  struct sigaction sig;
+  struct termios tio;
+  int flags;
+
+  fd = open(NETCFG_UNIX_HDLC_DEVICE, O_RDWR | O_NOCTTY);
+  P_ASSERT("hdlc open", fd != -1);
+
+  // Raw mode. Speed doesn't matter for pseudo terminals.
+  if (tcgetattr(fd, &tio) == 0) {
+
+    cfmakeraw(&tio);
+    cfsetspeed(&tio, NETCFG_UNIX_HDLC_SPEED);
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+
+  memset(&stats, '\0', sizeof(stats));
+  rxDecode = 0;
+  rxNext = 0;
+  rxReadyLen[0] = rxReadyLen[1] = 0;
+  rxRawLen = 0;
+
+#if NETCFG_HDLC_VJCOMP == 1
+  vjInit(&vj);
+  rxBadCRC = 0;
+#endif
+
+  inCtx.buf = rxFrame[0];
+  inCtx.max = RX_FRAME_SIZE;
+  inCtx.inputHook = packetInReady;
+  pppInputBegin(&inCtx);
+
+  memset(&sig, '\0', sizeof(sig));
+  
+  sig.sa_sigaction = ioReady;
+  sig.sa_flags     = SA_RESTART | SA_SIGINFO;
+  sigaction(SIGIO, &sig, NULL);
+
+  fcntl(fd, F_SETOWN, getpid());
+  flags = fcntl(fd, F_GETFL, 0);
+  fcntl(fd, F_SETFL, flags | O_ASYNC | O_NONBLOCK);
+}
+
+int unixHdlcPoll()
+{
+  sigset_t io;
+  sigset_t old;
+  int len;
+
+  sigemptyset(&io);
+  sigaddset(&io, SIGIO);
+  sigprocmask(SIG_BLOCK, &io, &old);
+
+#if NETCFG_HDLC_VJCOMP == 1
+
+  // Frame lost because of bad CRC invalidates
+  // compression state.
+  if (inCtx.stat.badCRC != rxBadCRC) {
+
+    rxBadCRC = inCtx.stat.badCRC;
+    vjRxError(&vj);
+  }
+
+  // Skip frames that cannot be decompressed.
+  len = 0;
+  while (len == 0 && rxReadyLen[rxNext] > 0) {
+
+    len = vjUncompress(&vj, rxReadyProto[rxNext], rxReadyPtr[rxNext], rxReadyLen[rxNext],
+                       uip_buf, UIP_BUFSIZE);
+    rxReadyLen[rxNext] = 0;
+    rxNext ^= 1;
+  }
+
+#else
+
+  len = rxReadyLen[rxNext];
+  if (len > 0) {
+
+    if (len > UIP_BUFSIZE)
+      len = UIP_BUFSIZE;
+
+    memcpy(uip_buf, rxReadyPtr[rxNext], len);
+    rxReadyLen[rxNext] = 0;
+    rxNext ^= 1;
+  }
+
+#endif
+
+  // Resume decoding if it was paused because
+  // both buffers were full. There is no new SIGIO
+  // for data that is already waiting.
+  rxProcess();
+
+  sigprocmask(SIG_SETMASK, &old, NULL);
+  return len;
+}
+
+static void txWrite(const uint8_t* buf, int len)
+{
+  fd_set ws;
+  int n;
+
+  while (len > 0) {
+
+    n = write(fd, buf, len);
+    if (n == -1 && errno == EAGAIN) {
+
+      FD_ZERO(&ws);
+      FD_SET(fd, &ws);
+      select(fd + 1, NULL, &ws, NULL, NULL);
+      continue;
+    }
+
+    P_ASSERT("hdlc write", n > 0);
+    buf += n;
+    len -= n;
+  }
+}
+
+void unixHdlcSend()
+{
+  unixHdlcSendv(NULL, 0);
+}
+
+void unixHdlcSendv(const void* data, int len)
+{
+  int skip = 0;
+
+  outCtx.buf = txFrame;
+  outCtx.max = sizeof(txFrame);
+
+#if NETCFG_HDLC_VJCOMP == 1
+
+  uint8_t vjHdr[VJ_HDR_BUF];
+  int vjLen;
+  int proto;
+
+  proto = vjCompress(&vj, uip_buf, uip_len - len, vjHdr, &vjLen, &skip);
+  pppOutputBegin(&outCtx, proto);
+  pppOutputAppendBuf(&outCtx, vjHdr, vjLen);
+
+#else
+
+  pppOutputBegin(&outCtx, PPP_ETHERNET);
+
+#endif
+
+  pppOutputAppendBuf(&outCtx, uip_buf + skip, uip_len - len - skip);
+  if (len > 0)
+    pppOutputAppendBuf(&outCtx, data, len);
+
+  pppOutputEnd(&outCtx);
+
+  txWrite(txFrame, outCtx.ptr - outCtx.buf);
+  ++stats.txFrames;
+}
+
+void unixHdlcGetStats(UnixHdlcStats* st)
+{
+  *st = stats;
+  st->badCRC = inCtx.stat.badCRC;
+  st->tooShort = inCtx.stat.tooShort;
+#if NETCFG_HDLC_VJCOMP == 1
+  st->vjCompressed = vj.stat.compressed;
+  st->vjUncompressed = vj.stat.uncompressed;
+  st->vjTossed = vj.stat.tossed;
+#endif
+}
+
+#endif
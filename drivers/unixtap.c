@@ -49,6 +49,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/select.h>
+#include <sys/uio.h>
 #include <memory.h>
 #include <signal.h>
 #include <errno.h>
@@ -153,4 +154,22 @@ void tapSend()
   P_ASSERT("tap send", i == uip_len);
 }
 
+/*
+ * Send frame whose payload (last len bytes)
+ * is not in uip_buf.
+ */
+void tapSendv(const void* data, int len)
+{
+  struct iovec iov[2];
+  int i;
+
+  iov[0].iov_base = uip_buf;
+  iov[0].iov_len  = uip_len - len;
+  iov[1].iov_base = (void*)data;
+  iov[1].iov_len  = len;
+
+  i = writev(tap, iov, 2);
+  P_ASSERT("tap send", i == uip_len);
+}
+
 #endif
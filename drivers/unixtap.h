@@ -31,3 +31,4 @@
 void tapInit(void);
 int tapPoll(void);
 void tapSend(void);
+void tapSendv(const void* data, int len);
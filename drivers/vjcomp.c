@@ -0,0 +1,583 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Van Jacobson TCP/IP header compression, as described in
+ * RFC 1144. Link carries ethernet frames, so ethernet header
+ * is kept in compression slot too: uncompressed TCP frames
+ * (PPP_VJC_UNCOMP) are sent as complete ethernet frames with
+ * IP protocol field replaced by slot number, compressed ones
+ * (PPP_VJC_COMP) contain only compressed header and TCP data.
+ * Other frames are sent as PPP_ETHERNET like before.
+ *
+ * Both ends of link must be configured with same number
+ * of slots, as there is no IPCP negotiation.
+ */
+
+#include <picoos.h>
+#include <picoos-net.h>
+#include <string.h>
+
+#if NETCFG_HDLC_VJCOMP == 1
+
+#include "ppp_defs.h"
+#include "ppp_frame.h"
+#include "vjcomp.h"
+
+#define ETH_TYPE_IP	0x0800
+
+#define TH_FIN		0x01
+#define TH_SYN		0x02
+#define TH_RST		0x04
+#define TH_PUSH		0x08
+#define TH_ACK		0x10
+#define TH_URG		0x20
+
+/*
+ * Bits in first octet of compressed packet.
+ */
+#define NEW_C		0x40	/* connection number present */
+#define NEW_I		0x20	/* IP id delta present */
+#define TCP_PUSH_BIT	0x10
+#define NEW_S		0x08
+#define NEW_A		0x04
+#define NEW_W		0x02
+#define NEW_U		0x01
+
+/*
+ * Reserved, special case values of above.
+ */
+#define SPECIAL_I	(NEW_S|NEW_W|NEW_U)		/* echoed interactive traffic */
+#define SPECIAL_D	(NEW_S|NEW_A|NEW_W|NEW_U)	/* unidirectional data */
+#define SPECIALS_MASK	(NEW_S|NEW_A|NEW_W|NEW_U)
+
+static uint16_t get16(const uint8_t* p)
+{
+  return (p[0] << 8) | p[1];
+}
+
+static uint32_t get32(const uint8_t* p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void put16(uint8_t* p, uint16_t v)
+{
+  p[0] = v >> 8;
+  p[1] = v;
+}
+
+static void put32(uint8_t* p, uint32_t v)
+{
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+/*
+ * Encode delta. Zero and values that don't fit
+ * into one octet are sent as zero followed by
+ * 16-bit value. Zero is allowed only in
+ * fields where it can be encoded (zero is true).
+ */
+static uint8_t* encode(uint8_t* cp, uint16_t n, bool zero)
+{
+  if (n >= 256 || (zero && n == 0)) {
+
+    *cp++ = 0;
+    *cp++ = n >> 8;
+  }
+
+  *cp++ = n;
+  return cp;
+}
+
+static bool decode(const uint8_t** cp, const uint8_t* end, uint16_t* n)
+{
+  const uint8_t* p = *cp;
+
+  if (p >= end)
+    return false;
+
+  if (*p == 0) {
+
+    if (p + 3 > end)
+      return false;
+
+    *n = get16(p + 1);
+    *cp = p + 3;
+  }
+  else {
+
+    *n = *p;
+    *cp = p + 1;
+  }
+
+  return true;
+}
+
+static uint16_t ipChksum(const uint8_t* p, int len)
+{
+  uint32_t sum = 0;
+
+  while (len > 1) {
+
+    sum += get16(p);
+    p += 2;
+    len -= 2;
+  }
+
+  while (sum >> 16)
+    sum = (sum & 0xffff) + (sum >> 16);
+
+  return ~sum;
+}
+
+void vjInit(VJContext* vj)
+{
+  int i;
+
+  memset(vj, '\0', sizeof(*vj));
+  for (i = 0; i < NETCFG_HDLC_VJ_SLOTS; i++)
+    vj->txOrder[i] = i;
+
+  // Nothing is known about slots until
+  // uncompressed packet has been received.
+  vj->txLast = 0xff;
+  vj->rxToss = true;
+}
+
+/*
+ * Move slot at given position in LRU order to front.
+ */
+static uint8_t txUse(VJContext* vj, int pos)
+{
+  uint8_t id = vj->txOrder[pos];
+
+  memmove(vj->txOrder + 1, vj->txOrder, pos);
+  vj->txOrder[0] = id;
+  return id;
+}
+
+/*
+ * Compress headers of ethernet frame. Frame must contain at least
+ * headers, len is number of bytes available. Returns PPP
+ * protocol number to use. Frame is sent by sending hdrLen bytes
+ * from hdr (max VJ_HDR_BUF) followed by frame contents starting
+ * at skip.
+ */
+int vjCompress(VJContext* vj, const uint8_t* frame, int len, uint8_t* hdr, int* hdrLen, int* skip)
+{
+  const uint8_t* ip = frame + VJ_ETH_HLEN;
+  const uint8_t* th;
+  const uint8_t* oip;
+  const uint8_t* oth;
+  VJSlot* s;
+  uint8_t deltas[16];
+  uint8_t* cp;
+  uint8_t changes = 0;
+  uint8_t id;
+  int ihl;
+  int hlen;
+  int pos;
+  uint16_t delta16;
+  uint32_t delta32;
+
+  *hdrLen = 0;
+  *skip = 0;
+
+  if (len < VJ_ETH_HLEN + 20 ||
+      get16(frame + 12) != ETH_TYPE_IP ||
+      (ip[0] & 0xf0) != 0x40 ||
+      ip[9] != UIP_PROTO_TCP ||
+      (get16(ip + 6) & 0x3fff) != 0)
+    return PPP_ETHERNET;
+
+  ihl = (ip[0] & 0x0f) << 2;
+  th = ip + ihl;
+  if (ihl < 20 || VJ_ETH_HLEN + ihl + 20 > len)
+    return PPP_ETHERNET;
+
+  hlen = ihl + ((th[12] >> 4) << 2);
+  if (hlen < ihl + 20 || hlen > VJ_MAX_HDR || VJ_ETH_HLEN + hlen > len)
+    return PPP_ETHERNET;
+
+  if ((th[13] & (TH_SYN | TH_FIN | TH_RST | TH_ACK)) != TH_ACK)
+    return PPP_ETHERNET;
+
+  // Locate slot for connection. Search starts
+  // from most recently used one. If not found,
+  // least recently used slot is taken.
+  for (pos = 0; pos < NETCFG_HDLC_VJ_SLOTS; pos++) {
+
+    s = &vj->tx[vj->txOrder[pos]];
+    if (s->hlen &&
+        !memcmp(ip + 12, s->hdr + 12, 8) &&
+        !memcmp(th, s->hdr + ((s->hdr[0] & 0x0f) << 2), 4))
+      break;
+  }
+
+  if (pos == NETCFG_HDLC_VJ_SLOTS) {
+
+    id = txUse(vj, NETCFG_HDLC_VJ_SLOTS - 1);
+    s = &vj->tx[id];
+    goto uncompressed;
+  }
+
+  id = txUse(vj, pos);
+
+  // Everything that is not sent as delta must be
+  // same as in previous packet: ethernet header,
+  // version, header length, TOS, fragment field, TTL,
+  // protocol and all options.
+  oip = s->hdr;
+  oth = oip + ihl;
+  if (s->hlen != hlen ||
+      memcmp(frame, s->eth, VJ_ETH_HLEN) ||
+      get16(ip) != get16(oip) ||
+      get16(ip + 6) != get16(oip + 6) ||
+      get16(ip + 8) != get16(oip + 8) ||
+      th[12] != oth[12] ||
+      memcmp(ip + 20, oip + 20, ihl - 20) ||
+      memcmp(th + 20, oth + 20, hlen - ihl - 20))
+    goto uncompressed;
+
+  cp = deltas;
+
+  if (th[13] & TH_URG) {
+
+    cp = encode(cp, get16(th + 18), true);
+    changes |= NEW_U;
+  }
+  else if (get16(th + 18) != get16(oth + 18))
+    goto uncompressed;
+
+  delta16 = get16(th + 14) - get16(oth + 14);
+  if (delta16) {
+
+    cp = encode(cp, delta16, false);
+    changes |= NEW_W;
+  }
+
+  delta32 = get32(th + 8) - get32(oth + 8);
+  if (delta32) {
+
+    if (delta32 > 0xffff)
+      goto uncompressed;
+
+    cp = encode(cp, delta32, false);
+    changes |= NEW_A;
+  }
+
+  delta32 = get32(th + 4) - get32(oth + 4);
+  if (delta32) {
+
+    if (delta32 > 0xffff)
+      goto uncompressed;
+
+    cp = encode(cp, delta32, false);
+    changes |= NEW_S;
+  }
+
+  switch (changes) {
+  case 0:
+    // Nothing changed. If this packet contains data and
+    // previous one didn't, this is probably data packet
+    // following an ack and it is sent compressed. Otherwise
+    // it is probably a retransmit, retransmitted ack or
+    // window probe, send it uncompressed in case other
+    // side missed the compressed version.
+    if (get16(ip + 2) != get16(oip + 2) && get16(oip + 2) == hlen)
+      break;
+
+    // fall through
+
+  case SPECIAL_I:
+  case SPECIAL_D:
+    // Actual changes match one of special case
+    // encodings, send packet uncompressed.
+    goto uncompressed;
+
+  case NEW_S | NEW_A:
+    delta16 = get16(oip + 2) - hlen;
+    if (get32(th + 4) - get32(oth + 4) == delta16 &&
+        get32(th + 8) - get32(oth + 8) == delta16) {
+
+      // Echoed terminal traffic.
+      changes = SPECIAL_I;
+      cp = deltas;
+    }
+    break;
+
+  case NEW_S:
+    if (get32(th + 4) - get32(oth + 4) == (uint16_t)(get16(oip + 2) - hlen)) {
+
+      // Data transfer.
+      changes = SPECIAL_D;
+      cp = deltas;
+    }
+    break;
+  }
+
+  delta16 = get16(ip + 4) - get16(oip + 4);
+  if (delta16 != 1) {
+
+    cp = encode(cp, delta16, true);
+    changes |= NEW_I;
+  }
+
+  if (th[13] & TH_PUSH)
+    changes |= TCP_PUSH_BIT;
+
+  memcpy(s->hdr, ip, hlen);
+
+  *hdr = changes;
+  *hdrLen = 1;
+  if (vj->txLast != id) {
+
+    vj->txLast = id;
+    hdr[0] |= NEW_C;
+    hdr[(*hdrLen)++] = id;
+  }
+
+  hdr[(*hdrLen)++] = th[16];
+  hdr[(*hdrLen)++] = th[17];
+  memcpy(hdr + *hdrLen, deltas, cp - deltas);
+  *hdrLen += cp - deltas;
+  *skip = VJ_ETH_HLEN + hlen;
+
+  ++vj->stat.compressed;
+  return PPP_VJC_COMP;
+
+uncompressed:
+  memcpy(s->eth, frame, VJ_ETH_HLEN);
+  memcpy(s->hdr, ip, hlen);
+  s->hlen = hlen;
+
+  memcpy(hdr, frame, VJ_ETH_HLEN + hlen);
+  hdr[VJ_ETH_HLEN + 9] = id;
+  *hdrLen = VJ_ETH_HLEN + hlen;
+  *skip = *hdrLen;
+  vj->txLast = id;
+
+  ++vj->stat.uncompressed;
+  return PPP_VJC_UNCOMP;
+}
+
+/*
+ * Reconstruct ethernet frame from received packet. Returns
+ * length of frame or zero if packet must be dropped.
+ */
+int vjUncompress(VJContext* vj, int proto, const uint8_t* data, int len, uint8_t* frame, int max)
+{
+  const uint8_t* cp;
+  const uint8_t* end;
+  uint8_t* ip;
+  uint8_t* th;
+  VJSlot* s;
+  uint8_t changes;
+  uint16_t n;
+  int ihl;
+  int hlen;
+
+  if (proto == PPP_ETHERNET) {
+
+    if (len > max)
+      len = max;
+
+    memcpy(frame, data, len);
+    return len;
+  }
+
+  if (proto == PPP_VJC_UNCOMP) {
+
+    ip = (uint8_t*)data + VJ_ETH_HLEN;
+    if (len < VJ_ETH_HLEN + 20 || ip[9] >= NETCFG_HDLC_VJ_SLOTS)
+      goto bad;
+
+    ihl = (ip[0] & 0x0f) << 2;
+    if (ihl < 20 || VJ_ETH_HLEN + ihl + 20 > len)
+      goto bad;
+
+    hlen = ihl + ((ip[ihl + 12] >> 4) << 2);
+    if (hlen < ihl + 20 || hlen > VJ_MAX_HDR || VJ_ETH_HLEN + hlen > len || len > max)
+      goto bad;
+
+    vj->rxLast = ip[9];
+    vj->rxToss = false;
+    s = &vj->rx[vj->rxLast];
+
+    memcpy(frame, data, len);
+    frame[VJ_ETH_HLEN + 9] = UIP_PROTO_TCP;
+
+    memcpy(s->eth, frame, VJ_ETH_HLEN);
+    memcpy(s->hdr, frame + VJ_ETH_HLEN, hlen);
+    s->hlen = hlen;
+
+    ++vj->stat.uncompressed;
+    return len;
+  }
+
+  if (proto != PPP_VJC_COMP)
+    return 0;
+
+  cp = data;
+  end = data + len;
+
+  if (len < 3)
+    goto bad;
+
+  changes = *cp++;
+  if (changes & NEW_C) {
+
+    if (*cp >= NETCFG_HDLC_VJ_SLOTS)
+      goto bad;
+
+    vj->rxLast = *cp++;
+    vj->rxToss = false;
+  }
+  else if (vj->rxToss) {
+
+    ++vj->stat.tossed;
+    return 0;
+  }
+
+  s = &vj->rx[vj->rxLast];
+  if (s->hlen == 0 || cp + 2 > end)
+    goto bad;
+
+  ip = s->hdr;
+  hlen = s->hlen;
+  ihl = (ip[0] & 0x0f) << 2;
+  th = ip + ihl;
+
+  th[16] = *cp++;
+  th[17] = *cp++;
+
+  if (changes & TCP_PUSH_BIT)
+    th[13] |= TH_PUSH;
+  else
+    th[13] &= ~TH_PUSH;
+
+  // Urgent flag is set only with NEW_U, special
+  // cases are never used for urgent data.
+  th[13] &= ~TH_URG;
+
+  switch (changes & SPECIALS_MASK) {
+  case SPECIAL_I:
+    n = get16(ip + 2) - hlen;
+    put32(th + 8, get32(th + 8) + n);
+    put32(th + 4, get32(th + 4) + n);
+    break;
+
+  case SPECIAL_D:
+    put32(th + 4, get32(th + 4) + get16(ip + 2) - hlen);
+    break;
+
+  default:
+    if (changes & NEW_U) {
+
+      if (!decode(&cp, end, &n))
+        goto bad;
+
+      th[13] |= TH_URG;
+      put16(th + 18, n);
+    }
+
+    if (changes & NEW_W) {
+
+      if (!decode(&cp, end, &n))
+        goto bad;
+
+      put16(th + 14, get16(th + 14) + n);
+    }
+
+    if (changes & NEW_A) {
+
+      if (!decode(&cp, end, &n))
+        goto bad;
+
+      put32(th + 8, get32(th + 8) + n);
+    }
+
+    if (changes & NEW_S) {
+
+      if (!decode(&cp, end, &n))
+        goto bad;
+
+      put32(th + 4, get32(th + 4) + n);
+    }
+
+    break;
+  }
+
+  if (changes & NEW_I) {
+
+    if (!decode(&cp, end, &n))
+      goto bad;
+
+    put16(ip + 4, get16(ip + 4) + n);
+  }
+  else
+    put16(ip + 4, get16(ip + 4) + 1);
+
+  len = end - cp;
+  if (VJ_ETH_HLEN + hlen + len > max)
+    goto bad;
+
+  put16(ip + 2, hlen + len);
+  put16(ip + 10, 0);
+  put16(ip + 10, ipChksum(ip, ihl));
+
+  memcpy(frame, s->eth, VJ_ETH_HLEN);
+  memcpy(frame + VJ_ETH_HLEN, ip, hlen);
+  memcpy(frame + VJ_ETH_HLEN + hlen, cp, len);
+
+  ++vj->stat.compressed;
+  return VJ_ETH_HLEN + hlen + len;
+
+bad:
+  vjRxError(vj);
+  ++vj->stat.tossed;
+  return 0;
+}
+
+/*
+ * Link layer detected an error, packet was lost.
+ * Compressed packets are discarded until one
+ * with explicit slot number arrives.
+ */
+void vjRxError(VJContext* vj)
+{
+  vj->rxToss = true;
+}
+
+#endif
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Van Jacobson TCP/IP header compression (RFC 1144)
+ * for HDLC bridge links.
+ */
+
+#define VJ_ETH_HLEN	14	/* ethernet header, kept in slot */
+#define VJ_MAX_HDR	64	/* max IP + TCP header length that is compressed */
+#define VJ_HDR_BUF	(VJ_ETH_HLEN + VJ_MAX_HDR) /* size of header buffer for vjCompress */
+
+typedef struct {
+
+  uint8_t eth[VJ_ETH_HLEN]; // Ethernet header
+  uint8_t hdr[VJ_MAX_HDR];  // IP and TCP header of last packet
+  uint8_t hlen;             // Length of hdr, 0 if slot is unused
+} VJSlot;
+
+struct vjContext {
+
+  VJSlot  tx[NETCFG_HDLC_VJ_SLOTS];
+  VJSlot  rx[NETCFG_HDLC_VJ_SLOTS];
+  uint8_t txOrder[NETCFG_HDLC_VJ_SLOTS]; // Slot numbers, most recently used first
+  uint8_t txLast;           // Slot of last packet sent
+  uint8_t rxLast;           // Slot of last packet received
+  bool    rxToss;           // Discard compressed packets until slot is known
+
+  struct {
+
+    int      compressed;
+    int      uncompressed;
+    int      tossed;
+  } stat;
+};
+
+typedef struct vjContext VJContext;
+
+void vjInit(VJContext* vj);
+int vjCompress(VJContext* vj, const uint8_t* frame, int len, uint8_t* hdr, int* hdrLen, int* skip);
+int vjUncompress(VJContext* vj, int proto, const uint8_t* data, int len, uint8_t* frame, int max);
+void vjRxError(VJContext* vj);
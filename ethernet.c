@@ -37,59 +37,60 @@
 struct uip_eth_addr uip_ethaddr = {{0,0,0,0,0,0}};
 #endif
 
-#if NETCFG_DRIVER_CS8900A == 2 || \
-    NETCFG_DRIVER_ENC28J60 == 2 || \
-    NETCFG_DRIVER_HDLC_BRIDGE == 2 || \
-    NETCFG_DRIVER_TM4C1294 == 2 || \
-    NETCFG_DRIVER_TAP == 2
+#define BUF ((struct uip_eth_hdr *)&uip_buf16(0))
+#define IPBUF ((struct uip_tcpip_hdr *)&uip_buf32(UIP_LLH_LEN))
 
-#if NETSTACK_CONF_WITH_IPV6
-void netInterfaceOutput(const uip_lladdr_t* lla)
-{
-  netEthernetOutput(lla);
-}
-#else
-void netInterfaceOutput(void)
+/*
+ * Driver glue. Each compiled-in ethernet-type driver gets
+ * a NetDriver vtable, so it can be attached to an interface
+ * with netInterfaceAdd. Driver selected with value 2 is also
+ * bound to the traditional global netInterface* functions,
+ * which are used by the default interface.
+ */
+
+static bool ethInput(void)
 {
-  netEthernetOutput();
-}
-#endif
+  if (uip_len) {
 
-#endif
+    netEthernetInput();
+    return true;
+  }
 
-#if NETCFG_DRIVER_CS8900A == 2
+  return false;
+}
+
+#if NETCFG_DRIVER_CS8900A > 0
 
 #include "drivers/cs8900a.h"
 
-void netInterfaceInit(void)
+static void cs8900aIfInit(NetInterface* ifc)
 {
   cs8900aInit();
 }
 
-bool netInterfacePoll(void)
+static bool cs8900aIfPoll(NetInterface* ifc)
 {
   uip_len = cs8900aPoll();
-  if (uip_len) {
-
-    netEthernetInput();
-    return true;
-  }
-
-  return false;
+  return ethInput();
 }
 
-void netInterfaceXmit(void)
+static void cs8900aIfXmit(NetInterface* ifc)
 {
   cs8900aSend();
 }
 
+const NetDriver netDriverCs8900a = { cs8900aIfInit, cs8900aIfPoll, cs8900aIfXmit, NULL };
+
+#if NETCFG_DRIVER_CS8900A == 2
+#define DEFAULT_DRIVER netDriverCs8900a
+#endif
 #endif
 
-#if NETCFG_DRIVER_ENC28J60 == 2
+#if NETCFG_DRIVER_ENC28J60 > 0
 
 #include "drivers/enc28j60.h"
 
-void netInterfaceInit(void)
+static void enc28j60IfInit(NetInterface* ifc)
 {
   enc28j60_spi_init();
   enc28j60_Init();
@@ -98,7 +99,7 @@ void netInterfaceInit(void)
 #endif
 }
 
-bool netInterfacePoll(void)
+static bool enc28j60IfPoll(NetInterface* ifc)
 {
 #ifdef ENC28J60_USE_INTERRUPTS
   enc28j60_InterruptPin_Disable();
@@ -108,16 +109,10 @@ bool netInterfacePoll(void)
   enc28j60_Enable_Global_Interrupts();
   enc28j60_InterruptPin_Enable();
 #endif
-  if (uip_len) {
-
-    netEthernetInput();
-    return true;
-  }
-
-  return false;
+  return ethInput();
 }
 
-void netInterfaceXmit(void)
+static void enc28j60IfXmit(NetInterface* ifc)
 {
 #ifdef ENC28J60_USE_INTERRUPTS
   enc28j60_InterruptPin_Disable();
@@ -128,97 +123,573 @@ void netInterfaceXmit(void)
 #endif
 }
 
+static void enc28j60IfXmitv(NetInterface* ifc, const void* data, uint16_t len)
+{
+#ifdef ENC28J60_USE_INTERRUPTS
+  enc28j60_InterruptPin_Disable();
+#endif
+  enc28j60_Frame_Sendv(uip_buf, uip_len - len, data, len);
+#ifdef ENC28J60_USE_INTERRUPTS
+  enc28j60_InterruptPin_Enable();
+#endif
+}
+
+const NetDriver netDriverEnc28j60 = { enc28j60IfInit, enc28j60IfPoll, enc28j60IfXmit, enc28j60IfXmitv };
+
+#if NETCFG_DRIVER_ENC28J60 == 2
+#define DEFAULT_DRIVER netDriverEnc28j60
+#endif
 #endif
 
-#if NETCFG_DRIVER_TAP == 2
+#if NETCFG_DRIVER_TAP > 0
 
 #include "drivers/unixtap.h"
 
-void netInterfaceInit(void)
+static void tapIfInit(NetInterface* ifc)
 {
   tapInit();
 }
 
-bool netInterfacePoll(void)
+static bool tapIfPoll(NetInterface* ifc)
 {
   uip_len = tapPoll();
-  if (uip_len) {
-
-    netEthernetInput();
-    return true;
-  }
-
-  return false;
+  return ethInput();
 }
 
-void netInterfaceXmit(void)
+static void tapIfXmit(NetInterface* ifc)
 {
   tapSend();
 }
 
+static void tapIfXmitv(NetInterface* ifc, const void* data, uint16_t len)
+{
+  tapSendv(data, len);
+}
+
+const NetDriver netDriverTap = { tapIfInit, tapIfPoll, tapIfXmit, tapIfXmitv };
+
+#if NETCFG_DRIVER_TAP == 2
+#define DEFAULT_DRIVER netDriverTap
+#endif
 #endif
 
-#if NETCFG_DRIVER_HDLC_BRIDGE == 2
+#if NETCFG_DRIVER_HDLC_BRIDGE > 0
 
 #include "drivers/stm32_hdlc_bridge.h"
 
-void netInterfaceInit(void)
+static void hdlcIfInit(NetInterface* ifc)
 {
   hdlcInit();
 }
 
-bool netInterfacePoll(void)
+static bool hdlcIfPoll(NetInterface* ifc)
 {
   uip_len = hdlcPoll();
-  if (uip_len) {
+  return ethInput();
+}
 
-    netEthernetInput();
-    return true;
-  }
+static void hdlcIfXmit(NetInterface* ifc)
+{
+  hdlcSend();
+}
 
-  return false;
+const NetDriver netDriverHdlcBridge = { hdlcIfInit, hdlcIfPoll, hdlcIfXmit, NULL };
+
+#if NETCFG_DRIVER_HDLC_BRIDGE == 2
+#define DEFAULT_DRIVER netDriverHdlcBridge
+#endif
+#endif
+
+#if NETCFG_DRIVER_UNIX_HDLC_BRIDGE > 0
+
+#include "drivers/unix_hdlc_bridge.h"
+
+static void unixHdlcIfInit(NetInterface* ifc)
+{
+  unixHdlcInit();
 }
 
-void netInterfaceXmit(void)
+static bool unixHdlcIfPoll(NetInterface* ifc)
 {
-  hdlcSend();
+  uip_len = unixHdlcPoll();
+  return ethInput();
+}
+
+static void unixHdlcIfXmit(NetInterface* ifc)
+{
+  unixHdlcSend();
 }
 
+static void unixHdlcIfXmitv(NetInterface* ifc, const void* data, uint16_t len)
+{
+  unixHdlcSendv(data, len);
+}
+
+const NetDriver netDriverUnixHdlcBridge = { unixHdlcIfInit, unixHdlcIfPoll, unixHdlcIfXmit, unixHdlcIfXmitv };
+
+#if NETCFG_DRIVER_UNIX_HDLC_BRIDGE == 2
+#define DEFAULT_DRIVER netDriverUnixHdlcBridge
+#endif
 #endif
 
-#if NETCFG_DRIVER_TM4C1294 == 2
+#if NETCFG_DRIVER_TM4C1294 > 0
 
 #include "drivers/tm4c_emac.h"
+#include "drivers/tm4c_emac_ring.h"
 
-void netInterfaceInit(void)
+static void tivaIfInit(NetInterface* ifc)
 {
   tivaEmacInit();
 }
 
-bool netInterfacePoll(void)
+/*
+ * Process all frames that are waiting in receive ring,
+ * but at most ring size of them to let other work run too.
+ */
+static bool tivaIfPoll(NetInterface* ifc)
 {
-  uip_len = tivaEmacPoll(uip_buf, UIP_BUFSIZE);
-  if (uip_len) {
+  int count = 0;
 
-    netEthernetInput();
-    return true;
+  while (count < NETCFG_TM4C_RX_DESCRIPTORS) {
+
+    uip_len = tivaEmacPoll(uip_buf, UIP_BUFSIZE);
+    if (!ethInput())
+      break;
+
+    ++count;
   }
 
-  return false;
+  return count > 0;
 }
 
-void netInterfaceXmit(void)
+static void tivaIfXmit(NetInterface* ifc)
 {
   tivaEmacSend(uip_buf, uip_len);
 }
 
+static void tivaIfXmitv(NetInterface* ifc, const void* data, uint16_t len)
+{
+  tivaEmacSendv(uip_buf, uip_len - len, data, len);
+}
+
+const NetDriver netDriverTm4c1294 = { tivaIfInit, tivaIfPoll, tivaIfXmit, tivaIfXmitv };
+
+#if NETCFG_DRIVER_TM4C1294 == 2
+#define DEFAULT_DRIVER netDriverTm4c1294
+#endif
+#endif
+
+#if NETCFG_DRIVER_PCAP_REPLAY > 0
+
+#include "drivers/pcap_replay.h"
+
+static void replayIfInit(NetInterface* ifc)
+{
+  pcapReplayInit();
+}
+
+/*
+ * Replay driver passes the frame to ethernet layer
+ * itself so it can measure the time spent there.
+ */
+static bool replayIfPoll(NetInterface* ifc)
+{
+  return pcapReplayPoll();
+}
+
+static void replayIfXmit(NetInterface* ifc)
+{
+  pcapReplaySend();
+}
+
+const NetDriver netDriverPcapReplay = { replayIfInit, replayIfPoll, replayIfXmit, NULL };
+
+#if NETCFG_DRIVER_PCAP_REPLAY == 2
+#define DEFAULT_DRIVER netDriverPcapReplay
+#endif
+#endif
+
+#if NETCFG_DRIVER_LOOPBACK > 0
+
+#include "drivers/loopback.h"
+
+static void loopbackIfInit(NetInterface* ifc)
+{
+  loopbackInit();
+}
+
+static bool loopbackIfPoll(NetInterface* ifc)
+{
+  uip_len = loopbackPoll();
+  return ethInput();
+}
+
+static void loopbackIfXmit(NetInterface* ifc)
+{
+  loopbackSend();
+}
+
+const NetDriver netDriverLoopback = { loopbackIfInit, loopbackIfPoll, loopbackIfXmit, NULL };
+
+#if NETCFG_DRIVER_LOOPBACK == 2
+#define DEFAULT_DRIVER netDriverLoopback
+#endif
+#endif
+
+#ifdef DEFAULT_DRIVER
+
+void netInterfaceInit(void)
+{
+  DEFAULT_DRIVER.init(NULL);
+}
+
+bool netInterfacePoll(void)
+{
+  return DEFAULT_DRIVER.poll(NULL);
+}
+
+void netInterfaceXmit(void)
+{
+  DEFAULT_DRIVER.xmit(NULL);
+}
+
+void netInterfaceXmitv(const void* data, uint16_t len)
+{
+  if (DEFAULT_DRIVER.xmitv != NULL) {
+
+    DEFAULT_DRIVER.xmitv(NULL, data, len);
+    return;
+  }
+
+  memcpy(uip_buf + uip_len - len, data, len);
+  DEFAULT_DRIVER.xmit(NULL);
+}
+
+#endif
+
+/*
+ * Interface list. Default interface gets all traffic
+ * that doesn't match network of any other interface.
+ */
+static NetInterface* ifList;
+static NetInterface* ifDefault;
+static bool ifDefaultSet;
+static NetInterface* txIf;
+NetInterface* netInterfaceCurrent;
+
+#if NETCFG_LEGACY_INTERFACE == 1
+
+static void legacyInit(NetInterface* ifc)
+{
+  netInterfaceInit();
+}
+
+static bool legacyPoll(NetInterface* ifc)
+{
+  return netInterfacePoll();
+}
+
+static void legacyXmit(NetInterface* ifc)
+{
+  netInterfaceXmit();
+}
+
+#ifdef DEFAULT_DRIVER
+
+static void legacyXmitv(NetInterface* ifc, const void* data, uint16_t len)
+{
+  netInterfaceXmitv(data, len);
+}
+
+#else
+
+/*
+ * Application-provided driver doesn't need
+ * to implement netInterfaceXmitv.
+ */
+#define legacyXmitv NULL
+
+#endif
+
+static const NetDriver legacyDriver = { legacyInit, legacyPoll, legacyXmit, legacyXmitv };
+static NetInterface legacyIf = {
+
+  .name   = "eth0",
+  .driver = &legacyDriver,
+  .mtu    = UIP_BUFSIZE - UIP_LLH_LEN
+};
+
+#endif
+
+static bool addrIsZero(const uip_ipaddr_t* a)
+{
+  unsigned int i;
+
+  for (i = 0; i < sizeof(a->u16) / sizeof(a->u16[0]); i++)
+    if (a->u16[i] != 0)
+      return false;
+
+  return true;
+}
+
+static bool addrMaskCmp(const uip_ipaddr_t* a, const uip_ipaddr_t* b, const uip_ipaddr_t* mask)
+{
+  unsigned int i;
+
+  for (i = 0; i < sizeof(a->u16) / sizeof(a->u16[0]); i++)
+    if ((a->u16[i] & mask->u16[i]) != (b->u16[i] & mask->u16[i]))
+      return false;
+
+  return true;
+}
+
+#if !NETSTACK_CONF_WITH_IPV6 && !UIP_FIXEDADDR
+
+/*
+ * uIP has only one host address. When serving an interface
+ * that has its own address, it is swapped into uip_hostaddr
+ * and uip_netmask, so packets addressed to it are accepted
+ * and outgoing packets get correct source address.
+ * Interfaces without address use primary (global) address.
+ */
+static NetInterface* addrIf;
+static uip_ipaddr_t primaryAddr;
+static uip_ipaddr_t primaryMask;
+
+static void ifUseAddr(NetInterface* ifc)
+{
+  if (ifc != NULL && addrIsZero(&ifc->addr))
+    ifc = NULL;
+
+  if (ifc == addrIf)
+    return;
+
+  if (addrIf == NULL) {
+
+    uip_ipaddr_copy(&primaryAddr, &uip_hostaddr);
+    uip_ipaddr_copy(&primaryMask, &uip_netmask);
+  }
+
+  if (ifc == NULL) {
+
+    uip_ipaddr_copy(&uip_hostaddr, &primaryAddr);
+    uip_ipaddr_copy(&uip_netmask, &primaryMask);
+  }
+  else {
+
+    uip_ipaddr_copy(&uip_hostaddr, &ifc->addr);
+    uip_ipaddr_copy(&uip_netmask, &ifc->netmask);
+  }
+
+  addrIf = ifc;
+}
+
+#else
+#define ifUseAddr(ifc)
+#endif
+
+void netInterfaceAdd(NetInterface* ifc, bool isDefault)
+{
+  NetInterface** ptr;
+
+  for (ptr = &ifList; *ptr != NULL; ptr = &(*ptr)->next)
+    if (*ptr == ifc)
+      return;
+
+  ifc->next = NULL;
+  if (ifc->mtu == 0)
+    ifc->mtu = UIP_BUFSIZE - UIP_LLH_LEN;
+
+  *ptr = ifc;
+
+  if (isDefault || ifDefault == NULL) {
+
+    ifDefault = ifc;
+    ifDefaultSet = ifDefaultSet || isDefault;
+  }
+}
+
+NetInterface* netInterfaceRoute(const uip_ipaddr_t* dest)
+{
+  NetInterface* ifc;
+
+#if NETSTACK_CONF_WITH_IPV6
+  if (uip_is_addr_mcast(dest) || uip_is_addr_linklocal(dest))
+#else
+  if (uip_ipaddr_cmp(dest, &uip_broadcast_addr))
+#endif
+    return netInterfaceCurrent != NULL ? netInterfaceCurrent : ifDefault;
+
+  for (ifc = ifList; ifc != NULL; ifc = ifc->next) {
+
+    if (ifc != ifDefault &&
+        !addrIsZero(&ifc->addr) &&
+        addrMaskCmp(dest, &ifc->addr, &ifc->netmask))
+      return ifc;
+  }
+
+  return ifDefault;
+}
+
+uint16_t netInterfaceTcpMss(const struct uip_conn* conn)
+{
+  NetInterface* ifc = netInterfaceRoute(&conn->ripaddr);
+
+  if (ifc != NULL && ifc->mtu > UIP_TCPIP_HLEN && ifc->mtu - UIP_TCPIP_HLEN < UIP_TCP_MSS)
+    return ifc->mtu - UIP_TCPIP_HLEN;
+
+  return UIP_TCP_MSS;
+}
+
+void netInterfaceEnter(NetInterface* ifc)
+{
+  netInterfaceCurrent = ifc;
+  ifUseAddr(ifc);
+}
+
+void netInterfaceLeave(void)
+{
+  netInterfaceCurrent = NULL;
+  ifUseAddr(NULL);
+}
+
+void netInterfaceInitAll(void)
+{
+  NetInterface* ifc;
+
+#if NETCFG_LEGACY_INTERFACE == 1
+  netInterfaceAdd(&legacyIf, !ifDefaultSet);
+#endif
+
+  for (ifc = ifList; ifc != NULL; ifc = ifc->next)
+    ifc->driver->init(ifc);
+}
+
+bool netInterfacePollAll(void)
+{
+  NetInterface* ifc;
+  bool packetSeen = false;
+
+  for (ifc = ifList; ifc != NULL; ifc = ifc->next) {
+
+    netInterfaceEnter(ifc);
+    if (ifc->driver->poll(ifc))
+      packetSeen = true;
+
+    netInterfaceLeave();
+  }
+
+  return packetSeen;
+}
+
+#if UIP_XMITV
+
+/*
+ * Pass frame to driver. If payload is not in uip_buf,
+ * use scatter-gather transmit if driver has it.
+ * Otherwise payload must be copied to uip_buf first.
+ */
+static void drvXmit(const NetDriver* drv, NetInterface* ifc)
+{
+  if (uip_xmitv_data != NULL) {
+
+    if (drv->xmitv != NULL) {
+
+      drv->xmitv(ifc, uip_xmitv_data, uip_xmitv_len);
+      return;
+    }
+
+    uip_xmitv_flatten();
+  }
+
+  drv->xmit(ifc);
+}
+
+#else
+
+#define drvXmit(drv, ifc) (drv)->xmit(ifc)
+
+#endif
+
+/*
+ * Transmit frame in uip_buf using interface selected
+ * for output, or the one currently being served.
+ */
+static void ifXmit(void)
+{
+  NetInterface* ifc = txIf != NULL ? txIf : netInterfaceCurrent;
+
+  if (ifc == NULL)
+    ifc = ifDefault;
+
+  if (ifc == NULL) {
+
+#ifdef DEFAULT_DRIVER
+    drvXmit(&DEFAULT_DRIVER, NULL);
+#endif
+  }
+  else if (uip_len > ifc->mtu + UIP_LLH_LEN) {
+
+    ++ifc->mtuDrops;
+  }
+  else {
+
+    ++ifc->xmits;
+    drvXmit(ifc->driver, ifc);
+  }
+
+#if UIP_XMITV
+  // External payload is not needed after frame has been sent.
+  uip_xmitv_clear();
+#endif
+}
+
+/*
+ * Routed output is used whenever library manages interface
+ * list. Application that provides legacy driver functions
+ * may also provide its own netInterfaceOutput.
+ */
+#if defined(DEFAULT_DRIVER) || NETCFG_LEGACY_INTERFACE == 0
+
+#if NETSTACK_CONF_WITH_IPV6
+void netInterfaceOutput(const uip_lladdr_t* lla)
+{
+  txIf = netInterfaceRoute(&IPBUF->destipaddr);
+  netEthernetOutput(lla);
+  txIf = NULL;
+}
+#else
+void netInterfaceOutput(void)
+{
+  txIf = netInterfaceRoute(&IPBUF->destipaddr);
+
+  // ARP uses uip_hostaddr and uip_netmask to
+  // decide if default router must be used.
+  ifUseAddr(txIf);
+  netEthernetOutput();
+  ifUseAddr(netInterfaceCurrent);
+  txIf = NULL;
+}
+#endif
+
+#endif
+
+#if NETCFG_CAPTURE == 1
+#define CAPTURE() netCapturePacket()
+#else
+#define CAPTURE()
 #endif
 
-#define BUF ((struct uip_eth_hdr *)&uip_buf16(0))
-#define IPBUF ((struct uip_tcpip_hdr *)&uip_buf32(UIP_LLH_LEN))
 
 void netEthernetInput()
 {
+#if UIP_XMITV
+  // Received frame replaces anything that was in uip_buf.
+  uip_xmitv_clear();
+#endif
+
+  CAPTURE();
+
 #if NETSTACK_CONF_WITH_IPV6
 
   if(BUF->type == uip_htons(UIP_ETHTYPE_IPV6)) {
@@ -234,7 +705,8 @@ void netEthernetInput()
     uip_arp_arpin();
     if(uip_len > 0) {
 
-      netInterfaceXmit();
+      CAPTURE();
+      ifXmit();
     }
 
     return;
@@ -272,12 +744,21 @@ void netEthernetOutput(const uip_lladdr_t* lladdr)
   BUF->type = UIP_HTONS(UIP_ETHTYPE_IPV6); //math tmp
    
   uip_len += sizeof(struct uip_eth_hdr);
-  netInterfaceXmit();
+  CAPTURE();
+  ifXmit();
 }
 #else
 void netEthernetOutput()
 {
   uip_arp_out();
-  netInterfaceXmit();
+
+#if UIP_XMITV
+  // If ARP request was generated, it replaced original packet.
+  if (BUF->type == uip_htons(UIP_ETHTYPE_ARP))
+    uip_xmitv_clear();
+#endif
+
+  CAPTURE();
+  ifXmit();
 }
 #endif
@@ -0,0 +1,561 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * POSIX threads implementation of pico]OS stand-in.
+ * Each task is a thread and a ticker thread advances
+ * jiffies and software timers HZ times per second.
+ * Timeouts are measured with CLOCK_MONOTONIC.
+ */
+
+#include <picoos.h>
+#include <picoos-u.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+struct hostSema {
+
+  pthread_mutex_t m;
+  pthread_cond_t c;
+  int count;
+};
+
+struct hostMutex {
+
+  pthread_mutex_t m;
+};
+
+struct hostFlag {
+
+  pthread_mutex_t m;
+  pthread_cond_t c;
+  unsigned int mask;
+};
+
+struct hostTimer {
+
+  struct hostTimer* next;
+  POSSEMA_t sema;
+  UINT_t wait;
+  UINT_t reload;
+  JIF_t expires;
+  bool running;
+  int fired;
+};
+
+struct hostTask {
+
+  pthread_t thread;
+  POSTASKFUNC_t func;
+  void* arg;
+};
+
+volatile JIF_t jiffies;
+
+static pthread_mutex_t schedLock;
+static pthread_mutex_t timerLock = PTHREAD_MUTEX_INITIALIZER;
+static struct hostTimer* timers;
+static __thread struct hostTask* currentTask;
+
+static HostPortTask portTask;
+HostPortTask* posCurrentTask_g = &portTask;
+
+static void deadline(struct timespec* ts, UINT_t ticks)
+{
+  clock_gettime(CLOCK_MONOTONIC, ts);
+  ts->tv_sec += ticks / HZ;
+  ts->tv_nsec += (long)(ticks % HZ) * (1000000000L / HZ);
+  if (ts->tv_nsec >= 1000000000L) {
+
+    ts->tv_sec++;
+    ts->tv_nsec -= 1000000000L;
+  }
+}
+
+static void condInit(pthread_cond_t* c)
+{
+  pthread_condattr_t attr;
+
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(c, &attr);
+  pthread_condattr_destroy(&attr);
+}
+
+static void recursiveInit(pthread_mutex_t* m)
+{
+  pthread_mutexattr_t attr;
+
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(m, &attr);
+  pthread_mutexattr_destroy(&attr);
+}
+
+/*
+ * Wait for condition with pico]OS style timeout,
+ * 0 = don't wait, INFINITE = wait forever.
+ * Returns ETIMEDOUT if time ran out.
+ */
+static int condWait(pthread_cond_t* c, pthread_mutex_t* m, UINT_t timeout, const struct timespec* ts)
+{
+  if (timeout == 0)
+    return ETIMEDOUT;
+
+  if (timeout == INFINITE)
+    return pthread_cond_wait(c, m);
+
+  return pthread_cond_timedwait(c, m, ts);
+}
+
+POSSEMA_t posSemaCreate(INT_t initcount)
+{
+  struct hostSema* s = calloc(1, sizeof(*s));
+
+  pthread_mutex_init(&s->m, NULL);
+  condInit(&s->c);
+  s->count = initcount;
+  return s;
+}
+
+VAR_t posSemaWait(POSSEMA_t s, UINT_t timeout)
+{
+  struct timespec ts;
+  int r = 0;
+
+  pthread_mutex_lock(&s->m);
+  if (timeout != INFINITE)
+    deadline(&ts, timeout);
+
+  while (s->count <= 0 && r == 0)
+    r = condWait(&s->c, &s->m, timeout, &ts);
+
+  if (s->count > 0) {
+
+    s->count--;
+    r = 0;
+  }
+
+  pthread_mutex_unlock(&s->m);
+  return r ? 1 : 0;
+}
+
+VAR_t posSemaSignal(POSSEMA_t s)
+{
+  pthread_mutex_lock(&s->m);
+  s->count++;
+  pthread_cond_signal(&s->c);
+  pthread_mutex_unlock(&s->m);
+  return 0;
+}
+
+void posSemaDestroy(POSSEMA_t s)
+{
+  pthread_mutex_destroy(&s->m);
+  pthread_cond_destroy(&s->c);
+  free(s);
+}
+
+/*
+ * pico]OS mutexes can be locked recursively.
+ */
+POSMUTEX_t posMutexCreate()
+{
+  struct hostMutex* m = calloc(1, sizeof(*m));
+
+  recursiveInit(&m->m);
+  return m;
+}
+
+VAR_t posMutexLock(POSMUTEX_t m)
+{
+  return pthread_mutex_lock(&m->m);
+}
+
+VAR_t posMutexTryLock(POSMUTEX_t m)
+{
+  return pthread_mutex_trylock(&m->m) ? 1 : 0;
+}
+
+VAR_t posMutexUnlock(POSMUTEX_t m)
+{
+  P_ASSERT("posMutexUnlock", pthread_mutex_unlock(&m->m) == 0);
+  return 0;
+}
+
+void posMutexDestroy(POSMUTEX_t m)
+{
+  pthread_mutex_destroy(&m->m);
+  free(m);
+}
+
+POSFLAG_t posFlagCreate()
+{
+  struct hostFlag* f = calloc(1, sizeof(*f));
+
+  pthread_mutex_init(&f->m, NULL);
+  condInit(&f->c);
+  return f;
+}
+
+/*
+ * Returns mask of flags that were set and clears them,
+ * zero if timeout expired.
+ */
+VAR_t posFlagWait(POSFLAG_t f, UINT_t timeout)
+{
+  struct timespec ts;
+  unsigned int mask;
+  int r = 0;
+
+  pthread_mutex_lock(&f->m);
+  if (timeout != INFINITE)
+    deadline(&ts, timeout);
+
+  while (f->mask == 0 && r == 0)
+    r = condWait(&f->c, &f->m, timeout, &ts);
+
+  mask = f->mask;
+  f->mask = 0;
+  pthread_mutex_unlock(&f->m);
+  return mask;
+}
+
+VAR_t posFlagGet(POSFLAG_t f, UVAR_t mode)
+{
+  return posFlagWait(f, INFINITE);
+}
+
+VAR_t posFlagSet(POSFLAG_t f, UVAR_t flgnum)
+{
+  pthread_mutex_lock(&f->m);
+  f->mask |= 1U << flgnum;
+  pthread_cond_broadcast(&f->c);
+  pthread_mutex_unlock(&f->m);
+  return 0;
+}
+
+void posFlagDestroy(POSFLAG_t f)
+{
+  pthread_mutex_destroy(&f->m);
+  pthread_cond_destroy(&f->c);
+  free(f);
+}
+
+POSTIMER_t posTimerCreate()
+{
+  struct hostTimer* t = calloc(1, sizeof(*t));
+
+  pthread_mutex_lock(&timerLock);
+  t->next = timers;
+  timers = t;
+  pthread_mutex_unlock(&timerLock);
+  return t;
+}
+
+VAR_t posTimerSet(POSTIMER_t t, POSSEMA_t sema, UINT_t waittime, UINT_t periodictime)
+{
+  pthread_mutex_lock(&timerLock);
+  t->sema = sema;
+  t->wait = waittime;
+  t->reload = periodictime;
+  pthread_mutex_unlock(&timerLock);
+  return 0;
+}
+
+VAR_t posTimerStart(POSTIMER_t t)
+{
+  pthread_mutex_lock(&timerLock);
+  t->expires = jiffies + t->wait;
+  t->running = true;
+  pthread_mutex_unlock(&timerLock);
+  return 0;
+}
+
+VAR_t posTimerStop(POSTIMER_t t)
+{
+  pthread_mutex_lock(&timerLock);
+  t->running = false;
+  pthread_mutex_unlock(&timerLock);
+  return 0;
+}
+
+VAR_t posTimerFired(POSTIMER_t t)
+{
+  int fired;
+
+  pthread_mutex_lock(&timerLock);
+  fired = t->fired;
+  t->fired = 0;
+  pthread_mutex_unlock(&timerLock);
+  return fired > 0;
+}
+
+/*
+ * Advance jiffies and run timers.
+ */
+static void* ticker(void* arg)
+{
+  struct timespec ts;
+  struct hostTimer* t;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  while (true) {
+
+    ts.tv_nsec += 1000000000L / HZ;
+    if (ts.tv_nsec >= 1000000000L) {
+
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000L;
+    }
+
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    ++jiffies;
+
+    pthread_mutex_lock(&timerLock);
+    for (t = timers; t != NULL; t = t->next) {
+
+      if (t->running && !POS_TIMEAFTER(t->expires, jiffies)) {
+
+        t->fired++;
+        if (t->sema != NULL)
+          posSemaSignal(t->sema);
+
+        if (t->reload)
+          t->expires += t->reload;
+        else
+          t->running = false;
+      }
+    }
+
+    pthread_mutex_unlock(&timerLock);
+  }
+
+  return NULL;
+}
+
+static void* taskStart(void* arg)
+{
+  struct hostTask* task = arg;
+
+  currentTask = task;
+  task->func(task->arg);
+  return NULL;
+}
+
+POSTASK_t posTaskCreate(POSTASKFUNC_t funcptr, void* funcarg, VAR_t priority, UINT_t stacksize)
+{
+  struct hostTask* task = calloc(1, sizeof(*task));
+
+  task->func = funcptr;
+  task->arg = funcarg;
+  if (pthread_create(&task->thread, NULL, taskStart, task) != 0) {
+
+    free(task);
+    return NULL;
+  }
+
+  pthread_detach(task->thread);
+  return task;
+}
+
+POSTASK_t posTaskGetCurrent()
+{
+  return currentTask;
+}
+
+void posTaskSleep(UINT_t ticks)
+{
+  struct timespec ts;
+
+  deadline(&ts, ticks);
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+void posTaskYield()
+{
+  sched_yield();
+}
+
+void posTaskSchedLock()
+{
+  pthread_mutex_lock(&schedLock);
+}
+
+void posTaskSchedUnlock()
+{
+  pthread_mutex_unlock(&schedLock);
+}
+
+void c_pos_intEnter()
+{
+}
+
+void c_pos_intExit()
+{
+}
+
+void nosPrintf(const char* fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  vprintf(fmt, ap);
+  va_end(ap);
+  fflush(stdout);
+}
+
+void nosPrint(const char* str)
+{
+  fputs(str, stdout);
+  fflush(stdout);
+}
+
+/*
+ * Start ticker and run first task in main thread.
+ * Process exits when first task returns.
+ */
+void nosInit(POSTASKFUNC_t firstfunc, void* funcarg, VAR_t priority,
+             UINT_t taskStackSize, UINT_t idleStackSize)
+{
+  static struct hostTask first;
+  pthread_t tick;
+
+  recursiveInit(&schedLock);
+  pthread_create(&tick, NULL, ticker, NULL);
+
+  first.thread = pthread_self();
+  first.func = firstfunc;
+  first.arg = funcarg;
+  currentTask = &first;
+
+  firstfunc(funcarg);
+  exit(0);
+}
+
+/*
+ * picoos-micro file table.
+ */
+static UosFile files[UOSCFG_MAX_OPEN_FILES];
+static bool fileUsed[UOSCFG_MAX_OPEN_FILES];
+
+int hostBittabAlloc(unsigned char* bits, int size)
+{
+  int i;
+
+  posTaskSchedLock();
+  for (i = 0; i < size; i++) {
+
+    if (!(bits[i / 8] & (1 << (i % 8)))) {
+
+      bits[i / 8] |= 1 << (i % 8);
+      posTaskSchedUnlock();
+      return i;
+    }
+  }
+
+  posTaskSchedUnlock();
+  return -1;
+}
+
+void uosSpinUSecs(uint16_t uSecs)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  ts.tv_nsec += uSecs * 1000L;
+  if (ts.tv_nsec >= 1000000000L) {
+
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000L;
+  }
+
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+UosFile* uosFileAlloc()
+{
+  int i;
+
+  posTaskSchedLock();
+  for (i = 0; i < UOSCFG_MAX_OPEN_FILES; i++) {
+
+    if (!fileUsed[i]) {
+
+      fileUsed[i] = true;
+      memset(&files[i], 0, sizeof(files[i]));
+      posTaskSchedUnlock();
+      return &files[i];
+    }
+  }
+
+  posTaskSchedUnlock();
+  return NULL;
+}
+
+void uosFileFree(UosFile* file)
+{
+  posTaskSchedLock();
+  fileUsed[file - files] = false;
+  posTaskSchedUnlock();
+}
+
+int uosFileClose(UosFile* file)
+{
+  return file->cf->close(file);
+}
+
+int uosFileRead(UosFile* file, void* buf, int max)
+{
+  return file->cf->read(file, buf, max);
+}
+
+int uosFileWrite(UosFile* file, const void* buf, int len)
+{
+  return file->cf->write(file, buf, len);
+}
+
+int uosFile2Slot(UosFile* file)
+{
+  return file - files;
+}
+
+UosFile* uosSlot2File(int slot)
+{
+  return &files[slot];
+}
+
+int uosMount(UosFS* fs)
+{
+  return fs->cf->init(fs);
+}
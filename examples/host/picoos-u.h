@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Minimal stand-in for picoos-micro API used by picoos-net,
+ * for building host harnesses without pico]OS tree.
+ */
+
+#ifndef _HOST_PICOOS_U_H
+#define _HOST_PICOOS_U_H
+
+#include <picoos.h>
+
+#define UOSCFG_MAX_OPEN_FILES 32
+
+typedef struct uosFS UosFS;
+typedef struct uosFile UosFile;
+
+typedef struct {
+
+  int (*init)(const UosFS* fs);
+} UosFSConf;
+
+typedef struct {
+
+  int (*close)(UosFile* file);
+  int (*read)(UosFile* file, char* buf, int max);
+  int (*write)(UosFile* file, const char* buf, int len);
+} UosFileConf;
+
+struct uosFS {
+
+  const UosFSConf* cf;
+  const char* mountPoint;
+};
+
+struct uosFile {
+
+  const UosFS* fs;
+  const UosFileConf* cf;
+  void* fsPriv;
+};
+
+UosFile* uosFileAlloc(void);
+void uosFileFree(UosFile* file);
+int uosFileClose(UosFile* file);
+int uosFileRead(UosFile* file, void* buf, int max);
+int uosFileWrite(UosFile* file, const void* buf, int len);
+int uosFile2Slot(UosFile* file);
+UosFile* uosSlot2File(int slot);
+int uosMount(UosFS* fs);
+
+void uosSpinUSecs(uint16_t uSecs);
+
+/*
+ * Bit-mapped allocation table.
+ */
+int hostBittabAlloc(unsigned char* bits, int size);
+
+#define UOS_BITTAB_TABLE(type, size) \
+  typedef struct { \
+    unsigned char bits[((size) + 7) / 8]; \
+    type elem[size]; \
+  } type##Bittab
+
+#define UOS_BITTAB_ALLOC(t) \
+  hostBittabAlloc((t).bits, sizeof((t).elem) / sizeof((t).elem[0]))
+
+#define UOS_BITTAB_FREE(t, i) \
+  do { \
+    posTaskSchedLock(); \
+    (t).bits[(i) / 8] &= ~(1 << ((i) % 8)); \
+    posTaskSchedUnlock(); \
+  } while (0)
+
+#define UOS_BITTAB_ELEM(t, i)    (&(t).elem[i])
+#define UOS_BITTAB_IS_FREE(t, i) (((t).bits[(i) / 8] & (1 << ((i) % 8))) == 0)
+#define UOS_BITTAB_SLOT(t, e)    ((e) - (t).elem)
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Minimal stand-in for pico]OS API used by picoos-net,
+ * for building host harnesses without pico]OS tree.
+ * Implemented with POSIX threads in host.c. Tasks are
+ * threads, so scheduling is not priority based and
+ * posTaskSchedLock is just a global recursive mutex.
+ */
+
+#ifndef _HOST_PICOOS_H
+#define _HOST_PICOOS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#define POS_VER_N 110
+
+typedef unsigned long JIF_t;
+typedef unsigned int  UINT_t;
+typedef int           INT_t;
+typedef unsigned int  UVAR_t;
+typedef int           VAR_t;
+
+typedef struct hostSema*  POSSEMA_t;
+typedef struct hostMutex* POSMUTEX_t;
+typedef struct hostFlag*  POSFLAG_t;
+typedef struct hostTimer* POSTIMER_t;
+typedef struct hostTask*  POSTASK_t;
+typedef void (*POSTASKFUNC_t)(void* arg);
+
+#define INFINITE  ((UINT_t)~0)
+#define HZ        1000
+#define MS(x)     ((x) * HZ / 1000)
+
+#define POSFLAG_MODE_GETSINGLE  0
+#define POSFLAG_MODE_GETMASK    1
+#define POSCFG_FEATURE_INHIBITSCHED 1
+
+extern volatile JIF_t jiffies;
+#define POS_TIMEAFTER(x, y) ((((long)(y)) - ((long)(x))) < 0)
+
+#define POS_SETEVENTNAME(e, n)
+#define POS_SETTASKNAME(t, n)
+
+#define P_ASSERT(text, x) \
+  do { \
+    if (!(x)) { \
+      fprintf(stderr, "assert %s: %s %s:%d\n", text, #x, __FILE__, __LINE__); \
+      abort(); \
+    } \
+  } while (0)
+
+POSSEMA_t posSemaCreate(INT_t initcount);
+VAR_t posSemaWait(POSSEMA_t sema, UINT_t timeout);
+VAR_t posSemaSignal(POSSEMA_t sema);
+void posSemaDestroy(POSSEMA_t sema);
+#define posSemaGet(s) posSemaWait(s, INFINITE)
+
+POSMUTEX_t posMutexCreate(void);
+VAR_t posMutexLock(POSMUTEX_t mutex);
+VAR_t posMutexTryLock(POSMUTEX_t mutex);
+VAR_t posMutexUnlock(POSMUTEX_t mutex);
+void posMutexDestroy(POSMUTEX_t mutex);
+
+POSFLAG_t posFlagCreate(void);
+VAR_t posFlagGet(POSFLAG_t flg, UVAR_t mode);
+VAR_t posFlagWait(POSFLAG_t flg, UINT_t timeout);
+VAR_t posFlagSet(POSFLAG_t flg, UVAR_t flgnum);
+void posFlagDestroy(POSFLAG_t flg);
+
+POSTIMER_t posTimerCreate(void);
+VAR_t posTimerSet(POSTIMER_t tmr, POSSEMA_t sema, UINT_t waittime, UINT_t periodictime);
+VAR_t posTimerStart(POSTIMER_t tmr);
+VAR_t posTimerStop(POSTIMER_t tmr);
+VAR_t posTimerFired(POSTIMER_t tmr);
+
+POSTASK_t posTaskCreate(POSTASKFUNC_t funcptr, void* funcarg, VAR_t priority, UINT_t stacksize);
+POSTASK_t posTaskGetCurrent(void);
+void posTaskSleep(UINT_t ticks);
+void posTaskYield(void);
+void posTaskSchedLock(void);
+void posTaskSchedUnlock(void);
+
+/*
+ * Unix port internals used by signal driven drivers.
+ * Interrupt context runs on separate stack and returns
+ * to context saved in posCurrentTask_g, so these work only
+ * when signal is handled by a single thread.
+ */
+#include <ucontext.h>
+
+#define PORTCFG_IRQ_STACK_SIZE  65536
+#define PORTCFG_MIN_STACK_SIZE  16384
+
+typedef struct {
+
+  ucontext_t ucontext;
+} HostPortTask;
+
+extern HostPortTask* posCurrentTask_g;
+
+void c_pos_intEnter(void);
+void c_pos_intExit(void);
+
+void nosInit(POSTASKFUNC_t firstfunc, void* funcarg, VAR_t priority,
+             UINT_t taskStackSize, UINT_t idleStackSize);
+void nosPrintf(const char* fmt, ...);
+void nosPrint(const char* str);
+
+#endif
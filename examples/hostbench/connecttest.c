@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Connection rate benchmark. Client connects to server
+ * task over loopback, waits for a one byte greeting
+ * and closes connection again, measuring full setup
+ * and teardown of a connection through socket layer.
+ *
+ * Client doesn't send anything before greeting, as
+ * connections waiting for accept don't receive data.
+ */
+
+#include <picoos.h>
+#include <picoos-u.h>
+#include <picoos-net.h>
+
+#include "hostbench.h"
+
+#define SERVER_PORT   7000
+#define CONNECTS      2000
+
+static volatile int accepted;
+static POSSEMA_t serverDone;
+
+/*
+ * Accept connections, send greeting and close
+ * connection when client closes it.
+ */
+static void serverTask(void* arg)
+{
+  UosFile* server = (UosFile*)arg;
+  UosFile* client;
+  uip_ipaddr_t peer;
+  char buf[16];
+  int len;
+
+  while (accepted < CONNECTS) {
+
+    client = netSockAccept(server, &peer);
+    if (client == NULL)
+      break;
+
+    ++accepted;
+    uosFileWrite(client, "+", 1);
+    do {
+
+      len = netSockRead(client, buf, sizeof(buf), MS(1000));
+    } while (len > 0 || len == NET_SOCK_TIMEOUT);
+
+    uosFileClose(client);
+  }
+
+  posSemaSignal(serverDone);
+}
+
+int connectTest()
+{
+  UosFile* server;
+  UosFile* client;
+  POSTASK_t task;
+  uint64_t start;
+  char greeting;
+  int failed = 0;
+  int i;
+
+  server = netSockCreateTCPServer(SERVER_PORT);
+  P_ASSERT("connectTest", server != NULL);
+  netSockListen(server);
+
+  serverDone = posSemaCreate(0);
+  task = posTaskCreate(serverTask, server, 2, 2000);
+  P_ASSERT("connectTest", task != NULL);
+
+  start = benchNanos();
+  for (i = 0; i < CONNECTS; i++) {
+
+    client = netSockCreateTCP(&benchAddr, SERVER_PORT);
+    if (client == NULL) {
+
+      BENCH_CHECK(client != NULL);
+      break;
+    }
+
+    BENCH_CHECK(netSockRead(client, &greeting, 1, MS(2000)) == 1);
+    uosFileClose(client);
+  }
+
+  benchReport("connect", "sequential", i, "connects", benchNanos() - start);
+
+  BENCH_CHECK(posSemaWait(serverDone, MS(2000)) == 0);
+  BENCH_CHECK(accepted == CONNECTS);
+
+  uosFileClose(server);
+  posSemaDestroy(serverDone);
+  return failed;
+}
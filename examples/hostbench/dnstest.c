@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * DNS resolver test. A stub nameserver task answers
+ * queries from a small table over loopback, counting
+ * queries so that caching and sharing of queries
+ * can be verified.
+ */
+
+#include <picoos.h>
+#include <picoos-u.h>
+#include <picoos-net.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <net/ip/uip-nameserver.h>
+
+#include "hostbench.h"
+
+#define STUB_PORT   53
+#define MSG_MAX     512
+
+typedef struct {
+
+  const char* name;
+  const char* cname;  // answer with CNAME to this first
+  uint8_t addr[4];
+  uint32_t ttl;
+} StubRecord;
+
+static const StubRecord records[] = {
+
+  { "host1.test", NULL,         { 10, 1, 2, 3 }, 60 },
+  { "host2.test", NULL,         { 10, 1, 2, 4 }, 60 },
+  { "short.test", NULL,         { 10, 1, 2, 5 }, 1 },
+  { "alias.test", "host1.test", { 10, 1, 2, 3 }, 60 },
+  { "other.test", NULL,         { 10, 1, 2, 6 }, 60 },
+  { "spoof.test", NULL,         { 10, 1, 2, 7 }, 60 },
+};
+
+#define RECORD_COUNT (int)(sizeof(records) / sizeof(records[0]))
+
+static volatile int queries;
+static volatile UINT_t replyDelay;
+
+/*
+ * Send an answer to other name with
+ * the same id before real answer.
+ */
+static volatile bool sendJunk;
+
+/*
+ * Convert query name to dotted form.
+ * Returns pointer after name or NULL.
+ */
+static const uint8_t* decodeName(const uint8_t* p, const uint8_t* end, char* name, int max)
+{
+  char* n = name;
+
+  while (p < end && *p != 0) {
+
+    if (*p > 63 || p + *p + 1 > end || n + *p + 2 > name + max)
+      return NULL;
+
+    if (n != name)
+      *n++ = '.';
+
+    memcpy(n, p + 1, *p);
+    n += *p;
+    p += *p + 1;
+  }
+
+  if (p >= end)
+    return NULL;
+
+  *n = '\0';
+  return p + 1;
+}
+
+static uint8_t* encodeName(uint8_t* p, const char* name)
+{
+  const char* dot;
+  int len;
+
+  while (*name) {
+
+    dot = strchr(name, '.');
+    len = dot ? dot - name : (int)strlen(name);
+    *p++ = len;
+    memcpy(p, name, len);
+    p += len;
+    name += len;
+    if (*name == '.')
+      ++name;
+  }
+
+  *p++ = 0;
+  return p;
+}
+
+static uint8_t* putRecord(uint8_t* p, uint16_t type, uint32_t ttl, const void* data, uint16_t len)
+{
+  *p++ = 0xc0;  // pointer to question name
+  *p++ = 12;
+  *p++ = type >> 8;
+  *p++ = type & 0xff;
+  *p++ = 0;
+  *p++ = 1;     // class IN
+  *p++ = ttl >> 24;
+  *p++ = ttl >> 16;
+  *p++ = ttl >> 8;
+  *p++ = ttl;
+  *p++ = len >> 8;
+  *p++ = len & 0xff;
+  memcpy(p, data, len);
+  return p + len;
+}
+
+static void stubTask(void* arg)
+{
+  UosFile* sock = (UosFile*)arg;
+  static uint8_t msg[MSG_MAX];
+  static uint8_t reply[MSG_MAX];
+  uint8_t cname[64];
+  char name[64];
+  const StubRecord* r;
+  const uint8_t* q;
+  uint8_t* p;
+  uip_ipaddr_t addr;
+  uint16_t port;
+  int len;
+  int i;
+
+  while (1) {
+
+    len = netSockRecvFrom(sock, msg, sizeof(msg), &addr, &port, MS(1000));
+    if (len < 12)
+      continue;
+
+    q = decodeName(msg + 12, msg + len, name, sizeof(name));
+    if (q == NULL || q + 4 > msg + len)
+      continue;
+
+    q += 4;  // type & class
+    ++queries;
+
+    r = NULL;
+    for (i = 0; i < RECORD_COUNT; i++)
+      if (!strcmp(records[i].name, name))
+        r = &records[i];
+
+    memcpy(reply, msg, q - msg);
+    reply[2] = 0x81;  // QR, RD
+    reply[3] = r ? 0x80 : 0x83;  // RA, NXDOMAIN if not found
+    reply[6] = 0;
+    reply[7] = 0;
+    reply[8] = reply[9] = reply[10] = reply[11] = 0;
+    p = reply + (q - msg);
+
+    if (r != NULL) {
+
+      if (r->cname) {
+
+        p = putRecord(p, 5, r->ttl, cname, encodeName(cname, r->cname) - cname);
+        ++reply[7];
+      }
+
+      p = putRecord(p, 1, r->ttl, r->addr, 4);
+      ++reply[7];
+    }
+
+    if (replyDelay)
+      posTaskSleep(replyDelay);
+
+    if (sendJunk && r != NULL) {
+
+      static const uint8_t evil[4] = { 6, 6, 6, 6 };
+
+      reply[13] ^= 0x01;
+      memcpy(p - 4, evil, 4);
+      netSockSendTo(sock, reply, p - reply, &addr, port);
+
+      reply[13] ^= 0x01;
+      memcpy(p - 4, r->addr, 4);
+    }
+
+    netSockSendTo(sock, reply, p - reply, &addr, port);
+  }
+}
+
+typedef struct {
+
+  POSSEMA_t done;
+  uip_ipaddr_t addr;
+  bool ok;
+} AsyncResult;
+
+static void asyncDone(void* arg, const char* name, const uip_ipaddr_t* addr)
+{
+  AsyncResult* r = (AsyncResult*)arg;
+
+  r->ok = addr != NULL;
+  if (addr != NULL)
+    uip_ipaddr_copy(&r->addr, addr);
+
+  posSemaSignal(r->done);
+}
+
+static bool addrIs(const uip_ipaddr_t* a, int b0, int b1, int b2, int b3)
+{
+  uip_ipaddr_t b;
+
+  uip_ipaddr(&b, b0, b1, b2, b3);
+  return uip_ipaddr_cmp(a, &b);
+}
+
+int dnsTest()
+{
+  UosFile* sock;
+  POSTASK_t task;
+  NetResolveReq req1, req2;
+  AsyncResult r1, r2;
+  struct addrinfo* ai;
+  uip_ipaddr_t addr;
+  uip_ipaddr_t dead;
+  uint64_t start;
+  int failed = 0;
+  int before;
+  int i;
+
+  sock = netSockAlloc(NET_SOCK_UNDEF_UDP);
+  P_ASSERT("dnsTest", sock != NULL);
+  netSockBind(sock, STUB_PORT);
+  P_ASSERT("dnsTest", netSockConnect(sock, NULL, 0) == 0);
+
+  task = posTaskCreate(stubTask, sock, 2, 2000);
+  P_ASSERT("dnsTest", task != NULL);
+
+  uip_nameserver_update(&benchAddr, UIP_NAMESERVER_INFINITE_LIFETIME);
+
+// Plain lookup and cache hit.
+
+  memset(&addr, 0, sizeof(addr));
+  BENCH_CHECK(netResolve("host1.test", &addr, MS(3000)) == 0);
+  BENCH_CHECK(addrIs(&addr, 10, 1, 2, 3));
+  BENCH_CHECK(queries == 1);
+
+  start = benchNanos();
+  for (i = 0; i < 10000; i++)
+    BENCH_CHECK(netResolve("HOST1.test", &addr, MS(3000)) == 0);
+
+  benchReport("dns", "cached", 10000, "lookups", benchNanos() - start);
+  BENCH_CHECK(queries == 1);
+
+// Numeric addresses are not sent to server.
+
+  BENCH_CHECK(netResolve("10.9.8.7", &addr, MS(3000)) == 0);
+  BENCH_CHECK(addrIs(&addr, 10, 9, 8, 7));
+  BENCH_CHECK(queries == 1);
+
+// Concurrent lookups of same name share the query.
+
+  replyDelay = MS(200);
+  r1.done = posSemaCreate(0);
+  r2.done = posSemaCreate(0);
+  BENCH_CHECK(netResolveAsync(&req1, "host2.test", asyncDone, &r1) == 0);
+  BENCH_CHECK(netResolveAsync(&req2, "host2.test", asyncDone, &r2) == 0);
+  BENCH_CHECK(posSemaWait(r1.done, MS(3000)) == 0);
+  BENCH_CHECK(posSemaWait(r2.done, MS(3000)) == 0);
+  BENCH_CHECK(r1.ok && addrIs(&r1.addr, 10, 1, 2, 4));
+  BENCH_CHECK(r2.ok && addrIs(&r2.addr, 10, 1, 2, 4));
+  BENCH_CHECK(queries == 2);
+  posSemaDestroy(r1.done);
+  posSemaDestroy(r2.done);
+  replyDelay = 0;
+
+// CNAME record before address is skipped.
+
+  BENCH_CHECK(netResolve("alias.test", &addr, MS(3000)) == 0);
+  BENCH_CHECK(addrIs(&addr, 10, 1, 2, 3));
+  BENCH_CHECK(queries == 3);
+
+// Answer is dropped from cache when TTL expires.
+
+  BENCH_CHECK(netResolve("short.test", &addr, MS(3000)) == 0);
+  BENCH_CHECK(netResolve("short.test", &addr, MS(3000)) == 0);
+  BENCH_CHECK(queries == 4);
+  posTaskSleep(MS(1500));
+  BENCH_CHECK(netResolve("short.test", &addr, MS(3000)) == 0);
+  BENCH_CHECK(addrIs(&addr, 10, 1, 2, 5));
+  BENCH_CHECK(queries == 5);
+
+// Error answer fails without retries.
+
+  BENCH_CHECK(netResolve("missing.test", &addr, MS(3000)) == -1);
+  BENCH_CHECK(queries == 6);
+
+// Answer to another question with matching
+// id is ignored.
+
+  sendJunk = true;
+  BENCH_CHECK(netResolve("spoof.test", &addr, MS(3000)) == 0);
+  BENCH_CHECK(addrIs(&addr, 10, 1, 2, 7));
+  BENCH_CHECK(queries == 7);
+  sendJunk = false;
+
+// Blocking BSD api.
+
+  BENCH_CHECK(getaddrinfo("host1.test", "80", NULL, &ai) == 0);
+  if (ai != NULL) {
+
+    BENCH_CHECK(addrIs(&((struct sockaddr_in*)ai->ai_addr)->sin_addr.uip, 10, 1, 2, 3));
+    BENCH_CHECK(((struct sockaddr_in*)ai->ai_addr)->sin_port == uip_htons(80));
+    freeaddrinfo(ai);
+  }
+
+// Server that doesn't answer is skipped after timeout.
+// Nobody answers ARP for 127.0.0.2 on loopback.
+
+  uip_ipaddr(&dead, 127, 0, 0, 2);
+  uip_nameserver_update(&benchAddr, 0);
+  uip_nameserver_update(&dead, UIP_NAMESERVER_INFINITE_LIFETIME);
+  uip_nameserver_update(&benchAddr, UIP_NAMESERVER_INFINITE_LIFETIME);
+
+  before = queries;
+  start = benchNanos();
+  BENCH_CHECK(netResolve("other.test", &addr, MS(10000)) == 0);
+  BENCH_CHECK(addrIs(&addr, 10, 1, 2, 6));
+  BENCH_CHECK(queries == before + 1);
+  BENCH_CHECK(benchNanos() - start >= 900000000ULL);
+
+  return failed;
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Host test and benchmark harness. Stack is configured
+ * with loopback driver, so tests run servers and clients
+ * as tasks of the same program.
+ */
+
+#include <picoos.h>
+#include <picoos-u.h>
+#include <picoos-net.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "hostbench.h"
+
+typedef struct {
+
+  const char* name;
+  BenchTestFunc func;
+} BenchTest;
+
+static const BenchTest tests[] = {
+
+  { "dns",      dnsTest },
+  { "connect",  connectTest },
+  { "readline", readlineTest },
+  { "telnet",   telnetTest },
+  { "udp",      udpTest },
+  { "mtu",      mtuTest },
+};
+
+#define TEST_COUNT (int)(sizeof(tests) / sizeof(tests[0]))
+
+static int    argCount;
+static char** args;
+
+uip_ipaddr_t benchAddr;
+
+uint64_t benchNanos()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void benchReport(const char* test, const char* what, uint64_t count, const char* unit, uint64_t nanos)
+{
+  if (nanos == 0)
+    nanos = 1;
+
+  nosPrintf("%s: %s %lu %s in %lu ms, %lu %s/s\n", test, what,
+            (unsigned long)count, unit, (unsigned long)(nanos / 1000000),
+            (unsigned long)(count * 1000000000ULL / nanos), unit);
+}
+
+/*
+ * Send a datagram to ourselves, so ARP entry for
+ * loopback address exists before tests start.
+ * Otherwise first packet of first test is replaced
+ * by ARP request and gets retransmitted much later.
+ */
+static void arpWarmup(void)
+{
+  UosFile* sock;
+
+  sock = netSockCreateUDP(&benchAddr, 9);
+  P_ASSERT("arpWarmup", sock != NULL);
+
+  netSockSendTo(sock, "", 1, &benchAddr, 9);
+  posTaskSleep(MS(100));
+  uosFileClose(sock);
+}
+
+static bool selected(const char* name)
+{
+  int i;
+
+  if (argCount <= 1)
+    return true;
+
+  for (i = 1; i < argCount; i++)
+    if (!strcmp(args[i], name))
+      return true;
+
+  return false;
+}
+
+static void mainTask(void* arg)
+{
+  static const struct uip_eth_addr mac = {{ 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 }};
+  uip_ipaddr_t mask;
+  int failed = 0;
+  int i;
+
+  netInit();
+
+  uip_ipaddr(&benchAddr, 127, 0, 0, 1);
+  uip_ipaddr(&mask, 255, 0, 0, 0);
+  uip_sethostaddr(&benchAddr);
+  uip_setnetmask(&mask);
+  uip_setethaddr(mac);
+
+  arpWarmup();
+
+  for (i = 0; i < TEST_COUNT; i++) {
+
+    if (!selected(tests[i].name))
+      continue;
+
+    nosPrintf("%s: start\n", tests[i].name);
+    if (tests[i].func() != 0) {
+
+      nosPrintf("%s: FAILED\n", tests[i].name);
+      ++failed;
+    }
+    else
+      nosPrintf("%s: ok\n", tests[i].name);
+  }
+
+  exit(failed ? 1 : 0);
+}
+
+int main(int argc, char** argv)
+{
+  argCount = argc;
+  args = argv;
+
+  nosInit(mainTask, NULL, 1, 8000, 1000);
+  return 0;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Common definitions for host harness tests.
+ */
+
+#include <stdint.h>
+
+/*
+ * Test entry point. Returns number of failed checks.
+ */
+typedef int (*BenchTestFunc)(void);
+
+/*
+ * Loopback address of stack.
+ */
+extern uip_ipaddr_t benchAddr;
+
+/*
+ * Monotonic time in nanoseconds.
+ */
+uint64_t benchNanos(void);
+
+/*
+ * Print a benchmark result line.
+ */
+void benchReport(const char* test, const char* what, uint64_t count, const char* unit, uint64_t nanos);
+
+/*
+ * Check a condition, print failure and
+ * count it in variable 'failed' of caller.
+ */
+#define BENCH_CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      nosPrintf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      ++failed; \
+    } \
+  } while (0)
+
+int dnsTest(void);
+int connectTest(void);
+int readlineTest(void);
+int telnetTest(void);
+int udpTest(void);
+int mtuTest(void);
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Check that TCP segments fit into interface mtu.
+ * Interface mtu is lowered below UIP_TCP_MSS and a block
+ * of data is sent over loopback. Without MSS limited by
+ * mtu interface would drop every full-sized segment.
+ */
+
+#include <picoos.h>
+#include <picoos-u.h>
+#include <picoos-net.h>
+#include <string.h>
+
+#include "hostbench.h"
+
+#define SERVER_PORT   7200
+#define TEST_MTU      576
+#define DATA_SIZE     8192
+
+static char data[DATA_SIZE];
+static POSSEMA_t serverDone;
+
+static void serverTask(void* arg)
+{
+  UosFile* server = (UosFile*)arg;
+  UosFile* client;
+  uip_ipaddr_t peer;
+
+  client = netSockAccept(server, &peer);
+  if (client != NULL) {
+
+    uosFileWrite(client, data, sizeof(data));
+    uosFileClose(client);
+  }
+
+  posSemaSignal(serverDone);
+}
+
+int mtuTest()
+{
+  static char buf[DATA_SIZE];
+  NetInterface* ifc;
+  UosFile* server;
+  UosFile* client;
+  POSTASK_t task;
+  uint16_t oldMtu;
+  uint32_t oldDrops;
+  int failed = 0;
+  int total;
+  int len;
+  int i;
+
+  for (i = 0; i < DATA_SIZE; i++)
+    data[i] = i * 7;
+
+  ifc = netInterfaceRoute(&benchAddr);
+  P_ASSERT("mtuTest", ifc != NULL);
+
+  oldMtu = ifc->mtu;
+  oldDrops = ifc->mtuDrops;
+  ifc->mtu = TEST_MTU;
+
+  server = netSockCreateTCPServer(SERVER_PORT);
+  P_ASSERT("mtuTest", server != NULL);
+  netSockListen(server);
+
+  serverDone = posSemaCreate(0);
+  task = posTaskCreate(serverTask, server, 2, 2000);
+  P_ASSERT("mtuTest", task != NULL);
+
+  total = 0;
+  client = netSockCreateTCP(&benchAddr, SERVER_PORT);
+  BENCH_CHECK(client != NULL);
+  if (client != NULL) {
+
+    while (total < DATA_SIZE) {
+
+      len = netSockRead(client, buf + total, DATA_SIZE - total, MS(2000));
+      if (len <= 0)
+        break;
+
+      total += len;
+    }
+
+    uosFileClose(client);
+  }
+
+  BENCH_CHECK(total == DATA_SIZE);
+  BENCH_CHECK(!memcmp(buf, data, DATA_SIZE));
+  BENCH_CHECK(ifc->mtuDrops == oldDrops);
+
+  BENCH_CHECK(posSemaWait(serverDone, MS(2000)) == 0);
+  uosFileClose(server);
+  posSemaDestroy(serverDone);
+
+  ifc->mtu = oldMtu;
+  return failed;
+}
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Line reading benchmark. Server task sends CRLF
+ * terminated lines with lengths taken from a few
+ * distributions seen in practice, client reads them
+ * with netSockReadLine and verifies each line.
+ */
+
+#include <picoos.h>
+#include <picoos-u.h>
+#include <picoos-net.h>
+#include <string.h>
+
+#include "hostbench.h"
+
+#define SERVER_PORT   7001
+#define STREAM_BYTES  (256 * 1024L)
+#define LINE_MAX      1500
+#define WRITE_CHUNK   4096
+
+typedef struct {
+
+  const char* name;
+  uint16_t    min;
+  uint16_t    max;
+  uint8_t     longPct;  // percentage of lines from long range
+  uint16_t    longMin;
+  uint16_t    longMax;
+} LineDist;
+
+static const LineDist dists[] = {
+
+  { "cli",       4,  40,  0, 0,   0    },  // short commands and replies
+  { "telemetry", 40, 160, 0, 0,   0    },  // text records
+  { "log",       80, 400, 0, 0,   0    },  // log messages
+  { "mixed",     8,  80,  10, 200, 1400 }, // mostly short, some dumps
+};
+
+#define DIST_COUNT (int)(sizeof(dists) / sizeof(dists[0]))
+
+static POSSEMA_t serverDone;
+
+static uint32_t nextRandom(uint32_t* state)
+{
+  uint32_t x = *state;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+/*
+ * Generate next line, including CRLF.
+ * Returns line length.
+ */
+static int makeLine(const LineDist* d, uint32_t* state, uint32_t lineNo, char* line)
+{
+  int len;
+  int i;
+
+  if (d->longPct && nextRandom(state) % 100 < d->longPct)
+    len = d->longMin + nextRandom(state) % (d->longMax - d->longMin + 1);
+  else
+    len = d->min + nextRandom(state) % (d->max - d->min + 1);
+
+  for (i = 0; i < len - 2; i++)
+    line[i] = 'a' + (lineNo + i) % 26;
+
+  line[len - 2] = '\r';
+  line[len - 1] = '\n';
+  return len;
+}
+
+/*
+ * Accept one connection per distribution and
+ * send lines to it.
+ */
+static void serverTask(void* arg)
+{
+  UosFile* server = (UosFile*)arg;
+  UosFile* client;
+  static char buf[WRITE_CHUNK + LINE_MAX];
+  uip_ipaddr_t peer;
+  uint32_t state;
+  uint32_t lineNo;
+  long sent;
+  int len;
+  int d;
+
+  for (d = 0; d < DIST_COUNT; d++) {
+
+    client = netSockAccept(server, &peer);
+    if (client == NULL)
+      break;
+
+    state = 12345;
+    lineNo = 0;
+    sent = 0;
+    len = 0;
+
+    while (sent < STREAM_BYTES) {
+
+      len += makeLine(&dists[d], &state, lineNo++, buf + len);
+      if (len >= WRITE_CHUNK) {
+
+        if (uosFileWrite(client, buf, len) != len)
+          break;
+
+        sent += len;
+        len = 0;
+      }
+    }
+
+    if (len > 0)
+      uosFileWrite(client, buf, len);
+
+    uosFileClose(client);
+  }
+
+  posSemaSignal(serverDone);
+}
+
+int readlineTest()
+{
+  UosFile* server;
+  UosFile* client;
+  POSTASK_t task;
+  static char line[LINE_MAX + 1];
+  static char expected[LINE_MAX];
+  uint32_t state;
+  uint32_t lineNo;
+  uint64_t start;
+  uint64_t bytes;
+  int failed = 0;
+  int len;
+  int exp;
+  int d;
+
+  server = netSockCreateTCPServer(SERVER_PORT);
+  P_ASSERT("readlineTest", server != NULL);
+  netSockListen(server);
+
+  serverDone = posSemaCreate(0);
+  task = posTaskCreate(serverTask, server, 2, 2000);
+  P_ASSERT("readlineTest", task != NULL);
+
+  for (d = 0; d < DIST_COUNT; d++) {
+
+    client = netSockCreateTCP(&benchAddr, SERVER_PORT);
+    if (client == NULL) {
+
+      BENCH_CHECK(client != NULL);
+      break;
+    }
+
+    state = 12345;
+    lineNo = 0;
+    bytes = 0;
+
+    start = benchNanos();
+    while ((len = netSockReadLine(client, line, sizeof(line), MS(2000))) > 0) {
+
+      // Reader gets line without CR.
+      exp = makeLine(&dists[d], &state, lineNo++, expected);
+      expected[exp - 2] = '\n';
+      --exp;
+
+      if (len != exp || memcmp(line, expected, len)) {
+
+        BENCH_CHECK(len == exp && !memcmp(line, expected, len));
+        break;
+      }
+
+      bytes += len + 1;
+    }
+
+    benchReport("readline", dists[d].name, lineNo, "lines", benchNanos() - start);
+    benchReport("readline", dists[d].name, bytes / 1024, "KB", benchNanos() - start);
+
+    BENCH_CHECK(len == NET_SOCK_EOF);
+    BENCH_CHECK(bytes >= STREAM_BYTES);
+    uosFileClose(client);
+  }
+
+  BENCH_CHECK(posSemaWait(serverDone, MS(2000)) == 0);
+
+  uosFileClose(server);
+  posSemaDestroy(serverDone);
+  return failed;
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Telnet CLI benchmark. Server task runs a minimal
+ * CLI with telnetReadLine and answers "dump" command
+ * by writing 100 KB of text lines with telnetWrite.
+ * Client decodes telnet stream and verifies it.
+ */
+
+#include <picoos.h>
+#include <picoos-u.h>
+#include <picoos-net.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hostbench.h"
+
+#define SERVER_PORT   7023
+#define DUMP_BYTES    (100 * 1024L)
+#define TELNET_IAC    255
+
+static POSSEMA_t serverDone;
+
+/*
+ * Generate line number n of dump. Every 16th
+ * line contains an IAC character, which must
+ * be escaped by telnetWrite.
+ */
+static int dumpLine(uint32_t n, char* line)
+{
+  int len;
+
+  len = sprintf(line, "%6lu: rx 1234567 tx 7654321 err 0 state running%s\n",
+                (unsigned long)n, (n % 16) == 0 ? "\377" : "");
+  return len;
+}
+
+static void serverTask(void* arg)
+{
+  UosFile* server = (UosFile*)arg;
+  UosFile* client;
+  static NetTelnet telnet;
+  uip_ipaddr_t peer;
+  char cmd[40];
+  char line[80];
+  uint32_t n;
+  long sent;
+
+  client = netSockAccept(server, &peer);
+  if (client == NULL) {
+
+    posSemaSignal(serverDone);
+    return;
+  }
+
+  telnetInit(&telnet, uosFile2Slot(client));
+  telnetWrite(&telnet, "> ");
+  telnetFlush(&telnet);
+
+  if (telnetReadLine(&telnet, cmd, sizeof(cmd), 2000) > 0 && !strcmp(cmd, "dump\n")) {
+
+    sent = 0;
+    n = 0;
+    while (sent < DUMP_BYTES) {
+
+      sent += dumpLine(n++, line);
+      telnetWrite(&telnet, line);
+    }
+
+    telnetFlush(&telnet);
+  }
+
+  uosFileClose(client);
+  posSemaSignal(serverDone);
+}
+
+int telnetTest()
+{
+  UosFile* server;
+  UosFile* client;
+  POSTASK_t task;
+  static uint8_t buf[1500];
+  char line[80];
+  int lineLen = 0;
+  int linePos = 0;
+  uint32_t n = 0;
+  bool iac = false;
+  bool cr = false;
+  bool match = true;
+  uint64_t start;
+  long bytes = 0;
+  int failed = 0;
+  int len;
+  int i;
+  uint8_t c;
+
+  server = netSockCreateTCPServer(SERVER_PORT);
+  P_ASSERT("telnetTest", server != NULL);
+  netSockListen(server);
+
+  serverDone = posSemaCreate(0);
+  task = posTaskCreate(serverTask, server, 2, 2000);
+  P_ASSERT("telnetTest", task != NULL);
+
+  client = netSockCreateTCP(&benchAddr, SERVER_PORT);
+  P_ASSERT("telnetTest", client != NULL);
+
+  // Wait for prompt, then request dump.
+  BENCH_CHECK(netSockRead(client, buf, sizeof(buf), MS(2000)) == 2 && !memcmp(buf, "> ", 2));
+
+  start = benchNanos();
+  uosFileWrite(client, "dump\r\n", 6);
+
+  while (match && (len = netSockRead(client, buf, sizeof(buf), MS(2000))) > 0) {
+
+    for (i = 0; i < len && match; i++) {
+
+      c = buf[i];
+
+      // Undo IAC doubling and CRLF translation.
+      if (iac) {
+
+        iac = false;
+        if (c != TELNET_IAC)
+          continue;
+      }
+      else if (c == TELNET_IAC) {
+
+        iac = true;
+        continue;
+      }
+      else if (cr) {
+
+        cr = false;
+        if (c != '\n')
+          match = false;
+      }
+      else if (c == '\r') {
+
+        cr = true;
+        continue;
+      }
+
+      if (linePos == lineLen) {
+
+        lineLen = dumpLine(n++, line);
+        linePos = 0;
+      }
+
+      if ((uint8_t)line[linePos++] != c)
+        match = false;
+
+      ++bytes;
+    }
+  }
+
+  benchReport("telnet", "dump", bytes / 1024, "KB", benchNanos() - start);
+
+  BENCH_CHECK(match);
+  BENCH_CHECK(linePos == lineLen);
+  BENCH_CHECK(bytes >= DUMP_BYTES);
+  BENCH_CHECK(posSemaWait(serverDone, MS(2000)) == 0);
+
+  uosFileClose(client);
+  uosFileClose(server);
+  posSemaDestroy(serverDone);
+  return failed;
+}
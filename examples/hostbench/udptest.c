@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * UDP test for BSD socket api. Also checks that datagrams
+ * that don't fit into uIP buffer are refused instead of
+ * overrunning it or being truncated.
+ */
+
+#include <picoos.h>
+#include <picoos-u.h>
+#include <picoos-net.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+
+#include "hostbench.h"
+
+#define UDP_PORT  7100
+
+static char buf[65536];
+static char big[NET_SOCK_MAX_DGRAM + 1];
+
+int udpTest()
+{
+  struct sockaddr_in addr;
+  struct sockaddr_in from;
+  socklen_t fromLen;
+  struct timeval tv;
+  struct mmsghdr vec[3];
+  struct iovec iov[3];
+  int failed = 0;
+  int rx, tx;
+  int i;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = uip_htons(UDP_PORT);
+  uip_ipaddr_copy(&addr.sin_addr.uip, &benchAddr);
+
+  rx = socket(AF_INET, SOCK_DGRAM, 0);
+  tx = socket(AF_INET, SOCK_DGRAM, 0);
+  BENCH_CHECK(rx >= 0 && tx >= 0);
+  BENCH_CHECK(bind(rx, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+
+  tv.tv_sec = 0;
+  tv.tv_usec = 100000;
+  setsockopt(rx, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+// Bound socket starts receiving on first read.
+
+  BENCH_CHECK(recvfrom(rx, buf, sizeof(buf), 0, NULL, NULL) == -1);
+
+// Buffer size above 65535 doesn't truncate datagram.
+
+  BENCH_CHECK(sendto(tx, "hello", 5, 0, (struct sockaddr*)&addr, sizeof(addr)) == 5);
+  fromLen = sizeof(from);
+  BENCH_CHECK(recvfrom(rx, buf, sizeof(buf), 0, (struct sockaddr*)&from, &fromLen) == 5);
+  BENCH_CHECK(!memcmp(buf, "hello", 5));
+  BENCH_CHECK(uip_ipaddr_cmp(&from.sin_addr.uip, &benchAddr));
+
+// Too long datagram is refused.
+
+  errno = 0;
+  BENCH_CHECK(sendto(tx, big, sizeof(big), 0, (struct sockaddr*)&addr, sizeof(addr)) == -1);
+  BENCH_CHECK(errno == EMSGSIZE);
+
+// sendmmsg stops at too long datagram.
+
+  iov[0].iov_base = "a";
+  iov[0].iov_len = 1;
+  iov[1].iov_base = big;
+  iov[1].iov_len = sizeof(big);
+  iov[2].iov_base = "b";
+  iov[2].iov_len = 1;
+
+  memset(vec, 0, sizeof(vec));
+  for (i = 0; i < 3; i++) {
+
+    vec[i].msg_hdr.msg_name = &addr;
+    vec[i].msg_hdr.msg_namelen = sizeof(addr);
+    vec[i].msg_hdr.msg_iov = &iov[i];
+    vec[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  BENCH_CHECK(sendmmsg(tx, vec, 3, 0) == 1);
+  BENCH_CHECK(recvfrom(rx, buf, sizeof(buf), 0, NULL, NULL) == 1 && buf[0] == 'a');
+
+  errno = 0;
+  BENCH_CHECK(sendmmsg(tx, vec + 1, 2, 0) == -1);
+  BENCH_CHECK(errno == EMSGSIZE);
+
+// Largest datagram still fits.
+
+  BENCH_CHECK(sendto(tx, big, NET_SOCK_MAX_DGRAM, 0, (struct sockaddr*)&addr, sizeof(addr)) == NET_SOCK_MAX_DGRAM);
+  BENCH_CHECK(recvfrom(rx, buf, 16, 0, NULL, NULL) == 16);
+
+  net_close(rx);
+  net_close(tx);
+  return failed;
+}
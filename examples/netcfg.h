@@ -43,11 +43,16 @@
 
 /**
  * Max number of connections. If using socket layer (::NETCFG_SOCKETS == 1)
- * Each socket consumes one Pico]OS mutex and two flags. In addition to that, 
- * network main loop uses one semaphore and one mutex. If uIP listen is enabled to 
+ * Each socket consumes one Pico]OS mutex and two flags, which are created
+ * by netInit for every socket table entry (connections, UDP connections and
+ * listen ports) and reused. In addition to that, 
+ * network main loop uses one semaphore and each listen port
+ * one semaphore for accept. If uIP listen is enabled to 
  * accept incoming connections, a task is required for each connection. 
- * So if number of connections is for example 4, 5 * 3 + 2 Pico]OS events are needed.
- * If using ::NOSCFG_FEATURE_CONOUT add 2 to that, which gives us 19 event objects.
+ * So with 4 connections, 1 UDP connection and 2 listen ports 7 * 3 + 1 + 2
+ * Pico]OS events are needed. If using ::NOSCFG_FEATURE_CONOUT add 2 to that,
+ * which gives us 26 event objects.
+ * Socket layer requires ::POSCFG_FEATURE_INHIBITSCHED.
  *
  * Number of tasks needed for tcp sockets is 4, but network system itself uses one
  * tasks and we must also have main and idle tasks. This results in 7 tasks.
@@ -121,6 +126,146 @@
  */
 #define NETCFG_TELNETD 1
 
+/**
+ * Telnet receive and transmit buffer sizes. Output is
+ * sent when transmit buffer fills up, so larger buffer
+ * means fewer segments for large outputs.
+ */
+#define NETCFG_TELNET_INBUF 80
+#define NETCFG_TELNET_OUTBUF 256
+
+/**
+ * Maximum number of established connections queued per
+ * listening socket, waiting for netSockAccept. Further
+ * connections are aborted. Backlog given to listen()
+ * is limited to this.
+ */
+#define NETCFG_LISTEN_BACKLOG 4
+
+/**
+ * Number of received UDP datagrams that can be queued
+ * for all UDP sockets when there is no reader waiting.
+ * Datagrams arriving when queue is full are dropped.
+ */
+#define NETCFG_UDP_RXQUEUE 4
+
+/**
+ * Maximum size of queued UDP datagram. Longer datagrams
+ * are truncated when queued. Datagram that is passed directly
+ * to waiting reader is limited only by reader's buffer size.
+ */
+#define NETCFG_UDP_RXSIZE 128
+
+/**
+ * Number of datagrams net_recvmmsg and net_sendmmsg pass to
+ * netSockRecvBatch or netSockSendBatch in one call. Larger vectors
+ * are handled in groups of this size, so datagrams of one
+ * net_sendmmsg call are sent during one main loop pass only
+ * if there are at most this many of them.
+ * Each entry takes a ::NetSockDgram from caller's stack.
+ */
+#define NETCFG_MMSG_BATCH 8
+
+/**
+ * Set to 1 to include TCP keepalive support, see
+ * ::netSockKeepalive and SO_KEEPALIVE socket option.
+ * NETCFG_TCP_KEEPIDLE, NETCFG_TCP_KEEPINTVL and NETCFG_TCP_KEEPCNT
+ * give default idle time before first probe (seconds),
+ * time between probes (seconds) and number of unanswered
+ * probes before connection is aborted.
+ */
+#define NETCFG_TCP_KEEPALIVE 0
+#define NETCFG_TCP_KEEPIDLE 120
+#define NETCFG_TCP_KEEPINTVL 10
+#define NETCFG_TCP_KEEPCNT 5
+
+/**
+ * Abort established TCP connection if nothing has been
+ * received from peer in this many seconds, freeing the
+ * connection slot. Zero disables idle timeout.
+ */
+#define NETCFG_TCP_IDLE_TIMEOUT 0
+
+/**
+ * Set to 1 to include DNS resolver. Resolver uses
+ * one UDP connection, a task, a mutex and a semaphore.
+ * Each blocking lookup uses a semaphore while waiting.
+ * Nameservers are taken from uip-nameserver module,
+ * DHCP client updates them automatically.
+ */
+#define NETCFG_DNS 1
+
+/**
+ * Number of names kept in DNS resolver cache.
+ */
+#define NETCFG_DNS_CACHE_SIZE 4
+
+/**
+ * Priority and stack size of DNS resolver task.
+ */
+#define NETCFG_DNS_TASK_PRIO 1
+#define NETCFG_DNS_STACK_SIZE 1000
+
+/**
+ * Number of addrinfo results that can be
+ * in use at the same time with net_getaddrinfo.
+ */
+#define NETCFG_ADDRINFO_COUNT 2
+
+/**
+ * Set to 1 to collect socket layer statistics:
+ * per-socket byte and segment counters, main loop timing
+ * and latency histograms. See ::netStatsDump.
+ */
+#define NETCFG_STATS 0
+
+/**
+ * Set to 1 to include packet capture ring. Ethernet layer
+ * copies frames (truncated to ::NETCFG_CAPTURE_SNAPLEN bytes)
+ * into a ring of ::NETCFG_CAPTURE_COUNT entries, which can
+ * be exported in pcap format. See ::netCaptureStart.
+ */
+#define NETCFG_CAPTURE 0
+
+/**
+ * Number of frames kept in capture ring.
+ */
+#define NETCFG_CAPTURE_COUNT 16
+
+/**
+ * Number of bytes stored from each captured frame.
+ */
+#define NETCFG_CAPTURE_SNAPLEN 96
+
+/**
+ * Set to 1 on host builds to allow saving captured
+ * frames directly to a file with ::netCaptureSave.
+ */
+#define NETCFG_CAPTURE_HOSTFILE 0
+
+/**
+ * Set to 0 if all network interfaces are added with
+ * netInterfaceAdd. By default an interface using global
+ * netInterfaceInit, netInterfacePoll and netInterfaceXmit
+ * functions (provided by driver selected with value 2 below or
+ * by application) is added automatically.
+ *
+ * Outgoing packets are routed to interfaces by library's
+ * netInterfaceOutput, which is included when driver is selected
+ * with value 2 or when this is 0. If application provides legacy
+ * interface functions without default driver, it must also provide
+ * netInterfaceOutput, which bypasses routing.
+ */
+#define NETCFG_LEGACY_INTERFACE 1
+
+/**
+ * Set to 1 to send socket data directly from socket
+ * buffer to device driver, without copying it to uip_buf first.
+ * Drivers without scatter-gather transmit (::netInterfaceXmitv)
+ * still get the whole packet in uip_buf.
+ */
+#define NETCFG_XMITV 0
+
 /**
  * Unix TAP driver configuration.
  * - 0: Don't compile driver
@@ -129,6 +274,33 @@
  */
 #define NETCFG_DRIVER_TAP 2
 
+/**
+ * Unix HDLC bridge driver configuration. Driver sends ethernet
+ * frames in PPP/HDLC-like framing over a serial port or pseudo
+ * terminal named by NETCFG_UNIX_HDLC_DEVICE (default /tmp/hdlc0).
+ * Serial port speed can be set with NETCFG_UNIX_HDLC_SPEED.
+ * - 0: Don't compile driver
+ * - 1: Compile driver
+ * - 2: Compile driver and use it as default for socket layer api.
+ */
+#define NETCFG_DRIVER_UNIX_HDLC_BRIDGE 0
+
+/**
+ * Set to 1 to use Van Jacobson TCP/IP header compression (RFC 1144)
+ * on HDLC bridge links (both STM32 and Unix drivers). IPv4 TCP
+ * headers are sent as small deltas against previous packet
+ * of same connection, other frames are sent unchanged. Peer
+ * must also use compression with same number of slots
+ * (::NETCFG_HDLC_VJ_SLOTS), as there is no negotiation.
+ */
+#define NETCFG_HDLC_VJCOMP 0
+
+/**
+ * Number of compression slots (TCP connections whose
+ * headers are remembered) in each direction.
+ */
+#define NETCFG_HDLC_VJ_SLOTS 4
+
 /**
  * CS8900A driver configuration. Currently driver supports
  * Olimex LPC-E2129 board.
@@ -147,4 +319,65 @@
  */
 #define NETCFG_DRIVER_ENC28J60 0
 
+/**
+ * Set to 1 on host builds to use simulated ENC28J60 chip
+ * instead of real SPI hardware. Frames are fed to simulated
+ * chip with enc28j60SimInput and transmitted frames are passed
+ * to function set with enc28j60SimSetOutput.
+ */
+#define NETCFG_ENC28J60_SIM 0
+
+/**
+ * Number of DMA receive and transmit descriptors for TM4C129
+ * ethernet driver. Each descriptor has a 1536 byte buffer.
+ * Must be powers of two.
+ */
+#define NETCFG_TM4C_RX_DESCRIPTORS 8
+#define NETCFG_TM4C_TX_DESCRIPTORS 4
+
+/**
+ * Set to 1 on host builds to include simulated TM4C129 DMA
+ * engine, for testing descriptor ring code without hardware.
+ */
+#define NETCFG_TM4C_EMAC_SIM 0
+
+/**
+ * Pcap replay driver configuration. Driver feeds frames from
+ * a pcap image to the stack as fast as possible and counts
+ * frames transmitted by stack, for benchmarking packet processing.
+ * Define NETCFG_CYCLE_COUNTER() to read a cycle counter
+ * to get cycles per frame. Cycles spent in socket layer
+ * callbacks are reported separately from stack processing.
+ * See examples/replaybench for
+ * captured bulk TCP transfers.
+ * - 0: Don't compile driver
+ * - 1: Compile driver
+ * - 2: Compile driver and use it as default for socket layer api.
+ */
+#define NETCFG_DRIVER_PCAP_REPLAY 0
+
+/**
+ * Set to 1 on host builds to allow loading pcap files with
+ * pcapReplayLoadFile.
+ */
+#define NETCFG_PCAP_REPLAY_HOSTFILE 0
+
+/**
+ * Loopback driver configuration. Frames sent to loopback
+ * interface are received by stack itself, which allows
+ * testing socket applications against each other without
+ * network hardware. IPv4 only, interface needs an address
+ * of its own (like 127.0.0.1/8).
+ * - 0: Don't compile driver
+ * - 1: Compile driver
+ * - 2: Compile driver and use it as default for socket layer api.
+ */
+#define NETCFG_DRIVER_LOOPBACK 0
+
+/**
+ * Number of frames loopback driver can hold before they
+ * are processed by main loop. Each takes UIP_BUFSIZE bytes.
+ */
+#define NETCFG_LOOPBACK_QUEUE 4
+
 /** @} */
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * picoos-net configuration for replay benchmark. Stack is
+ * 10.0.0.1/24 with MAC 02:00:00:00:00:01, which is what
+ * bulk-rx.pcap and bulk-tx.pcap are addressed to.
+ * See examples/netcfg.h for description of settings.
+ */
+
+#define UIP_CONF_LLH_LEN          14
+#define UIP_CONF_MAX_CONNECTIONS  4
+#define UIP_CONF_MAX_LISTENPORTS  2
+#define UIP_CONF_BUFFER_SIZE      1514
+#define UIP_CONF_UDP              0
+#define UIP_CONF_UDP_CONNS        0
+#define UIP_CONF_STATISTICS       1
+#define UIP_CONF_LOGGING          0
+
+/*
+ * Set to 0 to measure segment processing without
+ * TCP header prediction.
+ */
+#define UIP_CONF_TCP_FASTPATH     1
+
+#define NETCFG_SOCKETS            1
+#define NETCFG_STATS              1
+
+#define NETCFG_STACK_SIZE         4000
+#define NETCFG_TASK_PRIORITY      3
+
+#define NETCFG_DRIVER_PCAP_REPLAY   2
+#define NETCFG_PCAP_REPLAY_HOSTFILE 1
+
+#if defined(__i386__) || defined(__x86_64__)
+#define NETCFG_CYCLE_COUNTER()    ((uint32_t)__builtin_ia32_rdtsc())
+#endif
@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+#
+# Generate captures for replay benchmark. Peer is
+# 10.0.0.2 (02:00:00:00:00:02), stack 10.0.0.1
+# (02:00:00:00:00:01). Stack frames are included so
+# captures can be inspected with usual tools, replay
+# driver skips them.
+#
+# python3 mkpcap.py
+#
+
+import struct
+
+STACK_MAC = bytes([2, 0, 0, 0, 0, 1])
+PEER_MAC  = bytes([2, 0, 0, 0, 0, 2])
+STACK_IP  = bytes([10, 0, 0, 1])
+PEER_IP   = bytes([10, 0, 0, 2])
+PEER_PORT = 40000
+MSS       = 1460
+SEGMENTS  = 100
+
+FIN = 0x01
+SYN = 0x02
+PSH = 0x08
+ACK = 0x10
+
+def csum(data):
+    if len(data) % 2:
+        data += b"\0"
+    s = sum(struct.unpack("!%dH" % (len(data) // 2), data))
+    while s >> 16:
+        s = (s & 0xffff) + (s >> 16)
+    return ~s & 0xffff
+
+def eth(src, dst, type, payload):
+    return dst + src + struct.pack("!H", type) + payload
+
+def arpRequest():
+    arp = struct.pack("!HHBBH", 1, 0x0800, 6, 4, 1)
+    arp += PEER_MAC + PEER_IP + bytes(6) + STACK_IP
+    return eth(PEER_MAC, b"\xff" * 6, 0x0806, arp + bytes(18))
+
+def arpReply():
+    arp = struct.pack("!HHBBH", 1, 0x0800, 6, 4, 2)
+    arp += STACK_MAC + STACK_IP + PEER_MAC + PEER_IP
+    return eth(STACK_MAC, PEER_MAC, 0x0806, arp)
+
+class Tcp:
+
+    def __init__(self, port, peerIss, stackIss):
+        self.port = port
+        self.ipId = 1
+        self.peerSeq = peerIss
+        self.stackSeq = stackIss
+
+    def segment(self, fromPeer, flags, dataLen):
+        if fromPeer:
+            srcMac, dstMac, src, dst = PEER_MAC, STACK_MAC, PEER_IP, STACK_IP
+            sport, dport = PEER_PORT, self.port
+            seq, ack = self.peerSeq, self.stackSeq
+        else:
+            srcMac, dstMac, src, dst = STACK_MAC, PEER_MAC, STACK_IP, PEER_IP
+            sport, dport = self.port, PEER_PORT
+            seq, ack = self.stackSeq, self.peerSeq
+
+        opts = struct.pack("!BBH", 2, 4, MSS) if flags & SYN else b""
+        if not flags & ACK:
+            ack = 0
+
+        data = bytes((i & 0x3f) + 0x30 for i in range(dataLen))
+        tcp = struct.pack("!HHIIBBHHH", sport, dport, seq, ack,
+                          (5 + len(opts) // 4) << 4, flags,
+                          65535 if fromPeer else MSS, 0, 0) + opts + data
+        pseudo = src + dst + struct.pack("!BBH", 0, 6, len(tcp))
+        tcp = tcp[:16] + struct.pack("!H", csum(pseudo + tcp)) + tcp[18:]
+
+        ip = struct.pack("!BBHHHBBH", 0x45, 0, 20 + len(tcp), self.ipId, 0, 64, 6, 0) + src + dst
+        ip = ip[:10] + struct.pack("!H", csum(ip)) + ip[12:]
+        self.ipId += 1
+
+        advance = dataLen + (1 if flags & (SYN | FIN) else 0)
+        if fromPeer:
+            self.peerSeq = (self.peerSeq + advance) & 0xffffffff
+        else:
+            self.stackSeq = (self.stackSeq + advance) & 0xffffffff
+
+        return eth(srcMac, dstMac, 0x0800, ip + tcp)
+
+def bulk(port, peerSends):
+    tcp = Tcp(port, 0x10000000, 0x20000000)
+    frames = [arpRequest(), arpReply(),
+              tcp.segment(True, SYN, 0),
+              tcp.segment(False, SYN | ACK, 0),
+              tcp.segment(True, ACK, 0)]
+
+    for i in range(SEGMENTS):
+        frames.append(tcp.segment(peerSends, PSH | ACK, MSS))
+        frames.append(tcp.segment(not peerSends, ACK, 0))
+
+    frames.append(tcp.segment(True, FIN | ACK, 0))
+    frames.append(tcp.segment(False, FIN | ACK, 0))
+    frames.append(tcp.segment(True, ACK, 0))
+    return frames
+
+def write(name, frames):
+    with open(name, "wb") as f:
+        f.write(struct.pack("<IHHiIII", 0xa1b2c3d4, 2, 4, 0, 0, 65535, 1))
+        for i, frame in enumerate(frames):
+            f.write(struct.pack("<IIII", 0, i * 100, len(frame), len(frame)))
+            f.write(frame)
+
+write("bulk-rx.pcap", bulk(5001, True))
+write("bulk-tx.pcap", bulk(5002, False))
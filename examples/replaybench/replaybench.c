@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Per-segment processing benchmark. Replays a captured
+ * bulk TCP transfer to stack with pcap replay driver and
+ * prints cycles used for each frame class.
+ *
+ * bulk-rx.pcap: peer connects to port 5001 and sends
+ *               100 full-sized segments.
+ * bulk-tx.pcap: peer connects to port 5002 and stack
+ *               sends 100 full-sized segments, TX_SEGMENTS
+ *               must match SEGMENTS in mkpcap.py.
+ *
+ * In both captures peer closes the connection after
+ * transfer, so they can be looped.
+ */
+
+#include <picoos.h>
+#include <picoos-u.h>
+#include <picoos-net.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "drivers/pcap_replay.h"
+
+#define RX_PORT       5001
+#define TX_PORT       5002
+#define TX_SEGMENTS   100
+#define SEGMENT_SIZE  1460
+
+// Segments per write. Stack sends them back-to-back
+// as peer acknowledges.
+#define TX_CHUNK      10
+
+static uint32_t rxBytes;
+static uint32_t txBytes;
+
+/*
+ * Tasks of consecutive replay loops may run
+ * at the same time.
+ */
+static void addBytes(uint32_t* counter, uint32_t bytes)
+{
+  posTaskSchedLock();
+  *counter += bytes;
+  posTaskSchedUnlock();
+}
+
+static char buf[TX_CHUNK * SEGMENT_SIZE];
+
+/*
+ * Discard everything peer sends.
+ */
+static void rxTask(void* arg)
+{
+  UosFile* file = (UosFile*)arg;
+  char data[SEGMENT_SIZE];
+  uint32_t bytes = 0;
+  int len;
+
+  while ((len = uosFileRead(file, data, sizeof(data))) > 0)
+    bytes += len;
+
+  uosFileClose(file);
+  addBytes(&rxBytes, bytes);
+}
+
+/*
+ * Send TX_SEGMENTS full segments to peer and
+ * wait for it to close connection.
+ */
+static void txTask(void* arg)
+{
+  UosFile* file = (UosFile*)arg;
+  char data[16];
+  uint32_t bytes = 0;
+  int i;
+
+  for (i = 0; i < TX_SEGMENTS; i += TX_CHUNK) {
+
+    if (uosFileWrite(file, buf, sizeof(buf)) != sizeof(buf))
+      break;
+
+    bytes += sizeof(buf);
+  }
+
+  while (uosFileRead(file, data, sizeof(data)) > 0);
+  uosFileClose(file);
+  addBytes(&txBytes, bytes);
+}
+
+/*
+ * Each connection is handled by a task of its own, as
+ * next replay loop may connect before previous task
+ * has closed its socket.
+ */
+static int acceptHook(UosFile* file, int port)
+{
+  POSTASK_t task = NULL;
+
+  switch (port) {
+  case RX_PORT:
+    task = posTaskCreate(rxTask, file, 2, 2000);
+    break;
+
+  case TX_PORT:
+    task = posTaskCreate(txTask, file, 2, 2000);
+    break;
+  }
+
+  return task == NULL ? -1 : 0;
+}
+
+static void mainTask(void* arg)
+{
+  static const struct uip_eth_addr mac = {{ 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 }};
+  char** argv = (char**)arg;
+  uip_ipaddr_t addr;
+  uint32_t loops;
+  UosFile* server;
+
+  netInit();
+
+  uip_ipaddr(&addr, 10, 0, 0, 1);
+  uip_sethostaddr(&addr);
+  uip_ipaddr(&addr, 255, 255, 255, 0);
+  uip_setnetmask(&addr);
+  uip_setethaddr(mac);
+
+  server = netSockCreateTCPServer(RX_PORT);
+  P_ASSERT("replaybench", server != NULL);
+  netSockListen(server);
+
+  server = netSockCreateTCPServer(TX_PORT);
+  P_ASSERT("replaybench", server != NULL);
+  netSockListen(server);
+
+  netSockAcceptHookSet(acceptHook);
+
+  loops = argv[2] ? atoi(argv[2]) : 1;
+  if (pcapReplayLoadFile(argv[1], loops) == -1) {
+
+    nosPrintf("%s: cannot load\n", argv[1]);
+    exit(1);
+  }
+
+  while (!pcapReplayDone())
+    posTaskSleep(MS(100));
+
+  // Let task of last connection finish.
+  posTaskSleep(MS(100));
+
+  pcapReplayPrint();
+  nosPrintf("app: %lu bytes received, %lu bytes sent\n",
+            (unsigned long)rxBytes, (unsigned long)txBytes);
+
+  exit(0);
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) {
+
+    fprintf(stderr, "usage: %s capture.pcap [loops]\n", argv[0]);
+    return 1;
+  }
+
+  memset(buf, 'x', sizeof(buf));
+  nosInit(mainTask, argv, 1, 8000, 1000);
+  return 0;
+}
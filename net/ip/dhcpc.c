@@ -34,6 +34,7 @@
 
 #if UIP_CONF_UDP > 0
 #include "net/ip/dhcpc.h"
+#include "net/ip/uip-nameserver.h"
 
 #if !UIP_BROADCAST
 #error UIP_CONF_BROADCAST must be set to 1
@@ -360,9 +361,14 @@ static void dhcpTask(void* arg)
 	 uip_ntohs(s.lease_time[0])*65536ul + uip_ntohs(s.lease_time[1]));
 #endif
 
+  uint32_t leaseLeft = uip_ntohs(s.lease_time[0])*65536ul + uip_ntohs(s.lease_time[1]);
+
+  posTaskSchedLock();
+  uip_nameserver_update(&s.dnsaddr, leaseLeft);
+  posTaskSchedUnlock();
+
   dhcpc_configured(&s);
 
-  uint32_t leaseLeft = uip_ntohs(s.lease_time[0])*65536ul + uip_ntohs(s.lease_time[1]);
   uint32_t sleepLeft = leaseLeft / 2;
 
 #define MAX_SECS ((INFINITE - 1) / HZ)
@@ -409,6 +415,10 @@ static void dhcpTask(void* arg)
   /* rebinding: */
 
   /* lease_expired: */
+  posTaskSchedLock();
+  uip_nameserver_update(&s.dnsaddr, 0);
+  posTaskSchedUnlock();
+
   dhcpc_unconfigured(&s);
   goto init;
 }
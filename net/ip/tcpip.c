@@ -661,10 +661,17 @@ tcpip_ipv6_output(void)
 #if UIP_CONF_IPV6_QUEUE_PKT
         /* Copy outgoing pkt in the queuing buffer for later transmit. */
         if(uip_packetqueue_alloc(&nbr->packethandle, UIP_DS6_NBR_PACKET_LIFETIME) != NULL) {
+#if UIP_XMITV
+          uip_xmitv_flatten();
+#endif /* UIP_XMITV */
           memcpy(uip_packetqueue_buf(&nbr->packethandle), UIP_IP_BUF, uip_len);
           uip_packetqueue_set_buflen(&nbr->packethandle, uip_len);
         }
 #endif
+#if UIP_XMITV
+      /* Pico]OS: Solicitation replaces packet in uip_buf. */
+      uip_xmitv_clear();
+#endif /* UIP_XMITV */
       /* RFC4861, 7.2.2:
        * "If the source address of the packet prompting the solicitation is the
        * same as one of the addresses assigned to the outgoing interface, that
@@ -689,6 +696,9 @@ tcpip_ipv6_output(void)
         /* Copy outgoing pkt in the queuing buffer for later transmit and set
            the destination nbr to nbr. */
         if(uip_packetqueue_alloc(&nbr->packethandle, UIP_DS6_NBR_PACKET_LIFETIME) != NULL) {
+#if UIP_XMITV
+          uip_xmitv_flatten();
+#endif /* UIP_XMITV */
           memcpy(uip_packetqueue_buf(&nbr->packethandle), UIP_IP_BUF, uip_len);
           uip_packetqueue_set_buflen(&nbr->packethandle, uip_len);
         }
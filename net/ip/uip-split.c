@@ -59,6 +59,9 @@ uip_split_output(void)
 {
 #if UIP_TCP
   uint16_t tcplen, len1, len2;
+#if UIP_XMITV
+  const uint8_t *xmitv;
+#endif /* UIP_XMITV */
 
   /* We only split TCP segments that are larger than or equal to
      UIP_SPLIT_SIZE, which is configurable through
@@ -77,6 +80,16 @@ uip_split_output(void)
     /* Create the first packet. This is done by altering the length
        field of the IP header and updating the checksums. */
     uip_len = len1 + UIP_TCPIP_HLEN;
+#if UIP_XMITV
+/*
+ * Pico]OS: If payload is outside uip_buf, just give
+ *          each packet its own part of it.
+ */
+    xmitv = uip_xmitv_data;
+    if(xmitv != NULL) {
+      uip_xmitv_len = len1;
+    }
+#endif /* UIP_XMITV */
 #if NETSTACK_CONF_WITH_IPV6
     /* For IPv6, the IP length field does not include the IPv6 IP header
        length. */
@@ -122,6 +135,12 @@ uip_split_output(void)
 #endif /* NETSTACK_CONF_WITH_IPV6 */
     
     /*    uip_appdata += len1;*/
+#if UIP_XMITV
+    if(xmitv != NULL) {
+      uip_xmitv_data = xmitv + len1;
+      uip_xmitv_len = len2;
+    } else
+#endif /* UIP_XMITV */
     memcpy(uip_appdata, (uint8_t *)uip_appdata + len1, len2);
 
     uip_add32(BUF->seqno, len1);
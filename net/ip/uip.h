@@ -653,6 +653,42 @@ struct uip_conn *uip_connect(const uip_ipaddr_t *ripaddr, uint16_t port);
  */
 CCIF void uip_send(const void *data, int len);
 
+#if UIP_XMITV
+/**
+ * Pico]OS: Send data on the current connection without copying it.
+ *
+ * Works like uip_send(), but data is left where it is and handed
+ * to device driver as a separate fragment following the headers in
+ * uip_buf. Data must stay valid until it is acknowledged, as it is
+ * also used for retransmissions. Works for both TCP and UDP.
+ *
+ * \param data A pointer to the data which is to be sent.
+ *
+ * \param len The maximum amount of data bytes to be sent.
+ */
+CCIF void uip_sendv(const void *data, int len);
+
+/**
+ * Pico]OS: Payload of outgoing packet that is not in uip_buf,
+ * NULL if whole packet is in uip_buf. Headers take
+ * uip_len - uip_xmitv_len bytes at the start of uip_buf.
+ */
+CCIF extern const void *uip_xmitv_data;
+CCIF extern uint16_t uip_xmitv_len;
+
+/**
+ * Pico]OS: Copy external payload of outgoing packet to uip_buf,
+ * for code that needs whole packet there.
+ */
+CCIF void uip_xmitv_flatten(void);
+
+/**
+ * Pico]OS: Forget external payload, called after packet
+ * has been transmitted or replaced with another one.
+ */
+#define uip_xmitv_clear() do { uip_xmitv_data = NULL; uip_xmitv_len = 0; } while(0)
+#endif /* UIP_XMITV */
+
 /**
  * The length of any incoming data that is currently available (if available)
  * in the uip_appdata buffer.
@@ -1373,6 +1409,16 @@ struct uip_conn {
   uint8_t timer;         /**< The retransmission timer. */
   uint8_t nrtx;          /**< The number of retransmissions for the last
 			 segment sent. */
+#if UIP_TCP_KEEPALIVE
+  uint16_t idle;         /**< Periodic ticks since last segment was
+			 received. */
+  uint16_t ka_idle;      /**< Idle ticks before first keepalive probe,
+			 zero if keepalive is disabled. */
+  uint16_t ka_intvl;     /**< Ticks between keepalive probes. */
+  uint8_t ka_cnt;        /**< Number of unanswered probes before
+			 connection is dropped. */
+  uint8_t ka_probes;     /**< Number of probes sent. */
+#endif /* UIP_TCP_KEEPALIVE */
 
   /** The application state. */
   uip_tcp_appstate_t appstate;
@@ -1483,6 +1529,17 @@ struct uip_stats {
     uip_stats_t chkerr;   /**< Number of ICMP packets with a bad
 			     checksum. */
   } icmp;                 /**< ICMP statistics. */
+#if UIP_REASSEMBLY || UIP_CONF_IPV6_REASSEMBLY
+  struct {
+    uip_stats_t done;     /**< Number of reassembled datagrams. */
+    uip_stats_t timeout;  /**< Number of datagrams dropped because all
+			     fragments didn't arrive in time. */
+    uip_stats_t evicted;  /**< Number of datagrams dropped to make room
+			     for a new one. */
+    uip_stats_t toobig;   /**< Number of datagrams dropped because they
+			     didn't fit into reassembly buffer. */
+  } reass;                /**< IP reassembly statistics. */
+#endif /* UIP_REASSEMBLY || UIP_CONF_IPV6_REASSEMBLY */
 #if UIP_TCP
   struct {
     uip_stats_t recv;     /**< Number of recived TCP segments. */
@@ -280,6 +280,22 @@ void uip_log(char *msg);
 #else /* UIP_CONF_REASSEMBLY */
 #define UIP_REASSEMBLY 0
 #endif /* UIP_CONF_REASSEMBLY */
+
+/**
+ * Number of IP datagrams that can be reassembled at the same time.
+ * Reassembly contexts are allocated from a shared pool, each
+ * one holding a buffer of UIP_BUFSIZE bytes. Fragments are
+ * matched to contexts by source address, destination address
+ * and fragment id. If all contexts are in use when fragment
+ * of a new datagram arrives, least recently used one is evicted.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_REASS_CONTEXTS
+#define UIP_REASS_CONTEXTS (UIP_CONF_REASS_CONTEXTS)
+#else /* UIP_CONF_REASS_CONTEXTS */
+#define UIP_REASS_CONTEXTS 2
+#endif /* UIP_CONF_REASS_CONTEXTS */
 /** @} */
 
 /*------------------------------------------------------------------------------*/
@@ -495,6 +511,21 @@ void uip_log(char *msg);
 #define UIP_TCP_MSS     (UIP_BUFSIZE - UIP_LLH_LEN - UIP_TCPIP_HLEN)
 #endif /* UIP_CONF_TCP_MSS */
 
+/**
+ * Pico]OS: TCP maximum segment size for a connection. Used instead
+ * of UIP_TCP_MSS in the MSS option of SYN and SYNACK and as upper
+ * limit for MSS announced by peer, so that segments fit into MTU
+ * of the interface connection is routed to. Called after ripaddr
+ * of connection has been set.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_CONN_MSS
+#define UIP_TCP_CONN_MSS(conn) (UIP_CONF_TCP_CONN_MSS(conn))
+#else /* UIP_CONF_TCP_CONN_MSS */
+#define UIP_TCP_CONN_MSS(conn) (UIP_TCP_MSS)
+#endif /* UIP_CONF_TCP_CONN_MSS */
+
 /**
  * The size of the advertised receiver's window.
  *
@@ -521,6 +552,61 @@ void uip_log(char *msg);
 #define UIP_TIME_WAIT_TIMEOUT UIP_CONF_WAIT_TIMEOUT
 #endif
 
+/**
+ * Pico]OS: Allow application to send TCP/UDP payload from its own
+ * buffer with uip_sendv(). Payload is not copied into uip_buf,
+ * it is passed to device driver as a separate fragment.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_XMITV
+#define UIP_XMITV (UIP_CONF_XMITV)
+#else /* UIP_CONF_XMITV */
+#define UIP_XMITV 0
+#endif /* UIP_CONF_XMITV */
+
+/**
+ * Pico]OS: Track idle time of established TCP connections and send
+ * keepalive probes on connections that have them enabled (see
+ * ka_idle, ka_intvl and ka_cnt in struct uip_conn). Connection is
+ * dropped if peer doesn't answer to probes.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_KEEPALIVE
+#define UIP_TCP_KEEPALIVE (UIP_CONF_TCP_KEEPALIVE)
+#else /* UIP_CONF_TCP_KEEPALIVE */
+#define UIP_TCP_KEEPALIVE 0
+#endif /* UIP_CONF_TCP_KEEPALIVE */
+
+/**
+ * Pico]OS: Drop established TCP connection if nothing has been
+ * received from peer during this many periodic timer ticks.
+ * Zero disables idle timeout. Requires UIP_TCP_KEEPALIVE.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_IDLE_TIMEOUT
+#define UIP_TCP_IDLE_TIMEOUT (UIP_CONF_TCP_IDLE_TIMEOUT)
+#else /* UIP_CONF_TCP_IDLE_TIMEOUT */
+#define UIP_TCP_IDLE_TIMEOUT 0
+#endif /* UIP_CONF_TCP_IDLE_TIMEOUT */
+
+/**
+ * Pico]OS: Use header prediction for TCP input. Segments on
+ * established connection that carry next expected data or
+ * acknowledge outstanding data (common case for bulk transfers)
+ * bypass generic state machine. Last matched connection is
+ * also checked first when demultiplexing.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_FASTPATH
+#define UIP_TCP_FASTPATH (UIP_CONF_TCP_FASTPATH)
+#else /* UIP_CONF_TCP_FASTPATH */
+#define UIP_TCP_FASTPATH 1
+#endif /* UIP_CONF_TCP_FASTPATH */
+
 /** @} */
 /*------------------------------------------------------------------------------*/
 /**
@@ -80,6 +80,11 @@
 #include <string.h>
 #include "sys/cc.h"
 
+#if UIP_REASSEMBLY
+#include "lib/list.h"
+#include "lib/memb.h"
+#endif /* UIP_REASSEMBLY */
+
 /*---------------------------------------------------------------------------*/
 /* Variable definitions. */
 
@@ -134,6 +139,14 @@ uint16_t uip_urglen, uip_surglen;
 #endif /* UIP_URGDATA > 0 */
 
 uint16_t uip_len, uip_slen;
+#if UIP_XMITV
+/*
+ * Pico]OS: Payload of outgoing packet when it was given
+ *          with uip_sendv() and is not in uip_buf.
+ */
+const void *uip_xmitv_data;
+uint16_t uip_xmitv_len;
+#endif /* UIP_XMITV */
                              /* The uip_len is either 8 or 16 bits,
 				depending on the maximum packet
 				size. */
@@ -164,6 +177,17 @@ void uip_setipid(uint16_t id) { ipid = id; }
 static uint8_t iss[4];          /* The iss variable is used for the TCP
 				initial sequence number. */
 
+#if UIP_TCP && UIP_TCP_FASTPATH
+static struct uip_conn *uip_lastconn; /* Connection that received
+				last segment. */
+#endif /* UIP_TCP_FASTPATH */
+
+#if UIP_TCP_KEEPALIVE
+static uint8_t ka_probe;        /* Set when segment being sent is a
+				keepalive probe. */
+#define KA_PROBE_DUE(conn) ((conn)->ka_idle + (conn)->ka_probes * (conn)->ka_intvl)
+#endif /* UIP_TCP_KEEPALIVE */
+
 #if UIP_ACTIVE_OPEN || UIP_UDP
 static uint16_t lastport;       /* Keeps track of the last port used for
 				a new connection. */
@@ -213,11 +237,33 @@ static uint16_t tmp16;
  *          Allows compiling with gcc -Wcast-align.
  */
 #define BUF ((struct uip_tcpip_hdr *)&uip_buf16(UIP_LLH_LEN))
-#define FBUF ((struct uip_tcpip_hdr *)&uip_reassbuf[0])
+#define FBUF(r) ((struct uip_tcpip_hdr *)(r)->buf)
 #define ICMPBUF ((struct uip_icmpip_hdr *)&uip_buf16(UIP_LLH_LEN))
 #define UDPBUF ((struct uip_udpip_hdr *)&uip_buf16(UIP_LLH_LEN))
 
 
+#if UIP_REASSEMBLY
+#define UIP_REASS_BUFSIZE (UIP_BUFSIZE - UIP_LLH_LEN)
+
+/*
+ * Pico]OS: Multiple reassembly contexts, allocated from a pool.
+ *          Active contexts are kept in a list, most recently
+ *          used first. Buffer is declared as uint32_t array to
+ *          get alignment needed by FBUF.
+ */
+struct uip_reass_ctx {
+  struct uip_reass_ctx *next;
+  uint32_t buf[(UIP_REASS_BUFSIZE + 3) / 4];
+  uint8_t bitmap[UIP_REASS_BUFSIZE / (8 * 8) + 1];
+  uint16_t len;
+  uint8_t flags;
+  uint8_t tmr;
+};
+
+MEMB(uip_reass_memb, struct uip_reass_ctx, UIP_REASS_CONTEXTS);
+LIST(uip_reass_list);
+#endif /* UIP_REASSEMBLY */
+
 #if UIP_STATISTICS == 1
 struct uip_stats uip_stat;
 #define UIP_STAT(s) s
@@ -333,6 +379,18 @@ upper_layer_chksum(uint8_t proto)
   /* Sum IP source and destination addresses. */
   sum = chksum(sum, (uint8_t *)&BUF->srcipaddr, 2 * sizeof(uip_ipaddr_t));
 
+#if UIP_XMITV
+/*
+ * Pico]OS: Payload may be outside uip_buf.
+ */
+  if(uip_xmitv_data != NULL) {
+    sum = chksum(sum, &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN],
+                 upper_layer_len - uip_xmitv_len);
+    sum = chksum(sum, uip_xmitv_data, uip_xmitv_len);
+    return (sum == 0) ? 0xffff : uip_htons(sum);
+  }
+#endif /* UIP_XMITV */
+
   /* Sum TCP header and data. */
   sum = chksum(sum, &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN],
 	       upper_layer_len);
@@ -383,6 +441,10 @@ uip_init(void)
   }
 #endif /* UIP_UDP */
 
+#if UIP_REASSEMBLY
+  memb_init(&uip_reass_memb);
+  list_init(uip_reass_list);
+#endif /* UIP_REASSEMBLY */
 
   /* IPv4 initialization. */
 #if UIP_FIXEDADDR == 0
@@ -441,10 +503,13 @@ uip_connect(const uip_ipaddr_t *ripaddr, uint16_t rport)
   conn->snd_nxt[2] = iss[2];
   conn->snd_nxt[3] = iss[3];
 
-  conn->initialmss = conn->mss = UIP_TCP_MSS;
-
   conn->len = 1;   /* TCP length of the SYN is one. */
   conn->nrtx = 0;
+#if UIP_TCP_KEEPALIVE
+  conn->idle = 0;
+  conn->ka_idle = 0;
+  conn->ka_probes = 0;
+#endif /* UIP_TCP_KEEPALIVE */
   conn->timer = 1; /* Send the SYN next time around. */
   conn->rto = UIP_RTO;
   conn->sa = 0;
@@ -452,6 +517,7 @@ uip_connect(const uip_ipaddr_t *ripaddr, uint16_t rport)
   conn->lport = uip_htons(lastport);
   conn->rport = rport;
   uip_ipaddr_copy(&conn->ripaddr, ripaddr);
+  conn->initialmss = conn->mss = UIP_TCP_CONN_MSS(conn);
 
   return conn;
 }
@@ -528,128 +594,171 @@ uip_listen(uint16_t port)
 /* XXX: IP fragment reassembly: not well-tested. */
 
 #if UIP_REASSEMBLY && !NETSTACK_CONF_WITH_IPV6
-#define UIP_REASS_BUFSIZE (UIP_BUFSIZE - UIP_LLH_LEN)
-static uint8_t uip_reassbuf[UIP_REASS_BUFSIZE];
-static uint8_t uip_reassbitmap[UIP_REASS_BUFSIZE / (8 * 8)];
 static const uint8_t bitmap_bits[8] = {0xff, 0x7f, 0x3f, 0x1f,
 				    0x0f, 0x07, 0x03, 0x01};
-static uint16_t uip_reasslen;
-static uint8_t uip_reassflags;
 #define UIP_REASS_FLAG_LASTFRAG 0x01
-static uint8_t uip_reasstmr;
 
 #define IP_MF   0x20
 
-static uint8_t
+/*---------------------------------------------------------------------------*/
+static void
+uip_reass_free(struct uip_reass_ctx *r)
+{
+  list_remove(uip_reass_list, r);
+  memb_free(&uip_reass_memb, r);
+}
+/*---------------------------------------------------------------------------*/
+static struct uip_reass_ctx *
+uip_reass_lookup(void)
+{
+  struct uip_reass_ctx *r;
+
+  for(r = list_head(uip_reass_list); r != NULL; r = list_item_next(r)) {
+    if(uip_ipaddr_cmp(&BUF->srcipaddr, &FBUF(r)->srcipaddr) &&
+       uip_ipaddr_cmp(&BUF->destipaddr, &FBUF(r)->destipaddr) &&
+       BUF->ipid[0] == FBUF(r)->ipid[0] &&
+       BUF->ipid[1] == FBUF(r)->ipid[1]) {
+
+      /* Move to front of list to keep it in LRU order. */
+      list_remove(uip_reass_list, r);
+      list_push(uip_reass_list, r);
+      return r;
+    }
+  }
+
+  /* Fragment of a new datagram. If all contexts are busy,
+     evict the least recently used one. */
+  r = memb_alloc(&uip_reass_memb);
+  if(r == NULL) {
+    r = list_chop(uip_reass_list);
+    if(r == NULL) {
+      return NULL;
+    }
+    UIP_STAT(++uip_stat.reass.evicted);
+  }
+
+  memcpy(FBUF(r), &BUF->vhl, UIP_IPH_LEN);
+  r->tmr = UIP_REASS_MAXAGE;
+  r->flags = 0;
+  r->len = 0;
+  memset(r->bitmap, 0, sizeof(r->bitmap));
+  list_push(uip_reass_list, r);
+  return r;
+}
+/*---------------------------------------------------------------------------*/
+static void
+uip_reass_periodic(void)
+{
+  struct uip_reass_ctx *r, *next;
+
+  for(r = list_head(uip_reass_list); r != NULL; r = next) {
+    next = list_item_next(r);
+    if(--r->tmr == 0) {
+      UIP_STAT(++uip_stat.reass.timeout);
+      uip_reass_free(r);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
 uip_reass(void)
 {
+  struct uip_reass_ctx *r;
   uint16_t offset, len;
   uint16_t i;
 
-  /* If ip_reasstmr is zero, no packet is present in the buffer, so we
-     write the IP header of the fragment into the reassembly
-     buffer. The timer is updated with the maximum age. */
-  if(uip_reasstmr == 0) {
-    memcpy(uip_reassbuf, &BUF->vhl, UIP_IPH_LEN);
-    uip_reasstmr = UIP_REASS_MAXAGE;
-    uip_reassflags = 0;
-    /* Clear the bitmap. */
-    memset(uip_reassbitmap, 0, sizeof(uip_reassbitmap));
-  }
-
-  /* Check if the incoming fragment matches the one currently present
-     in the reasembly buffer. If so, we proceed with copying the
-     fragment into the buffer. */
-  if(BUF->srcipaddr[0] == FBUF->srcipaddr[0] &&
-     BUF->srcipaddr[1] == FBUF->srcipaddr[1] &&
-     BUF->destipaddr[0] == FBUF->destipaddr[0] &&
-     BUF->destipaddr[1] == FBUF->destipaddr[1] &&
-     BUF->ipid[0] == FBUF->ipid[0] &&
-     BUF->ipid[1] == FBUF->ipid[1]) {
-
-    len = (BUF->len[0] << 8) + BUF->len[1] - (BUF->vhl & 0x0f) * 4;
-    offset = (((BUF->ipoffset[0] & 0x3f) << 8) + BUF->ipoffset[1]) * 8;
-
-    /* If the offset or the offset + fragment length overflows the
-       reassembly buffer, we discard the entire packet. */
-    if(offset > UIP_REASS_BUFSIZE ||
-       offset + len > UIP_REASS_BUFSIZE) {
-      uip_reasstmr = 0;
-      goto nullreturn;
-    }
+  r = uip_reass_lookup();
+  if(r == NULL) {
+    goto nullreturn;
+  }
 
-    /* Copy the fragment into the reassembly buffer, at the right
-       offset. */
-    memcpy(&uip_reassbuf[UIP_IPH_LEN + offset],
-	   (char *)BUF + (int)((BUF->vhl & 0x0f) * 4),
-	   len);
+  len = (BUF->len[0] << 8) + BUF->len[1] - (BUF->vhl & 0x0f) * 4;
+  offset = (((BUF->ipoffset[0] & 0x3f) << 8) + BUF->ipoffset[1]) * 8;
 
-    /* Update the bitmap. */
-    if(offset / (8 * 8) == (offset + len) / (8 * 8)) {
-      /* If the two endpoints are in the same byte, we only update
-	 that byte. */
+  /* If the offset or the offset + fragment length overflows the
+     reassembly buffer, we discard the entire packet. */
+  if(offset > UIP_REASS_BUFSIZE - UIP_IPH_LEN ||
+     offset + len > UIP_REASS_BUFSIZE - UIP_IPH_LEN) {
+    UIP_STAT(++uip_stat.reass.toobig);
+    uip_reass_free(r);
+    goto nullreturn;
+  }
 
-      uip_reassbitmap[offset / (8 * 8)] |=
-	     bitmap_bits[(offset / 8 ) & 7] &
-	     ~bitmap_bits[((offset + len) / 8 ) & 7];
-    } else {
-      /* If the two endpoints are in different bytes, we update the
-	 bytes in the endpoints and fill the stuff inbetween with
-	 0xff. */
-      uip_reassbitmap[offset / (8 * 8)] |=
-	bitmap_bits[(offset / 8 ) & 7];
-      for(i = 1 + offset / (8 * 8); i < (offset + len) / (8 * 8); ++i) {
-	uip_reassbitmap[i] = 0xff;
-      }
-      uip_reassbitmap[(offset + len) / (8 * 8)] |=
-	~bitmap_bits[((offset + len) / 8 ) & 7];
-    }
+  /* Copy the fragment into the reassembly buffer, at the right
+     offset. */
+  memcpy((uint8_t *)FBUF(r) + UIP_IPH_LEN + offset,
+	 (char *)BUF + (int)((BUF->vhl & 0x0f) * 4),
+	 len);
 
-    /* If this fragment has the More Fragments flag set to zero, we
-       know that this is the last fragment, so we can calculate the
-       size of the entire packet. We also set the
-       IP_REASS_FLAG_LASTFRAG flag to indicate that we have received
-       the final fragment. */
+  /* Update the bitmap. */
+  if(offset / (8 * 8) == (offset + len) / (8 * 8)) {
+    /* If the two endpoints are in the same byte, we only update
+       that byte. */
 
-    if((BUF->ipoffset[0] & IP_MF) == 0) {
-      uip_reassflags |= UIP_REASS_FLAG_LASTFRAG;
-      uip_reasslen = offset + len;
+    r->bitmap[offset / (8 * 8)] |=
+	   bitmap_bits[(offset / 8 ) & 7] &
+	   ~bitmap_bits[((offset + len) / 8 ) & 7];
+  } else {
+    /* If the two endpoints are in different bytes, we update the
+       bytes in the endpoints and fill the stuff inbetween with
+       0xff. */
+    r->bitmap[offset / (8 * 8)] |=
+      bitmap_bits[(offset / 8 ) & 7];
+    for(i = 1 + offset / (8 * 8); i < (offset + len) / (8 * 8); ++i) {
+      r->bitmap[i] = 0xff;
     }
+    r->bitmap[(offset + len) / (8 * 8)] |=
+      ~bitmap_bits[((offset + len) / 8 ) & 7];
+  }
 
-    /* Finally, we check if we have a full packet in the buffer. We do
-       this by checking if we have the last fragment and if all bits
-       in the bitmap are set. */
-    if(uip_reassflags & UIP_REASS_FLAG_LASTFRAG) {
-      /* Check all bytes up to and including all but the last byte in
-	 the bitmap. */
-      for(i = 0; i < uip_reasslen / (8 * 8) - 1; ++i) {
-	if(uip_reassbitmap[i] != 0xff) {
-	  goto nullreturn;
-	}
-      }
-      /* Check the last byte in the bitmap. It should contain just the
-	 right amount of bits. */
-      if(uip_reassbitmap[uip_reasslen / (8 * 8)] !=
-	 (uint8_t)~bitmap_bits[uip_reasslen / 8 & 7]) {
+  /* If this fragment has the More Fragments flag set to zero, we
+     know that this is the last fragment, so we can calculate the
+     size of the entire packet. We also set the
+     IP_REASS_FLAG_LASTFRAG flag to indicate that we have received
+     the final fragment. */
+
+  if((BUF->ipoffset[0] & IP_MF) == 0) {
+    r->flags |= UIP_REASS_FLAG_LASTFRAG;
+    r->len = offset + len;
+  }
+
+  /* Finally, we check if we have a full packet in the buffer. We do
+     this by checking if we have the last fragment and if all bits
+     in the bitmap are set. */
+  if(r->flags & UIP_REASS_FLAG_LASTFRAG) {
+    /* Check all bytes up to and including all but the last byte in
+       the bitmap. */
+    for(i = 0; i < r->len / (8 * 8); ++i) {
+      if(r->bitmap[i] != 0xff) {
 	goto nullreturn;
       }
-
-      /* If we have come this far, we have a full packet in the
-	 buffer, so we allocate a pbuf and copy the packet into it. We
-	 also reset the timer. */
-      uip_reasstmr = 0;
-      memcpy(BUF, FBUF, uip_reasslen);
-
-      /* Pretend to be a "normal" (i.e., not fragmented) IP packet
-	 from now on. */
-      BUF->ipoffset[0] = BUF->ipoffset[1] = 0;
-      BUF->len[0] = uip_reasslen >> 8;
-      BUF->len[1] = uip_reasslen & 0xff;
-      BUF->ipchksum = 0;
-      BUF->ipchksum = ~(uip_ipchksum());
-
-      return uip_reasslen;
     }
+    /* Check the last byte in the bitmap. It should contain just the
+       right amount of bits. */
+    if(r->bitmap[r->len / (8 * 8)] !=
+       (uint8_t)~bitmap_bits[r->len / 8 & 7]) {
+      goto nullreturn;
+    }
+
+    /* If we have come this far, we have a full packet in the
+       buffer, so we copy it into uip_buf and release the context.
+       Options of first fragment are not kept, so header is
+       always UIP_IPH_LEN bytes. */
+    len = r->len + UIP_IPH_LEN;
+    memcpy(BUF, FBUF(r), len);
+    uip_reass_free(r);
+    UIP_STAT(++uip_stat.reass.done);
+
+    /* Pretend to be a "normal" (i.e., not fragmented) IP packet
+       from now on. */
+    BUF->vhl = 0x45;
+    BUF->ipoffset[0] = BUF->ipoffset[1] = 0;
+    BUF->len[0] = len >> 8;
+    BUF->len[1] = len & 0xff;
+    BUF->ipchksum = 0;
+    BUF->ipchksum = ~(uip_ipchksum());
+
+    return len;
   }
 
  nullreturn:
@@ -667,11 +776,69 @@ uip_add_rcv_nxt(uint16_t n)
   uip_conn->rcv_nxt[3] = uip_acc32[3];
 }
 /*---------------------------------------------------------------------------*/
+#if UIP_TCP
+/*
+ * All outstanding data has been acknowledged (new snd_nxt is in
+ * uip_acc32). Update sequence number and RTT estimate.
+ */
+static void
+uip_tcp_acked(void)
+{
+  uip_conn->snd_nxt[0] = uip_acc32[0];
+  uip_conn->snd_nxt[1] = uip_acc32[1];
+  uip_conn->snd_nxt[2] = uip_acc32[2];
+  uip_conn->snd_nxt[3] = uip_acc32[3];
+
+  /* Do RTT estimation, unless we have done retransmissions. */
+  if(uip_conn->nrtx == 0) {
+    signed char m;
+    m = uip_conn->rto - uip_conn->timer;
+    /* This is taken directly from VJs original code in his paper */
+    m = m - (uip_conn->sa >> 3);
+    uip_conn->sa += m;
+    if(m < 0) {
+      m = -m;
+    }
+    m = m - (uip_conn->sv >> 2);
+    uip_conn->sv += m;
+    uip_conn->rto = (uip_conn->sa >> 3) + uip_conn->sv;
+
+  }
+  /* Set the acknowledged flag. */
+  uip_flags = UIP_ACKDATA;
+  /* Reset the retransmission timer. */
+  uip_conn->timer = uip_conn->rto;
+
+  /* Reset length of outstanding data. */
+  uip_conn->len = 0;
+}
+#endif /* UIP_TCP */
+/*---------------------------------------------------------------------------*/
+#if UIP_XMITV
+/*
+ * Pico]OS: Set length of external payload of outgoing
+ *          packet. Payload follows hdrlen bytes of headers.
+ */
+static void
+xmitv_setlen(uint16_t hdrlen)
+{
+  if(uip_xmitv_data != NULL) {
+    uip_xmitv_len = uip_len - hdrlen;
+    if(uip_xmitv_len == 0) {
+      uip_xmitv_data = NULL;
+    }
+  }
+}
+#endif /* UIP_XMITV */
+/*---------------------------------------------------------------------------*/
 void
 uip_process(uint8_t flag)
 {
   register struct uip_conn *uip_connr = uip_conn;
 
+#if UIP_XMITV
+  uip_xmitv_clear();
+#endif /* UIP_XMITV */
 #if UIP_UDP
   if(flag == UIP_UDP_SEND_CONN) {
     goto udp_send;
@@ -709,9 +876,7 @@ uip_process(uint8_t flag)
     /* Check if we were invoked because of the periodic timer firing. */
   } else if(flag == UIP_TIMER) {
 #if UIP_REASSEMBLY
-    if(uip_reasstmr != 0) {
-      --uip_reasstmr;
-    }
+    uip_reass_periodic();
 #endif /* UIP_REASSEMBLY */
     /* Increase the initial sequence number. */
     if(++iss[3] == 0) {
@@ -805,6 +970,30 @@ uip_process(uint8_t flag)
 	  }
 	}
       } else if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
+#if UIP_TCP_KEEPALIVE
+	/* Pico]OS: Connection is idle. Drop it if idle timeout
+	   has expired or peer hasn't answered to keepalive
+	   probes, or send next probe if it is time for it. */
+	if(uip_connr->idle != 0xffff) {
+	  ++(uip_connr->idle);
+	}
+
+	if((UIP_TCP_IDLE_TIMEOUT != 0 && uip_connr->idle >= UIP_TCP_IDLE_TIMEOUT) ||
+	   (uip_connr->ka_idle != 0 && uip_connr->idle >= KA_PROBE_DUE(uip_connr) &&
+	    uip_connr->ka_probes >= uip_connr->ka_cnt)) {
+	  uip_connr->tcpstateflags = UIP_CLOSED;
+	  uip_flags = UIP_TIMEDOUT;
+	  UIP_APPCALL();
+	  BUF->flags = TCP_RST | TCP_ACK;
+	  goto tcp_send_nodata;
+	}
+
+	if(uip_connr->ka_idle != 0 && uip_connr->idle >= KA_PROBE_DUE(uip_connr)) {
+	  ++(uip_connr->ka_probes);
+	  ka_probe = 1;
+	  goto tcp_send_ack;
+	}
+#endif /* UIP_TCP_KEEPALIVE */
 	/* If there was no need for a retransmission, we poll the
            application for new data. */
 	uip_flags = UIP_POLL;
@@ -1189,6 +1378,9 @@ uip_process(uint8_t flag)
     goto drop;
   }
   uip_len = uip_slen + UIP_IPUDPH_LEN;
+#if UIP_XMITV
+  xmitv_setlen(UIP_IPUDPH_LEN);
+#endif /* UIP_XMITV */
 
 #if NETSTACK_CONF_WITH_IPV6
   /* For IPv6, the IP length field does not include the IPv6 IP header
@@ -1251,6 +1443,18 @@ uip_process(uint8_t flag)
   }
 
   /* Demultiplex this segment. */
+#if UIP_TCP_FASTPATH
+  /* Pico]OS: Segments tend to come in trains, try
+     connection that got previous one first. */
+  uip_connr = uip_lastconn;
+  if(uip_connr != NULL &&
+     uip_connr->tcpstateflags != UIP_CLOSED &&
+     BUF->destport == uip_connr->lport &&
+     BUF->srcport == uip_connr->rport &&
+     uip_ipaddr_cmp(&BUF->srcipaddr, &uip_connr->ripaddr)) {
+    goto found;
+  }
+#endif /* UIP_TCP_FASTPATH */
   /* First check any active connections. */
   for(uip_connr = &uip_conns[0]; uip_connr <= &uip_conns[UIP_CONNS - 1];
       ++uip_connr) {
@@ -1258,6 +1462,9 @@ uip_process(uint8_t flag)
        BUF->destport == uip_connr->lport &&
        BUF->srcport == uip_connr->rport &&
        uip_ipaddr_cmp(&BUF->srcipaddr, &uip_connr->ripaddr)) {
+#if UIP_TCP_FASTPATH
+      uip_lastconn = uip_connr;
+#endif /* UIP_TCP_FASTPATH */
       goto found;
     }
   }
@@ -1372,10 +1579,16 @@ uip_process(uint8_t flag)
   uip_connr->sa = 0;
   uip_connr->sv = 4;
   uip_connr->nrtx = 0;
+#if UIP_TCP_KEEPALIVE
+  uip_connr->idle = 0;
+  uip_connr->ka_idle = 0;
+  uip_connr->ka_probes = 0;
+#endif /* UIP_TCP_KEEPALIVE */
   uip_connr->lport = BUF->destport;
   uip_connr->rport = BUF->srcport;
   uip_ipaddr_copy(&uip_connr->ripaddr, &BUF->srcipaddr);
   uip_connr->tcpstateflags = UIP_SYN_RCVD;
+  uip_connr->initialmss = uip_connr->mss = UIP_TCP_CONN_MSS(uip_connr);
 
   uip_connr->snd_nxt[0] = iss[0];
   uip_connr->snd_nxt[1] = iss[1];
@@ -1406,7 +1619,7 @@ uip_process(uint8_t flag)
 	tmp16 = ((uint16_t)uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 2 + c] << 8) |
 	  (uint16_t)uip_buf[UIP_IPTCPH_LEN + UIP_LLH_LEN + 3 + c];
 	uip_connr->initialmss = uip_connr->mss =
-	  tmp16 > UIP_TCP_MSS? UIP_TCP_MSS: tmp16;
+	  tmp16 > uip_connr->initialmss? uip_connr->initialmss: tmp16;
 
 	/* And we are done processing options. */
 	break;
@@ -1437,10 +1650,11 @@ uip_process(uint8_t flag)
 
   /* We send out the TCP Maximum Segment Size option with our
      SYNACK. */
+  tmp16 = UIP_TCP_CONN_MSS(uip_connr);
   BUF->optdata[0] = TCP_OPT_MSS;
   BUF->optdata[1] = TCP_OPT_MSS_LEN;
-  BUF->optdata[2] = (UIP_TCP_MSS) / 256;
-  BUF->optdata[3] = (UIP_TCP_MSS) & 255;
+  BUF->optdata[2] = tmp16 / 256;
+  BUF->optdata[3] = tmp16 & 255;
   uip_len = UIP_IPTCPH_LEN + TCP_OPT_MSS_LEN;
   BUF->tcpoffset = ((UIP_TCPH_LEN + TCP_OPT_MSS_LEN) / 4) << 4;
   goto tcp_send;
@@ -1460,6 +1674,62 @@ uip_process(uint8_t flag)
     UIP_APPCALL();
     goto drop;
   }
+#if UIP_TCP_KEEPALIVE
+  /* Pico]OS: Peer is alive. */
+  uip_connr->idle = 0;
+  uip_connr->ka_probes = 0;
+#endif /* UIP_TCP_KEEPALIVE */
+#if UIP_TCP_FASTPATH
+  /* Pico]OS: Header prediction. Segment on established (and not
+     stopped) connection that has no options, no control flags
+     except ACK and PSH and carries next expected sequence number
+     is either in-order data or an ACK. If it also acknowledges
+     all outstanding data (or there is none), it can be passed to
+     application directly. Everything else takes the generic path. */
+  if(uip_connr->tcpstateflags == UIP_ESTABLISHED &&
+     BUF->tcpoffset == (UIP_TCPH_LEN / 4) << 4 &&
+     (BUF->flags & (TCP_FIN | TCP_SYN | TCP_RST | TCP_URG | TCP_ACK)) == TCP_ACK &&
+     BUF->seqno[0] == uip_connr->rcv_nxt[0] &&
+     BUF->seqno[1] == uip_connr->rcv_nxt[1] &&
+     BUF->seqno[2] == uip_connr->rcv_nxt[2] &&
+     BUF->seqno[3] == uip_connr->rcv_nxt[3]) {
+
+    if(uip_outstanding(uip_connr)) {
+      uip_add32(uip_connr->snd_nxt, uip_connr->len);
+      if(BUF->ackno[0] != uip_acc32[0] ||
+	 BUF->ackno[1] != uip_acc32[1] ||
+	 BUF->ackno[2] != uip_acc32[2] ||
+	 BUF->ackno[3] != uip_acc32[3]) {
+	goto slowpath;
+      }
+      uip_tcp_acked();
+    }
+
+    uip_len = uip_len - UIP_TCPIP_HLEN;
+    if(uip_len > 0) {
+      uip_flags |= UIP_NEWDATA;
+      uip_add_rcv_nxt(uip_len);
+    }
+
+    tmp16 = ((uint16_t)BUF->wnd[0] << 8) + (uint16_t)BUF->wnd[1];
+    if(tmp16 > uip_connr->initialmss ||
+       tmp16 == 0) {
+      tmp16 = uip_connr->initialmss;
+    }
+    uip_connr->mss = tmp16;
+
+    if(uip_flags == 0) {
+      /* Duplicate or window update ACK. */
+      goto drop;
+    }
+
+    uip_slen = 0;
+    UIP_APPCALL();
+    goto appsend;
+  }
+
+ slowpath:
+#endif /* UIP_TCP_FASTPATH */
   /* Calculate the length of the data, if the application has sent
      any data to us. */
   c = (BUF->tcpoffset >> 4) << 2;
@@ -1497,34 +1767,7 @@ uip_process(uint8_t flag)
        BUF->ackno[1] == uip_acc32[1] &&
        BUF->ackno[2] == uip_acc32[2] &&
        BUF->ackno[3] == uip_acc32[3]) {
-      /* Update sequence number. */
-      uip_connr->snd_nxt[0] = uip_acc32[0];
-      uip_connr->snd_nxt[1] = uip_acc32[1];
-      uip_connr->snd_nxt[2] = uip_acc32[2];
-      uip_connr->snd_nxt[3] = uip_acc32[3];
-
-      /* Do RTT estimation, unless we have done retransmissions. */
-      if(uip_connr->nrtx == 0) {
-	signed char m;
-	m = uip_connr->rto - uip_connr->timer;
-	/* This is taken directly from VJs original code in his paper */
-	m = m - (uip_connr->sa >> 3);
-	uip_connr->sa += m;
-	if(m < 0) {
-	  m = -m;
-	}
-	m = m - (uip_connr->sv >> 2);
-	uip_connr->sv += m;
-	uip_connr->rto = (uip_connr->sa >> 3) + uip_connr->sv;
-
-      }
-      /* Set the acknowledged flag. */
-      uip_flags = UIP_ACKDATA;
-      /* Reset the retransmission timer. */
-      uip_connr->timer = uip_connr->rto;
-
-      /* Reset length of outstanding data. */
-      uip_connr->len = 0;
+      uip_tcp_acked();
     }
 
   }
@@ -1546,10 +1789,16 @@ uip_process(uint8_t flag)
       uip_connr->len = 0;
       if(uip_len > 0) {
         uip_flags |= UIP_NEWDATA;
-        uip_add_rcv_nxt(uip_len);
       }
       uip_slen = 0;
       UIP_APPCALL();
+      /* Pico]OS: Application may stop a connection that waits to be
+         accepted. Data that came with the ACK is then left
+         unacknowledged and peer sends it again after the connection
+         has been restarted. */
+      if((uip_flags & UIP_NEWDATA) && !uip_stopped(uip_connr)) {
+        uip_add_rcv_nxt(uip_len);
+      }
       goto appsend;
     }
     /* We need to retransmit the SYNACK */
@@ -1582,7 +1831,7 @@ uip_process(uint8_t flag)
 	    tmp16 = (uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 2 + c] << 8) |
 	      uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 3 + c];
 	    uip_connr->initialmss =
-	      uip_connr->mss = tmp16 > UIP_TCP_MSS? UIP_TCP_MSS: tmp16;
+	      uip_connr->mss = tmp16 > uip_connr->initialmss? uip_connr->initialmss: tmp16;
 
 	    /* And we are done processing options. */
 	    break;
@@ -1885,6 +2134,17 @@ uip_process(uint8_t flag)
   BUF->seqno[2] = uip_connr->snd_nxt[2];
   BUF->seqno[3] = uip_connr->snd_nxt[3];
 
+#if UIP_TCP_KEEPALIVE
+  if(ka_probe) {
+    /* Keepalive probe carries an already acknowledged
+       sequence number, which makes peer answer with ACK. */
+    ka_probe = 0;
+    if(BUF->seqno[3]-- == 0 && BUF->seqno[2]-- == 0 && BUF->seqno[1]-- == 0) {
+      --BUF->seqno[0];
+    }
+  }
+#endif /* UIP_TCP_KEEPALIVE */
+
   BUF->srcport  = uip_connr->lport;
   BUF->destport = uip_connr->rport;
 
@@ -1916,6 +2176,10 @@ uip_process(uint8_t flag)
 
   BUF->urgp[0] = BUF->urgp[1] = 0;
 
+#if UIP_XMITV
+  xmitv_setlen(UIP_IPTCPH_LEN);
+#endif /* UIP_XMITV */
+
   /* Calculate TCP checksum. */
   BUF->tcpchksum = 0;
   BUF->tcpchksum = ~(uip_tcpchksum());
@@ -1972,6 +2236,10 @@ void
 uip_send(const void *data, int len)
 {
   int copylen;
+
+#if UIP_XMITV
+  uip_xmitv_clear();
+#endif /* UIP_XMITV */
   copylen = MIN(len, UIP_BUFSIZE - UIP_LLH_LEN - UIP_TCPIP_HLEN -
 		(int)((char *)uip_sappdata - (char *)&uip_buf[UIP_LLH_LEN + UIP_TCPIP_HLEN]));
   if(copylen > 0) {
@@ -1982,4 +2250,33 @@ uip_send(const void *data, int len)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if UIP_XMITV
+void
+uip_sendv(const void *data, int len)
+{
+  /* Pico]OS: Keep payload size within uip_buf, so packet
+              can always be flattened if needed. */
+  len = MIN(len, UIP_BUFSIZE - UIP_LLH_LEN - UIP_TCPIP_HLEN);
+  if(len > 0) {
+    uip_slen = len;
+    uip_xmitv_data = data;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_xmitv_flatten(void)
+{
+  uint16_t iplen;
+
+  /* Pico]OS: Locate end of headers using IP length, as uip_len
+              may or may not include link-level header yet. */
+  if(uip_xmitv_data != NULL) {
+    iplen = ((uint16_t)(BUF->len[0]) << 8) + BUF->len[1];
+    memcpy(&uip_buf[UIP_LLH_LEN + iplen - uip_xmitv_len], uip_xmitv_data,
+           uip_xmitv_len);
+    uip_xmitv_clear();
+  }
+}
+#endif /* UIP_XMITV */
+/*---------------------------------------------------------------------------*/
 /** @}*/
@@ -89,6 +89,68 @@ static uip_ds6_maddr_t *locmaddr;
 static uip_ds6_aaddr_t *locaaddr;
 static uip_ds6_prefix_t *locprefix;
 
+/*
+ * Pico]OS: Bloom-style acceptance filter for own unicast, anycast
+ * and multicast addresses. Lookups for addresses that don't
+ * have their bits set in filter fail without scanning the lists.
+ * Bits are set when address is added, filter is rebuilt when
+ * address is removed.
+ */
+static uint32_t addr_filter[2];
+
+#define ADDR_FILTER_HASH(a) ((a)->u16[0] ^ (a)->u16[6] ^ (a)->u16[7])
+#define ADDR_FILTER_BIT(h)  (addr_filter[((h) >> 5) & 1] & (1UL << ((h) & 31)))
+
+/*---------------------------------------------------------------------------*/
+static void
+addr_filter_set(const uip_ipaddr_t *ipaddr)
+{
+  uint16_t h = ADDR_FILTER_HASH(ipaddr);
+
+  addr_filter[(h >> 5) & 1] |= 1UL << (h & 31);
+  h >>= 6;
+  addr_filter[(h >> 5) & 1] |= 1UL << (h & 31);
+}
+
+/*---------------------------------------------------------------------------*/
+static int
+addr_filter_match(const uip_ipaddr_t *ipaddr)
+{
+  uint16_t h = ADDR_FILTER_HASH(ipaddr);
+
+  return ADDR_FILTER_BIT(h) && ADDR_FILTER_BIT(h >> 6);
+}
+
+/*---------------------------------------------------------------------------*/
+static void
+addr_filter_rebuild(void)
+{
+  uint8_t i;
+
+  addr_filter[0] = 0;
+  addr_filter[1] = 0;
+
+  for(i = 0; i < UIP_DS6_ADDR_NB; i++) {
+    if(uip_ds6_if.addr_list[i].isused) {
+      addr_filter_set(&uip_ds6_if.addr_list[i].ipaddr);
+    }
+  }
+
+#if UIP_DS6_AADDR_NB > 0
+  for(i = 0; i < UIP_DS6_AADDR_NB; i++) {
+    if(uip_ds6_if.aaddr_list[i].isused) {
+      addr_filter_set(&uip_ds6_if.aaddr_list[i].ipaddr);
+    }
+  }
+#endif /* UIP_DS6_AADDR_NB > 0 */
+
+  for(i = 0; i < UIP_DS6_MADDR_NB; i++) {
+    if(uip_ds6_if.maddr_list[i].isused) {
+      addr_filter_set(&uip_ds6_if.maddr_list[i].ipaddr);
+    }
+  }
+}
+
 /*---------------------------------------------------------------------------*/
 void
 uip_ds6_init(void)
@@ -103,6 +165,7 @@ uip_ds6_init(void)
      UIP_DS6_ADDR_NB, UIP_DS6_MADDR_NB, UIP_DS6_AADDR_NB);
   memset(uip_ds6_prefix_list, 0, sizeof(uip_ds6_prefix_list));
   memset(&uip_ds6_if, 0, sizeof(uip_ds6_if));
+  addr_filter_rebuild();
   uip_ds6_addr_size = sizeof(struct uip_ds6_addr);
   uip_ds6_netif_addr_list_offset = offsetof(struct uip_ds6_netif, addr_list);
 
@@ -342,6 +405,7 @@ uip_ds6_addr_add(uip_ipaddr_t *ipaddr, unsigned long vlifetime, uint8_t type)
       (uip_ds6_element_t **)&locaddr) == FREESPACE) {
     locaddr->isused = 1;
     uip_ipaddr_copy(&locaddr->ipaddr, ipaddr);
+    addr_filter_set(ipaddr);
     locaddr->type = type;
     if(vlifetime == 0) {
       locaddr->isinfinite = 1;
@@ -375,6 +439,7 @@ uip_ds6_addr_rm(uip_ds6_addr_t *addr)
       uip_ds6_maddr_rm(locmaddr);
     }
     addr->isused = 0;
+    addr_filter_rebuild();
   }
   return;
 }
@@ -383,6 +448,10 @@ uip_ds6_addr_rm(uip_ds6_addr_t *addr)
 uip_ds6_addr_t *
 uip_ds6_addr_lookup(uip_ipaddr_t *ipaddr)
 {
+  if(!addr_filter_match(ipaddr)) {
+    return NULL;
+  }
+
   if(uip_ds6_list_loop
      ((uip_ds6_element_t *)uip_ds6_if.addr_list, UIP_DS6_ADDR_NB,
       sizeof(uip_ds6_addr_t), ipaddr, 128,
@@ -440,6 +509,7 @@ uip_ds6_maddr_add(const uip_ipaddr_t *ipaddr)
       (uip_ds6_element_t **)&locmaddr) == FREESPACE) {
     locmaddr->isused = 1;
     uip_ipaddr_copy(&locmaddr->ipaddr, ipaddr);
+    addr_filter_set(ipaddr);
     return locmaddr;
   }
   return NULL;
@@ -451,6 +521,7 @@ uip_ds6_maddr_rm(uip_ds6_maddr_t *maddr)
 {
   if(maddr != NULL) {
     maddr->isused = 0;
+    addr_filter_rebuild();
   }
   return;
 }
@@ -459,6 +530,10 @@ uip_ds6_maddr_rm(uip_ds6_maddr_t *maddr)
 uip_ds6_maddr_t *
 uip_ds6_maddr_lookup(const uip_ipaddr_t *ipaddr)
 {
+  if(!addr_filter_match(ipaddr)) {
+    return NULL;
+  }
+
   if(uip_ds6_list_loop
      ((uip_ds6_element_t *)uip_ds6_if.maddr_list, UIP_DS6_MADDR_NB,
       sizeof(uip_ds6_maddr_t), (void*)ipaddr, 128,
@@ -479,6 +554,7 @@ uip_ds6_aaddr_add(uip_ipaddr_t *ipaddr)
       (uip_ds6_element_t **)&locaaddr) == FREESPACE) {
     locaaddr->isused = 1;
     uip_ipaddr_copy(&locaaddr->ipaddr, ipaddr);
+    addr_filter_set(ipaddr);
     return locaaddr;
   }
   return NULL;
@@ -490,6 +566,7 @@ uip_ds6_aaddr_rm(uip_ds6_aaddr_t *aaddr)
 {
   if(aaddr != NULL) {
     aaddr->isused = 0;
+    addr_filter_rebuild();
   }
   return;
 }
@@ -498,6 +575,10 @@ uip_ds6_aaddr_rm(uip_ds6_aaddr_t *aaddr)
 uip_ds6_aaddr_t *
 uip_ds6_aaddr_lookup(uip_ipaddr_t *ipaddr)
 {
+  if(!addr_filter_match(ipaddr)) {
+    return NULL;
+  }
+
   if(uip_ds6_list_loop((uip_ds6_element_t *)uip_ds6_if.aaddr_list,
 		       UIP_DS6_AADDR_NB, sizeof(uip_ds6_aaddr_t), ipaddr, 128,
 		       (uip_ds6_element_t **)&locaaddr) == FOUND) {
@@ -76,17 +76,34 @@ static uip_ipaddr_t tmp_ipaddr;
 
 LIST(echo_reply_callback_list);
 /*---------------------------------------------------------------------------*/
-/* List of input handlers */
+/*
+ * Input handlers. Types inside the dispatch window are looked up
+ * directly by type; handlers registered for the same type but
+ * different codes are chained through their next pointer. Types
+ * outside the window fall back to the list.
+ */
+#define DISPATCH_SIZE (UIP_ICMP6_DISPATCH_LAST - UIP_ICMP6_DISPATCH_FIRST + 1)
+#define DISPATCH_SLOT(type) ((uint8_t)((type) - UIP_ICMP6_DISPATCH_FIRST))
+
+static uip_icmp6_input_handler_t *input_handler_table[DISPATCH_SIZE];
 LIST(input_handler_list);
+
+#if UIP_STATISTICS == 1
+static uip_stats_t input_handler_hits[DISPATCH_SIZE + 1];
+#endif /* UIP_STATISTICS == 1 */
 /*---------------------------------------------------------------------------*/
 static uip_icmp6_input_handler_t *
 input_handler_lookup(uint8_t type, uint8_t icode)
 {
   uip_icmp6_input_handler_t *handler = NULL;
 
-  for(handler = list_head(input_handler_list);
-      handler != NULL;
-      handler = list_item_next(handler)) {
+  if(DISPATCH_SLOT(type) < DISPATCH_SIZE) {
+    handler = input_handler_table[DISPATCH_SLOT(type)];
+  } else {
+    handler = list_head(input_handler_list);
+  }
+
+  for(; handler != NULL; handler = handler->next) {
     if(handler->type == type &&
        (handler->icode == icode ||
         handler->icode == UIP_ICMP6_HANDLER_CODE_ANY)) {
@@ -110,6 +127,8 @@ uip_icmp6_input(uint8_t type, uint8_t icode)
     return UIP_ICMP6_INPUT_ERROR;
   }
 
+  UIP_STAT(++input_handler_hits[DISPATCH_SLOT(type) < DISPATCH_SIZE ?
+                                DISPATCH_SLOT(type) : DISPATCH_SIZE]);
   handler->handler();
   return UIP_ICMP6_INPUT_SUCCESS;
 }
@@ -117,8 +136,40 @@ uip_icmp6_input(uint8_t type, uint8_t icode)
 void
 uip_icmp6_register_input_handler(uip_icmp6_input_handler_t *handler)
 {
-  list_add(input_handler_list, handler);
+  uip_icmp6_input_handler_t **prev;
+
+  if(DISPATCH_SLOT(handler->type) >= DISPATCH_SIZE) {
+    list_add(input_handler_list, handler);
+    return;
+  }
+
+  /*
+   * Append to the end of per-type chain, so that lookup order
+   * is the same as registration order (like list_add).
+   */
+  prev = &input_handler_table[DISPATCH_SLOT(handler->type)];
+  while(*prev != NULL) {
+    if(*prev == handler) {
+      return;
+    }
+    prev = &(*prev)->next;
+  }
+
+  handler->next = NULL;
+  *prev = handler;
+}
+/*---------------------------------------------------------------------------*/
+#if UIP_STATISTICS == 1
+uip_stats_t
+uip_icmp6_input_hits(uint8_t type)
+{
+  if(DISPATCH_SLOT(type) < DISPATCH_SIZE) {
+    return input_handler_hits[DISPATCH_SLOT(type)];
+  }
+
+  return input_handler_hits[DISPATCH_SIZE];
 }
+#endif /* UIP_STATISTICS == 1 */
 /*---------------------------------------------------------------------------*/
 static void
 echo_request_input(void)
@@ -186,6 +186,23 @@ typedef struct uip_icmp6_input_handler {
 
 #define UIP_ICMP6_HANDLER_CODE_ANY 0xFF /* Handle all codes for this type */
 
+/*
+ * Pico]OS: Range of ICMPv6 types that are dispatched using a
+ * table indexed by type. Default covers echo and neighbor
+ * discovery messages. Other types are searched from a list.
+ */
+#ifdef UIP_CONF_ICMP6_DISPATCH_FIRST
+#define UIP_ICMP6_DISPATCH_FIRST UIP_CONF_ICMP6_DISPATCH_FIRST
+#else
+#define UIP_ICMP6_DISPATCH_FIRST ICMP6_ECHO_REQUEST
+#endif
+
+#ifdef UIP_CONF_ICMP6_DISPATCH_LAST
+#define UIP_ICMP6_DISPATCH_LAST UIP_CONF_ICMP6_DISPATCH_LAST
+#else
+#define UIP_ICMP6_DISPATCH_LAST ICMP6_REDIRECT
+#endif
+
 /*
  * Initialise a variable of type uip_icmp6_input_handler, to be used later as
  * the argument to uip_icmp6_register_input_handler
@@ -228,6 +245,16 @@ uint8_t uip_icmp6_input(uint8_t type, uint8_t icode);
  */
 void uip_icmp6_register_input_handler(uip_icmp6_input_handler_t *handler);
 
+#if UIP_STATISTICS == 1
+/**
+ * \brief Number of ICMPv6 messages dispatched to handlers
+ * \param type The ICMPv6 message type
+ * \return Messages handled for type. Types outside the dispatch
+ *         table share a single counter.
+ */
+uip_stats_t uip_icmp6_input_hits(uint8_t type);
+#endif /* UIP_STATISTICS == 1 */
+
 
 /**
  * \brief Initialise the uIP ICMPv6 core
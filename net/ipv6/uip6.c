@@ -83,6 +83,11 @@
 #include "net/ipv6/uip-nd6.h"
 #include "net/ipv6/uip-ds6.h"
 
+#if UIP_CONF_IPV6_REASSEMBLY
+#include "lib/list.h"
+#include "lib/memb.h"
+#endif /* UIP_CONF_IPV6_REASSEMBLY */
+
 #include <string.h>
 
 /*---------------------------------------------------------------------------*/
@@ -160,7 +165,7 @@ uint8_t uip_ext_opt_offset = 0;
  * Pico]OS: Use uip_buf32 macro to ensure 32-bit alignment.
  *          Allows compiling with gcc -Wcast-align.
  */
-#define FBUF                             ((struct uip_tcpip_hdr *)&uip_reassbuf[0])
+#define FBUF(r)                          ((struct uip_tcpip_hdr *)(r)->buf)
 #define UIP_IP_BUF                          ((struct uip_ip_hdr *)&uip_buf16(UIP_LLH_LEN))
 #define UIP_ICMP_BUF                      ((struct uip_icmp_hdr *)&uip_buf16(uip_l2_l3_hdr_len))
 #define UIP_UDP_BUF                        ((struct uip_udp_hdr *)&uip_buf16((UIP_LLH_LEN + UIP_IPH_LEN)))
@@ -177,6 +182,33 @@ uint8_t uip_ext_opt_offset = 0;
 #endif /* UIP_CONF_IPV6_RPL */
 #define UIP_ICMP6_ERROR_BUF            ((struct uip_icmp6_error *)&uip_buf32(uip_l2_l3_icmp_hdr_len))
 /** @} */
+
+#if UIP_CONF_IPV6_REASSEMBLY
+#define UIP_REASS_BUFSIZE (UIP_BUFSIZE - UIP_LLH_LEN)
+
+/*
+ * Pico]OS: Multiple reassembly contexts, allocated from a pool.
+ *          Active contexts are kept in a list, most recently
+ *          used first. Buffer is declared as uint32_t array to
+ *          get alignment needed by FBUF.
+ */
+struct uip_reass_ctx {
+  struct uip_reass_ctx *next;
+  uint32_t buf[(UIP_REASS_BUFSIZE + 3) / 4];
+  /*the first byte of an IP fragment is aligned on an 8-byte boundary */
+  uint8_t bitmap[UIP_REASS_BUFSIZE / (8 * 8) + 1];
+  clock_time_t start;
+  uint32_t id; /* For every packet that is to be fragmented, the source
+                  node generates an Identification value that is present
+                  in all the fragments */
+  uint16_t len;
+  uint8_t flags;
+};
+
+MEMB(uip_reass_memb, struct uip_reass_ctx, UIP_REASS_CONTEXTS);
+LIST(uip_reass_list);
+#endif /* UIP_CONF_IPV6_REASSEMBLY */
+
 /**
  * \name Buffer variables
  * @{
@@ -199,6 +231,14 @@ uint16_t uip_urglen, uip_surglen;
 
 /* The uip_len is either 8 or 16 bits, depending on the maximum packet size.*/
 uint16_t uip_len, uip_slen;
+#if UIP_XMITV
+/*
+ * Pico]OS: Payload of outgoing packet when it was given
+ *          with uip_sendv() and is not in uip_buf.
+ */
+const void *uip_xmitv_data;
+uint16_t uip_xmitv_len;
+#endif /* UIP_XMITV */
 /** @} */
 
 /*---------------------------------------------------------------------------*/
@@ -262,6 +302,17 @@ uint16_t uip_listenports[UIP_LISTENPORTS];
 /* The iss variable is used for the TCP initial sequence number. */
 static uint8_t iss[4];
 
+#if UIP_TCP_FASTPATH
+/* Connection that received last segment. */
+static struct uip_conn *uip_lastconn;
+#endif /* UIP_TCP_FASTPATH */
+
+#if UIP_TCP_KEEPALIVE
+/* Set when segment being sent is a keepalive probe. */
+static uint8_t ka_probe;
+#define KA_PROBE_DUE(conn) ((conn)->ka_idle + (conn)->ka_probes * (conn)->ka_intvl)
+#endif /* UIP_TCP_KEEPALIVE */
+
 /* Temporary variables. */
 uint8_t uip_acc32[4];
 static uint8_t opt;
@@ -403,6 +454,18 @@ upper_layer_chksum(uint8_t proto)
   /* Sum IP source and destination addresses. */
   sum = chksum(sum, (uint8_t *)&UIP_IP_BUF->srcipaddr, 2 * sizeof(uip_ipaddr_t));
 
+#if UIP_XMITV
+/*
+ * Pico]OS: Payload may be outside uip_buf.
+ */
+  if(uip_xmitv_data != NULL) {
+    sum = chksum(sum, &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN + uip_ext_len],
+                 upper_layer_len - uip_xmitv_len);
+    sum = chksum(sum, uip_xmitv_data, uip_xmitv_len);
+    return (sum == 0) ? 0xffff : uip_htons(sum);
+  }
+#endif /* UIP_XMITV */
+
   /* Sum TCP header and data. */
   sum = chksum(sum, &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN + uip_ext_len],
                upper_layer_len);
@@ -461,6 +524,11 @@ uip_init(void)
   }
 #endif /* UIP_UDP */
 
+#if UIP_CONF_IPV6_REASSEMBLY
+  memb_init(&uip_reass_memb);
+  list_init(uip_reass_list);
+#endif /* UIP_CONF_IPV6_REASSEMBLY */
+
 #if UIP_CONF_IPV6_MULTICAST
   UIP_MCAST6.init();
 #endif
@@ -521,10 +589,13 @@ uip_connect(const uip_ipaddr_t *ripaddr, uint16_t rport)
   conn->rcv_nxt[2] = 0;
   conn->rcv_nxt[3] = 0;
 
-  conn->initialmss = conn->mss = UIP_TCP_MSS;
-  
   conn->len = 1;   /* TCP length of the SYN is one. */
   conn->nrtx = 0;
+#if UIP_TCP_KEEPALIVE
+  conn->idle = 0;
+  conn->ka_idle = 0;
+  conn->ka_probes = 0;
+#endif /* UIP_TCP_KEEPALIVE */
   conn->timer = 1; /* Send the SYN next time around. */
   conn->rto = UIP_RTO;
   conn->sa = 0;
@@ -532,6 +603,7 @@ uip_connect(const uip_ipaddr_t *ripaddr, uint16_t rport)
   conn->lport = uip_htons(lastport);
   conn->rport = rport;
   uip_ipaddr_copy(&conn->ripaddr, ripaddr);
+  conn->initialmss = conn->mss = UIP_TCP_CONN_MSS(conn);
   
   return conn;
 }
@@ -637,22 +709,15 @@ uip_listen(uint16_t port)
 /*---------------------------------------------------------------------------*/
 
 #if UIP_CONF_IPV6_REASSEMBLY
-#define UIP_REASS_BUFSIZE (UIP_BUFSIZE - UIP_LLH_LEN)
-
-static uint8_t uip_reassbuf[UIP_REASS_BUFSIZE];
-
-static uint8_t uip_reassbitmap[UIP_REASS_BUFSIZE / (8 * 8)];
-/*the first byte of an IP fragment is aligned on an 8-byte boundary */
-
 static const uint8_t bitmap_bits[8] = {0xff, 0x7f, 0x3f, 0x1f,
                                     0x0f, 0x07, 0x03, 0x01};
-static uint16_t uip_reasslen;
-static uint8_t uip_reassflags;
+static uint8_t uip_reassflags; /* flags of last completed/failed context */
 
 #define UIP_REASS_FLAG_LASTFRAG 0x01
 #define UIP_REASS_FLAG_FIRSTFRAG 0x02
 #define UIP_REASS_FLAG_ERROR_MSG 0x04
 
+#define UIP_REASS_MAXAGE_TICKS ((clock_time_t)UIP_REASS_MAXAGE * CLOCK_SECOND)
 
 /*
  * See RFC 2460 for a description of fragmentation in IPv6
@@ -664,187 +729,247 @@ static uint8_t uip_reassflags;
  */
 
 
-struct etimer uip_reass_timer; /* timer for reassembly */
-uint8_t uip_reass_on; /* equal to 1 if we are currently reassembling a packet */
+struct etimer uip_reass_timer; /* timer for reassembly, runs for oldest context */
 
-static uint32_t uip_id; /* For every packet that is to be fragmented, the source
-                        node generates an Identification value that is present
-                        in all the fragments */
 #define IP_MF   0x0001
 
+/*---------------------------------------------------------------------------*/
+static void
+uip_reass_free(struct uip_reass_ctx *r)
+{
+  list_remove(uip_reass_list, r);
+  memb_free(&uip_reass_memb, r);
+  if(list_head(uip_reass_list) == NULL) {
+    etimer_stop(&uip_reass_timer);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static struct uip_reass_ctx *
+uip_reass_lookup(void)
+{
+  struct uip_reass_ctx *r;
+
+  for(r = list_head(uip_reass_list); r != NULL; r = list_item_next(r)) {
+    if(uip_ipaddr_cmp(&FBUF(r)->srcipaddr, &UIP_IP_BUF->srcipaddr) &&
+       uip_ipaddr_cmp(&FBUF(r)->destipaddr, &UIP_IP_BUF->destipaddr) &&
+       UIP_FRAG_BUF->id == r->id) {
+
+      /* Move to front of list to keep it in LRU order. */
+      list_remove(uip_reass_list, r);
+      list_push(uip_reass_list, r);
+      return r;
+    }
+  }
+
+  /* Fragment of a new datagram. If all contexts are busy,
+     evict the least recently used one. */
+  r = memb_alloc(&uip_reass_memb);
+  if(r == NULL) {
+    r = list_chop(uip_reass_list);
+    if(r == NULL) {
+      return NULL;
+    }
+    PRINTF("Evicting reassembly context\n");
+    UIP_STAT(++uip_stat.reass.evicted);
+  }
+
+  PRINTF("Starting reassembly\n");
+  /* We first write the unfragmentable part of IP header into the reassembly
+     buffer. The reset the other reassembly variables. */
+  memcpy(FBUF(r), UIP_IP_BUF, uip_ext_len + UIP_IPH_LEN);
+  r->start = clock_time();
+  r->id = UIP_FRAG_BUF->id;
+  r->flags = 0;
+  r->len = 0;
+  /* Clear the bitmap. */
+  memset(r->bitmap, 0, sizeof(r->bitmap));
+
+  if(list_head(uip_reass_list) == NULL) {
+    etimer_set(&uip_reass_timer, UIP_REASS_MAXAGE_TICKS);
+  }
+
+  list_push(uip_reass_list, r);
+  return r;
+}
+/*---------------------------------------------------------------------------*/
 static uint16_t
 uip_reass(void)
 {
+  struct uip_reass_ctx *r;
   uint16_t offset=0;
   uint16_t len;
   uint16_t i;
-  
-  /* If ip_reasstmr is zero, no packet is present in the buffer */
-  /* We first write the unfragmentable part of IP header into the reassembly
-     buffer. The reset the other reassembly variables. */
-  if(uip_reass_on == 0) {
-    PRINTF("Starting reassembly\n");
-    memcpy(FBUF, UIP_IP_BUF, uip_ext_len + UIP_IPH_LEN);
-    /* temporary in case we do not receive the fragment with offset 0 first */
-    etimer_set(&uip_reass_timer, UIP_REASS_MAXAGE*CLOCK_SECOND);
-    uip_reass_on = 1;
-    uip_reassflags = 0;
-    uip_id = UIP_FRAG_BUF->id;
-    /* Clear the bitmap. */
-    memset(uip_reassbitmap, 0, sizeof(uip_reassbitmap));
+
+  r = uip_reass_lookup();
+  if(r == NULL) {
+    return 0;
   }
-  /*
-   * Check if the incoming fragment matches the one currently present
-   * in the reasembly buffer. If so, we proceed with copying the fragment
-   * into the buffer.
-   */
-  if(uip_ipaddr_cmp(&FBUF->srcipaddr, &UIP_IP_BUF->srcipaddr) &&
-     uip_ipaddr_cmp(&FBUF->destipaddr, &UIP_IP_BUF->destipaddr) &&
-     UIP_FRAG_BUF->id == uip_id) {
-    len = uip_len - uip_ext_len - UIP_IPH_LEN - UIP_FRAGH_LEN;
-    offset = (uip_ntohs(UIP_FRAG_BUF->offsetresmore) & 0xfff8);
-    /* in byte, originaly in multiple of 8 bytes*/
-    PRINTF("len %d\n", len);
-    PRINTF("offset %d\n", offset);
-    if(offset == 0){
-      uip_reassflags |= UIP_REASS_FLAG_FIRSTFRAG;
-      /*
-       * The Next Header field of the last header of the Unfragmentable
-       * Part is obtained from the Next Header field of the first
-       * fragment's Fragment header.
-       */
-      *uip_next_hdr = UIP_FRAG_BUF->next;
-      memcpy(FBUF, UIP_IP_BUF, uip_ext_len + UIP_IPH_LEN);
-      PRINTF("src ");
-      PRINT6ADDR(&FBUF->srcipaddr);
-      PRINTF("dest ");
-      PRINT6ADDR(&FBUF->destipaddr);
-      PRINTF("next %d\n", UIP_IP_BUF->proto);
-      
+
+  len = uip_len - uip_ext_len - UIP_IPH_LEN - UIP_FRAGH_LEN;
+  offset = (uip_ntohs(UIP_FRAG_BUF->offsetresmore) & 0xfff8);
+  /* in byte, originaly in multiple of 8 bytes*/
+  PRINTF("len %d\n", len);
+  PRINTF("offset %d\n", offset);
+  if(offset == 0){
+    r->flags |= UIP_REASS_FLAG_FIRSTFRAG;
+    /*
+     * The Next Header field of the last header of the Unfragmentable
+     * Part is obtained from the Next Header field of the first
+     * fragment's Fragment header.
+     */
+    *uip_next_hdr = UIP_FRAG_BUF->next;
+    memcpy(FBUF(r), UIP_IP_BUF, uip_ext_len + UIP_IPH_LEN);
+    PRINTF("src ");
+    PRINT6ADDR(&FBUF(r)->srcipaddr);
+    PRINTF("dest ");
+    PRINT6ADDR(&FBUF(r)->destipaddr);
+    PRINTF("next %d\n", UIP_IP_BUF->proto);
+
+  }
+
+  /* If the offset or the offset + fragment length overflows the
+     reassembly buffer, we discard the entire packet. */
+  if(offset > UIP_REASS_BUFSIZE - UIP_IPH_LEN - uip_ext_len ||
+     offset + len > UIP_REASS_BUFSIZE - UIP_IPH_LEN - uip_ext_len) {
+    UIP_STAT(++uip_stat.reass.toobig);
+    uip_reass_free(r);
+    return 0;
+  }
+
+  /* If this fragment has the More Fragments flag set to zero, it is the
+     last fragment*/
+  if((uip_ntohs(UIP_FRAG_BUF->offsetresmore) & IP_MF) == 0) {
+    r->flags |= UIP_REASS_FLAG_LASTFRAG;
+    /*calculate the size of the entire packet*/
+    r->len = offset + len;
+    PRINTF("LAST FRAGMENT reasslen %d\n", r->len);
+  } else {
+    /* If len is not a multiple of 8 octets and the M flag of that fragment
+       is 1, then that fragment must be discarded and an ICMP Parameter
+       Problem, Code 0, message should be sent to the source of the fragment,
+       pointing to the Payload Length field of the fragment packet. */
+    if(len % 8 != 0){
+      uip_icmp6_error_output(ICMP6_PARAM_PROB, ICMP6_PARAMPROB_HEADER, 4);
+      uip_reassflags = r->flags | UIP_REASS_FLAG_ERROR_MSG;
+      /* not clear if we should interrupt reassembly, but it seems so from
+         the conformance tests */
+      uip_reass_free(r);
+      return uip_len;
     }
-    
-    /* If the offset or the offset + fragment length overflows the
-       reassembly buffer, we discard the entire packet. */
-    if(offset > UIP_REASS_BUFSIZE ||
-       offset + len > UIP_REASS_BUFSIZE) {
-      uip_reass_on = 0;
-      etimer_stop(&uip_reass_timer);
-      return 0;
+  }
+
+  /* Copy the fragment into the reassembly buffer, at the right
+     offset. */
+  memcpy((uint8_t *)FBUF(r) + UIP_IPH_LEN + uip_ext_len + offset,
+         (uint8_t *)UIP_FRAG_BUF + UIP_FRAGH_LEN, len);
+
+  /* Update the bitmap. */
+  if(offset >> 6 == (offset + len) >> 6) {
+    r->bitmap[offset >> 6] |=
+      bitmap_bits[(offset >> 3) & 7] &
+      ~bitmap_bits[((offset + len) >> 3)  & 7];
+  } else {
+    /* If the two endpoints are in different bytes, we update the
+       bytes in the endpoints and fill the stuff inbetween with
+       0xff. */
+    r->bitmap[offset >> 6] |= bitmap_bits[(offset >> 3) & 7];
+
+    for(i = (1 + (offset >> 6)); i < ((offset + len) >> 6); ++i) {
+      r->bitmap[i] = 0xff;
     }
+    r->bitmap[(offset + len) >> 6] |=
+      ~bitmap_bits[((offset + len) >> 3) & 7];
+  }
 
-    /* If this fragment has the More Fragments flag set to zero, it is the
-       last fragment*/
-    if((uip_ntohs(UIP_FRAG_BUF->offsetresmore) & IP_MF) == 0) {
-      uip_reassflags |= UIP_REASS_FLAG_LASTFRAG;
-      /*calculate the size of the entire packet*/
-      uip_reasslen = offset + len;
-      PRINTF("LAST FRAGMENT reasslen %d\n", uip_reasslen);
-    } else {
-      /* If len is not a multiple of 8 octets and the M flag of that fragment
-         is 1, then that fragment must be discarded and an ICMP Parameter
-         Problem, Code 0, message should be sent to the source of the fragment,
-         pointing to the Payload Length field of the fragment packet. */
-      if(len % 8 != 0){
-        uip_icmp6_error_output(ICMP6_PARAM_PROB, ICMP6_PARAMPROB_HEADER, 4);
-        uip_reassflags |= UIP_REASS_FLAG_ERROR_MSG;
-        /* not clear if we should interrupt reassembly, but it seems so from
-           the conformance tests */
-        uip_reass_on = 0;
-        etimer_stop(&uip_reass_timer);
-        return uip_len;
+  /* Finally, we check if we have a full packet in the buffer. We do
+     this by checking if we have the last fragment and if all bits
+     in the bitmap are set. */
+
+  if(r->flags & UIP_REASS_FLAG_LASTFRAG) {
+    /* Check all bytes up to and including all but the last byte in
+       the bitmap. */
+    for(i = 0; i < (r->len >> 6); ++i) {
+      if(r->bitmap[i] != 0xff) {
+        return 0;
       }
     }
-    
-    /* Copy the fragment into the reassembly buffer, at the right
-       offset. */
-    memcpy((uint8_t *)FBUF + UIP_IPH_LEN + uip_ext_len + offset,
-           (uint8_t *)UIP_FRAG_BUF + UIP_FRAGH_LEN, len);
-    
-    /* Update the bitmap. */
-    if(offset >> 6 == (offset + len) >> 6) {
-      uip_reassbitmap[offset >> 6] |=
-        bitmap_bits[(offset >> 3) & 7] &
-        ~bitmap_bits[((offset + len) >> 3)  & 7];
-    } else {
-      /* If the two endpoints are in different bytes, we update the
-         bytes in the endpoints and fill the stuff inbetween with
-         0xff. */
-      uip_reassbitmap[offset >> 6] |= bitmap_bits[(offset >> 3) & 7];
- 
-      for(i = (1 + (offset >> 6)); i < ((offset + len) >> 6); ++i) {
-        uip_reassbitmap[i] = 0xff;
-      }
-      uip_reassbitmap[(offset + len) >> 6] |=
-        ~bitmap_bits[((offset + len) >> 3) & 7];
+    /* Check the last byte in the bitmap. It should contain just the
+       right amount of bits. */
+    if(r->bitmap[r->len >> 6] !=
+       (uint8_t)~bitmap_bits[(r->len >> 3) & 7]) {
+      return 0;
     }
-  
-    /* Finally, we check if we have a full packet in the buffer. We do
-       this by checking if we have the last fragment and if all bits
-       in the bitmap are set. */
-    
-    if(uip_reassflags & UIP_REASS_FLAG_LASTFRAG) {
-      /* Check all bytes up to and including all but the last byte in
-         the bitmap. */
-      for(i = 0; i < (uip_reasslen >> 6); ++i) {
-        if(uip_reassbitmap[i] != 0xff) {
-          return 0;
-        }
-      }
-      /* Check the last byte in the bitmap. It should contain just the
-         right amount of bits. */
-      if(uip_reassbitmap[uip_reasslen >> 6] !=
-         (uint8_t)~bitmap_bits[(uip_reasslen >> 3) & 7]) {
-        return 0;
-      }
 
-     /* If we have come this far, we have a full packet in the
-         buffer, so we copy it to uip_buf. We also reset the timer. */
-      uip_reass_on = 0;
-      etimer_stop(&uip_reass_timer);
-
-      uip_reasslen += UIP_IPH_LEN + uip_ext_len;
-      memcpy(UIP_IP_BUF, FBUF, uip_reasslen);
-      UIP_IP_BUF->len[0] = ((uip_reasslen - UIP_IPH_LEN) >> 8);
-      UIP_IP_BUF->len[1] = ((uip_reasslen - UIP_IPH_LEN) & 0xff);
-      PRINTF("REASSEMBLED PAQUET %d (%d)\n", uip_reasslen,
-             (UIP_IP_BUF->len[0] << 8) | UIP_IP_BUF->len[1]);
-   
-      return uip_reasslen;
-      
-    }
-  } else {
-    PRINTF("Already reassembling another paquet\n");
+   /* If we have come this far, we have a full packet in the
+       buffer, so we copy it to uip_buf and release the context. */
+    len = r->len + UIP_IPH_LEN + uip_ext_len;
+    memcpy(UIP_IP_BUF, FBUF(r), len);
+    UIP_IP_BUF->len[0] = ((len - UIP_IPH_LEN) >> 8);
+    UIP_IP_BUF->len[1] = ((len - UIP_IPH_LEN) & 0xff);
+    PRINTF("REASSEMBLED PAQUET %d (%d)\n", len,
+           (UIP_IP_BUF->len[0] << 8) | UIP_IP_BUF->len[1]);
+
+    uip_reassflags = r->flags;
+    uip_reass_free(r);
+    UIP_STAT(++uip_stat.reass.done);
+    return len;
   }
+
   return 0;
 }
 
 void
 uip_reass_over(void)
 {
-   /* to late, we abandon the reassembly of the packet */
-
-  uip_reass_on = 0;
-  etimer_stop(&uip_reass_timer);
-
-  if(uip_reassflags & UIP_REASS_FLAG_FIRSTFRAG){
-    PRINTF("FRAG INTERRUPTED TOO LATE\n");
-    /* If the first fragment has been received, an ICMP Time Exceeded
-       -- Fragment Reassembly Time Exceeded message should be sent to the
-       source of that fragment. */
-    /** \note
-     * We don't have a complete packet to put in the error message.
-     * We could include the first fragment but since its not mandated by
-     * any RFC, we decided not to include it as it reduces the size of
-     * the packet.
-     */
-    uip_len = 0;
-    uip_ext_len = 0;
-    memcpy(UIP_IP_BUF, FBUF, UIP_IPH_LEN); /* copy the header for src
-                                              and dest address*/
-    uip_icmp6_error_output(ICMP6_TIME_EXCEEDED, ICMP6_TIME_EXCEED_REASSEMBLY, 0);
-    
-    UIP_STAT(++uip_stat.ip.sent);
-    uip_flags = 0;
+  struct uip_reass_ctx *r, *next, *oldest = NULL;
+  clock_time_t now = clock_time();
+  uint8_t icmp_sent = 0;
+
+  uip_len = 0;
+
+  for(r = list_head(uip_reass_list); r != NULL; r = next) {
+    next = list_item_next(r);
+
+    if(now - r->start < UIP_REASS_MAXAGE_TICKS) {
+      if(oldest == NULL || now - r->start > now - oldest->start) {
+        oldest = r;
+      }
+      continue;
+    }
+
+    /* to late, we abandon the reassembly of the packet */
+    UIP_STAT(++uip_stat.reass.timeout);
+
+    if((r->flags & UIP_REASS_FLAG_FIRSTFRAG) && !icmp_sent) {
+      PRINTF("FRAG INTERRUPTED TOO LATE\n");
+      /* If the first fragment has been received, an ICMP Time Exceeded
+         -- Fragment Reassembly Time Exceeded message should be sent to the
+         source of that fragment. Only one message fits into uip_buf,
+         so it is sent for first expired context only. */
+      /** \note
+       * We don't have a complete packet to put in the error message.
+       * We could include the first fragment but since its not mandated by
+       * any RFC, we decided not to include it as it reduces the size of
+       * the packet.
+       */
+      uip_len = 0;
+      uip_ext_len = 0;
+      memcpy(UIP_IP_BUF, FBUF(r), UIP_IPH_LEN); /* copy the header for src
+                                                   and dest address*/
+      uip_icmp6_error_output(ICMP6_TIME_EXCEEDED, ICMP6_TIME_EXCEED_REASSEMBLY, 0);
+
+      UIP_STAT(++uip_stat.ip.sent);
+      uip_flags = 0;
+      icmp_sent = 1;
+    }
+
+    uip_reass_free(r);
+  }
+
+  /* Restart timer for the oldest remaining context. */
+  if(oldest != NULL) {
+    etimer_set(&uip_reass_timer,
+               UIP_REASS_MAXAGE_TICKS - (now - oldest->start));
   }
 }
 
@@ -861,6 +986,42 @@ uip_add_rcv_nxt(uint16_t n)
   uip_conn->rcv_nxt[2] = uip_acc32[2];
   uip_conn->rcv_nxt[3] = uip_acc32[3];
 }
+/*---------------------------------------------------------------------------*/
+/*
+ * All outstanding data has been acknowledged (new snd_nxt is in
+ * uip_acc32). Update sequence number and RTT estimate.
+ */
+static void
+uip_tcp_acked(void)
+{
+  uip_conn->snd_nxt[0] = uip_acc32[0];
+  uip_conn->snd_nxt[1] = uip_acc32[1];
+  uip_conn->snd_nxt[2] = uip_acc32[2];
+  uip_conn->snd_nxt[3] = uip_acc32[3];
+
+  /* Do RTT estimation, unless we have done retransmissions. */
+  if(uip_conn->nrtx == 0) {
+    signed char m;
+    m = uip_conn->rto - uip_conn->timer;
+    /* This is taken directly from VJs original code in his paper */
+    m = m - (uip_conn->sa >> 3);
+    uip_conn->sa += m;
+    if(m < 0) {
+      m = -m;
+    }
+    m = m - (uip_conn->sv >> 2);
+    uip_conn->sv += m;
+    uip_conn->rto = (uip_conn->sa >> 3) + uip_conn->sv;
+
+  }
+  /* Set the acknowledged flag. */
+  uip_flags = UIP_ACKDATA;
+  /* Reset the retransmission timer. */
+  uip_conn->timer = uip_conn->rto;
+
+  /* Reset length of outstanding data. */
+  uip_conn->len = 0;
+}
 #endif
 /*---------------------------------------------------------------------------*/
 
@@ -947,6 +1108,23 @@ ext_hdr_options_process(void)
 }
 
 
+/*---------------------------------------------------------------------------*/
+#if UIP_XMITV
+/*
+ * Pico]OS: Set length of external payload of outgoing
+ *          packet. Payload follows hdrlen bytes of headers.
+ */
+static void
+xmitv_setlen(uint16_t hdrlen)
+{
+  if(uip_xmitv_data != NULL) {
+    uip_xmitv_len = uip_len - hdrlen;
+    if(uip_xmitv_len == 0) {
+      uip_xmitv_data = NULL;
+    }
+  }
+}
+#endif /* UIP_XMITV */
 /*---------------------------------------------------------------------------*/
 void
 uip_process(uint8_t flag)
@@ -954,6 +1132,9 @@ uip_process(uint8_t flag)
 #if UIP_TCP
   register struct uip_conn *uip_connr = uip_conn;
 #endif /* UIP_TCP */
+#if UIP_XMITV
+  uip_xmitv_clear();
+#endif /* UIP_XMITV */
 #if UIP_UDP
   if(flag == UIP_UDP_SEND_CONN) {
     goto udp_send;
@@ -1089,6 +1270,32 @@ uip_process(uint8_t flag)
           }
         }
       } else if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
+#if UIP_TCP_KEEPALIVE
+        /*
+         * Pico]OS: Connection is idle. Drop it if idle timeout
+         * has expired or peer hasn't answered to keepalive
+         * probes, or send next probe if it is time for it.
+         */
+        if(uip_connr->idle != 0xffff) {
+          ++(uip_connr->idle);
+        }
+
+        if((UIP_TCP_IDLE_TIMEOUT != 0 && uip_connr->idle >= UIP_TCP_IDLE_TIMEOUT) ||
+           (uip_connr->ka_idle != 0 && uip_connr->idle >= KA_PROBE_DUE(uip_connr) &&
+            uip_connr->ka_probes >= uip_connr->ka_cnt)) {
+          uip_connr->tcpstateflags = UIP_CLOSED;
+          uip_flags = UIP_TIMEDOUT;
+          UIP_APPCALL();
+          UIP_TCP_BUF->flags = TCP_RST | TCP_ACK;
+          goto tcp_send_nodata;
+        }
+
+        if(uip_connr->ka_idle != 0 && uip_connr->idle >= KA_PROBE_DUE(uip_connr)) {
+          ++(uip_connr->ka_probes);
+          ka_probe = 1;
+          goto tcp_send_ack;
+        }
+#endif /* UIP_TCP_KEEPALIVE */
         /*
          * If there was no need for a retransmission, we poll the
          * application for new data.
@@ -1572,6 +1779,9 @@ uip_process(uint8_t flag)
     goto drop;
   }
   uip_len = uip_slen + UIP_IPUDPH_LEN;
+#if UIP_XMITV
+  xmitv_setlen(UIP_IPUDPH_LEN);
+#endif /* UIP_XMITV */
 
   /* For IPv6, the IP length field does not include the IPv6 IP header
      length. */
@@ -1601,6 +1811,9 @@ uip_process(uint8_t flag)
 #endif /* UIP_UDP_CHECKSUMS */
 
 #if UIP_CONF_IPV6_RPL
+#if UIP_XMITV
+  uip_xmitv_flatten();
+#endif /* UIP_XMITV */
   rpl_insert_header();
 #endif /* UIP_CONF_IPV6_RPL */
 
@@ -1634,6 +1847,18 @@ uip_process(uint8_t flag)
   }
 
   /* Demultiplex this segment. */
+#if UIP_TCP_FASTPATH
+  /* Pico]OS: Segments tend to come in trains, try
+     connection that got previous one first. */
+  uip_connr = uip_lastconn;
+  if(uip_connr != NULL &&
+     uip_connr->tcpstateflags != UIP_CLOSED &&
+     UIP_TCP_BUF->destport == uip_connr->lport &&
+     UIP_TCP_BUF->srcport == uip_connr->rport &&
+     uip_ipaddr_cmp(&UIP_IP_BUF->srcipaddr, &uip_connr->ripaddr)) {
+    goto found;
+  }
+#endif /* UIP_TCP_FASTPATH */
   /* First check any active connections. */
   for(uip_connr = &uip_conns[0]; uip_connr <= &uip_conns[UIP_CONNS - 1];
       ++uip_connr) {
@@ -1641,6 +1866,9 @@ uip_process(uint8_t flag)
        UIP_TCP_BUF->destport == uip_connr->lport &&
        UIP_TCP_BUF->srcport == uip_connr->rport &&
        uip_ipaddr_cmp(&UIP_IP_BUF->srcipaddr, &uip_connr->ripaddr)) {
+#if UIP_TCP_FASTPATH
+      uip_lastconn = uip_connr;
+#endif /* UIP_TCP_FASTPATH */
       goto found;
     }
   }
@@ -1756,10 +1984,16 @@ uip_process(uint8_t flag)
   uip_connr->sa = 0;
   uip_connr->sv = 4;
   uip_connr->nrtx = 0;
+#if UIP_TCP_KEEPALIVE
+  uip_connr->idle = 0;
+  uip_connr->ka_idle = 0;
+  uip_connr->ka_probes = 0;
+#endif /* UIP_TCP_KEEPALIVE */
   uip_connr->lport = UIP_TCP_BUF->destport;
   uip_connr->rport = UIP_TCP_BUF->srcport;
   uip_ipaddr_copy(&uip_connr->ripaddr, &UIP_IP_BUF->srcipaddr);
   uip_connr->tcpstateflags = UIP_SYN_RCVD;
+  uip_connr->initialmss = uip_connr->mss = UIP_TCP_CONN_MSS(uip_connr);
 
   uip_connr->snd_nxt[0] = iss[0];
   uip_connr->snd_nxt[1] = iss[1];
@@ -1790,7 +2024,7 @@ uip_process(uint8_t flag)
         tmp16 = ((uint16_t)uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 2 + c] << 8) |
           (uint16_t)uip_buf[UIP_IPTCPH_LEN + UIP_LLH_LEN + 3 + c];
         uip_connr->initialmss = uip_connr->mss =
-          tmp16 > UIP_TCP_MSS? UIP_TCP_MSS: tmp16;
+          tmp16 > uip_connr->initialmss? uip_connr->initialmss: tmp16;
    
         /* And we are done processing options. */
         break;
@@ -1821,10 +2055,11 @@ uip_process(uint8_t flag)
   
   /* We send out the TCP Maximum Segment Size option with our
      SYNACK. */
+  tmp16 = UIP_TCP_CONN_MSS(uip_connr);
   UIP_TCP_BUF->optdata[0] = TCP_OPT_MSS;
   UIP_TCP_BUF->optdata[1] = TCP_OPT_MSS_LEN;
-  UIP_TCP_BUF->optdata[2] = (UIP_TCP_MSS) / 256;
-  UIP_TCP_BUF->optdata[3] = (UIP_TCP_MSS) & 255;
+  UIP_TCP_BUF->optdata[2] = tmp16 / 256;
+  UIP_TCP_BUF->optdata[3] = tmp16 & 255;
   uip_len = UIP_IPTCPH_LEN + TCP_OPT_MSS_LEN;
   UIP_TCP_BUF->tcpoffset = ((UIP_TCPH_LEN + TCP_OPT_MSS_LEN) / 4) << 4;
   goto tcp_send;
@@ -1845,6 +2080,62 @@ uip_process(uint8_t flag)
     UIP_APPCALL();
     goto drop;
   }
+#if UIP_TCP_KEEPALIVE
+  /* Pico]OS: Peer is alive. */
+  uip_connr->idle = 0;
+  uip_connr->ka_probes = 0;
+#endif /* UIP_TCP_KEEPALIVE */
+#if UIP_TCP_FASTPATH
+  /* Pico]OS: Header prediction. Segment on established (and not
+     stopped) connection that has no options, no control flags
+     except ACK and PSH and carries next expected sequence number
+     is either in-order data or an ACK. If it also acknowledges
+     all outstanding data (or there is none), it can be passed to
+     application directly. Everything else takes the generic path. */
+  if(uip_connr->tcpstateflags == UIP_ESTABLISHED &&
+     UIP_TCP_BUF->tcpoffset == (UIP_TCPH_LEN / 4) << 4 &&
+     (UIP_TCP_BUF->flags & (TCP_FIN | TCP_SYN | TCP_RST | TCP_URG | TCP_ACK)) == TCP_ACK &&
+     UIP_TCP_BUF->seqno[0] == uip_connr->rcv_nxt[0] &&
+     UIP_TCP_BUF->seqno[1] == uip_connr->rcv_nxt[1] &&
+     UIP_TCP_BUF->seqno[2] == uip_connr->rcv_nxt[2] &&
+     UIP_TCP_BUF->seqno[3] == uip_connr->rcv_nxt[3]) {
+
+    if(uip_outstanding(uip_connr)) {
+      uip_add32(uip_connr->snd_nxt, uip_connr->len);
+      if(UIP_TCP_BUF->ackno[0] != uip_acc32[0] ||
+         UIP_TCP_BUF->ackno[1] != uip_acc32[1] ||
+         UIP_TCP_BUF->ackno[2] != uip_acc32[2] ||
+         UIP_TCP_BUF->ackno[3] != uip_acc32[3]) {
+        goto slowpath;
+      }
+      uip_tcp_acked();
+    }
+
+    uip_len = uip_len - UIP_TCPH_LEN - UIP_IPH_LEN;
+    if(uip_len > 0) {
+      uip_flags |= UIP_NEWDATA;
+      uip_add_rcv_nxt(uip_len);
+    }
+
+    tmp16 = ((uint16_t)UIP_TCP_BUF->wnd[0] << 8) + (uint16_t)UIP_TCP_BUF->wnd[1];
+    if(tmp16 > uip_connr->initialmss ||
+       tmp16 == 0) {
+      tmp16 = uip_connr->initialmss;
+    }
+    uip_connr->mss = tmp16;
+
+    if(uip_flags == 0) {
+      /* Duplicate or window update ACK. */
+      goto drop;
+    }
+
+    uip_slen = 0;
+    UIP_APPCALL();
+    goto appsend;
+  }
+
+ slowpath:
+#endif /* UIP_TCP_FASTPATH */
   /* Calculate the length of the data, if the application has sent
      any data to us. */
   c = (UIP_TCP_BUF->tcpoffset >> 4) << 2;
@@ -1890,34 +2181,7 @@ uip_process(uint8_t flag)
        UIP_TCP_BUF->ackno[1] == uip_acc32[1] &&
        UIP_TCP_BUF->ackno[2] == uip_acc32[2] &&
        UIP_TCP_BUF->ackno[3] == uip_acc32[3]) {
-      /* Update sequence number. */
-      uip_connr->snd_nxt[0] = uip_acc32[0];
-      uip_connr->snd_nxt[1] = uip_acc32[1];
-      uip_connr->snd_nxt[2] = uip_acc32[2];
-      uip_connr->snd_nxt[3] = uip_acc32[3];
-   
-      /* Do RTT estimation, unless we have done retransmissions. */
-      if(uip_connr->nrtx == 0) {
-        signed char m;
-        m = uip_connr->rto - uip_connr->timer;
-        /* This is taken directly from VJs original code in his paper */
-        m = m - (uip_connr->sa >> 3);
-        uip_connr->sa += m;
-        if(m < 0) {
-          m = -m;
-        }
-        m = m - (uip_connr->sv >> 2);
-        uip_connr->sv += m;
-        uip_connr->rto = (uip_connr->sa >> 3) + uip_connr->sv;
-
-      }
-      /* Set the acknowledged flag. */
-      uip_flags = UIP_ACKDATA;
-      /* Reset the retransmission timer. */
-      uip_connr->timer = uip_connr->rto;
-
-      /* Reset length of outstanding data. */
-      uip_connr->len = 0;
+      uip_tcp_acked();
     }
     
   }
@@ -1939,10 +2203,16 @@ uip_process(uint8_t flag)
         uip_connr->len = 0;
         if(uip_len > 0) {
           uip_flags |= UIP_NEWDATA;
-          uip_add_rcv_nxt(uip_len);
         }
         uip_slen = 0;
         UIP_APPCALL();
+        /* Pico]OS: Application may stop a connection that waits to be
+           accepted. Data that came with the ACK is then left
+           unacknowledged and peer sends it again after the connection
+           has been restarted. */
+        if((uip_flags & UIP_NEWDATA) && !uip_stopped(uip_connr)) {
+          uip_add_rcv_nxt(uip_len);
+        }
         goto appsend;
       }
       /* We need to retransmit the SYNACK */
@@ -1975,7 +2245,7 @@ uip_process(uint8_t flag)
               tmp16 = (uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 2 + c] << 8) |
                 uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 3 + c];
               uip_connr->initialmss =
-                uip_connr->mss = tmp16 > UIP_TCP_MSS? UIP_TCP_MSS: tmp16;
+                uip_connr->mss = tmp16 > uip_connr->initialmss? uip_connr->initialmss: tmp16;
 
               /* And we are done processing options. */
               break;
@@ -2280,6 +2550,18 @@ uip_process(uint8_t flag)
   UIP_TCP_BUF->seqno[2] = uip_connr->snd_nxt[2];
   UIP_TCP_BUF->seqno[3] = uip_connr->snd_nxt[3];
 
+#if UIP_TCP_KEEPALIVE
+  if(ka_probe) {
+    /* Keepalive probe carries an already acknowledged
+       sequence number, which makes peer answer with ACK. */
+    ka_probe = 0;
+    if(UIP_TCP_BUF->seqno[3]-- == 0 && UIP_TCP_BUF->seqno[2]-- == 0 &&
+       UIP_TCP_BUF->seqno[1]-- == 0) {
+      --UIP_TCP_BUF->seqno[0];
+    }
+  }
+#endif /* UIP_TCP_KEEPALIVE */
+
   UIP_TCP_BUF->srcport  = uip_connr->lport;
   UIP_TCP_BUF->destport = uip_connr->rport;
 
@@ -2309,6 +2591,10 @@ uip_process(uint8_t flag)
 
   UIP_TCP_BUF->urgp[0] = UIP_TCP_BUF->urgp[1] = 0;
   
+#if UIP_XMITV
+  xmitv_setlen(UIP_IPTCPH_LEN);
+#endif /* UIP_XMITV */
+
   /* Calculate TCP checksum. */
   UIP_TCP_BUF->tcpchksum = 0;
   UIP_TCP_BUF->tcpchksum = ~(uip_tcpchksum());
@@ -2355,6 +2641,10 @@ uip_send(const void *data, int len)
 {
   int copylen;
 
+#if UIP_XMITV
+  uip_xmitv_clear();
+#endif /* UIP_XMITV */
+
   if(uip_sappdata != NULL) {
     copylen = MIN(len, UIP_BUFSIZE - UIP_LLH_LEN - UIP_TCPIP_HLEN -
                   (int)((char *)uip_sappdata -
@@ -2375,4 +2665,33 @@ uip_send(const void *data, int len)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if UIP_XMITV
+void
+uip_sendv(const void *data, int len)
+{
+  /* Pico]OS: Keep payload size within uip_buf, so packet
+              can always be flattened if needed. */
+  len = MIN(len, UIP_BUFSIZE - UIP_LLH_LEN - UIP_TCPIP_HLEN);
+  if(len > 0) {
+    uip_slen = len;
+    uip_xmitv_data = data;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_xmitv_flatten(void)
+{
+  uint16_t iplen;
+
+  /* Pico]OS: Locate end of headers using IP length, as uip_len
+              may or may not include link-level header yet. */
+  if(uip_xmitv_data != NULL) {
+    iplen = ((uint16_t)(UIP_IP_BUF->len[0]) << 8) + UIP_IP_BUF->len[1] + UIP_IPH_LEN;
+    memcpy(&uip_buf[UIP_LLH_LEN + iplen - uip_xmitv_len], uip_xmitv_data,
+           uip_xmitv_len);
+    uip_xmitv_clear();
+  }
+}
+#endif /* UIP_XMITV */
+/*---------------------------------------------------------------------------*/
 /** @} */
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2001-2004 Swedish Institute of Computer Science.
+ * Copyright (c) 2014, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without modification, 
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission. 
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED 
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF 
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT 
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT 
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING 
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+ * OF SUCH DAMAGE.
+ */
+/*
+ * This is originally from lwIP network stack, but stripped
+ * down and modified heavily for picoos-net.
+ */
+
+#ifndef __NETDB_H
+#define __NETDB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "sys/socket.h"
+
+/* Errors used by getaddrinfo */
+#define EAI_NONAME      200
+#define EAI_SERVICE     201
+#define EAI_FAIL        202
+#define EAI_MEMORY      203
+#define EAI_FAMILY      204
+
+/* Input flags for struct addrinfo */
+#define AI_PASSIVE      0x01
+#define AI_CANONNAME    0x02
+#define AI_NUMERICHOST  0x04
+#define AI_NUMERICSERV  0x08
+
+struct addrinfo {
+  int               ai_flags;      /* Input flags. */
+  int               ai_family;     /* Address family of socket. */
+  int               ai_socktype;   /* Socket type. */
+  int               ai_protocol;   /* Protocol of socket. */
+  socklen_t         ai_addrlen;    /* Length of socket address. */
+  struct sockaddr  *ai_addr;       /* Socket address of socket. */
+  char             *ai_canonname;  /* Canonical name of service location. */
+  struct addrinfo  *ai_next;       /* Pointer to next in list. */
+};
+
+int  net_getaddrinfo(const char *nodename,
+                     const char *servname,
+                     const struct addrinfo *hints,
+                     struct addrinfo **res);
+void net_freeaddrinfo(struct addrinfo *ai);
+
+#if NETCFG_COMPAT_SOCKETS
+#define getaddrinfo(a,b,c,d)  net_getaddrinfo(a,b,c,d)
+#define freeaddrinfo(addrinfo) net_freeaddrinfo(addrinfo)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NETDB_H */
@@ -65,9 +65,9 @@
  *
  * Typical packet flow when using socket layer is:
  *
- * in:  ::netInterfacePoll -> ::netEthernetInput -> arp -> uip:tcpip_input
+ * in:  ::netInterfacePollAll -> NetDriver.poll -> ::netEthernetInput -> arp -> uip:tcpip_input
  *
- * out: uip:tcpip_output -> ::netInterfaceOutput -> ::netEthernetOutput -> arp -> ::netInterfaceXmit
+ * out: uip:tcpip_output -> ::netInterfaceOutput -> route -> ::netEthernetOutput -> arp -> NetDriver.xmit
  */
 
 /** @defgroup api   Network API */
@@ -90,11 +90,122 @@ extern "C"
  * @{
  */
 
+typedef struct netInterface NetInterface;
+
+/**
+ * Driver function table for network interface.
+ * Functions work like ::netInterfaceInit, ::netInterfacePoll,
+ * ::netInterfaceXmit and ::netInterfaceXmitv but get the interface
+ * as argument. xmitv is optional, if it is NULL payload is copied
+ * into uip_buf and xmit is used instead.
+ * Tables for compiled-in ethernet drivers are provided
+ * by library (netDriverTap, netDriverEnc28j60 etc.).
+ */
+typedef struct {
+
+  void (*init)(NetInterface* ifc);
+  bool (*poll)(NetInterface* ifc);
+  void (*xmit)(NetInterface* ifc);
+  void (*xmitv)(NetInterface* ifc, const void* data, uint16_t len);
+} NetDriver;
+
+/**
+ * Network interface. Packets are sent to interface whose network
+ * (addr & netmask) contains the destination, others go to the
+ * default interface. With IPv4, interface address is used as 
+ * host address while processing traffic of the interface. Interface
+ * with zero address uses address set with uip_sethostaddr.
+ */
+struct netInterface {
+
+  NetInterface* next;
+  const char* name;
+  const NetDriver* driver;
+  void* priv;              ///< for driver use
+  uip_ipaddr_t addr;
+  uip_ipaddr_t netmask;    ///< IPv6: prefix as mask
+  uint16_t mtu;            ///< max IP packet size, 0 = use UIP_BUFSIZE, also limits TCP MSS
+  uint32_t xmits;          ///< frames sent
+  uint32_t mtuDrops;       ///< frames dropped because they exceeded mtu
+};
+
+/**
+ * Add a network interface. Must be called before ::netInit.
+ * If driver selected with value 2 in netcfg.h exists, it is added
+ * as interface "eth0" during ::netInit and becomes default unless 
+ * some other interface was explicitly set as default.
+ */
+void netInterfaceAdd(NetInterface* ifc, bool isDefault);
+
+#if NETCFG_DRIVER_CS8900A > 0
+extern const NetDriver netDriverCs8900a;
+#endif
+#if NETCFG_DRIVER_ENC28J60 > 0
+extern const NetDriver netDriverEnc28j60;
+#endif
+#if NETCFG_DRIVER_TAP > 0
+extern const NetDriver netDriverTap;
+#endif
+#if NETCFG_DRIVER_HDLC_BRIDGE > 0
+extern const NetDriver netDriverHdlcBridge;
+#endif
+#if NETCFG_DRIVER_UNIX_HDLC_BRIDGE > 0
+extern const NetDriver netDriverUnixHdlcBridge;
+#endif
+#if NETCFG_DRIVER_TM4C1294 > 0
+extern const NetDriver netDriverTm4c1294;
+#endif
+#if NETCFG_DRIVER_PCAP_REPLAY > 0
+extern const NetDriver netDriverPcapReplay;
+#endif
+#if NETCFG_DRIVER_LOOPBACK > 0
+extern const NetDriver netDriverLoopback;
+#endif
+
+/**
+ * Find interface used for sending packets to given destination.
+ */
+NetInterface* netInterfaceRoute(const uip_ipaddr_t* dest);
+
+/**
+ * TCP maximum segment size for connection. Limits UIP_TCP_MSS
+ * by mtu of the interface that connection is routed to,
+ * so that full-sized segments are not dropped by interface.
+ * Used by uIP when connection is opened (SYN and SYNACK).
+ */
+uint16_t netInterfaceTcpMss(const struct uip_conn* conn);
+
+/**
+ * Interface being currently served by main loop, NULL if none.
+ */
+extern NetInterface* netInterfaceCurrent;
+
+/**
+ * Used by main loop: start/stop serving given interface.
+ */
+void netInterfaceEnter(NetInterface* ifc);
+void netInterfaceLeave(void);
+
+/**
+ * Used by main loop: initialize/poll all interfaces.
+ */
+void netInterfaceInitAll(void);
+bool netInterfacePollAll(void);
+
 /**
  * Device driver function: Transmit current packet to network.
  */
 void netInterfaceXmit(void);
 
+/**
+ * Device driver function: Transmit current packet to network, when
+ * packet payload is not in uip_buf. Packet headers are
+ * first uip_len - len bytes of uip_buf, followed by len bytes
+ * of payload at data. Used only when ::NETCFG_XMITV is enabled.
+ * Provided by library for compiled-in drivers.
+ */
+void netInterfaceXmitv(const void* data, uint16_t len);
+
 /**
  * Device driver function: Poll network adapter for packet. Function should
  * return true if packet is available. It must also deliver the packet for
@@ -111,7 +222,9 @@ void netInterfaceInit(void);
 /**
  * Pass outgoing packet to interface layer for sending.
  * Before transmitting packet ARP processing is done
- * if needed by device driver (ethernet).
+ * if needed by device driver (ethernet). Library provides
+ * this (with route lookup) when a default driver is selected
+ * or ::NETCFG_LEGACY_INTERFACE is 0.
  */
 #if NETSTACK_CONF_WITH_IPV6
 void netInterfaceOutput(const uip_lladdr_t* lla);
@@ -139,6 +252,54 @@ void netEthernetOutput(const uip_lladdr_t* lla);
 void netEthernetOutput(void);
 #endif
 
+#if NETCFG_CAPTURE == 1 || DOX == 1
+
+/**
+ * Packet capture filter. Zero fields match everything.
+ */
+typedef struct {
+
+  uint16_t ethType;  ///< ethernet frame type
+  uint8_t  proto;    ///< IP protocol (IPv6: next header after fixed header)
+  uint16_t port;     ///< TCP or UDP source or destination port
+} NetCaptureFilter;
+
+/**
+ * Called by ethernet layer for each frame received or transmitted.
+ * Copies frame in uip_buf to capture ring if it passes the filter.
+ */
+void netCapturePacket(void);
+
+/**
+ * Clear capture ring and start capturing frames
+ * that match the filter. Filter can be NULL to
+ * capture everything.
+ */
+void netCaptureStart(const NetCaptureFilter* filter);
+
+/**
+ * Stop capturing.
+ */
+void netCaptureStop(void);
+
+/**
+ * Stop capturing and write ring contents in pcap format to
+ * given file, typically an accepted TCP socket.
+ * Returns 0 on success, -1 on write error.
+ */
+int netCaptureExport(UosFile* file);
+
+#if NETCFG_CAPTURE_HOSTFILE == 1 || DOX == 1
+
+/**
+ * Host builds only: stop capturing and save ring
+ * contents to a pcap file.
+ */
+int netCaptureSave(const char* fileName);
+
+#endif
+#endif
+
 #if NETCFG_SOCKETS == 1 || DOX == 1
 
 /**
@@ -201,11 +362,24 @@ int netSockBind(UosFile* sock, int port);
 /**
  * Start listening for incoming connections.
  * Port is set during netSockServerCreate().
+ * Uses maximum backlog (::NETCFG_LISTEN_BACKLOG).
  */
 void netSockListen(UosFile* sock);
 
 /**
- * Accept new incoming connection.
+ * Start listening for incoming connections. At most
+ * backlog connections (limited to ::NETCFG_LISTEN_BACKLOG)
+ * are queued waiting for accept, more are aborted.
+ * Returns -1 if too many ports are being listened.
+ * Similar to unix *listen()*.
+ */
+int netSockListenBacklog(UosFile* sock, int backlog);
+
+/**
+ * Accept new incoming connection. Several tasks can
+ * wait for connections on same listening socket, each
+ * connection is given to one of them. If listening socket
+ * is closed, waiting tasks get NULL.
  */
 UosFile* netSockAccept(UosFile* listenSocket, uip_ipaddr_t* peer);
 
@@ -253,6 +427,213 @@ int netSockRead(UosFile* sock, void* data, uint16_t max, uint16_t timeout);
  */
 int netSockReadLine(UosFile* sock, void* data, uint16_t max, uint16_t timeout);
 
+/**
+ * Borrow received data from TCP socket without copying it.
+ * Function blocks like ::netSockRead, but instead of copying
+ * data it sets *data to point directly into received segment
+ * in uIP buffer and returns its length (or error code like ::netSockRead).
+ * Data must be given back with ::netSockRelease before doing anything
+ * else with socket (except closing it), as network main loop is stopped
+ * while it is lent. If data is not released within 500 ms, main loop
+ * takes it back and aborts connection. Only TCP sockets can be used,
+ * -1 is returned for UDP sockets.
+ */
+int netSockBorrow(UosFile* sock, const void** data, uint16_t timeout);
+
+/**
+ * Release data lent by ::netSockBorrow. Used tells how many
+ * bytes were consumed, rest of data is returned by next
+ * read or borrow call. Returns 0 or NET_SOCK_ABORT if main loop
+ * had already taken data back, in which case it may have been
+ * overwritten while reader was using it.
+ */
+int netSockRelease(UosFile* sock, uint16_t used);
+
+#if NETCFG_TCP_KEEPALIVE == 1 || DOX == 1
+
+/**
+ * Enable or disable TCP keepalive for socket. If nothing
+ * is received from peer for a while, probes are sent and
+ * connection is aborted if peer doesn't answer to them.
+ * Connections accepted from listening socket inherit its
+ * keepalive settings. Similar to SO_KEEPALIVE socket option.
+ */
+int netSockKeepalive(UosFile* sock, bool enable);
+
+/**
+ * Set keepalive timing: idle seconds before first probe,
+ * seconds between probes and number of unanswered probes
+ * before connection is aborted. Zero or negative value leaves
+ * setting unchanged. Defaults are ::NETCFG_TCP_KEEPIDLE,
+ * ::NETCFG_TCP_KEEPINTVL and ::NETCFG_TCP_KEEPCNT.
+ */
+int netSockKeepaliveParams(UosFile* sock, int idle, int intvl, int cnt);
+
+#endif
+
+#if UIP_CONF_UDP == 1 || DOX == 1
+
+/**
+ * Largest UDP datagram payload that can be sent. Datagram
+ * must fit into uIP packet buffer with IP and UDP headers.
+ */
+#define NET_SOCK_MAX_DGRAM (UIP_BUFSIZE - UIP_LLH_LEN - UIP_IPUDPH_LEN)
+
+/**
+ * Datagram for ::netSockRecvBatch and ::netSockSendBatch.
+ */
+typedef struct netSockDgram {
+
+  void* data;        ///< buffer for datagram
+  uint16_t max;      ///< size of buffer (receive)
+  uint16_t len;      ///< length of datagram
+  uip_ipaddr_t addr; ///< sender or destination address
+  uint16_t port;     ///< sender or destination port, 0 = connected peer (send)
+} NetSockDgram;
+
+/**
+ * Read a datagram from UDP socket and return sender's
+ * address and port. Datagrams that arrive when there is no
+ * reader waiting are queued (see ::NETCFG_UDP_RXQUEUE).
+ * Socket that is not connected accepts datagrams from
+ * anyone after first call (see ::netSockSendTo).
+ * Similar to unix *recvfrom()*.
+ */
+int netSockRecvFrom(UosFile* sock, void* data, uint16_t max, uip_ipaddr_t* addr, uint16_t* port, uint16_t timeout);
+
+/**
+ * Read up to count datagrams from UDP socket. Function
+ * waits for first datagram and then returns it with others
+ * that are already queued. Returns number of datagrams read.
+ * Similar to unix *recvmmsg()*.
+ */
+int netSockRecvBatch(UosFile* sock, NetSockDgram* msgs, int count, uint16_t timeout);
+
+/**
+ * Send a datagram to given address and port. Socket
+ * doesn't need to be connected, if it is not, a local
+ * port is allocated (or one given to ::netSockBind is used)
+ * and socket receives datagrams from any sender after that.
+ * Similar to unix *sendto()*.
+ */
+int netSockSendTo(UosFile* sock, const void* data, uint16_t len, uip_ipaddr_t* addr, uint16_t port);
+
+/**
+ * Send count datagrams, each to its own destination. All of
+ * them are transmitted during one pass of network main loop.
+ * Datagram with zero port is sent to connected peer, sending
+ * stops at it if socket is not connected. Sending also stops
+ * at datagram longer than ::NET_SOCK_MAX_DGRAM.
+ * Returns number of datagrams sent, -1 if none.
+ * Similar to unix *sendmmsg()*.
+ */
+int netSockSendBatch(UosFile* sock, const NetSockDgram* msgs, int count);
+
+#endif
+
+#if NETCFG_STATS == 1 || DOX == 1
+
+/**
+ * Number of buckets in latency histograms. Bucket 0
+ * counts operations that completed within same tick,
+ * bucket n counts those that took 2^(n-1) .. 2^n - 1 ticks.
+ * Last bucket includes everything slower than that.
+ */
+#define NET_STATS_BUCKETS 16
+
+typedef struct {
+
+  uint32_t bucket[NET_STATS_BUCKETS];
+} NetStatsHist;
+
+/**
+ * Socket layer runtime statistics. Times are in
+ * pico]OS ticks.
+ */
+typedef struct {
+
+  uint32_t loops;        ///< main loop iterations
+  uint32_t busyTicks;    ///< ticks spent processing in main loop
+  uint32_t maxLoopTicks; ///< longest main loop iteration
+  NetStatsHist read;     ///< netSockRead/netSockReadLine latency
+  NetStatsHist write;    ///< write latency, including wait for ACK
+  NetStatsHist connect;  ///< netSockConnect latency
+  NetStatsHist accept;   ///< netSockAccept latency
+  NetStatsHist appWait;  ///< time main loop blocked waiting for application
+  uint32_t acceptQueued;    ///< connections queued for accept
+  uint32_t acceptOverflows; ///< connections aborted, accept backlog full
+  uint32_t udpQueued;       ///< datagrams queued for reader
+  uint32_t udpDrops;        ///< datagrams dropped, queue full
+} NetStats;
+
+/**
+ * Function used by ::netStatsDump to output text.
+ */
+typedef void (*NetStatsPrint)(void* arg, const char* text);
+
+/**
+ * Get a snapshot of socket layer statistics.
+ */
+void netStatsGet(NetStats* stats);
+
+/**
+ * Clear socket layer statistics and uIP counters.
+ */
+void netStatsReset(void);
+
+/**
+ * Format uIP counters, per-socket counters and socket layer
+ * statistics as text lines and output them with given function.
+ */
+void netStatsDump(NetStatsPrint print, void* arg);
+
+#endif
+
+#if NETCFG_DNS == 1 || DOX == 1
+
+/**
+ * Callback for asynchronous name resolving. Called by
+ * resolver task when lookup completes, so it should not
+ * block. Addr is NULL if name could not be resolved.
+ */
+typedef void (*NetResolveCallback)(void* arg, const char* name, const uip_ipaddr_t* addr);
+
+/**
+ * Asynchronous resolver request. Allocated by caller,
+ * must stay valid until callback has been called.
+ */
+typedef struct netResolveReq {
+
+  struct netResolveReq* next;
+  NetResolveCallback callback;
+  void* arg;
+} NetResolveReq;
+
+/**
+ * Initialize DNS resolver. Called by ::netInit.
+ */
+void netResolveInit(void);
+
+/**
+ * Resolve host name to address using nameservers
+ * known by uip-nameserver module. Answers are cached
+ * according to their TTL. Function blocks until name
+ * is resolved or timeout expires. Returns 0 on success
+ * and -1 on failure.
+ */
+int netResolve(const char* name, uip_ipaddr_t* addr, UINT_t timeout);
+
+/**
+ * Start resolving host name. Callback is called when
+ * lookup completes (immediately if address is a numeric
+ * one or found from cache). Concurrent requests for same
+ * name share the query. Returns -1 if request could not
+ * be started.
+ */
+int netResolveAsync(NetResolveReq* req, const char* name, NetResolveCallback cb, void* arg);
+
+#endif
+
 /*
  * Main thread.
  */
@@ -267,15 +648,20 @@ void netMainThread(void* arg);
 #error BSD sockets required for telnet.
 #endif
 
+/**
+ * Telnet connection state. Buffer sizes are set with
+ * ::NETCFG_TELNET_INBUF and ::NETCFG_TELNET_OUTBUF.
+ */
 typedef struct {
 
   int   state;
-  char  inBuf[80];
+  char  inBuf[NETCFG_TELNET_INBUF];
   char* inPtr;
   int   inLen;
-  char  outBuf[80];
+  char  outBuf[NETCFG_TELNET_OUTBUF];
   char* outPtr;
   int   sock;
+  int   timeout;  ///< receive timeout currently set for socket
 } NetTelnet;
 
 /**
@@ -299,6 +685,15 @@ void telnetFlush(NetTelnet* conn);
  */
 int telnetReadLine(NetTelnet* conn, char* data, int max, int timeout);
 
+#if NETCFG_STATS == 1 || DOX == 1
+
+/**
+ * Write network statistics to telnet connection.
+ */
+void telnetStatsDump(NetTelnet* conn);
+
+#endif
+
 #endif
 
 /** @} */
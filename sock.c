@@ -32,12 +32,18 @@
 #include <picoos-u.h>
 #include <picoos-net.h>
 #include <string.h>
+#include <stdio.h>
 #include <net/ip/uip-split.h>
+#include <lib/memb.h>
 
 #if !defined(UOSCFG_MAX_OPEN_FILES) || UOSCFG_MAX_OPEN_FILES == 0
 #error UOSCFG_MAX_OPEN_FILES must be > 0
 #endif
 
+#if POSCFG_FEATURE_INHIBITSCHED == 0
+#error POSCFG_FEATURE_INHIBITSCHED must be 1
+#endif
+
 #ifndef NETCFG_STACK_SIZE
 #define NETCFG_STACK_SIZE 500
 #endif
@@ -48,6 +54,9 @@
 
 #if NETSTACK_CONF_WITH_IPV6
 #include "net/ipv6/uip-ds6.h"
+#if UIP_CONF_IPV6_REASSEMBLY
+extern struct etimer uip_reass_timer;
+#endif
 #endif
 
 #if NETCFG_SOCKETS == 1
@@ -55,11 +64,58 @@
 extern void srvTask(void* arg);
 
 POSSEMA_t uipGiant;
-static POSMUTEX_t uipMutex;
+static NetSock* volatile cmdQueue = NULL;
 static volatile int dataToSend = 0;
 static NetSockAcceptHook acceptHook = NULL;
 static volatile UINT_t pollTicks;
 
+#if NETCFG_STATS == 1
+static NetStats netStats;
+#define NET_STAT(s) s
+#else
+#define NET_STAT(s)
+#endif
+
+/*
+ * With NETCFG_XMITV data is sent directly from
+ * writer's buffer, so it must be kept until
+ * all of it has been acknowledged (TCP) or
+ * passed to driver (UDP).
+ */
+#if NETCFG_XMITV == 1
+#define NET_SEND(buf, len) uip_sendv(buf, len)
+#if UIP_CONF_UDP == 1
+static NetSock* udpXmitvSock = NULL;
+#endif
+#else
+#define NET_SEND(buf, len) uip_send(buf, len)
+#endif
+
+#if UIP_CONF_UDP == 1
+
+/*
+ * Received datagrams are queued here if there is no
+ * reader waiting, so main thread never blocks for
+ * UDP application. Pool is shared by all UDP sockets.
+ */
+struct netUdpDgram {
+
+  struct netUdpDgram* next;
+  uip_ipaddr_t addr;
+  uint16_t port;
+  uint16_t len;
+  uint8_t data[NETCFG_UDP_RXSIZE];
+};
+
+typedef struct netUdpDgram NetUdpDgram;
+
+MEMB(udpDgramPool, NetUdpDgram, NETCFG_UDP_RXQUEUE);
+
+#define UDP_IP_HDR  ((struct uip_ip_hdr*)&uip_buf[UIP_LLH_LEN])
+#define UDP_HDR     ((struct uip_udp_hdr*)((uint8_t*)uip_appdata - UIP_UDPH_LEN))
+
+#endif
+
 typedef struct {
 
   UosFS base;
@@ -72,6 +128,19 @@ UOS_BITTAB_TABLE(NetSock, SOCK_TABSIZE);
 static NetSockBittab netSocketTable;
 static NetFS netFS;
 
+/*
+ * Listening sockets by port. Updated only
+ * by main thread when running listen commands.
+ */
+typedef struct {
+
+  uint16_t port;
+  NetSock* sock;
+  POSSEMA_t acceptSema;
+} NetListener;
+
+static NetListener listeners[UIP_LISTENPORTS];
+
 static int sockInit(const UosFS*);
 static int sockClose(UosFile* file);
 static int sockRead(UosFile* file, char* buf, int max);
@@ -94,6 +163,242 @@ static int sockInit(const UosFS* fs)
   return 0;
 }
 
+#if NETCFG_STATS == 1
+
+/*
+ * Add sample to log2 histogram.
+ */
+static void netStatsHist(NetStatsHist* h, JIF_t ticks)
+{
+  int b = 0;
+
+  while (ticks != 0 && b < NET_STATS_BUCKETS - 1) {
+
+    ticks >>= 1;
+    ++b;
+  }
+
+  ++h->bucket[b];
+}
+
+#endif
+
+/*
+ * Submit a command to main thread, which is the only
+ * one that touches uIP state. Caller must hold sock->mutex.
+ * Queue is pushed with scheduler locked for a few instructions
+ * only, so caller never waits for packet processing to
+ * release the stack. Result is returned via uipChange flag.
+ */
+static int netSockCommand(UosFile* file, NetSockCmd cmd, const void* ip, uint16_t port)
+{
+  NetSock* sock = (NetSock*)file->fsPriv;
+
+  sock->cmd = cmd;
+  sock->cmdFile = file;
+  sock->cmdAddr = ip;
+  sock->cmdPort = port;
+  sock->cmdResult = 0;
+
+  posTaskSchedLock();
+  sock->cmdNext = cmdQueue;
+  cmdQueue = sock;
+  posTaskSchedUnlock();
+
+  posSemaSignal(uipGiant);
+
+  while (sock->cmd != NET_SOCK_CMD_NONE) {
+
+    posMutexUnlock(sock->mutex);
+    posFlagGet(sock->uipChange, POSFLAG_MODE_GETMASK);
+    posMutexLock(sock->mutex);
+  }
+
+  return sock->cmdResult;
+}
+
+static int netListenerAdd(NetSock* sock)
+{
+  int i;
+
+  for (i = 0; i < UIP_LISTENPORTS; i++) {
+
+    if (listeners[i].sock == NULL) {
+
+      listeners[i].port = sock->port;
+      listeners[i].sock = sock;
+
+      // Semaphore counts connections waiting for
+      // accept. Clear what previous user left.
+      while (posSemaWait(listeners[i].acceptSema, 0) == 0);
+      sock->acceptSema = listeners[i].acceptSema;
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+static void netListenerRemove(NetSock* sock)
+{
+  int i;
+
+  for (i = 0; i < UIP_LISTENPORTS; i++)
+    if (listeners[i].sock == sock)
+      listeners[i].sock = NULL;
+}
+
+static NetSock* netListenerFind(uint16_t port)
+{
+  int i;
+
+  for (i = 0; i < UIP_LISTENPORTS; i++)
+    if (listeners[i].sock != NULL && listeners[i].port == port)
+      return listeners[i].sock;
+
+  return NULL;
+}
+
+#if NETCFG_TCP_KEEPALIVE == 1
+
+/*
+ * Copy socket keepalive settings to connection.
+ * Called by main thread.
+ */
+static void netKeepaliveSet(struct uip_conn* conn, NetSock* sock)
+{
+  conn->ka_idle = sock->kaOn ? sock->kaIdle : 0;
+  conn->ka_intvl = sock->kaIntvl;
+  conn->ka_cnt = sock->kaCnt;
+  conn->ka_probes = 0;
+}
+
+static struct uip_conn* netTcpConnFind(UosFile* file)
+{
+  int i;
+
+  for (i = 0; i < UIP_CONNS; i++)
+    if (uip_conns[i].tcpstateflags != UIP_CLOSED && uip_conns[i].appstate.file == file)
+      return &uip_conns[i];
+
+  return NULL;
+}
+
+#endif
+
+/*
+ * Execute commands submitted by netSockCommand.
+ * Called by main thread.
+ */
+static void netSockCommandRun(void)
+{
+  NetSock* list;
+  NetSock* sock;
+  NetSock* fifo = NULL;
+#if UIP_ACTIVE_OPEN == 1
+  struct uip_conn* tcp;
+#endif
+#if UIP_CONF_UDP == 1
+  struct uip_udp_conn* udp;
+#endif
+
+  posTaskSchedLock();
+  list = cmdQueue;
+  cmdQueue = NULL;
+  posTaskSchedUnlock();
+
+  // Queue is LIFO, reverse it to run commands in submit order.
+  while (list != NULL) {
+
+    sock = list;
+    list = list->cmdNext;
+    sock->cmdNext = fifo;
+    fifo = sock;
+  }
+
+  while (fifo != NULL) {
+
+    sock = fifo;
+    fifo = fifo->cmdNext;
+
+    posMutexLock(sock->mutex);
+
+    switch (sock->cmd) {
+#if UIP_ACTIVE_OPEN == 1
+    case NET_SOCK_CMD_CONNECT:
+      tcp = uip_connect(sock->cmdAddr, sock->cmdPort);
+      if (tcp == NULL) {
+
+        sock->cmdResult = -1;
+        break;
+      }
+
+      tcp->appstate.file = sock->cmdFile;
+#if NETCFG_TCP_KEEPALIVE == 1
+      netKeepaliveSet(tcp, sock);
+#endif
+      sock->state = NET_SOCK_CONNECT;
+
+      // Polling connection sends SYN right away,
+      // periodic timer takes care of retransmits.
+      tcp->timer = tcp->rto;
+      dataToSend = 1;
+      break;
+#endif
+
+#if UIP_CONF_UDP == 1
+    case NET_SOCK_CMD_UDP_NEW:
+      udp = uip_udp_new(sock->cmdAddr, sock->cmdPort);
+      if (udp == NULL) {
+
+        sock->cmdResult = -1;
+        break;
+      }
+
+      udp->appstate.file = sock->cmdFile;
+      if (sock->state == NET_SOCK_BOUND_UDP)
+        uip_udp_bind(udp, sock->port);
+
+      sock->state = NET_SOCK_BUSY;
+      break;
+#endif
+
+    case NET_SOCK_CMD_LISTEN:
+      sock->cmdResult = netListenerAdd(sock);
+      if (sock->cmdResult == 0)
+        uip_listen(sock->port);
+
+      break;
+
+    case NET_SOCK_CMD_UNLISTEN:
+      uip_unlisten(sock->port);
+      netListenerRemove(sock);
+      break;
+
+#if NETCFG_TCP_KEEPALIVE == 1
+    case NET_SOCK_CMD_KEEPALIVE:
+      {
+        struct uip_conn* conn = netTcpConnFind(sock->cmdFile);
+
+        if (conn == NULL)
+          sock->cmdResult = -1;
+        else
+          netKeepaliveSet(conn, sock);
+      }
+      break;
+#endif
+
+    default:
+      sock->cmdResult = -1;
+      break;
+    }
+
+    sock->cmd = NET_SOCK_CMD_NONE;
+    posFlagSet(sock->uipChange, 0);
+    posMutexUnlock(sock->mutex);
+  }
+}
+
 UosFile* netSockAlloc(NetSockState initialState)
 {
   int      slot;
@@ -110,21 +415,40 @@ UosFile* netSockAlloc(NetSockState initialState)
     return NULL;
   }
 
+  // Synchronization objects were created by netInit
+  // and are kept over reuse. Clear flags left over
+  // from previous user.
   NetSock* sock = UOS_BITTAB_ELEM(netSocketTable, slot);
+  posFlagWait(sock->sockChange, 0);
+  posFlagWait(sock->uipChange, 0);
+
   sock->state = initialState;
-  sock->mutex = posMutexCreate();
-  sock->sockChange = posFlagCreate();
-  sock->uipChange = posFlagCreate();
+  sock->udp = initialState == NET_SOCK_UNDEF_UDP;
+  sock->pendingAccept = false;
   sock->timeout = INFINITE;
+  sock->cmd = NET_SOCK_CMD_NONE;
+  sock->cmdNext = NULL;
+#if NETCFG_STATS == 1
+  memset(&sock->stats, 0, sizeof(sock->stats));
+#endif
   sock->buf = NULL;
   sock->len = 0;
   sock->max = 0;
-
-  P_ASSERT("netSockAlloc", sock->mutex != NULL && sock->sockChange != NULL && sock->uipChange != NULL);
-
-  POS_SETEVENTNAME(sock->mutex, "sock:mutex");
-  POS_SETEVENTNAME(sock->sockChange, "sock:api");
-  POS_SETEVENTNAME(sock->uipChange, "sock:uip");
+  sock->fromAddr = NULL;
+  sock->fromPort = NULL;
+  sock->txMsgs = NULL;
+  sock->txNext = 0;
+  sock->txCount = 0;
+#if UIP_CONF_UDP == 1
+  sock->rxHead = NULL;
+  sock->rxTail = NULL;
+#endif
+#if NETCFG_TCP_KEEPALIVE == 1
+  sock->kaOn = false;
+  sock->kaIdle = NETCFG_TCP_KEEPIDLE * NET_PERIODIC_HZ;
+  sock->kaIntvl = NETCFG_TCP_KEEPINTVL * NET_PERIODIC_HZ;
+  sock->kaCnt = NETCFG_TCP_KEEPCNT;
+#endif
 
   file->fs     = &netFS.base;
   file->cf     = &netSockConf;
@@ -173,9 +497,6 @@ UosFile* netSockCreateUDP(uip_ipaddr_t* ip, int port)
 
 int netSockConnect(UosFile* file, uip_ipaddr_t* ip, int port)
 {
-  struct uip_conn* tcp;
-  struct uip_udp_conn* udp;
-
   P_ASSERT("netSockConnect", file->fs->cf == &netFSConf);
   NetSock* sock = (NetSock*)file->fsPriv;
 
@@ -190,20 +511,15 @@ int netSockConnect(UosFile* file, uip_ipaddr_t* ip, int port)
 
 #if UIP_ACTIVE_OPEN == 1
 
-    posMutexLock(uipMutex);
-    tcp = uip_connect(ip, uip_htons(port));
-    if (tcp == NULL) {
+    NET_STAT(JIF_t start = jiffies);
+
+    posMutexLock(sock->mutex);
+    if (netSockCommand(file, NET_SOCK_CMD_CONNECT, ip, uip_htons(port)) == -1) {
 
-      posMutexUnlock(uipMutex);
+      posMutexUnlock(sock->mutex);
       return -1;
     }
 
-    tcp->appstate.file = file;
-
-    posMutexLock(sock->mutex);
-    sock->state = NET_SOCK_CONNECT;
-    posMutexUnlock(uipMutex);
-
     while (sock->state == NET_SOCK_CONNECT) {
 
       posMutexUnlock(sock->mutex);
@@ -211,35 +527,32 @@ int netSockConnect(UosFile* file, uip_ipaddr_t* ip, int port)
       posMutexLock(sock->mutex);
     }
 
+    // Like BSD connect(), socket is left for
+    // caller to close if connection failed.
     if (sock->state == NET_SOCK_PEER_CLOSED || sock->state == NET_SOCK_PEER_ABORTED) {
   
       posMutexUnlock(sock->mutex);
-      uosFileClose(file);
       return -1;
     }
 
     P_ASSERT("sockConnect", sock->state == NET_SOCK_CONNECT_OK);
     sock->state = NET_SOCK_BUSY;
+    posMutexUnlock(sock->mutex);
+    NET_STAT(netStatsHist(&netStats.connect, jiffies - start));
 #endif
   }
   else {
 
 #if UIP_CONF_UDP == 1
 
-    posMutexLock(uipMutex);
-    udp = uip_udp_new(ip, uip_htons(port));
-    if (udp == NULL) {
+    int result;
 
-      posMutexUnlock(uipMutex);
-      return -1;
-    }
-
-    udp->appstate.file = file;
-    if (sock->state == NET_SOCK_BOUND_UDP)
-      uip_udp_bind(udp, sock->port);
+    posMutexLock(sock->mutex);
+    result = netSockCommand(file, NET_SOCK_CMD_UDP_NEW, ip, uip_htons(port));
+    posMutexUnlock(sock->mutex);
 
-    sock->state = NET_SOCK_BUSY;
-    posMutexUnlock(uipMutex);
+    if (result == -1)
+      return -1;
 #endif
   }
 
@@ -287,55 +600,150 @@ int netSockBind(UosFile* file, int port)
 
 void netSockListen(UosFile* file)
 {
+  netSockListenBacklog(file, NETCFG_LISTEN_BACKLOG);
+}
+
+int netSockListenBacklog(UosFile* file, int backlog)
+{
+  int result;
+
   P_ASSERT("netSockListen", file->fs->cf == &netFSConf);
   NetSock* sock = (NetSock*)file->fsPriv;
 
+  if (backlog < 1)
+    backlog = 1;
+  else if (backlog > NETCFG_LISTEN_BACKLOG)
+    backlog = NETCFG_LISTEN_BACKLOG;
+
   posMutexLock(sock->mutex);
+  sock->backlog = backlog;
+  sock->pendingHead = 0;
+  sock->pendingCount = 0;
+  sock->acceptWaiters = 0;
   sock->state = NET_SOCK_LISTENING;
-  posMutexUnlock(sock->mutex);
+  result = netSockCommand(file, NET_SOCK_CMD_LISTEN, NULL, 0);
+  if (result == -1)
+    sock->state = NET_SOCK_BOUND;
 
-  posMutexLock(uipMutex);
-  uip_listen(sock->port);
-  posMutexUnlock(uipMutex);
+  posMutexUnlock(sock->mutex);
+  return result;
 }
 
+/*
+ * Any number of tasks can wait here for same listening
+ * socket. Each queued connection signals accept semaphore
+ * once, so it wakes exactly one of them.
+ */
 UosFile* netSockAccept(UosFile* listenSockFile, uip_ipaddr_t* peer)
 {
-  UosFile* file;
+  NetSockPending p;
+  NetSock* sock;
+  bool alive;
 
   P_ASSERT("netSockAccept", listenSockFile->fs->cf == &netFSConf);
   NetSock* listenSock = (NetSock*)listenSockFile->fsPriv;
+  NET_STAT(JIF_t start = jiffies);
 
   posMutexLock(listenSock->mutex);
 
   P_ASSERT("sockAccept", listenSock->state == NET_SOCK_LISTENING);
+  ++listenSock->acceptWaiters;
 
-  listenSock->state = NET_SOCK_ACCEPTING;
-  posFlagSet(listenSock->sockChange, 0);
+  do {
 
-  while (listenSock->state == NET_SOCK_ACCEPTING) {
+    do {
 
-    posMutexUnlock(listenSock->mutex);
-    posFlagGet(listenSock->uipChange, POSFLAG_MODE_GETMASK);
-    posMutexLock(listenSock->mutex);
-  }
+      posMutexUnlock(listenSock->mutex);
+      posSemaWait(listenSock->acceptSema, INFINITE);
+      posMutexLock(listenSock->mutex);
+
+      if (listenSock->state != NET_SOCK_LISTENING) {
+
+        // Socket is being closed, let closer
+        // know when all waiters are gone.
+        if (--listenSock->acceptWaiters == 0)
+          posFlagSet(listenSock->uipChange, 0);
+
+        posMutexUnlock(listenSock->mutex);
+        return NULL;
+      }
+
+    } while (listenSock->pendingCount == 0);
+
+    p = listenSock->pending[listenSock->pendingHead];
+    listenSock->pendingHead = (listenSock->pendingHead + 1) % NETCFG_LISTEN_BACKLOG;
+    --listenSock->pendingCount;
+
+    // Connection may have been closed by peer
+    // while waiting in queue, skip it.
+    sock = (NetSock*)p.file->fsPriv;
+    posMutexLock(sock->mutex);
+    alive = sock->state == NET_SOCK_BUSY;
+    if (alive) {
+
+      uip_ipaddr_copy(peer, &p.conn->ripaddr);
 
-  P_ASSERT("sockAccept", listenSock->state == NET_SOCK_ACCEPTED);
+      // Let main loop restart connection
+      // when it polls it.
+      sock->pendingAccept = false;
+      dataToSend = 1;
+      posSemaSignal(uipGiant);
+    }
+
+    posMutexUnlock(sock->mutex);
+    if (!alive)
+      netSockFree(p.file);
 
-  uip_ipaddr_copy(peer, &listenSock->newConnection->ripaddr);
-  file = listenSock->newConnection->appstate.file;
-  listenSock->newConnection = NULL;
-  listenSock->state = NET_SOCK_LISTENING;
+  } while (!alive);
 
+  --listenSock->acceptWaiters;
   posMutexUnlock(listenSock->mutex);
 
-  return file;
+  NET_STAT(netStatsHist(&netStats.accept, jiffies - start));
+  return p.file;
+}
+
+#if UIP_CONF_UDP == 1
+
+/*
+ * Take oldest queued datagram. Caller must hold
+ * sock->mutex. Returns -1 if queue is empty.
+ */
+static int netUdpDequeue(NetSock* sock, void* data, uint16_t max, uip_ipaddr_t* addr, uint16_t* port)
+{
+  NetUdpDgram* d = sock->rxHead;
+  int len;
+
+  if (d == NULL)
+    return -1;
+
+  sock->rxHead = d->next;
+  if (sock->rxHead == NULL)
+    sock->rxTail = NULL;
+
+  len = d->len > max ? max : d->len;
+  memcpy(data, d->data, len);
+  if (addr != NULL)
+    uip_ipaddr_copy(addr, &d->addr);
+
+  if (port != NULL)
+    *port = d->port;
+
+  posTaskSchedLock();
+  memb_free(&udpDgramPool, d);
+  posTaskSchedUnlock();
+
+  return len;
 }
 
-static int sockReadInternal(NetSock* sock, NetSockState state, void* data, uint16_t max, uint16_t timeout)
+#endif
+
+static int sockReadInternal(NetSock* sock, NetSockState state, void* data, uint16_t max,
+                            uip_ipaddr_t* from, uint16_t* fromPort, uint16_t timeout)
 {
   int len;
   bool timedOut = false;
+  NET_STAT(JIF_t start = jiffies);
 
   posMutexLock(sock->mutex);
 
@@ -353,10 +761,22 @@ static int sockReadInternal(NetSock* sock, NetSockState state, void* data, uint1
 
   P_ASSERT("sockRead", sock->state == NET_SOCK_BUSY);
 
+#if UIP_CONF_UDP == 1
+  len = netUdpDequeue(sock, data, max, from, fromPort);
+  if (len >= 0) {
+
+    posMutexUnlock(sock->mutex);
+    NET_STAT(netStatsHist(&netStats.read, jiffies - start));
+    return len;
+  }
+#endif
+
   sock->state = state;
   sock->buf = data;
   sock->max = max;
   sock->len = 0;
+  sock->fromAddr = from;
+  sock->fromPort = fromPort;
 
   posFlagSet(sock->sockChange, 0);
 
@@ -367,26 +787,101 @@ static int sockReadInternal(NetSock* sock, NetSockState state, void* data, uint1
     posMutexLock(sock->mutex);
   }
 
-  if (sock->state == NET_SOCK_PEER_CLOSED)
+  // Connection may have been closed after data was
+  // given to us, return data first. Next read returns
+  // close status.
+  if (sock->len > 0 && (sock->state == NET_SOCK_PEER_CLOSED ||
+                        sock->state == NET_SOCK_PEER_ABORTED))
+    len = sock->len;
+  else if (sock->state == NET_SOCK_PEER_CLOSED)
     len = NET_SOCK_EOF;
   else if (sock->state == NET_SOCK_PEER_ABORTED)
     len = NET_SOCK_ABORT;
   else {
 
-    P_ASSERT("sockRead", (timedOut && sock->state == state) || sock->state == NET_SOCK_READ_OK);
+    P_ASSERT("sockRead", (timedOut && sock->state == state) ||
+                         sock->state == NET_SOCK_READ_OK ||
+                         sock->state == NET_SOCK_LENT);
 
     if (timedOut && sock->state == state)
       len = NET_SOCK_TIMEOUT;
-    else
+    else {
+
       len = sock->len;
+      NET_STAT(netStatsHist(&netStats.read, jiffies - start));
+    }
 
-    sock->state = NET_SOCK_BUSY;
+    // Lent data stays with reader until netSockRelease.
+    if (sock->state != NET_SOCK_LENT)
+      sock->state = NET_SOCK_BUSY;
   }
 
   posMutexUnlock(sock->mutex);
   return len;
 }
 
+#if NETCFG_TCP_KEEPALIVE == 1
+
+/*
+ * Pass keepalive settings of connected
+ * socket to its uIP connection.
+ */
+static int netKeepaliveUpdate(UosFile* file, NetSock* sock)
+{
+  if (sock->state != NET_SOCK_BUSY)
+    return 0;
+
+  return netSockCommand(file, NET_SOCK_CMD_KEEPALIVE, NULL, 0);
+}
+
+int netSockKeepalive(UosFile* file, bool enable)
+{
+  P_ASSERT("netSockKeepalive", file->fs->cf == &netFSConf);
+  NetSock* sock = (NetSock*)file->fsPriv;
+  int result;
+
+  posMutexLock(sock->mutex);
+  sock->kaOn = enable;
+  result = netKeepaliveUpdate(file, sock);
+  posMutexUnlock(sock->mutex);
+
+  return result;
+}
+
+int netSockKeepaliveParams(UosFile* file, int idle, int intvl, int cnt)
+{
+  P_ASSERT("netSockKeepaliveParams", file->fs->cf == &netFSConf);
+  NetSock* sock = (NetSock*)file->fsPriv;
+  long newIdle;
+  long newIntvl;
+  int result;
+
+  posMutexLock(sock->mutex);
+
+  newIdle = idle > 0 ? (long)idle * NET_PERIODIC_HZ : sock->kaIdle;
+  newIntvl = intvl > 0 ? (long)intvl * NET_PERIODIC_HZ : sock->kaIntvl;
+  if (cnt <= 0)
+    cnt = sock->kaCnt;
+
+  // Last probe must be due before
+  // uIP idle counter saturates.
+  if (cnt > 255 || newIdle + cnt * newIntvl >= 0xffff) {
+
+    posMutexUnlock(sock->mutex);
+    return -1;
+  }
+
+  sock->kaIdle = newIdle;
+  sock->kaIntvl = newIntvl;
+  sock->kaCnt = cnt;
+  result = netKeepaliveUpdate(file, sock);
+  posMutexUnlock(sock->mutex);
+
+  return result;
+}
+
+#endif
+
 static int sockRead(UosFile* file, char* buf, int max)
 {
   P_ASSERT("netSockRead", file->fs->cf == &netFSConf);
@@ -409,21 +904,213 @@ int netSockRead(UosFile* file, void* data, uint16_t max, uint16_t timeout)
   P_ASSERT("netSockRead", file->fs->cf == &netFSConf);
   NetSock* sock = (NetSock*)file->fsPriv;
 
-  return sockReadInternal(sock, NET_SOCK_READING, data, max, timeout);
+  return sockReadInternal(sock, NET_SOCK_READING, data, max, NULL, NULL, timeout);
+}
+
+int netSockBorrow(UosFile* file, const void** data, uint16_t timeout)
+{
+  P_ASSERT("netSockBorrow", file->fs->cf == &netFSConf);
+  NetSock* sock = (NetSock*)file->fsPriv;
+  int len;
+
+  // Datagrams are queued in pool entries,
+  // there is nothing to lend from uip_buf.
+  if (sock->udp)
+    return -1;
+
+  len = sockReadInternal(sock, NET_SOCK_BORROWING, NULL, 0, NULL, NULL, timeout);
+  if (len > 0)
+    *data = sock->buf;
+
+  return len;
+}
+
+int netSockRelease(UosFile* file, uint16_t used)
+{
+  P_ASSERT("netSockRelease", file->fs->cf == &netFSConf);
+  NetSock* sock = (NetSock*)file->fsPriv;
+
+  posMutexLock(sock->mutex);
+
+  // Main loop took data back because it
+  // was not released in time.
+  if (sock->state != NET_SOCK_LENT) {
+
+    posMutexUnlock(sock->mutex);
+    return NET_SOCK_ABORT;
+  }
+
+  P_ASSERT("netSockRelease", used <= sock->len);
+
+  sock->lentUsed = used;
+  sock->state = NET_SOCK_BUSY;
+  posFlagSet(sock->sockChange, 0);
+
+  posMutexUnlock(sock->mutex);
+  return 0;
+}
+
+#if UIP_CONF_UDP == 1
+
+int netSockRecvFrom(UosFile* file, void* data, uint16_t max, uip_ipaddr_t* addr, uint16_t* port, uint16_t timeout)
+{
+  P_ASSERT("netSockRecvFrom", file->fs->cf == &netFSConf);
+  NetSock* sock = (NetSock*)file->fsPriv;
+  int len;
+
+  // Bound socket without connection gets one
+  // that accepts datagrams from anyone.
+  if (sock->state == NET_SOCK_UNDEF_UDP || sock->state == NET_SOCK_BOUND_UDP)
+    if (netSockConnect(file, NULL, 0) == -1)
+      return -1;
+
+  len = sockReadInternal(sock, NET_SOCK_READING, data, max, addr, port, timeout);
+  if (len >= 0 && port != NULL)
+    *port = uip_ntohs(*port);
+
+  return len;
+}
+
+int netSockRecvBatch(UosFile* file, NetSockDgram* msgs, int count, uint16_t timeout)
+{
+  P_ASSERT("netSockRecvBatch", file->fs->cf == &netFSConf);
+  NetSock* sock = (NetSock*)file->fsPriv;
+  int len;
+  int n;
+
+  if (count < 1)
+    return 0;
+
+  // Wait for first datagram, then take the
+  // ones that are already queued in one go.
+  len = netSockRecvFrom(file, msgs[0].data, msgs[0].max, &msgs[0].addr, &msgs[0].port, timeout);
+  if (len < 0)
+    return len;
+
+  msgs[0].len = len;
+
+  posMutexLock(sock->mutex);
+  for (n = 1; n < count; n++) {
+
+    len = netUdpDequeue(sock, msgs[n].data, msgs[n].max, &msgs[n].addr, &msgs[n].port);
+    if (len < 0)
+      break;
+
+    msgs[n].len = len;
+    msgs[n].port = uip_ntohs(msgs[n].port);
+  }
+
+  posMutexUnlock(sock->mutex);
+  return n;
+}
+
+int netSockSendTo(UosFile* file, const void* data, uint16_t len, uip_ipaddr_t* addr, uint16_t port)
+{
+  NetSockDgram msg;
+  int result;
+
+  msg.data = (void*)data;
+  msg.len = len;
+  uip_ipaddr_copy(&msg.addr, addr);
+  msg.port = port;
+
+  result = netSockSendBatch(file, &msg, 1);
+  return result == 1 ? len : result;
+}
+
+int netSockSendBatch(UosFile* file, const NetSockDgram* msgs, int count)
+{
+  P_ASSERT("netSockSendBatch", file->fs->cf == &netFSConf);
+  NetSock* sock = (NetSock*)file->fsPriv;
+  NET_STAT(JIF_t start = jiffies);
+  int n;
+
+  if (count < 1)
+    return 0;
+
+  // Datagram that doesn't fit into uip_buf
+  // is not sent, sending stops before it.
+  for (n = 0; n < count; n++)
+    if (msgs[n].len > NET_SOCK_MAX_DGRAM)
+      break;
+
+  if (n == 0)
+    return -1;
+
+  count = n;
+
+  // Socket without connection gets one
+  // that accepts datagrams from anyone.
+  if (sock->state == NET_SOCK_UNDEF_UDP || sock->state == NET_SOCK_BOUND_UDP)
+    if (netSockConnect(file, NULL, 0) == -1)
+      return -1;
+
+  posMutexLock(sock->mutex);
+
+  if (sock->state == NET_SOCK_PEER_CLOSED) {
+
+    posMutexUnlock(sock->mutex);
+    return NET_SOCK_EOF;
+  }
+
+  if (sock->state == NET_SOCK_PEER_ABORTED) {
+
+    posMutexUnlock(sock->mutex);
+    return NET_SOCK_ABORT;
+  }
+
+  P_ASSERT("netSockSendBatch", sock->state == NET_SOCK_BUSY);
+
+  sock->txMsgs = msgs;
+  sock->txNext = 0;
+  sock->txCount = count;
+  sock->state = NET_SOCK_WRITING;
+
+  dataToSend = 1;
+  posSemaSignal(uipGiant);
+
+  while (sock->state == NET_SOCK_WRITING) {
+
+    posMutexUnlock(sock->mutex);
+    posFlagGet(sock->uipChange, POSFLAG_MODE_GETMASK);
+    posMutexLock(sock->mutex);
+  }
+
+  P_ASSERT("netSockSendBatch", sock->state == NET_SOCK_WRITE_OK);
+
+  count = sock->txNext;
+  sock->txMsgs = NULL;
+  sock->state = NET_SOCK_BUSY;
+
+#if NETCFG_STATS == 1
+  int i;
+
+  for (i = 0; i < count; i++)
+    sock->stats.txBytes += msgs[i].len;
+
+  netStatsHist(&netStats.write, jiffies - start);
+#endif
+
+  posMutexUnlock(sock->mutex);
+
+  return count;
 }
 
+#endif
+
 int netSockReadLine(UosFile* file, void* data, uint16_t max, uint16_t timeout)
 {
   P_ASSERT("netSockReadLine", file->fs->cf == &netFSConf);
   NetSock* sock = (NetSock*)file->fsPriv;
 
-  return sockReadInternal(sock, NET_SOCK_READING_LINE, data, max, timeout);
+  return sockReadInternal(sock, NET_SOCK_READING_LINE, data, max, NULL, NULL, timeout);
 }
 
 static int sockWrite(UosFile* file, const char* data, int len)
 {
   P_ASSERT("sockWrite", file->fs->cf == &netFSConf);
   NetSock* sock = (NetSock*)file->fsPriv;
+  NET_STAT(JIF_t start = jiffies);
 
   posMutexLock(sock->mutex);
 
@@ -441,6 +1128,14 @@ static int sockWrite(UosFile* file, const char* data, int len)
 
   P_ASSERT("sockWrite", sock->state == NET_SOCK_BUSY);
 
+#if UIP_CONF_UDP == 1
+  if (sock->udp && len > NET_SOCK_MAX_DGRAM) {
+
+    posMutexUnlock(sock->mutex);
+    return -1;
+  }
+#endif
+
   sock->state = NET_SOCK_WRITING;
   sock->buf = (void*)data;
   sock->len = len;
@@ -455,7 +1150,15 @@ static int sockWrite(UosFile* file, const char* data, int len)
     posMutexLock(sock->mutex);
   }
 
-  if (sock->state == NET_SOCK_PEER_CLOSED)
+  // Connection may have been closed after all data
+  // was acknowledged, write was still successful.
+  // Next write returns close status.
+  if (sock->len == 0 && (sock->state == NET_SOCK_PEER_CLOSED ||
+                         sock->state == NET_SOCK_PEER_ABORTED)) {
+
+    NET_STAT(sock->stats.txBytes += len);
+  }
+  else if (sock->state == NET_SOCK_PEER_CLOSED)
     len = NET_SOCK_EOF;
   else if (sock->state == NET_SOCK_PEER_ABORTED)
     len = NET_SOCK_ABORT;
@@ -464,6 +1167,8 @@ static int sockWrite(UosFile* file, const char* data, int len)
     P_ASSERT("sockWrite", sock->state == NET_SOCK_WRITE_OK);
 
     sock->state = NET_SOCK_BUSY;
+    NET_STAT(sock->stats.txBytes += len);
+    NET_STAT(netStatsHist(&netStats.write, jiffies - start));
   }
 
   posMutexUnlock(sock->mutex);
@@ -476,14 +1181,24 @@ void netSockFree(UosFile* file)
   P_ASSERT("sockWrite", file->fs->cf == &netFSConf);
   NetSock* sock = (NetSock*)file->fsPriv;
 
-  posMutexDestroy(sock->mutex);
-  posFlagDestroy(sock->sockChange);
-  posFlagDestroy(sock->uipChange);
-  sock->mutex = NULL;
-  sock->sockChange = NULL;
-  sock->uipChange = NULL;
+#if UIP_CONF_UDP == 1
+  NetUdpDgram* d;
+
+  // Drop datagrams nobody read.
+  posTaskSchedLock();
+  while (sock->rxHead != NULL) {
+
+    d = sock->rxHead;
+    sock->rxHead = d->next;
+    memb_free(&udpDgramPool, d);
+  }
+
+  sock->rxTail = NULL;
+  posTaskSchedUnlock();
+#endif
 
   sock->state = NET_SOCK_NULL;
+  UOS_BITTAB_FREE(netSocketTable, UOS_BITTAB_SLOT(netSocketTable, sock));
 
   uosFileFree(file);
 }
@@ -495,6 +1210,15 @@ static int sockClose(UosFile* file)
 
   posMutexLock(sock->mutex);
 
+  if (sock->state == NET_SOCK_LENT) {
+
+    // Give borrowed data back so main loop
+    // continues, rest of it is discarded.
+    sock->lentUsed = sock->len;
+    sock->state = NET_SOCK_BUSY;
+    posFlagSet(sock->sockChange, 0);
+  }
+
   if (sock->state == NET_SOCK_BUSY) {
 
     sock->state = NET_SOCK_CLOSE;
@@ -512,24 +1236,85 @@ static int sockClose(UosFile* file)
 
   if (sock->state == NET_SOCK_LISTENING) {
 
-    posMutexLock(uipMutex);
-    uip_unlisten(sock->port);
-    posMutexUnlock(uipMutex);
+    NetSockPending p;
+    int i;
+
+    // Wake up tasks waiting in accept and wait until
+    // they are gone. New connections are not queued
+    // after state change.
+    sock->state = NET_SOCK_CLOSE;
+    for (i = 0; i < sock->acceptWaiters; i++)
+      posSemaSignal(sock->acceptSema);
+
+    while (sock->acceptWaiters > 0) {
+
+      posMutexUnlock(sock->mutex);
+      posFlagGet(sock->uipChange, POSFLAG_MODE_GETMASK);
+      posMutexLock(sock->mutex);
+    }
+
+    netSockCommand(file, NET_SOCK_CMD_UNLISTEN, NULL, 0);
 
     sock->port = 0;
     sock->state = NET_SOCK_CLOSE_OK;
+
+    // Close connections that were never accepted.
+    while (sock->pendingCount > 0) {
+
+      p = sock->pending[sock->pendingHead];
+      sock->pendingHead = (sock->pendingHead + 1) % NETCFG_LISTEN_BACKLOG;
+      --sock->pendingCount;
+
+      posMutexUnlock(sock->mutex);
+      uosFileClose(p.file);
+      posMutexLock(sock->mutex);
+    }
   }
 
   P_ASSERT("CloseState", (sock->state == NET_SOCK_PEER_CLOSED ||
                           sock->state == NET_SOCK_PEER_ABORTED || 
                           sock->state == NET_SOCK_CLOSE_OK));
 
+  // Pooled mutex outlives this socket, so release it
+  // before the slot is handed out again.
+  posMutexUnlock(sock->mutex);
   netSockFree(file);
   return 0;
 }
 
 static void netTcpAppcallMutex(NetSock* sock);
 
+/*
+ * Remove CR characters from buffer,
+ * return new length.
+ */
+static uint16_t netStripCR(char* buf, uint16_t len)
+{
+  const char* end = buf + len;
+  const char* in;
+  char* out;
+  char* cr;
+
+  cr = memchr(buf, '\r', len);
+  if (cr == NULL)
+    return len;
+
+  out = cr;
+  in = cr + 1;
+  while (in < end) {
+
+    cr = memchr(in, '\r', end - in);
+    if (cr == NULL)
+      cr = (char*)end;
+
+    memmove(out, in, cr - in);
+    out += cr - in;
+    in = cr + 1;
+  }
+
+  return out - buf;
+}
+
 void netTcpAppcall()
 {
   UosFile *file = NULL;
@@ -560,40 +1345,24 @@ void netTcpAppcall()
       }
       else {
 
-        int i;
         NetSock* listenSock;
+        NetSockPending* p;
 
-        for (i = 0; i < SOCK_TABSIZE; i++, listenSock++) {
-
-          if (UOS_BITTAB_IS_FREE(netSocketTable, i))
-            continue;
-
-          listenSock = UOS_BITTAB_ELEM(netSocketTable, i);
-          if ((listenSock->state == NET_SOCK_LISTENING ||
-              listenSock->state == NET_SOCK_ACCEPTING ||
-              listenSock->state == NET_SOCK_ACCEPTED) &&
-              listenSock->port == uip_conn->lport)
-            break;
-        }
-
-        if (i >= SOCK_TABSIZE) {
+        listenSock = netListenerFind(uip_conn->lport);
+        if (listenSock == NULL) {
 
           uip_abort();
           return;
         }
 
-        bool timeout = false;
- 
+        // Queue connection for accept. Main loop
+        // never waits for application here, if backlog
+        // is full connection is aborted.
         posMutexLock(listenSock->mutex);
-        while (listenSock->state != NET_SOCK_ACCEPTING && !timeout) {
- 
-          posMutexUnlock(listenSock->mutex);
-          timeout = posFlagWait(listenSock->sockChange, MS(200)) == 0;
-          posMutexLock(listenSock->mutex);
-        }
+        if (listenSock->state != NET_SOCK_LISTENING ||
+            listenSock->pendingCount >= listenSock->backlog) {
 
-        if (timeout) {
-      
+          NET_STAT(++netStats.acceptOverflows);
           uip_abort();
           posMutexUnlock(listenSock->mutex);
           return;
@@ -602,16 +1371,40 @@ void netTcpAppcall()
         file = netSockAlloc(NET_SOCK_BUSY);
         if (file == NULL) {
       
+          NET_STAT(++netStats.acceptOverflows);
           uip_abort();
           posMutexUnlock(listenSock->mutex);
           return;
         }
 
         uip_conn->appstate.file = file;
-        listenSock->newConnection = uip_conn;
-        listenSock->state = NET_SOCK_ACCEPTED;
-
-        posFlagSet(listenSock->uipChange, 0);
+#if NETCFG_TCP_KEEPALIVE == 1
+        // Accepted connection inherits keepalive
+        // settings of listening socket.
+        NetSock* newSock = (NetSock*)file->fsPriv;
+
+        newSock->kaOn = listenSock->kaOn;
+        newSock->kaIdle = listenSock->kaIdle;
+        newSock->kaIntvl = listenSock->kaIntvl;
+        newSock->kaCnt = listenSock->kaCnt;
+        netKeepaliveSet(uip_conn, newSock);
+#endif
+        // Peer's data waits in its retransmit queue
+        // (we advertise zero window) until connection
+        // is accepted, so main loop doesn't have to
+        // wait for reader. This includes data that came
+        // with the handshake ACK, uIP doesn't acknowledge
+        // it when connection is stopped here.
+        uip_stop();
+        ((NetSock*)file->fsPriv)->pendingAccept = true;
+
+        p = &listenSock->pending[(listenSock->pendingHead + listenSock->pendingCount) % NETCFG_LISTEN_BACKLOG];
+        p->file = file;
+        p->conn = uip_conn;
+        ++listenSock->pendingCount;
+        NET_STAT(++netStats.acceptQueued);
+
+        posSemaSignal(listenSock->acceptSema);
         posMutexUnlock(listenSock->mutex);
       }
     }
@@ -645,8 +1438,7 @@ void netTcpAppcall()
 
   posMutexLock(sock->mutex);
   netTcpAppcallMutex(sock);
-  if (sock->mutex != NULL)
-    posMutexUnlock(sock->mutex);
+  posMutexUnlock(sock->mutex);
 }
 
 static void netAppcallClose(NetSock* sock, NetSockState nextState)
@@ -682,21 +1474,30 @@ static void netTcpAppcallMutex(NetSock* sock)
 
         sock->buf = sock->buf + uip_mss();
         sock->len -= uip_mss();
-        uip_send(sock->buf, sock->len);
+        NET_SEND(sock->buf, sock->len);
+        NET_STAT(++sock->stats.txSegs);
       }
     }
   }
 
-  if (uip_newdata()) {
+  // Connection waiting in accept queue has no reader,
+  // its data is left for peer to retransmit.
+  if (uip_newdata() && !sock->pendingAccept) {
 
     bool timeout = false;
     uint16_t dataLeft = uip_datalen();
     char* dataPtr = uip_appdata;
 
+    NET_STAT(++sock->stats.rxSegs);
+    NET_STAT(sock->stats.rxBytes += dataLeft);
+
     while (dataLeft > 0 && !timeout) {
 
+      NET_STAT(JIF_t start = jiffies);
+
       while (sock->state != NET_SOCK_READING &&
              sock->state != NET_SOCK_READING_LINE && 
+             sock->state != NET_SOCK_BORROWING &&
              !timeout) {
 
         posMutexUnlock(sock->mutex);
@@ -704,6 +1505,8 @@ static void netTcpAppcallMutex(NetSock* sock)
         posMutexLock(sock->mutex);
       }
 
+      NET_STAT(netStatsHist(&netStats.appWait, jiffies - start));
+
       if (timeout) {
 
         // Timeout or bad state
@@ -712,24 +1515,29 @@ static void netTcpAppcallMutex(NetSock* sock)
       }
       else if (sock->state == NET_SOCK_READING_LINE) {
 
-        char ch;
+        const char* nl;
+        uint16_t run;
 
+        // Copy up to end of line or buffer in one go
+        // and strip CRs from copied data afterwards.
+        // Stripping frees space from buffer, so
+        // loop until line or buffer is complete.
         while (dataLeft && sock->len < sock->max) {
-          
-          ch = *dataPtr;
-
-          if (ch == '\r') {
-       
-            ++dataPtr;
-            --dataLeft;
-            continue;
-          }
-
-          sock->buf[sock->len] = ch;
-          ++dataPtr;
-          --dataLeft;
-          ++sock->len;
-          if (ch == '\n')
+
+          run = sock->max - sock->len;
+          if (run > dataLeft)
+            run = dataLeft;
+
+          nl = memchr(dataPtr, '\n', run);
+          if (nl != NULL)
+            run = nl - dataPtr + 1;
+
+          memcpy(sock->buf + sock->len, dataPtr, run);
+          dataPtr += run;
+          dataLeft -= run;
+          sock->len += netStripCR(sock->buf + sock->len, run);
+
+          if (nl != NULL)
             break;
         }
 
@@ -753,12 +1561,47 @@ static void netTcpAppcallMutex(NetSock* sock)
         sock->state = NET_SOCK_READ_OK;
         posFlagSet(sock->uipChange, 0);
       }
+      else if (sock->state == NET_SOCK_BORROWING) {
+
+        // Lend data to reader and wait until it is
+        // released. Main loop is stopped meanwhile,
+        // so uip_buf stays intact. If reader borrows
+        // again right after release, state is already
+        // BORROWING when we get here.
+        sock->buf = dataPtr;
+        sock->len = dataLeft;
+        sock->state = NET_SOCK_LENT;
+        posFlagSet(sock->uipChange, 0);
+
+        while (sock->state == NET_SOCK_LENT && !timeout) {
+
+          posMutexUnlock(sock->mutex);
+          timeout = posFlagWait(sock->sockChange, MS(500)) == 0;
+          posMutexLock(sock->mutex);
+        }
+
+        if (sock->state == NET_SOCK_LENT) {
+
+          // Reader didn't release data in time. Take it
+          // back and abort, netSockRelease tells reader
+          // that data may have been overwritten.
+          uip_abort();
+          netAppcallClose(sock, NET_SOCK_PEER_ABORTED);
+        }
+        else {
+
+          timeout = false;
+          dataLeft -= sock->lentUsed;
+          dataPtr += sock->lentUsed;
+        }
+      }
     }
   }
 
   if (uip_rexmit()) {
 
-    uip_send(sock->buf, sock->len);
+    NET_SEND(sock->buf, sock->len);
+    NET_STAT(++sock->stats.txSegs);
   }
 
   if (uip_closed()) {
@@ -768,6 +1611,12 @@ static void netTcpAppcallMutex(NetSock* sock)
 
   if (uip_poll()) {
 
+    // Connection that was stopped while waiting
+    // in accept queue has been accepted, open window
+    // again. This causes window update to be sent.
+    if (uip_stopped(uip_conn) && !sock->pendingAccept)
+      uip_restart();
+
     if (sock->state == NET_SOCK_CLOSE) {
 
       uip_close();
@@ -775,7 +1624,8 @@ static void netTcpAppcallMutex(NetSock* sock)
     }
     else if (sock->state == NET_SOCK_WRITING) {
 
-      uip_send(sock->buf, sock->len);
+      NET_SEND(sock->buf, sock->len);
+      NET_STAT(++sock->stats.txSegs);
     }
   }
 }
@@ -791,59 +1641,237 @@ void netUdpAppcall()
   P_ASSERT("netUdpAppcall", file->fs->cf == &netFSConf);
   NetSock* sock = (NetSock*)file->fsPriv;
 
-  if (sock->mutex == NULL) {
+  if (sock->state == NET_SOCK_NULL) {
 
     return;
   }
 
   posMutexLock(sock->mutex);
   netUdpAppcallMutex(sock);
-  if (sock->mutex != NULL)
-    posMutexUnlock(sock->mutex);
+  posMutexUnlock(sock->mutex);
 }
 
 static void netUdpAppcallMutex(NetSock* sock)
 {
   if (uip_newdata()) {
 
-    bool timeout = false;
-
-    while (sock->state != NET_SOCK_READING && !timeout) {
+    NetUdpDgram* d;
 
-      posMutexUnlock(sock->mutex);
-      timeout = posFlagWait(sock->sockChange, MS(500)) == 0;
-      posMutexLock(sock->mutex);
-    }
+    NET_STAT(++sock->stats.rxSegs);
+    NET_STAT(sock->stats.rxBytes += uip_datalen());
 
-    if (!timeout) {
+    if (sock->state == NET_SOCK_READING && sock->rxHead == NULL) {
 
+      // Reader is waiting, copy directly to its buffer.
       if (uip_datalen() > sock->max)
         sock->len = sock->max;
       else
         sock->len = uip_datalen();
 
       memcpy(sock->buf, uip_appdata, sock->len);
+      if (sock->fromAddr != NULL)
+        uip_ipaddr_copy((uip_ipaddr_t*)sock->fromAddr, &UDP_IP_HDR->srcipaddr);
+
+      if (sock->fromPort != NULL)
+        *sock->fromPort = UDP_HDR->srcport;
 
       sock->state = NET_SOCK_READ_OK;
       posFlagSet(sock->uipChange, 0);
     }
+    else {
+
+      // Queue datagram for next read. Main loop never
+      // waits for application, if pool is empty
+      // datagram is dropped.
+      posTaskSchedLock();
+      d = memb_alloc(&udpDgramPool);
+      posTaskSchedUnlock();
+
+      if (d == NULL) {
+
+        NET_STAT(++netStats.udpDrops);
+      }
+      else {
+
+        d->next = NULL;
+        d->len = uip_datalen() > NETCFG_UDP_RXSIZE ? NETCFG_UDP_RXSIZE : uip_datalen();
+        memcpy(d->data, uip_appdata, d->len);
+        uip_ipaddr_copy(&d->addr, &UDP_IP_HDR->srcipaddr);
+        d->port = UDP_HDR->srcport;
+
+        if (sock->rxTail == NULL)
+          sock->rxHead = d;
+        else
+          sock->rxTail->next = d;
+
+        sock->rxTail = d;
+        NET_STAT(++netStats.udpQueued);
+      }
+    }
   }
 
   if (uip_poll()) {
 
     if (sock->state == NET_SOCK_CLOSE) {
 
+      // netAppcallClose is for tcp connections only.
       uip_udp_remove(uip_udp_conn);
-      netAppcallClose(sock, NET_SOCK_CLOSE_OK);
+      uip_udp_conn->appstate.file = NULL;
+      sock->state = NET_SOCK_CLOSE_OK;
+      posFlagSet(sock->uipChange, 0);
+    }
+    else if (sock->state == NET_SOCK_WRITING && sock->txMsgs != NULL) {
+
+      // netUdpPollConn has pointed connection
+      // to destination of this datagram.
+      if (sock->txNext < sock->txCount) {
+
+        const NetSockDgram* m = &sock->txMsgs[sock->txNext++];
+
+#if NETCFG_XMITV == 1
+        uip_sendv(m->data, m->len);
+#else
+        memcpy(uip_appdata, m->data, m->len);
+        uip_udp_send(m->len);
+#endif
+        NET_STAT(++sock->stats.txSegs);
+      }
     }
     else if (sock->state == NET_SOCK_WRITING) {
 
+#if NETCFG_XMITV == 1
+      // Writer is released by netUdpXmitvDone
+      // after datagram has been sent.
+      uip_sendv(sock->buf, sock->len);
+      NET_STAT(++sock->stats.txSegs);
+      udpXmitvSock = sock;
+#else
       memcpy(uip_appdata, sock->buf, sock->len);
       uip_udp_send(sock->len);
+      NET_STAT(++sock->stats.txSegs);
       sock->state = NET_SOCK_WRITE_OK;
       posFlagSet(sock->uipChange, 0);
+#endif
+    }
+  }
+}
+
+#if NETCFG_XMITV == 1
+
+/*
+ * Complete write of UDP datagram that was sent
+ * directly from writer's buffer.
+ */
+static void netUdpXmitvDone(void)
+{
+  NetSock* sock = udpXmitvSock;
+
+  if (sock == NULL)
+    return;
+
+  udpXmitvSock = NULL;
+  posMutexLock(sock->mutex);
+  sock->state = NET_SOCK_WRITE_OK;
+  posFlagSet(sock->uipChange, 0);
+  posMutexUnlock(sock->mutex);
+}
+
+#endif
+
+/*
+ * Poll UDP connection and send datagram
+ * it generates.
+ */
+static void netUdpOutput(uint8_t i)
+{
+  uip_len = 0;
+  netInterfaceEnter(netInterfaceRoute(&uip_udp_conns[i].ripaddr));
+  uip_udp_periodic(i);
+  if(uip_len > 0) {
+
+#if NETSTACK_CONF_WITH_IPV6
+    tcpip_ipv6_output();
+#else
+    tcpip_output();
+#endif
+  }
+
+  netInterfaceLeave();
+#if NETCFG_XMITV == 1
+  netUdpXmitvDone();
+#endif
+}
+
+/*
+ * Poll UDP connection. If socket is sending datagrams
+ * with destinations (netSockSendBatch), connection is
+ * pointed to each destination in turn and all of them are
+ * sent now, instead of one per main loop pass.
+ */
+static void netUdpPollConn(uint8_t i)
+{
+  struct uip_udp_conn* conn = &uip_udp_conns[i];
+  UosFile* file = conn->appstate.file;
+  NetSock* sock = NULL;
+  const NetSockDgram* m;
+  uip_ipaddr_t ripaddr;
+  uint16_t rport;
+  uint16_t next;
+
+  if (file != NULL && conn->lport != 0) {
+
+    NetSock* s = (NetSock*)file->fsPriv;
+
+    posMutexLock(s->mutex);
+    if (s->state == NET_SOCK_WRITING && s->txMsgs != NULL)
+      sock = s;
+
+    posMutexUnlock(s->mutex);
+  }
+
+  if (sock == NULL) {
+
+    netUdpOutput(i);
+    return;
+  }
+
+  uip_ipaddr_copy(&ripaddr, &conn->ripaddr);
+  rport = conn->rport;
+
+  // Writer waits for WRITE_OK, so txMsgs and
+  // txNext are changed only by appcall here.
+  while (sock->txNext < sock->txCount) {
+
+    next = sock->txNext;
+    m = &sock->txMsgs[next];
+    if (m->port == 0) {
+
+      // Datagram without destination goes to
+      // connected peer, if there is one.
+      if (rport == 0)
+        break;
+
+      uip_ipaddr_copy(&conn->ripaddr, &ripaddr);
+      conn->rport = rport;
+    }
+    else {
+
+      uip_ipaddr_copy(&conn->ripaddr, &m->addr);
+      conn->rport = uip_htons(m->port);
     }
+
+    netUdpOutput(i);
+    if (sock->txNext == next)
+      break;
   }
+
+  uip_ipaddr_copy(&conn->ripaddr, &ripaddr);
+  conn->rport = rport;
+
+  posMutexLock(sock->mutex);
+  sock->state = NET_SOCK_WRITE_OK;
+  posFlagSet(sock->uipChange, 0);
+  posMutexUnlock(sock->mutex);
 }
 
 #endif
@@ -854,13 +1882,43 @@ void netInit()
   int i;
 
   uipGiant = posSemaCreate(0);
-  uipMutex = posMutexCreate();
 
   pollTicks = INFINITE;
-  P_ASSERT("netInit", uipGiant != NULL && uipMutex != NULL);
+  cmdQueue = NULL;
+  P_ASSERT("netInit", uipGiant != NULL);
 
   POS_SETEVENTNAME(uipGiant, "uip:giant");
-  POS_SETEVENTNAME(uipMutex, "uip:mutex");
+
+// Socket pool. Synchronization objects are created once
+// here, so setting up a connection doesn't need to create them.
+
+  for (i = 0; i < SOCK_TABSIZE; i++) {
+
+    NetSock* sock = UOS_BITTAB_ELEM(netSocketTable, i);
+
+    sock->state = NET_SOCK_NULL;
+    sock->mutex = posMutexCreate();
+    sock->sockChange = posFlagCreate();
+    sock->uipChange = posFlagCreate();
+
+    P_ASSERT("netInit", sock->mutex != NULL && sock->sockChange != NULL && sock->uipChange != NULL);
+
+    POS_SETEVENTNAME(sock->mutex, "sock:mutex");
+    POS_SETEVENTNAME(sock->sockChange, "sock:api");
+    POS_SETEVENTNAME(sock->uipChange, "sock:uip");
+  }
+
+  memset(listeners, '\0', sizeof(listeners));
+  for (i = 0; i < UIP_LISTENPORTS; i++) {
+
+    listeners[i].acceptSema = posSemaCreate(0);
+    P_ASSERT("netInit", listeners[i].acceptSema != NULL);
+    POS_SETEVENTNAME(listeners[i].acceptSema, "sock:accept");
+  }
+
+#if UIP_CONF_UDP == 1
+  memb_init(&udpDgramPool);
+#endif
 
 // uosFS setup
 
@@ -883,7 +1941,7 @@ void netInit()
     uip_udp_conns[i].appstate.file = NULL;
 #endif /* UIP_UDP */
 
-  netInterfaceInit();
+  netInterfaceInitAll();
   uip_init();
 
 #if NETSTACK_CONF_WITH_IPV6 == 0
@@ -893,6 +1951,10 @@ void netInit()
   t = posTaskCreate(netMainThread, NULL, NETCFG_TASK_PRIORITY, NETCFG_STACK_SIZE);
   P_ASSERT("netInit2", t != NULL);
   POS_SETTASKNAME(t, "uip:main");
+
+#if NETCFG_DNS == 1
+  netResolveInit();
+#endif
 }
 
 void netMainThread(void* arg)
@@ -904,6 +1966,10 @@ void netMainThread(void* arg)
   POSTIMER_t periodicTimer;
   int sendRequested;
   bool packetSeen;
+#if NETCFG_STATS == 1
+  JIF_t loopStart;
+  JIF_t loopTicks;
+#endif
 
 #if !NETSTACK_CONF_WITH_IPV6
   arpTimer = posTimerCreate();
@@ -916,17 +1982,13 @@ void netMainThread(void* arg)
   periodicTimer = posTimerCreate();
   P_ASSERT("netMainThread2", periodicTimer != NULL);
 
-  posTimerSet(periodicTimer, uipGiant, MS(500), MS(500));
+  posTimerSet(periodicTimer, uipGiant, MS(1000 / NET_PERIODIC_HZ), MS(1000 / NET_PERIODIC_HZ));
   posTimerStart(periodicTimer);
 
-  posMutexLock(uipMutex);
-
   packetSeen = false;
 
   while(1) {
 
-    posMutexUnlock(uipMutex);
-
     // Using semaphore here is not fully optimal.
     // As it is a counting one, it can get bumped
     // to larger value than 1 by upper or interrupt 
@@ -940,7 +2002,8 @@ void netMainThread(void* arg)
     if (!packetSeen || pollTicks == INFINITE)
       posSemaWait(uipGiant, pollTicks);
 
-    posMutexLock(uipMutex);
+    NET_STAT(loopStart = jiffies);
+    netSockCommandRun();
 
     sendRequested = dataToSend;
     dataToSend = 0;
@@ -951,6 +2014,7 @@ void netMainThread(void* arg)
       for(i = 0; i < UIP_CONNS; i++) {
 
         uip_len = 0;
+        netInterfaceEnter(netInterfaceRoute(&uip_conns[i].ripaddr));
         uip_poll_conn(&uip_conns[i]);
         if(uip_len > 0) {
 
@@ -964,32 +2028,24 @@ void netMainThread(void* arg)
 #endif
 #endif
         }
+
+        netInterfaceLeave();
       }
 
 #if UIP_UDP
-      for(i = 0; i < UIP_UDP_CONNS; i++) {
-
-        uip_len = 0;
-        uip_udp_periodic(i);
-        if(uip_len > 0) {
-
-#if NETSTACK_CONF_WITH_IPV6
-          tcpip_ipv6_output();
-#else
-          tcpip_output();
-#endif
-        }
-      }
+      for(i = 0; i < UIP_UDP_CONNS; i++)
+        netUdpPollConn(i);
 #endif /* UIP_UDP */
 
     }
 
-    packetSeen = netInterfacePoll();
+    packetSeen = netInterfacePollAll();
 
     if (posTimerFired(periodicTimer)) {
 
       for(i = 0; i < UIP_CONNS; i++) {
 
+        netInterfaceEnter(netInterfaceRoute(&uip_conns[i].ripaddr));
         uip_periodic(i);
         if(uip_len > 0) {
 
@@ -1003,21 +2059,13 @@ void netMainThread(void* arg)
 #endif
 #endif
         }
+
+        netInterfaceLeave();
       }
 
 #if UIP_UDP
-      for(i = 0; i < UIP_UDP_CONNS; i++) {
-
-        uip_udp_periodic(i);
-        if(uip_len > 0) {
-
-#if NETSTACK_CONF_WITH_IPV6
-          tcpip_ipv6_output();
-#else
-          tcpip_output();
-#endif
-        }
-      }
+      for(i = 0; i < UIP_UDP_CONNS; i++)
+        netUdpPollConn(i);
 #endif /* UIP_UDP */
 
     }
@@ -1036,11 +2084,23 @@ void netMainThread(void* arg)
 
     etimer_request_poll();
 
+#if NETCFG_STATS == 1
+    loopTicks = jiffies - loopStart;
+    ++netStats.loops;
+    netStats.busyTicks += loopTicks;
+    if (loopTicks > netStats.maxLoopTicks)
+      netStats.maxLoopTicks = loopTicks;
+#endif
   }
 }
 
 void etimer_callback(struct etimer* et)
 {
+#if UIP_XMITV
+  // Timers generate new packets to uip_buf.
+  uip_xmitv_clear();
+#endif
+
 #if NETSTACK_CONF_WITH_IPV6
    
 #if !UIP_CONF_ROUTER
@@ -1056,6 +2116,14 @@ void etimer_callback(struct etimer* et)
       uip_ds6_periodic();
       tcpip_ipv6_output();
     }
+
+#if UIP_CONF_IPV6_REASSEMBLY
+    if (et == &uip_reass_timer) {
+
+      uip_reass_over();
+      tcpip_ipv6_output();
+    }
+#endif
 #endif
 
 }
@@ -1071,4 +2139,119 @@ void netInterrupt()
   posSemaSignal(uipGiant);
 }
 
+#if NETCFG_STATS == 1
+
+void netStatsGet(NetStats* stats)
+{
+  posTaskSchedLock();
+  *stats = netStats;
+  posTaskSchedUnlock();
+}
+
+void netStatsReset()
+{
+  posTaskSchedLock();
+  memset(&netStats, 0, sizeof(netStats));
+#if UIP_STATISTICS == 1
+  memset(&uip_stat, 0, sizeof(uip_stat));
+#endif
+  posTaskSchedUnlock();
+}
+
+static void netStatsDumpHist(NetStatsPrint print, void* arg, const char* name, const NetStatsHist* h)
+{
+  char line[80];
+  int  len;
+  int  b;
+
+  len = snprintf(line, sizeof(line), "%-8s", name);
+  for (b = 0; b < NET_STATS_BUCKETS; b++) {
+
+    if (h->bucket[b] == 0)
+      continue;
+
+    if (len > (int)sizeof(line) - 16) {
+
+      print(arg, line);
+      print(arg, "\n");
+      len = snprintf(line, sizeof(line), "%-8s", "");
+    }
+
+    len += snprintf(line + len, sizeof(line) - len, " %lu:%lu",
+                    b == 0 ? 0ul : 1ul << (b - 1), (unsigned long)h->bucket[b]);
+  }
+
+  print(arg, line);
+  print(arg, "\n");
+}
+
+void netStatsDump(NetStatsPrint print, void* arg)
+{
+  char line[80];
+  NetStats st;
+  NetSock* sock;
+  int i;
+
+#if UIP_STATISTICS == 1
+  snprintf(line, sizeof(line), "ip   recv %lu sent %lu drop %lu\n",
+           (unsigned long)uip_stat.ip.recv, (unsigned long)uip_stat.ip.sent,
+           (unsigned long)uip_stat.ip.drop);
+  print(arg, line);
+
+  snprintf(line, sizeof(line), "icmp recv %lu sent %lu drop %lu\n",
+           (unsigned long)uip_stat.icmp.recv, (unsigned long)uip_stat.icmp.sent,
+           (unsigned long)uip_stat.icmp.drop);
+  print(arg, line);
+
+  snprintf(line, sizeof(line), "tcp  recv %lu sent %lu drop %lu rexmit %lu syndrop %lu\n",
+           (unsigned long)uip_stat.tcp.recv, (unsigned long)uip_stat.tcp.sent,
+           (unsigned long)uip_stat.tcp.drop, (unsigned long)uip_stat.tcp.rexmit,
+           (unsigned long)uip_stat.tcp.syndrop);
+  print(arg, line);
+
+#if UIP_UDP
+  snprintf(line, sizeof(line), "udp  recv %lu sent %lu drop %lu\n",
+           (unsigned long)uip_stat.udp.recv, (unsigned long)uip_stat.udp.sent,
+           (unsigned long)uip_stat.udp.drop);
+  print(arg, line);
+#endif
+#endif
+
+  netStatsGet(&st);
+
+  snprintf(line, sizeof(line), "loop %lu busy %lu max %lu ticks\n",
+           (unsigned long)st.loops, (unsigned long)st.busyTicks,
+           (unsigned long)st.maxLoopTicks);
+  print(arg, line);
+
+  netStatsDumpHist(print, arg, "read", &st.read);
+  netStatsDumpHist(print, arg, "write", &st.write);
+  netStatsDumpHist(print, arg, "connect", &st.connect);
+  netStatsDumpHist(print, arg, "accept", &st.accept);
+  netStatsDumpHist(print, arg, "appwait", &st.appWait);
+
+  snprintf(line, sizeof(line), "accept queued %lu overflow %lu\n",
+           (unsigned long)st.acceptQueued, (unsigned long)st.acceptOverflows);
+  print(arg, line);
+
+  snprintf(line, sizeof(line), "udp queued %lu drop %lu\n",
+           (unsigned long)st.udpQueued, (unsigned long)st.udpDrops);
+  print(arg, line);
+
+  for (i = 0; i < SOCK_TABSIZE; i++) {
+
+    if (UOS_BITTAB_IS_FREE(netSocketTable, i))
+      continue;
+
+    sock = UOS_BITTAB_ELEM(netSocketTable, i);
+    snprintf(line, sizeof(line), "sock %d state %d rx %lu/%lu tx %lu/%lu\n",
+             i, (int)sock->state,
+             (unsigned long)sock->stats.rxBytes, (unsigned long)sock->stats.rxSegs,
+             (unsigned long)sock->stats.txBytes, (unsigned long)sock->stats.txSegs);
+    print(arg, line);
+  }
+}
+
+#endif
+
 #endif
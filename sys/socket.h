@@ -97,7 +97,7 @@ typedef uint32_t socklen_t;
 #define  SO_DEBUG       0x0001 /* Unimplemented */
 #define  SO_ACCEPTCONN  0x0002 /* socket has had listen() */
 #define  SO_REUSEADDR   0x0004 /* Unimplemented */
-#define  SO_KEEPALIVE   0x0008 /* Unimplemented */
+#define  SO_KEEPALIVE   0x0008 /* keep connections alive (NETCFG_TCP_KEEPALIVE) */
 #define  SO_DONTROUTE   0x0010 /* Unimplemented */
 #define  SO_BROADCAST   0x0020 /* Unimplemented */
 #define  SO_USELOOPBACK 0x0040 /* Unimplemented */
@@ -121,6 +121,13 @@ typedef uint32_t socklen_t;
 #define SO_CONTIMEO  0x1009    /* Unimplemented */
 #define SO_NO_CHECK  0x100a    /* Unimplemented */
 
+/*
+ * Options for level IPPROTO_TCP.
+ */
+#define TCP_KEEPIDLE  0x03     /* seconds before first keepalive probe */
+#define TCP_KEEPINTVL 0x04     /* seconds between keepalive probes */
+#define TCP_KEEPCNT   0x05     /* number of unanswered probes */
+
 
 /*
  * Structure used for manipulating linger option.
@@ -163,6 +170,32 @@ struct timeval {
   long    tv_usec;        /* and microseconds */
 };
 
+struct iovec {
+  void   *iov_base;
+  size_t  iov_len;
+};
+
+/*
+ * Message header for net_recvmmsg and net_sendmmsg. Only one
+ * buffer (msg_iov[0]) is supported per datagram,
+ * control data is not supported. Datagrams are handled
+ * NETCFG_MMSG_BATCH at a time.
+ */
+struct msghdr {
+  void         *msg_name;       /* address of peer */
+  socklen_t     msg_namelen;
+  struct iovec *msg_iov;
+  int           msg_iovlen;
+  void         *msg_control;
+  socklen_t     msg_controllen;
+  int           msg_flags;
+};
+
+struct mmsghdr {
+  struct msghdr msg_hdr;
+  unsigned int  msg_len;        /* bytes received or sent */
+};
+
 int net_accept(int s, struct sockaddr *addr, socklen_t *addrlen);
 int net_bind(int s, const struct sockaddr *name, socklen_t namelen);
 int net_getsockopt (int s, int level, int optname, void *optval, socklen_t *optlen);
@@ -171,7 +204,11 @@ int net_close(int s);
 int net_connect(int s, const struct sockaddr *name, socklen_t namelen);
 int net_listen(int s, int backlog);
 int net_recv(int s, void *mem, size_t len, int flags);
+int net_recvfrom(int s, void *mem, size_t len, int flags, struct sockaddr *from, socklen_t *fromlen);
+int net_recvmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen, int flags);
 int net_send(int s, const void *dataptr, size_t size, int flags);
+int net_sendto(int s, const void *dataptr, size_t size, int flags, const struct sockaddr *to, socklen_t tolen);
+int net_sendmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen, int flags);
 int net_socket(int domain, int type, int protocol);
 int net_read(int s, void *mem, size_t len);
 int net_write(int s, const void *dataptr, size_t size);
@@ -185,7 +222,11 @@ int net_write(int s, const void *dataptr, size_t size);
 #define getsockopt(a,b,c,d,e) net_getsockopt(a,b,c,d,e)
 #define listen(a,b)           net_listen(a,b)
 #define recv(a,b,c,d)         net_recv(a,b,c,d)
+#define recvfrom(a,b,c,d,e,f) net_recvfrom(a,b,c,d,e,f)
+#define recvmmsg(a,b,c,d)     net_recvmmsg(a,b,c,d)
 #define send(a,b,c,d)         net_send(a,b,c,d)
+#define sendto(a,b,c,d,e,f)   net_sendto(a,b,c,d,e,f)
+#define sendmmsg(a,b,c,d)     net_sendmmsg(a,b,c,d)
 #define socket(a,b,c)         net_socket(a,b,c)
 #define htons(v)              uip_htons(v)
 #endif
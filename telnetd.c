@@ -55,21 +55,52 @@
 #define TELNET_DO    253
 #define TELNET_DONT  254
 
-void telnetInit(NetTelnet* state, int sock)
+static const char outSpecial[] = { '\n', (char)TELNET_IAC };
+static const char inSpecial[]  = { '\n', '\r', (char)TELNET_IAC };
+
+/*
+ * Return length of data before first
+ * special character (or len if there is none).
+ */
+static int plainLen(const char* data, int len, const char* special, int count)
+{
+  const char* p;
+
+  while (count--) {
+
+    p = memchr(data, *special++, len);
+    if (p != NULL)
+      len = p - data;
+  }
+
+  return len;
+}
+
+/*
+ * Set receive timeout for socket. Timeout is
+ * remembered, so it is set again only if it changes.
+ */
+static void setTimeout(NetTelnet* conn, int timeout)
 {
   struct timeval tv;
 
+  tv.tv_sec = timeout / 1000;
+  tv.tv_usec = (timeout % 1000) * 1000L;
+
+  setsockopt(conn->sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  conn->timeout = timeout;
+}
+
+void telnetInit(NetTelnet* state, int sock)
+{
   state->outPtr = state->outBuf;
   state->inPtr  = state->inBuf;
   state->inLen  = 0;
   state->state = STATE_NORMAL;
+  state->sock = sock;
   
-  tv.tv_sec = 0;
-  tv.tv_usec = 500 * 1000L;
-
-  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setTimeout(state, 500);
   state->inLen = recv(sock, state->inBuf, sizeof(state->inBuf), 0);
-  state->sock = sock;
   if (state->inLen < 0)
     state->inLen = 0;
 }
@@ -77,33 +108,66 @@ void telnetInit(NetTelnet* state, int sock)
 void telnetWrite(NetTelnet* conn, char* data)
 {
   int len = strlen(data);
+  int run;
 
   while (len) {
 
-    if ((size_t)(conn->outPtr - conn->outBuf + 1) >= sizeof(conn->outBuf)) {
+    // Copy characters that need no translation in bulk.
+    run = plainLen(data, len, outSpecial, sizeof(outSpecial));
+    if (run >= (int)sizeof(conn->outBuf)) {
+
+      // Too long to be buffered, send directly.
+      telnetFlush(conn);
+      send(conn->sock, data, run, 0);
+    }
+    else if (run > 0) {
+
+      if (run > conn->outBuf + sizeof(conn->outBuf) - conn->outPtr)
+        telnetFlush(conn);
 
-      send(conn->sock, conn->outBuf, conn->outPtr - conn->outBuf, 0);
-      conn->outPtr = conn->outBuf;
+      memcpy(conn->outPtr, data, run);
+      conn->outPtr += run;
     }
 
+    data += run;
+    len -= run;
+    if (len == 0)
+      break;
+
+    if ((size_t)(conn->outPtr - conn->outBuf + 1) >= sizeof(conn->outBuf))
+      telnetFlush(conn);
+
     if (*data == '\n') {
 
       *conn->outPtr++ = '\r';
       *conn->outPtr++ = '\n';
     }
-    else if (*((unsigned char*)data) == TELNET_IAC) {
+    else {
 
       *conn->outPtr++ = TELNET_IAC;
       *conn->outPtr++ = TELNET_IAC;
     }
-    else
-      *conn->outPtr++ = *data;
 
     ++data;
     --len;
   }
 }
 
+#if NETCFG_STATS == 1
+
+static void statsPrint(void* arg, const char* text)
+{
+  telnetWrite((NetTelnet*)arg, (char*)text);
+}
+
+void telnetStatsDump(NetTelnet* conn)
+{
+  netStatsDump(statsPrint, conn);
+  telnetFlush(conn);
+}
+
+#endif
+
 void telnetFlush(NetTelnet* conn)
 {
   if (conn->outPtr != conn->outBuf) {
@@ -130,22 +194,44 @@ int telnetReadLine(NetTelnet* conn, char* data, int max, int timeout)
 {
   uint8_t c;
   int len = 0;
+  int run;
   bool gotLine = false;
   max = max - 1;
-  struct timeval tv;
+
+  if (timeout != conn->timeout)
+    setTimeout(conn, timeout);
 
   do {
     
     if (conn->inLen == 0) {
 
-      tv.tv_sec = 0;
-      tv.tv_usec = timeout * 1000L;
-
-      setsockopt(conn->sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
       conn->inLen = recv(conn->sock, conn->inBuf, sizeof(conn->inBuf), 0);
       conn->inPtr = conn->inBuf;
-      if (conn->inLen <= 0)
-        return conn->inLen;
+      if (conn->inLen <= 0) {
+
+        run = conn->inLen;
+        conn->inLen = 0;
+        return run;
+      }
+    }
+
+    if (conn->state == STATE_NORMAL) {
+
+      // Copy plain characters in bulk, state
+      // machine handles only special ones.
+      run = conn->inLen;
+      if (run > max - len)
+        run = max - len;
+
+      run = plainLen(conn->inPtr, run, inSpecial, sizeof(inSpecial));
+      memcpy(data, conn->inPtr, run);
+      data += run;
+      len += run;
+      conn->inPtr += run;
+      conn->inLen -= run;
+
+      if (conn->inLen == 0 || len == max)
+        continue;
     }
 
     c = *conn->inPtr;
@@ -238,7 +324,7 @@ int telnetReadLine(NetTelnet* conn, char* data, int max, int timeout)
       break;
     }
 
-  } while(!gotLine);
+  } while(!gotLine && len < max);
 
   telnetFlush(conn);
 